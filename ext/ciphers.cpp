@@ -41,12 +41,21 @@
 #include "jseal.h"
 
 #include "jbasiccipherinfo.h"
+#include "jcipherspec.h"
 #include "jexception.h"
+#include "jfilecrypter.h"
+#include "jgvl.h"
+#include "jhash.h"
+#include "jkeyschedulecache.h"
+#include "jmultibuffercbc.h"
+#include "jnoncesequence.h"
 
 #include "cryptopp_ruby_api.h"
 
 extern void cipher_mark(JBase *c);
 extern void cipher_free(JBase *c);
+extern void nonce_sequence_free(JNonceSequence *n);
+extern void cipher_spec_free(JCipherSpec *s);
 
 // forward declarations
 
@@ -54,22 +63,30 @@ static CipherEnum cipher_sym_to_const(VALUE cipher);
 static ModeEnum mode_sym_to_const(VALUE m);
 static PaddingEnum padding_sym_to_const(VALUE p);
 static RNGEnum rng_sym_to_const(VALUE rng);
+static CompressionEnum compression_option(VALUE options, const char* name);
 
 static bool cipher_enabled(CipherEnum cipher);
 static void cipher_options(VALUE self, VALUE options);
 static JBase* cipher_factory(long algorithm);
 static VALUE wrap_cipher_in_ruby(JBase* cipher);
 static void cipher_rand_iv(VALUE self, VALUE l);
-static string cipher_iv_eq(VALUE self, VALUE iv, bool hex);
-static string cipher_iv(VALUE self, bool hex);
-static string cipher_plaintext_eq(VALUE self, VALUE plaintext, bool hex);
-static string cipher_plaintext(VALUE self, bool hex);
-static string cipher_ciphertext_eq(VALUE self, VALUE ciphertext, bool hex);
-static string cipher_ciphertext(VALUE self, bool hex);
-static string cipher_key_eq(VALUE self, VALUE key, bool hex);
-static string cipher_key(VALUE self, bool hex);
-static VALUE cipher_encrypt(VALUE self, bool hex);
-static VALUE cipher_decrypt(VALUE self, bool hex);
+static void cipher_iv_eq(VALUE self, VALUE iv, RubyEncodingEnum encoding);
+static string nonce_sequence_next(VALUE self);
+static void nonce_sequence_check_size(VALUE self, JBase* cipher);
+static VALUE cipher_iv(VALUE self, RubyEncodingEnum encoding);
+static void cipher_plaintext_eq(VALUE self, VALUE plaintext, RubyEncodingEnum encoding);
+static VALUE cipher_plaintext(VALUE self, RubyEncodingEnum encoding);
+static void cipher_ciphertext_eq(VALUE self, VALUE ciphertext, RubyEncodingEnum encoding);
+static VALUE cipher_ciphertext(VALUE self, RubyEncodingEnum encoding);
+static void cipher_key_eq(VALUE self, VALUE key, RubyEncodingEnum encoding);
+static VALUE cipher_key(VALUE self, RubyEncodingEnum encoding);
+static VALUE cipher_encrypt(int argc, VALUE *argv, VALUE self, RubyEncodingEnum encoding);
+static VALUE cipher_decrypt(int argc, VALUE *argv, VALUE self, RubyEncodingEnum encoding);
+
+/* Inputs at least this long are encrypted and decrypted with the GVL
+ * released where we can. Below it, releasing and reacquiring the GVL costs
+ * more than the crypto. */
+#define CIPHER_WITHOUT_GVL_THRESHOLD 16384
 
 static CipherEnum cipher_sym_to_const(VALUE c)
 {
@@ -149,6 +166,33 @@ static RNGEnum rng_sym_to_const(VALUE r)
   return rng;
 }
 
+/* Reads a compression Symbol out of options[name], which may be missing. */
+static CompressionEnum compression_option(VALUE options, const char* name)
+{
+  VALUE value = Qnil;
+
+  if (!NIL_P(options)) {
+    Check_Type(options, T_HASH);
+    value = rb_hash_aref(options, ID2SYM(rb_intern(name)));
+  }
+  if (NIL_P(value)) {
+    return NO_COMPRESSION;
+  }
+
+  Check_Type(value, T_SYMBOL);
+  ID id = SYM2ID(value);
+  if (false) {
+    // no-op so we can use our x-macro
+  }
+#  define COMPRESSION_X(c, s) \
+  else if (id == rb_intern(# s)) { \
+    return c ## _COMPRESSION; \
+  }
+#  include "defs/compressions.def"
+
+  rb_raise(rb_eCryptoPP_Error, "invalid %s option", name);
+}
+
 
 /* See if a cipher algorithm is enabled. */
 static bool cipher_enabled(CipherEnum cipher)
@@ -169,44 +213,26 @@ static void cipher_options(VALUE self, VALUE options)
   Check_Type(options, T_HASH);
 
   {
-    VALUE plaintext = rb_hash_aref(options, ID2SYM(rb_intern("plaintext")));
-    VALUE plaintext_hex = rb_hash_aref(options, ID2SYM(rb_intern("plaintext_hex")));
-    if (!NIL_P(plaintext) && !NIL_P(plaintext_hex)) {
-      rb_raise(rb_eCryptoPP_Error, "can't set both plaintext and plaintext_hex in options");
-    }
-    else if (!NIL_P(plaintext)) {
-      cipher_plaintext_eq(self, plaintext, false);
-    }
-    else if (!NIL_P(plaintext_hex)) {
-      cipher_plaintext_eq(self, plaintext_hex, true);
+    RubyEncodingEnum encoding;
+    VALUE plaintext = getEncodedRubyOption(options, "plaintext", &encoding);
+    if (!NIL_P(plaintext)) {
+      cipher_plaintext_eq(self, plaintext, encoding);
     }
   }
 
   {
-    VALUE ciphertext = rb_hash_aref(options, ID2SYM(rb_intern("ciphertext")));
-    VALUE ciphertext_hex = rb_hash_aref(options, ID2SYM(rb_intern("ciphertext_hex")));
-    if (!NIL_P(ciphertext) && !NIL_P(ciphertext_hex)) {
-      rb_raise(rb_eCryptoPP_Error, "can't set both ciphertext and ciphertext_hex in options");
-    }
-    else if (!NIL_P(ciphertext)) {
-      cipher_ciphertext_eq(self, ciphertext, false);
-    }
-    else if (!NIL_P(ciphertext_hex)) {
-      cipher_ciphertext_eq(self, ciphertext_hex, true);
+    RubyEncodingEnum encoding;
+    VALUE ciphertext = getEncodedRubyOption(options, "ciphertext", &encoding);
+    if (!NIL_P(ciphertext)) {
+      cipher_ciphertext_eq(self, ciphertext, encoding);
     }
   }
 
   {
-    VALUE key = rb_hash_aref(options, ID2SYM(rb_intern("key")));
-    VALUE key_hex = rb_hash_aref(options, ID2SYM(rb_intern("key_hex")));
-    if (!NIL_P(key) && !NIL_P(key_hex)) {
-      rb_raise(rb_eCryptoPP_Error, "can't set both key and key_hex in options");
-    }
-    else if (!NIL_P(key)) {
-      cipher_key_eq(self, key, false);
-    }
-    else if (!NIL_P(key_hex)) {
-      cipher_key_eq(self, key_hex, true);
+    RubyEncodingEnum encoding;
+    VALUE key = getEncodedRubyOption(options, "key", &encoding);
+    if (!NIL_P(key)) {
+      cipher_key_eq(self, key, encoding);
     }
   }
 
@@ -226,6 +252,15 @@ static void cipher_options(VALUE self, VALUE options)
   }
 #  endif
 
+#  if ENABLED_AES_CIPHER
+  {
+    VALUE backend = rb_hash_aref(options, ID2SYM(rb_intern("backend")));
+    if (!NIL_P(backend)) {
+      rb_cipher_backend_eq(self, backend);
+    }
+  }
+#  endif
+
   {
     VALUE rounds = rb_hash_aref(options, ID2SYM(rb_intern("rounds")));
     if (!NIL_P(rounds)) {
@@ -241,24 +276,18 @@ static void cipher_options(VALUE self, VALUE options)
   }
 
   {
+    RubyEncodingEnum encoding;
     VALUE rand_iv = rb_hash_aref(options, ID2SYM(rb_intern("rand_iv")));
-    VALUE iv = rb_hash_aref(options, ID2SYM(rb_intern("iv")));
-    VALUE iv_hex = rb_hash_aref(options, ID2SYM(rb_intern("iv_hex")));
+    VALUE iv = getEncodedRubyOption(options, "iv", &encoding);
 
-    if (!NIL_P(rand_iv) && (!NIL_P(iv) || !NIL_P(iv_hex))) {
-      rb_raise(rb_eCryptoPP_Error, "can't set both rand_iv and iv or iv_hex in options");
-    }
-    else if (!NIL_P(iv) && !NIL_P(iv_hex)) {
-      rb_raise(rb_eCryptoPP_Error, "can't set both iv and iv_hex in options");
+    if (!NIL_P(rand_iv) && !NIL_P(iv)) {
+      rb_raise(rb_eCryptoPP_Error, "can't set both rand_iv and an iv in options");
     }
     else if (!NIL_P(rand_iv)) {
       cipher_rand_iv(self, rand_iv);
     }
     else if (!NIL_P(iv)) {
-      cipher_iv_eq(self, iv, false);
-    }
-    else if (!NIL_P(iv_hex)) {
-      cipher_iv_eq(self, iv_hex, true);
+      cipher_iv_eq(self, iv, encoding);
     }
   }
 
@@ -383,30 +412,42 @@ VALUE rb_cipher_rand_iv(VALUE self, VALUE l)
   JBase *cipher = NULL;
   unsigned int length = NUM2UINT(rb_funcall(l, rb_intern("to_i"), 0));
   Data_Get_Struct(self, JBase, cipher);
-  cipher->setRandIV(length);
+  try {
+    cipher->setRandIV(length);
+  }
+  catch (Exception& e) {
+    rb_raise(rb_eCryptoPP_Error, "Crypto++ exception: %s", e.GetWhat().c_str());
+  }
   return l;
 }
 
 
 /* Sets an IV on the cipher. */
-static string cipher_iv_eq(VALUE self, VALUE iv, bool hex)
+static void cipher_iv_eq(VALUE self, VALUE iv, RubyEncodingEnum encoding)
 {
   JBase *cipher = NULL;
-  Check_Type(iv, T_STRING);
   Data_Get_Struct(self, JBase, cipher);
-  cipher->setIV(string(StringValuePtr(iv), RSTRING_LEN(iv)), hex);
-  return cipher->getIV(hex);
+  if (rb_obj_is_kind_of(iv, rb_cCryptoPP_NonceSequence)) {
+    nonce_sequence_check_size(iv, cipher);
+    cipher->setIV(nonce_sequence_next(iv), false);
+  }
+  else {
+    cipher->setIV(decodeRubyString(iv, encoding), false);
+  }
 }
 
 /**
  * call-seq:
  *    iv=(iv) => String
+ *    iv=(nonce_sequence) => CryptoPP::NonceSequence
  *
- * Set an initialization vector on the Cipher.
+ * Set an initialization vector on the Cipher. Given a NonceSequence, the
+ * next nonce from it is used. For block ciphers the sequence's size has to
+ * match the cipher's block size, or an ArgumentError is raised.
  */
 VALUE rb_cipher_iv_eq(VALUE self, VALUE iv)
 {
-  cipher_iv_eq(self, iv, false);
+  cipher_iv_eq(self, iv, BINARY_ENCODING);
   return iv;
 }
 
@@ -419,17 +460,42 @@ VALUE rb_cipher_iv_eq(VALUE self, VALUE iv)
  */
 VALUE rb_cipher_iv_hex_eq(VALUE self, VALUE iv)
 {
-  cipher_iv_eq(self, iv, true);
+  cipher_iv_eq(self, iv, HEX_ENCODING);
+  return iv;
+}
+
+/**
+ * call-seq:
+ *    iv_b64=(iv) => String
+ *
+ * Set an initialization vector on the Cipher. This method uses Base64 data.
+ */
+VALUE rb_cipher_iv_b64_eq(VALUE self, VALUE iv)
+{
+  cipher_iv_eq(self, iv, BASE64_ENCODING);
+  return iv;
+}
+
+/**
+ * call-seq:
+ *    iv_b64url=(iv) => String
+ *
+ * Set an initialization vector on the Cipher. This method uses URL-safe
+ * Base64 data, with or without padding.
+ */
+VALUE rb_cipher_iv_b64url_eq(VALUE self, VALUE iv)
+{
+  cipher_iv_eq(self, iv, BASE64URL_ENCODING);
   return iv;
 }
 
 
 /* Gets the IV. */
-static string cipher_iv(VALUE self, bool hex)
+static VALUE cipher_iv(VALUE self, RubyEncodingEnum encoding)
 {
   JBase *cipher = NULL;
   Data_Get_Struct(self, JBase, cipher);
-  return cipher->getIV(hex);
+  return encodeRubyString(cipher->getIV(false), encoding);
 }
 
 /**
@@ -440,8 +506,7 @@ static string cipher_iv(VALUE self, bool hex)
  */
 VALUE rb_cipher_iv(VALUE self)
 {
-  string retval = cipher_iv(self, false);
-  return rb_tainted_str_new(retval.data(), retval.length());
+  return cipher_iv(self, BINARY_ENCODING);
 }
 
 /**
@@ -452,8 +517,29 @@ VALUE rb_cipher_iv(VALUE self)
  */
 VALUE rb_cipher_iv_hex(VALUE self)
 {
-  string retval = cipher_iv(self, true);
-  return rb_tainted_str_new(retval.data(), retval.length());
+  return cipher_iv(self, HEX_ENCODING);
+}
+
+/**
+ * call-seq:
+ *    iv_b64 => String
+ *
+ * Returns the Cipher's IV in Base64.
+ */
+VALUE rb_cipher_iv_b64(VALUE self)
+{
+  return cipher_iv(self, BASE64_ENCODING);
+}
+
+/**
+ * call-seq:
+ *    iv_b64url => String
+ *
+ * Returns the Cipher's IV in URL-safe Base64 without padding.
+ */
+VALUE rb_cipher_iv_b64url(VALUE self)
+{
+  return cipher_iv(self, BASE64URL_ENCODING);
 }
 
 
@@ -619,13 +705,11 @@ VALUE rb_cipher_rng(VALUE self)
 
 
 /* Set the plaintext. */
-static string cipher_plaintext_eq(VALUE self, VALUE plaintext, bool hex)
+static void cipher_plaintext_eq(VALUE self, VALUE plaintext, RubyEncodingEnum encoding)
 {
   JBase *cipher = NULL;
-  Check_Type(plaintext, T_STRING);
   Data_Get_Struct(self, JBase, cipher);
-  cipher->setPlaintext(string(StringValuePtr(plaintext), RSTRING_LEN(plaintext)), hex);
-  return cipher->getPlaintext(hex);
+  cipher->setPlaintext(decodeRubyString(plaintext, encoding), false);
 }
 
 /**
@@ -636,7 +720,7 @@ static string cipher_plaintext_eq(VALUE self, VALUE plaintext, bool hex)
  */
 VALUE rb_cipher_plaintext_eq(VALUE self, VALUE plaintext)
 {
-  cipher_plaintext_eq(self, plaintext, false);
+  cipher_plaintext_eq(self, plaintext, BINARY_ENCODING);
   return plaintext;
 }
 
@@ -648,17 +732,41 @@ VALUE rb_cipher_plaintext_eq(VALUE self, VALUE plaintext)
  */
 VALUE rb_cipher_plaintext_hex_eq(VALUE self, VALUE plaintext)
 {
-  cipher_plaintext_eq(self, plaintext, true);
+  cipher_plaintext_eq(self, plaintext, HEX_ENCODING);
+  return plaintext;
+}
+
+/**
+ * call-seq:
+ *    plaintext_b64=(string) => String
+ *
+ * Sets the plaintext on the Cipher in Base64 and returns the same.
+ */
+VALUE rb_cipher_plaintext_b64_eq(VALUE self, VALUE plaintext)
+{
+  cipher_plaintext_eq(self, plaintext, BASE64_ENCODING);
+  return plaintext;
+}
+
+/**
+ * call-seq:
+ *    plaintext_b64url=(string) => String
+ *
+ * Sets the plaintext on the Cipher in URL-safe Base64 and returns the same.
+ */
+VALUE rb_cipher_plaintext_b64url_eq(VALUE self, VALUE plaintext)
+{
+  cipher_plaintext_eq(self, plaintext, BASE64URL_ENCODING);
   return plaintext;
 }
 
 
 /* Get the plaintext. */
-static string cipher_plaintext(VALUE self, bool hex)
+static VALUE cipher_plaintext(VALUE self, RubyEncodingEnum encoding)
 {
   JBase *cipher = NULL;
   Data_Get_Struct(self, JBase, cipher);
-  return cipher->getPlaintext(hex);
+  return encodeRubyString(cipher->getPlaintext(false), encoding);
 }
 
 /**
@@ -669,8 +777,7 @@ static string cipher_plaintext(VALUE self, bool hex)
  */
 VALUE rb_cipher_plaintext(VALUE self)
 {
-  string retval = cipher_plaintext(self, false);
-  return rb_tainted_str_new(retval.data(), retval.length());
+  return cipher_plaintext(self, BINARY_ENCODING);
 }
 
 /**
@@ -681,19 +788,38 @@ VALUE rb_cipher_plaintext(VALUE self)
  */
 VALUE rb_cipher_plaintext_hex(VALUE self)
 {
-  string retval = cipher_plaintext(self, true);
-  return rb_tainted_str_new(retval.data(), retval.length());
+  return cipher_plaintext(self, HEX_ENCODING);
+}
+
+/**
+ * call-seq:
+ *    plaintext_b64 => String
+ *
+ * Gets the plaintext from the Cipher in Base64.
+ */
+VALUE rb_cipher_plaintext_b64(VALUE self)
+{
+  return cipher_plaintext(self, BASE64_ENCODING);
+}
+
+/**
+ * call-seq:
+ *    plaintext_b64url => String
+ *
+ * Gets the plaintext from the Cipher in URL-safe Base64 without padding.
+ */
+VALUE rb_cipher_plaintext_b64url(VALUE self)
+{
+  return cipher_plaintext(self, BASE64URL_ENCODING);
 }
 
 
 /* Set the ciphertext. */
-static string cipher_ciphertext_eq(VALUE self, VALUE ciphertext, bool hex)
+static void cipher_ciphertext_eq(VALUE self, VALUE ciphertext, RubyEncodingEnum encoding)
 {
   JBase *cipher = NULL;
-  Check_Type(ciphertext, T_STRING);
   Data_Get_Struct(self, JBase, cipher);
-  cipher->setCiphertext(string(StringValuePtr(ciphertext), RSTRING_LEN(ciphertext)), hex);
-  return cipher->getCiphertext(hex);
+  cipher->setCiphertext(decodeRubyString(ciphertext, encoding), false);
 }
 
 /**
@@ -704,7 +830,7 @@ static string cipher_ciphertext_eq(VALUE self, VALUE ciphertext, bool hex)
  */
 VALUE rb_cipher_ciphertext_eq(VALUE self, VALUE ciphertext)
 {
-  cipher_ciphertext_eq(self, ciphertext, false);
+  cipher_ciphertext_eq(self, ciphertext, BINARY_ENCODING);
   return ciphertext;
 }
 
@@ -716,17 +842,41 @@ VALUE rb_cipher_ciphertext_eq(VALUE self, VALUE ciphertext)
  */
 VALUE rb_cipher_ciphertext_hex_eq(VALUE self, VALUE ciphertext)
 {
-  cipher_ciphertext_eq(self, ciphertext, true);
+  cipher_ciphertext_eq(self, ciphertext, HEX_ENCODING);
+  return ciphertext;
+}
+
+/**
+ * call-seq:
+ *    ciphertext_b64=(string) => String
+ *
+ * Sets the ciphertext on the Cipher in Base64 and returns the same.
+ */
+VALUE rb_cipher_ciphertext_b64_eq(VALUE self, VALUE ciphertext)
+{
+  cipher_ciphertext_eq(self, ciphertext, BASE64_ENCODING);
+  return ciphertext;
+}
+
+/**
+ * call-seq:
+ *    ciphertext_b64url=(string) => String
+ *
+ * Sets the ciphertext on the Cipher in URL-safe Base64 and returns the same.
+ */
+VALUE rb_cipher_ciphertext_b64url_eq(VALUE self, VALUE ciphertext)
+{
+  cipher_ciphertext_eq(self, ciphertext, BASE64URL_ENCODING);
   return ciphertext;
 }
 
 
 /* Get the ciphertext. */
-static string cipher_ciphertext(VALUE self, bool hex)
+static VALUE cipher_ciphertext(VALUE self, RubyEncodingEnum encoding)
 {
   JBase *cipher = NULL;
   Data_Get_Struct(self, JBase, cipher);
-  return cipher->getCiphertext(hex);
+  return encodeRubyString(cipher->getCiphertext(false), encoding);
 }
 
 /**
@@ -737,8 +887,7 @@ static string cipher_ciphertext(VALUE self, bool hex)
  */
 VALUE rb_cipher_ciphertext(VALUE self)
 {
-  string retval = cipher_ciphertext(self, false);
-  return rb_tainted_str_new(retval.data(), retval.length());
+  return cipher_ciphertext(self, BINARY_ENCODING);
 }
 
 /**
@@ -749,21 +898,40 @@ VALUE rb_cipher_ciphertext(VALUE self)
  */
 VALUE rb_cipher_ciphertext_hex(VALUE self)
 {
-  string retval = cipher_ciphertext(self, true);
-  return rb_tainted_str_new(retval.data(), retval.length());
+  return cipher_ciphertext(self, HEX_ENCODING);
+}
+
+/**
+ * call-seq:
+ *    ciphertext_b64 => String
+ *
+ * Gets the ciphertext from the Cipher in Base64.
+ */
+VALUE rb_cipher_ciphertext_b64(VALUE self)
+{
+  return cipher_ciphertext(self, BASE64_ENCODING);
+}
+
+/**
+ * call-seq:
+ *    ciphertext_b64url => String
+ *
+ * Gets the ciphertext from the Cipher in URL-safe Base64 without padding.
+ */
+VALUE rb_cipher_ciphertext_b64url(VALUE self)
+{
+  return cipher_ciphertext(self, BASE64URL_ENCODING);
 }
 
 
 /* Set the key. The true length of the key might not be what you expect,
  * as different algorithms behave differently, i.e. 3Way has a fixed keylength
  * of 12 bytes, while Blowfish can use keys of 1 to 72 bytes. */
-static string cipher_key_eq(VALUE self, VALUE key, bool hex)
+static void cipher_key_eq(VALUE self, VALUE key, RubyEncodingEnum encoding)
 {
   JBase *cipher = NULL;
-  Check_Type(key, T_STRING);
   Data_Get_Struct(self, JBase, cipher);
-  cipher->setKey(string(StringValuePtr(key), RSTRING_LEN(key)), hex);
-  return cipher->getKey(hex);
+  cipher->setKey(decodeRubyString(key, encoding), false);
 }
 
 /**
@@ -785,7 +953,7 @@ static string cipher_key_eq(VALUE self, VALUE key, bool hex)
  */
 VALUE rb_cipher_key_eq(VALUE self, VALUE key)
 {
-  cipher_key_eq(self, key, false);
+  cipher_key_eq(self, key, BINARY_ENCODING);
   return key;
 }
 
@@ -808,17 +976,43 @@ VALUE rb_cipher_key_eq(VALUE self, VALUE key)
  */
 VALUE rb_cipher_key_hex_eq(VALUE self, VALUE key)
 {
-  cipher_key_eq(self, key, true);
+  cipher_key_eq(self, key, HEX_ENCODING);
+  return key;
+}
+
+/**
+ * call-seq:
+ *    key_b64=(string) => String
+ *
+ * Sets the key on the Cipher in Base64 and returns the same. The same
+ * truncation and padding rules as <tt>key=</tt> apply.
+ */
+VALUE rb_cipher_key_b64_eq(VALUE self, VALUE key)
+{
+  cipher_key_eq(self, key, BASE64_ENCODING);
+  return key;
+}
+
+/**
+ * call-seq:
+ *    key_b64url=(string) => String
+ *
+ * Sets the key on the Cipher in URL-safe Base64 and returns the same. The
+ * same truncation and padding rules as <tt>key=</tt> apply.
+ */
+VALUE rb_cipher_key_b64url_eq(VALUE self, VALUE key)
+{
+  cipher_key_eq(self, key, BASE64URL_ENCODING);
   return key;
 }
 
 
 /* Get the key. */
-static string cipher_key(VALUE self, bool hex)
+static VALUE cipher_key(VALUE self, RubyEncodingEnum encoding)
 {
   JBase *cipher = NULL;
   Data_Get_Struct(self, JBase, cipher);
-  return cipher->getKey(hex);
+  return encodeRubyString(cipher->getKey(false), encoding);
 }
 
 /**
@@ -829,8 +1023,7 @@ static string cipher_key(VALUE self, bool hex)
  */
 VALUE rb_cipher_key(VALUE self)
 {
-  string retval = cipher_key(self, false);
-  return rb_tainted_str_new(retval.data(), retval.length());
+  return cipher_key(self, BINARY_ENCODING);
 }
 
 /**
@@ -841,8 +1034,29 @@ VALUE rb_cipher_key(VALUE self)
  */
 VALUE rb_cipher_key_hex(VALUE self)
 {
-  string retval = cipher_key(self, true);
-  return rb_tainted_str_new(retval.data(), retval.length());
+  return cipher_key(self, HEX_ENCODING);
+}
+
+/**
+ * call-seq:
+ *    key_b64 => String
+ *
+ * Returns the key set on the Cipher in Base64.
+ */
+VALUE rb_cipher_key_b64(VALUE self)
+{
+  return cipher_key(self, BASE64_ENCODING);
+}
+
+/**
+ * call-seq:
+ *    key_b64url => String
+ *
+ * Returns the key set on the Cipher in URL-safe Base64 without padding.
+ */
+VALUE rb_cipher_key_b64url(VALUE self)
+{
+  return cipher_key(self, BASE64URL_ENCODING);
 }
 
 
@@ -979,6 +1193,62 @@ VALUE rb_cipher_effective_key_length(VALUE self)
 #endif
 
 
+#if ENABLED_AES_CIPHER
+/**
+ * call-seq:
+ *    backend=(backend) => Symbol
+ *
+ * Set the implementation of AES to use. This function can only be used
+ * with AES. Either :crypto_pp, the default, which is Crypto++'s own
+ * table-driven AES, or :bitsliced, which runs in constant time as it
+ * doesn't look anything up in tables by the key or data. It's the one to
+ * use on CPUs without AES instructions when timing attacks are a concern.
+ * It works through four blocks at a time, so it does best in the ECB, CTR
+ * and CBC decryption paths where the blocks are independent.
+ */
+VALUE rb_cipher_backend_eq(VALUE self, VALUE b)
+{
+  JBase *cipher = NULL;
+  Data_Get_Struct(self, JBase, cipher);
+  if (cipher->getCipherType() != AES_CIPHER) {
+    rb_raise(rb_eCryptoPP_Error, "backends can only be used with the AES cipher");
+  }
+
+  ID id = SYM2ID(b);
+  if (id == rb_intern("crypto_pp")) {
+    ((JAES*) cipher)->setBackend(CRYPTOPP_AES_BACKEND);
+  }
+  else if (id == rb_intern("bitsliced")) {
+    ((JAES*) cipher)->setBackend(BITSLICED_AES_BACKEND);
+  }
+  else {
+    rb_raise(rb_eCryptoPP_Error, "invalid AES backend");
+  }
+  return b;
+}
+
+
+/**
+ * call-seq:
+ *    backend => Symbol
+ *
+ * Gets the implementation of AES being used, either :crypto_pp or
+ * :bitsliced.
+ */
+VALUE rb_cipher_backend(VALUE self)
+{
+  JBase *cipher = NULL;
+  Data_Get_Struct(self, JBase, cipher);
+  if (((JAES*) cipher)->getBackend() == BITSLICED_AES_BACKEND) {
+    return ID2SYM(rb_intern("bitsliced"));
+  }
+  else {
+    return ID2SYM(rb_intern("crypto_pp"));
+  }
+}
+#endif
+
+
 /**
  * call-seq:
  *     block_size => Fixnum
@@ -1042,15 +1312,21 @@ VALUE rb_cipher_rounds(VALUE self)
 
 
 /* Encrypt the plaintext using the options set on the Cipher. This method will
- * return the ciphertext in binary or hex accordingly, but the raw ciphertext
- * will always be available through the ciphertext methods regardless. */
-static VALUE cipher_encrypt(VALUE self, bool hex)
+ * return the ciphertext in binary, hex or Base64 accordingly, but the raw
+ * ciphertext will always be available through the ciphertext methods
+ * regardless. */
+static VALUE cipher_encrypt(int argc, VALUE *argv, VALUE self, RubyEncodingEnum encoding)
 {
   JBase *cipher = NULL;
+  VALUE options;
+
+  rb_scan_args(argc, argv, "01", &options);
+  CompressionEnum compression = compression_option(options, "compress");
+
   Data_Get_Struct(self, JBase, cipher);
   try {
-    cipher->encrypt();
-    return rb_tainted_str_new(cipher->getCiphertext(hex).data(), cipher->getCiphertext(hex).length());
+    cipher->encrypt(compression);
+    return encodeRubyString(cipher->getCiphertext(false), encoding);
   }
   catch (Exception e) {
     rb_raise(rb_eCryptoPP_Error, "Crypto++ exception: %s", e.GetWhat().c_str());
@@ -1060,42 +1336,80 @@ static VALUE cipher_encrypt(VALUE self, bool hex)
 /**
  * call-seq:
  *     encrypt => String
+ *     encrypt(options) => String
  *
  * Encrypt the plaintext using the options set on the Cipher. This method will
  * return the ciphertext in binary. The raw ciphertext will always be available
  * through the ciphertext and ciphertext_hex afterwards.
+ *
+ * Available options:
+ *
+ * * <tt>:compress</tt> - <tt>:deflate</tt> or <tt>:gzip</tt> to compress
+ *   the plaintext on its way into the cipher. Decrypt with the same
+ *   <tt>:decompress</tt> option to get it back.
  */
-VALUE rb_cipher_encrypt(VALUE self)
+VALUE rb_cipher_encrypt(int argc, VALUE *argv, VALUE self)
 {
-  return cipher_encrypt(self, false);
+  return cipher_encrypt(argc, argv, self, BINARY_ENCODING);
 }
 
 /**
  * call-seq:
  *     encrypt_hex => String
+ *     encrypt_hex(options) => String
  *
  * Encrypt the plaintext using the options set on the Cipher. This method will
  * return the ciphertext in hex. The raw ciphertext will always be available
- * through the ciphertext and ciphertext_hex afterwards.
+ * through the ciphertext and ciphertext_hex afterwards. Takes the same options
+ * as <tt>encrypt</tt>.
+ */
+VALUE rb_cipher_encrypt_hex(int argc, VALUE *argv, VALUE self)
+{
+  return cipher_encrypt(argc, argv, self, HEX_ENCODING);
+}
+
+/**
+ * call-seq:
+ *     encrypt_b64 => String
+ *     encrypt_b64(options) => String
+ *
+ * Like <tt>encrypt</tt>, but returns the ciphertext in Base64.
+ */
+VALUE rb_cipher_encrypt_b64(int argc, VALUE *argv, VALUE self)
+{
+  return cipher_encrypt(argc, argv, self, BASE64_ENCODING);
+}
+
+/**
+ * call-seq:
+ *     encrypt_b64url => String
+ *     encrypt_b64url(options) => String
+ *
+ * Like <tt>encrypt</tt>, but returns the ciphertext in URL-safe Base64
+ * without padding.
  */
-VALUE rb_cipher_encrypt_hex(VALUE self)
+VALUE rb_cipher_encrypt_b64url(int argc, VALUE *argv, VALUE self)
 {
-  return cipher_encrypt(self, true);
+  return cipher_encrypt(argc, argv, self, BASE64URL_ENCODING);
 }
 
 
 /* Decrypt the ciphertext using the options set on the Cipher and store
  * it in the plaintext attribute. This method will return the plaintext
- * in binary or hex accordingly, but the raw plaintext will always be
+ * in binary, hex or Base64 accordingly, but the raw plaintext will always be
  * available through the plaintext methods regardless. */
-static VALUE cipher_decrypt(VALUE self, bool hex)
+static VALUE cipher_decrypt(int argc, VALUE *argv, VALUE self, RubyEncodingEnum encoding)
 {
   JBase *cipher = NULL;
+  VALUE options;
+
+  rb_scan_args(argc, argv, "01", &options);
+  CompressionEnum compression = compression_option(options, "decompress");
+
   Data_Get_Struct(self, JBase, cipher);
   try {
-    cipher->decrypt();
-    string retval = cipher->getPlaintext(hex);
-    return rb_tainted_str_new(retval.data(), retval.length());
+    cipher->decrypt(compression);
+    return encodeRubyString(cipher->getPlaintext(false), encoding);
   }
   catch (Exception e) {
     rb_raise(rb_eCryptoPP_Error, "Crypto++ exception: %s", e.GetWhat().c_str());
@@ -1105,298 +1419,1540 @@ static VALUE cipher_decrypt(VALUE self, bool hex)
 /**
  * call-seq:
  *     decrypt => String
+ *     decrypt(options) => String
  *
  * Decrypt the ciphertext using the options set on the Cipher. This method
  * will return the plaintext in binary. The raw plaintext will always be
  * available through the plaintext and plaintext_hex methods afterwards.
+ *
+ * Available options:
+ *
+ * * <tt>:decompress</tt> - <tt>:deflate</tt> or <tt>:gzip</tt> to
+ *   decompress the plaintext as it comes out of the cipher.
  */
-VALUE rb_cipher_decrypt(VALUE self)
+VALUE rb_cipher_decrypt(int argc, VALUE *argv, VALUE self)
 {
-  return cipher_decrypt(self, false);
+  return cipher_decrypt(argc, argv, self, BINARY_ENCODING);
 }
 
 /**
  * call-seq:
  *     decrypt_hex => String
+ *     decrypt_hex(options) => String
  *
  * Decrypt the ciphertext using the options set on the Cipher. This method
  * will return the plaintext in hex. The raw plaintext will always be
- * available through the plaintext and plaintext_hex methods afterwards.
+ * available through the plaintext and plaintext_hex methods afterwards. Takes
+ * the same options as <tt>decrypt</tt>.
  */
-VALUE rb_cipher_decrypt_hex(VALUE self)
+VALUE rb_cipher_decrypt_hex(int argc, VALUE *argv, VALUE self)
 {
-  return cipher_decrypt(self, true);
+  return cipher_decrypt(argc, argv, self, HEX_ENCODING);
 }
 
-
 /**
  * call-seq:
- *    encrypt_io(in, out) => true
- *
- * Encrypts a Ruby IO object and spits the result into another one. You can use
- * any sort of Ruby object as long as it implements <tt>eof?</tt>,
- * <tt>read</tt>, <tt>write</tt> and <tt>flush</tt>.
+ *     decrypt_b64 => String
+ *     decrypt_b64(options) => String
  *
- * Examples:
- *
- *  cipher.encrypt_io(File.open("http://example.com/"), File.open("test.out", 'w'))
- *
- *  output = StringIO.new
- *  cipher.encrypt_io(File.open('test.enc'), output)
+ * Like <tt>decrypt</tt>, but returns the plaintext in Base64.
  */
-VALUE rb_cipher_encrypt_io(VALUE self, VALUE in, VALUE out)
+VALUE rb_cipher_decrypt_b64(int argc, VALUE *argv, VALUE self)
 {
-  JBase *cipher = NULL;
-  Data_Get_Struct(self, JBase, cipher);
-  try {
-    cipher->encryptRubyIO(&in, &out);
-    return Qtrue;
-  }
-  catch (Exception e) {
-    rb_raise(rb_eCryptoPP_Error, "Crypto++ exception: %s", e.GetWhat().c_str());
-  }
+  return cipher_decrypt(argc, argv, self, BASE64_ENCODING);
 }
 
-
 /**
  * call-seq:
- *    decrypt_io(in, out) => true
+ *     decrypt_b64url => String
+ *     decrypt_b64url(options) => String
  *
- * Decrypts a Ruby IO object and spits the result into another one. You can use
- * any sort of Ruby object as long as it implements <tt>eof?</tt>,
- * <tt>read</tt>, <tt>write</tt> and <tt>flush</tt>.
- *
- * Examples:
- *
- *  cipher.decrypt_io(File.open("http://example.com/"), File.open("test.out", 'w'))
- *
- *  output = StringIO.new
- *  cipher.decrypt_io(File.open('test.enc'), output)
+ * Like <tt>decrypt</tt>, but returns the plaintext in URL-safe Base64
+ * without padding.
  */
-VALUE rb_cipher_decrypt_io(VALUE self, VALUE in, VALUE out)
+VALUE rb_cipher_decrypt_b64url(int argc, VALUE *argv, VALUE self)
 {
-  JBase *cipher = NULL;
-  Data_Get_Struct(self, JBase, cipher);
-  try {
-    cipher->decryptRubyIO(&in, &out);
-    return Qtrue;
-  }
-  catch (Exception e) {
+  return cipher_decrypt(argc, argv, self, BASE64URL_ENCODING);
+}
+
+
+/* Arguments for running blocks through a key schedule without the GVL. */
+struct cipher_blocks_args
+{
+  BlockCipher* bc;
+  const byte* in;
+  byte* out;
+  size_t length;
+};
+
+static void* cipher_blocks_without_gvl(void* data)
+{
+  struct cipher_blocks_args* args = (struct cipher_blocks_args*) data;
+
+  // with no flags every block is processed on its own, like ECB mode, and
+  // ciphers with multi-block kernels get to run them over the lot...
+  args->bc->AdvancedProcessBlocks(args->in, NULL, args->out, args->length, 0);
+  return NULL;
+}
+
+/* Encrypts or decrypts input, either a String of whole blocks or an Array of
+ * single blocks, block by block with no mode and no padding. Returns the
+ * output in the same shape as the input. */
+static VALUE cipher_blocks(VALUE self, VALUE input, bool encryption)
+{
+  JBase *cipher = NULL;
+  struct cipher_blocks_args args;
+  VALUE packed, retval;
+
+  Data_Get_Struct(self, JBase, cipher);
+  if (IS_STREAM_CIPHER(cipher->getCipherType())) {
+    rb_raise(rb_eCryptoPP_Error, "can't process blocks with stream ciphers");
+  }
+
+  unsigned int block_size = cipher->getBlockSize();
+
+  if (TYPE(input) == T_ARRAY) {
+    packed = rb_str_buf_new(RARRAY_LEN(input) * block_size);
+    for (long i = 0; i < RARRAY_LEN(input); ++i) {
+      VALUE block = rb_ary_entry(input, i);
+      Check_Type(block, T_STRING);
+      if ((size_t) RSTRING_LEN(block) != block_size) {
+        rb_raise(rb_eCryptoPP_Error, "blocks must be %u bytes", block_size);
+      }
+      rb_str_buf_cat(packed, RSTRING_PTR(block), block_size);
+    }
+  }
+  else {
+    Check_Type(input, T_STRING);
+    if (RSTRING_LEN(input) % block_size != 0) {
+      rb_raise(rb_eCryptoPP_Error, "input must be a multiple of %u bytes", block_size);
+    }
+
+    // a frozen copy shares the input's buffer, and leaves it alone if the
+    // input is changed while we're working without the GVL...
+    packed = rb_str_new_frozen(input);
+  }
+
+  args.length = RSTRING_LEN(packed);
+  retval = rb_str_new(NULL, args.length);
+  args.in = (const byte*) RSTRING_PTR(packed);
+  args.out = (byte*) RSTRING_PTR(retval);
+
+  try {
+    args.bc = ((JCipher*) cipher)->getKeySchedule(encryption);
+  }
+  catch (Exception& e) {
+    rb_raise(rb_eCryptoPP_Error, "Crypto++ exception: %s", e.GetWhat().c_str());
+  }
+
+  if (args.length >= CIPHER_WITHOUT_GVL_THRESHOLD) {
+    callWithoutGVL(cipher_blocks_without_gvl, &args);
+  }
+  else {
+    cipher_blocks_without_gvl(&args);
+  }
+  delete args.bc;
+  RB_GC_GUARD(packed);
+
+  if (TYPE(input) == T_ARRAY) {
+    VALUE ary = rb_ary_new2(args.length / block_size);
+    for (size_t i = 0; i < args.length; i += block_size) {
+      rb_ary_push(ary, rb_tainted_str_new(RSTRING_PTR(retval) + i, block_size));
+    }
+    return ary;
+  }
+
+  OBJ_TAINT(retval);
+  return retval;
+}
+
+/**
+ * call-seq:
+ *    encrypt_blocks(blocks) => String or Array
+ *
+ * Encrypts each block on its own with the cipher's key, as in ECB mode but
+ * without a filter or padding in the way. The blocks may be given as a
+ * String whose length is a multiple of the block size, in which case a
+ * String of encrypted blocks is returned, or as an Array of single blocks,
+ * in which case an Array is returned. The whole lot is handed to the block
+ * cipher in one go, so ciphers that process several blocks at a time can
+ * do so. Handy for encrypting lots of 16-byte IDs or tokens with AES. The
+ * IV, block mode and padding are ignored.
+ */
+VALUE rb_cipher_encrypt_blocks(VALUE self, VALUE blocks)
+{
+  return cipher_blocks(self, blocks, true);
+}
+
+/**
+ * call-seq:
+ *    decrypt_blocks(blocks) => String or Array
+ *
+ * The inverse of <tt>encrypt_blocks</tt>.
+ */
+VALUE rb_cipher_decrypt_blocks(VALUE self, VALUE blocks)
+{
+  return cipher_blocks(self, blocks, false);
+}
+
+
+static void* cipher_many_without_gvl(void* data)
+{
+  ((JMultiBufferCBC*) data)->encrypt();
+  return NULL;
+}
+
+/**
+ * call-seq:
+ *    encrypt_many(plaintexts, ivs) => Array
+ *
+ * Encrypts each String in plaintexts in CBC mode with the cipher's key and
+ * padding and the IV at the same position in ivs, and returns an Array of
+ * the ciphertexts in the same order. Each ciphertext is exactly what
+ * <tt>encrypt</tt> would give for its message and IV, but CBC encryption
+ * can't be spread over the blocks of a single message, so the messages are
+ * interleaved instead, a block from each of several at a time, and ciphers
+ * that process several blocks at once get to do so. The IVs are binary and
+ * at least a block long. The cipher's own IV and plaintext are left alone.
+ */
+VALUE rb_cipher_encrypt_many(VALUE self, VALUE plaintexts, VALUE ivs)
+{
+  JBase *cipher = NULL;
+  BlockCipher* bc = NULL;
+  VALUE inputs, retval;
+  size_t total = 0;
+  long i, len;
+
+  Data_Get_Struct(self, JBase, cipher);
+  if (IS_STREAM_CIPHER(cipher->getCipherType())) {
+    rb_raise(rb_eCryptoPP_Error, "can't use encrypt_many with stream ciphers");
+  }
+  else if (((JCipher*) cipher)->getMode() != CBC_MODE) {
+    rb_raise(rb_eCryptoPP_Error, "encrypt_many only works in CBC mode");
+  }
+
+  Check_Type(plaintexts, T_ARRAY);
+  Check_Type(ivs, T_ARRAY);
+  len = RARRAY_LEN(plaintexts);
+  if (RARRAY_LEN(ivs) != len) {
+    rb_raise(rb_eArgError, "expected an IV for each plaintext");
+  }
+
+  unsigned int block_size = cipher->getBlockSize();
+  PaddingEnum padding = ((JCipher*) cipher)->getPadding();
+
+  // frozen copies of the plaintexts and IVs, which leave them alone if
+  // they're changed while we're working without the GVL, and the
+  // ciphertexts, all made up front as nothing can raise once we've got a
+  // key schedule...
+  inputs = rb_ary_new2(len * 2);
+  retval = rb_ary_new2(len);
+  for (i = 0; i < len; ++i) {
+    VALUE plaintext = RARRAY_PTR(plaintexts)[i];
+    VALUE iv = RARRAY_PTR(ivs)[i];
+
+    Check_Type(plaintext, T_STRING);
+    Check_Type(iv, T_STRING);
+    if ((size_t) RSTRING_LEN(iv) < block_size) {
+      rb_raise(rb_eCryptoPP_Error, "IVs must be at least %u bytes", block_size);
+    }
+    rb_ary_push(inputs, rb_str_new_frozen(plaintext));
+    rb_ary_push(inputs, rb_str_new_frozen(iv));
+
+    VALUE ciphertext = rb_str_new(NULL, JMultiBufferCBC::ciphertextLength(RSTRING_LEN(plaintext), block_size, padding));
+    OBJ_TAINT(ciphertext);
+    rb_ary_push(retval, ciphertext);
+    total += RSTRING_LEN(ciphertext);
+  }
+
+  try {
+    bc = ((JCipher*) cipher)->getKeySchedule(true);
+  }
+  catch (Exception& e) {
+    rb_raise(rb_eCryptoPP_Error, "Crypto++ exception: %s", e.GetWhat().c_str());
+  }
+
+  {
+    JMultiBufferCBC cbc(*bc, padding);
+
+    for (i = 0; i < len; ++i) {
+      VALUE plaintext = RARRAY_PTR(inputs)[i * 2];
+
+      cbc.add(
+        (const byte*) RSTRING_PTR(plaintext), RSTRING_LEN(plaintext),
+        (const byte*) RSTRING_PTR(RARRAY_PTR(inputs)[i * 2 + 1]),
+        (byte*) RSTRING_PTR(RARRAY_PTR(retval)[i])
+      );
+    }
+
+    if (total >= CIPHER_WITHOUT_GVL_THRESHOLD) {
+      callWithoutGVL(cipher_many_without_gvl, &cbc);
+    }
+    else {
+      cipher_many_without_gvl(&cbc);
+    }
+  }
+  delete bc;
+  RB_GC_GUARD(inputs);
+
+  return retval;
+}
+
+
+/* Runs input, a String or an IO, through the cipher and yields the output in
+ * chunks to the block. */
+static VALUE cipher_each(int argc, VALUE *argv, VALUE self, bool encryption)
+{
+  JBase *cipher = NULL;
+  VALUE input, options;
+  size_t chunk_size = RUBY_IO_DEFAULT_BUFFER_SIZE;
+  int state = 0;
+  string error;
+
+  RETURN_ENUMERATOR(self, argc, argv);
+  rb_scan_args(argc, argv, "11", &input, &options);
+
+  if (!NIL_P(options)) {
+    Check_Type(options, T_HASH);
+    VALUE c = rb_hash_aref(options, ID2SYM(rb_intern("chunk_size")));
+    if (!NIL_P(c) && (chunk_size = NUM2SIZET(c)) == 0) {
+      rb_raise(rb_eArgError, "chunk_size must be greater than 0");
+    }
+  }
+
+  // a frozen copy so the block can't pull the String out from under us...
+  if (TYPE(input) == T_STRING) {
+    input = rb_str_new_frozen(input);
+  }
+
+  Data_Get_Struct(self, JBase, cipher);
+  try {
+    JCipherFilter* filter = encryption ? cipher->getEncryptionFilter() : cipher->getDecryptionFilter();
+    if (filter == NULL) {
+      throw JException("could not create a filter for the cipher");
+    }
+    filter->Attach(new RubyYieldSink(chunk_size, &state));
+
+    if (TYPE(input) == T_STRING) {
+      StringSource((const byte*) RSTRING_PTR(input), RSTRING_LEN(input), true, filter);
+    }
+    else {
+      VALUE* in = &input;
+      RubyIOSource(&in, true, filter, chunk_size);
+    }
+  }
+  catch (Exception& e) {
+    error = e.GetWhat();
+  }
+
+  if (state != 0) {
+    rb_jump_tag(state);
+  }
+  else if (!error.empty()) {
+    rb_raise(rb_eCryptoPP_Error, "Crypto++ exception: %s", error.c_str());
+  }
+
+  return self;
+}
+
+/**
+ * call-seq:
+ *    encrypt_each(input) { |chunk| ... } => self
+ *    encrypt_each(input, options) { |chunk| ... } => self
+ *    encrypt_each(input) => Enumerator
+ *
+ * Encrypts input, which can be a String or an IO, and yields the ciphertext
+ * to the block a chunk at a time rather than building it all up. Every chunk
+ * is <tt>:chunk_size</tt> bytes long apart from the last, so memory use
+ * stays bounded by the chunk size however big the input is. The default is
+ * 64 KB. Without a block an Enumerator is returned.
+ *
+ * The ciphertext and plaintext attributes aren't touched.
+ *
+ * Example:
+ *
+ *  cipher.encrypt_each(File.open('big.dat'), :chunk_size => 1 << 20) do |chunk|
+ *    response.write(chunk)
+ *  end
+ */
+VALUE rb_cipher_encrypt_each(int argc, VALUE *argv, VALUE self)
+{
+  return cipher_each(argc, argv, self, true);
+}
+
+/**
+ * call-seq:
+ *    decrypt_each(input) { |chunk| ... } => self
+ *    decrypt_each(input, options) { |chunk| ... } => self
+ *    decrypt_each(input) => Enumerator
+ *
+ * Decrypts input, which can be a String or an IO, and yields the plaintext
+ * to the block a chunk at a time. See <tt>encrypt_each</tt>.
+ */
+VALUE rb_cipher_decrypt_each(int argc, VALUE *argv, VALUE self)
+{
+  return cipher_each(argc, argv, self, false);
+}
+
+/* Pumps in through the cipher into out, teeing off any digests asked for in
+ * the options. Returns true, or the digests if there were any. */
+static VALUE cipher_io(int argc, VALUE *argv, VALUE self, bool encryption)
+{
+  JBase *cipher = NULL;
+  VALUE in, out, options, plaintext_algorithms = Qnil, ciphertext_algorithms = Qnil;
+
+  rb_scan_args(argc, argv, "21", &in, &out, &options);
+  RubyIOOptions io_options = getRubyIOOptions(options);
+  if (!NIL_P(options)) {
+    plaintext_algorithms = rb_hash_aref(options, ID2SYM(rb_intern("plaintext_digests")));
+    ciphertext_algorithms = rb_hash_aref(options, ID2SYM(rb_intern("ciphertext_digests")));
+  }
+  CompressionEnum compression = compression_option(options, encryption ? "compress" : "decompress");
+  bool digesting = !NIL_P(plaintext_algorithms) || !NIL_P(ciphertext_algorithms);
+  plaintext_algorithms = rb_Array(plaintext_algorithms);
+  ciphertext_algorithms = rb_Array(ciphertext_algorithms);
+
+  Data_Get_Struct(self, JBase, cipher);
+  try {
+    JDigestTee plaintext_digests, ciphertext_digests;
+    addRubyDigests(plaintext_digests, plaintext_algorithms);
+    addRubyDigests(ciphertext_digests, ciphertext_algorithms);
+
+    if (encryption) {
+      cipher->encryptRubyIO(&in, &out, io_options, &plaintext_digests, &ciphertext_digests, compression);
+    }
+    else {
+      cipher->decryptRubyIO(&in, &out, io_options, &ciphertext_digests, &plaintext_digests, compression);
+    }
+
+    if (!digesting) {
+      return Qtrue;
+    }
+
+    VALUE retval = rb_hash_new();
+    rb_hash_aset(retval, ID2SYM(rb_intern("plaintext_digests")), getRubyDigests(plaintext_digests, plaintext_algorithms));
+    rb_hash_aset(retval, ID2SYM(rb_intern("ciphertext_digests")), getRubyDigests(ciphertext_digests, ciphertext_algorithms));
+    return retval;
+  }
+  catch (Exception& e) {
+    rb_raise(rb_eCryptoPP_Error, "Crypto++ exception: %s", e.GetWhat().c_str());
+  }
+}
+
+/**
+ * call-seq:
+ *    encrypt_io(in, out) => true
+ *    encrypt_io(in, out, options) => true or Hash
+ *
+ * Encrypts a Ruby IO object and spits the result into another one. You can use
+ * any sort of Ruby object as long as it implements <tt>eof?</tt>,
+ * <tt>read</tt>, <tt>write</tt> and <tt>flush</tt>.
+ *
+ * Output is collected and written out in large chunks rather than a block
+ * at a time. Available options:
+ *
+ * * <tt>:buffer_size</tt> - the size in bytes of the chunks read from in
+ *   and written to out. The default is 64 KB.
+ * * <tt>:pipeline</tt> - when true, reading, the cipher and writing
+ *   overlap. The cipher runs on a native thread without the GVL while in is
+ *   read on the calling thread and out is written on a Ruby thread.
+ * * <tt>:plaintext_digests</tt>, <tt>:ciphertext_digests</tt> - Arrays of
+ *   digest algorithms to compute over the plaintext and the ciphertext in
+ *   the same pass. When either is given a Hash is returned with both keys,
+ *   each holding a Hash of algorithm => binary digest.
+ * * <tt>:compress</tt> - <tt>:deflate</tt> or <tt>:gzip</tt> to compress
+ *   the plaintext in the same pass on its way into the cipher. The
+ *   plaintext digests are of the uncompressed plaintext.
+ *
+ * Examples:
+ *
+ *  cipher.encrypt_io(File.open("http://example.com/"), File.open("test.out", 'w'))
+ *
+ *  output = StringIO.new
+ *  cipher.encrypt_io(File.open('test.enc'), output)
+ *
+ *  digests = cipher.encrypt_io(upload, output,
+ *    :plaintext_digests => [ :sha256 ], :ciphertext_digests => [ :md5 ])
+ *  digests[:ciphertext_digests][:md5]
+ */
+VALUE rb_cipher_encrypt_io(int argc, VALUE *argv, VALUE self)
+{
+  return cipher_io(argc, argv, self, true);
+}
+
+
+/**
+ * call-seq:
+ *    decrypt_io(in, out) => true
+ *    decrypt_io(in, out, options) => true or Hash
+ *
+ * Decrypts a Ruby IO object and spits the result into another one. You can use
+ * any sort of Ruby object as long as it implements <tt>eof?</tt>,
+ * <tt>read</tt>, <tt>write</tt> and <tt>flush</tt>.
+ *
+ * Output is collected and written out in large chunks rather than a block
+ * at a time. Available options:
+ *
+ * * <tt>:buffer_size</tt> - the size in bytes of the chunks read from in
+ *   and written to out. The default is 64 KB.
+ * * <tt>:pipeline</tt> - when true, reading, the cipher and writing
+ *   overlap. The cipher runs on a native thread without the GVL while in is
+ *   read on the calling thread and out is written on a Ruby thread.
+ * * <tt>:plaintext_digests</tt>, <tt>:ciphertext_digests</tt> - digests
+ *   to compute in the same pass, see <tt>encrypt_io</tt>.
+ * * <tt>:decompress</tt> - <tt>:deflate</tt> or <tt>:gzip</tt> to
+ *   decompress the plaintext as it comes out of the cipher.
+ *
+ * Examples:
+ *
+ *  cipher.decrypt_io(File.open("http://example.com/"), File.open("test.out", 'w'))
+ *
+ *  output = StringIO.new
+ *  cipher.decrypt_io(File.open('test.enc'), output)
+ */
+VALUE rb_cipher_decrypt_io(int argc, VALUE *argv, VALUE self)
+{
+  return cipher_io(argc, argv, self, false);
+}
+
+
+/* Runs the file at in_path through the cipher into out_path, memory-mapping
+ * both with the GVL released. */
+static VALUE cipher_file(int argc, VALUE *argv, VALUE self, bool encryption)
+{
+  JBase *cipher = NULL;
+  VALUE in, out, options;
+  string error;
+  int state = 0;
+
+  rb_scan_args(argc, argv, "21", &in, &out, &options);
+  RubyIOOptions io_options = getRubyIOOptions(options);
+  FilePathValue(in);
+  FilePathValue(out);
+
+  Data_Get_Struct(self, JBase, cipher);
+  {
+    JFileCrypter crypter(io_options.bufferSize, 1, 1, true);
+
+    try {
+      JCipherFilter* filter = encryption ? cipher->getEncryptionFilter() : cipher->getDecryptionFilter();
+      if (filter == NULL) {
+        throw JException("could not create a filter for the cipher");
+      }
+      crypter.Add(string(RSTRING_PTR(in), RSTRING_LEN(in)), string(RSTRING_PTR(out), RSTRING_LEN(out)), filter);
+      state = crypter.Run();
+      error = crypter.GetJobs()[0].error;
+    }
+    catch (Exception& e) {
+      error = e.GetWhat();
+    }
+  }
+
+  if (state != 0) {
+    rb_jump_tag(state);
+  }
+  rb_thread_check_ints();
+
+  if (!error.empty()) {
+    rb_raise(rb_eCryptoPP_Error, "Crypto++ exception: %s", error.c_str());
+  }
+
+  return Qtrue;
+}
+
+/**
+ * call-seq:
+ *    encrypt_file(in_path, out_path) => true
+ *    encrypt_file(in_path, out_path, options) => true
+ *
+ * Encrypts the file at in_path into out_path. Both files are memory-mapped
+ * and the data is encrypted straight from one mapping into the other with
+ * the GVL released, without passing through any Ruby Strings. Files that
+ * can't be mapped, like pipes, are read and written in chunks of
+ * <tt>:buffer_size</tt> bytes instead.
+ *
+ * If encryption fails, out_path is removed and a CryptoPPError is raised.
+ *
+ * Example:
+ *
+ *  cipher.encrypt_file('test.txt', 'test.enc')
+ */
+VALUE rb_cipher_encrypt_file(int argc, VALUE *argv, VALUE self)
+{
+  return cipher_file(argc, argv, self, true);
+}
+
+/**
+ * call-seq:
+ *    decrypt_file(in_path, out_path) => true
+ *    decrypt_file(in_path, out_path, options) => true
+ *
+ * Decrypts the file at in_path into out_path. See <tt>encrypt_file</tt>.
+ */
+VALUE rb_cipher_decrypt_file(int argc, VALUE *argv, VALUE self)
+{
+  return cipher_file(argc, argv, self, false);
+}
+
+
+/* Runs a batch of [in_path, out_path] pairs through a cipher with a
+ * JFileCrypter. The cipher is either a Cipher or an options Hash with an
+ * :algorithm for cipher_factory, in which case the Hash doubles as the
+ * FileCrypter options. */
+static VALUE file_crypter_run(int argc, VALUE *argv, bool encryption)
+{
+  VALUE pairs, cipher, options;
+  JBase *c = NULL;
+  RubyIOOptions io_options;
+  unsigned int threads = 0;
+  unsigned int depth = 0;
+  vector<string> ins, outs;
+
+  VALUE nonces = Qnil;
+  vector<string> ivs;
+
+  rb_scan_args(argc, argv, "21", &pairs, &cipher, &options);
+  Check_Type(pairs, T_ARRAY);
+
+  if (TYPE(cipher) == T_HASH) {
+    VALUE factory_args[2];
+
+    factory_args[0] = rb_hash_aref(cipher, ID2SYM(rb_intern("algorithm")));
+    factory_args[1] = cipher;
+    if (NIL_P(factory_args[0])) {
+      rb_raise(rb_eCryptoPP_Error, "no :algorithm in cipher options");
+    }
+    if (NIL_P(options)) {
+      options = cipher;
+    }
+    cipher = rb_module_cipher_factory(2, factory_args, rb_mCryptoPP);
+  }
+  else if (!rb_obj_is_kind_of(cipher, rb_cCryptoPP_Cipher)) {
+    rb_raise(rb_eTypeError, "expected a CryptoPP::Cipher or an options Hash");
+  }
+  Data_Get_Struct(cipher, JBase, c);
+
+  io_options = getRubyIOOptions(options);
+  if (!NIL_P(options)) {
+    VALUE t = rb_hash_aref(options, ID2SYM(rb_intern("threads")));
+    VALUE d = rb_hash_aref(options, ID2SYM(rb_intern("queue_depth")));
+
+    if (!NIL_P(t) && (threads = NUM2UINT(t)) == 0) {
+      rb_raise(rb_eArgError, "threads must be greater than 0");
+    }
+    if (!NIL_P(d) && (depth = NUM2UINT(d)) == 0) {
+      rb_raise(rb_eArgError, "queue_depth must be greater than 0");
+    }
+
+    VALUE iv = rb_hash_aref(options, ID2SYM(rb_intern("iv")));
+    if (encryption && rb_obj_is_kind_of(iv, rb_cCryptoPP_NonceSequence)) {
+      nonce_sequence_check_size(iv, c);
+      nonces = iv;
+    }
+  }
+
+  for (long i = 0; i < RARRAY_LEN(pairs); ++i) {
+    VALUE pair = rb_ary_entry(pairs, i);
+    VALUE in, out;
+
+    Check_Type(pair, T_ARRAY);
+    if (RARRAY_LEN(pair) != 2) {
+      rb_raise(rb_eArgError, "expected [in_path, out_path] pairs");
+    }
+    in = rb_ary_entry(pair, 0);
+    out = rb_ary_entry(pair, 1);
+    FilePathValue(in);
+    FilePathValue(out);
+    ins.push_back(string(RSTRING_PTR(in), RSTRING_LEN(in)));
+    outs.push_back(string(RSTRING_PTR(out), RSTRING_LEN(out)));
+    if (!NIL_P(nonces)) {
+      ivs.push_back(nonce_sequence_next(nonces));
+    }
+  }
+
+  string error;
+  size_t failures = 0;
+  int state = 0;
+  {
+    JFileCrypter crypter(io_options.bufferSize, threads, depth);
+
+    // the nonces only go into the filters, the caller's cipher keeps its
+    // own IV...
+    string iv = c->getIV();
+
+    try {
+      for (size_t i = 0; i < ins.size(); ++i) {
+        if (!ivs.empty()) {
+          c->setIV(ivs[i], false);
+        }
+        JCipherFilter* filter = encryption ? c->getEncryptionFilter() : c->getDecryptionFilter();
+        if (filter == NULL) {
+          throw JException("could not create a filter for the cipher");
+        }
+        crypter.Add(ins[i], outs[i], filter);
+      }
+      state = crypter.Run();
+
+      const vector<JFileCrypter::Job>& jobs = crypter.GetJobs();
+      for (vector<JFileCrypter::Job>::const_iterator i = jobs.begin(); i != jobs.end(); ++i) {
+        if (!i->error.empty() && failures++ == 0) {
+          error = i->in + ": " + i->error;
+        }
+      }
+    }
+    catch (Exception& e) {
+      error = "Crypto++ exception: " + e.GetWhat();
+    }
+    c->setIV(iv, false);
+  }
+
+  if (state != 0) {
+    rb_jump_tag(state);
+  }
+  rb_thread_check_ints();
+
+  if (failures > 1) {
+    rb_raise(rb_eCryptoPP_Error, "%s (and %lu more files failed)", error.c_str(), (unsigned long) failures - 1);
+  }
+  else if (!error.empty()) {
+    rb_raise(rb_eCryptoPP_Error, "%s", error.c_str());
+  }
+
+  if (!NIL_P(nonces)) {
+    VALUE retval = rb_ary_new2(ivs.size());
+    for (size_t i = 0; i < ivs.size(); ++i) {
+      rb_ary_push(retval, rb_tainted_str_new(ivs[i].data(), ivs[i].length()));
+    }
+    return retval;
+  }
+  return Qtrue;
+}
+
+/**
+ * call-seq:
+ *    encrypt_files(pairs, cipher) => true
+ *    encrypt_files(pairs, cipher, options) => true or Array
+ *    encrypt_files(pairs, cipher_options) => true or Array
+ *
+ * Encrypts each <tt>[in_path, out_path]</tt> pair in pairs. The files are
+ * read, encrypted and written by a pool of native threads with the GVL
+ * released, using io_uring with several files in flight per thread where
+ * it's available and pread and pwrite otherwise.
+ *
+ * cipher is either a Cipher or a Hash of Cipher options with an
+ * <tt>:algorithm</tt> to create one with. Every file is encrypted with the
+ * same key and IV, unless <tt>:iv</tt> is a NonceSequence, in which case
+ * each file gets the next nonce from it and the nonces are returned in the
+ * same order as pairs. The sequence's size has to match the cipher's block
+ * size. Available options:
+ *
+ * * <tt>:buffer_size</tt> - the size in bytes of the chunks read and
+ *   written. The default is 64 KB.
+ * * <tt>:threads</tt> - the number of worker threads. The default is one per
+ *   CPU.
+ * * <tt>:queue_depth</tt> - the number of files each thread keeps in flight
+ *   with io_uring. The default is 8.
+ *
+ * Every file is attempted. If any of them fail their output files are
+ * removed and a CryptoPPError is raised naming the first one.
+ *
+ * Example:
+ *
+ *  CryptoPP::FileCrypter.encrypt_files([
+ *    [ 'a.txt', 'a.txt.enc' ],
+ *    [ 'b.txt', 'b.txt.enc' ]
+ *  ], :algorithm => :aes, :key => key, :iv => iv, :block_mode => :cbc)
+ */
+VALUE rb_file_crypter_encrypt_files(int argc, VALUE *argv, VALUE self)
+{
+  return file_crypter_run(argc, argv, true);
+}
+
+/**
+ * call-seq:
+ *    decrypt_files(pairs, cipher) => true
+ *    decrypt_files(pairs, cipher, options) => true
+ *    decrypt_files(pairs, cipher_options) => true
+ *
+ * Decrypts each <tt>[in_path, out_path]</tt> pair in pairs. See
+ * <tt>encrypt_files</tt> for the options.
+ */
+VALUE rb_file_crypter_decrypt_files(int argc, VALUE *argv, VALUE self)
+{
+  return file_crypter_run(argc, argv, false);
+}
+
+
+/**
+ * call-seq:
+ *    cipher_name(algorithm) => String
+ *
+ * Returns the name of a Cipher.
+ */
+VALUE rb_module_cipher_name(VALUE self, VALUE c)
+{
+  switch (cipher_sym_to_const(c)) {
+    default:
+      rb_raise(rb_eCryptoPP_Error, "could not find a valid cipher type");
+    break;
+
+#    define CIPHER_ALGORITHM_X(klass, r, c, s) \
+      case r ## _CIPHER: \
+        return rb_tainted_str_new2(c::getStaticCipherName().c_str());
+#    include "defs/ciphers.def"
+  }
+}
+
+
+/**
+ * call-seq:
+ *    algorithm_name() => String
+ *
+ * Returns the name of the cipher algorithm being used.
+ */
+VALUE rb_cipher_algorithm_name(VALUE self)
+{
+  JBase *cipher = NULL;
+  Data_Get_Struct(self, JBase, cipher);
+  return rb_tainted_str_new2(cipher->getCipherName().c_str());
+}
+
+
+/**
+ * call-seq:
+ *    block_mode_name(block_mode) => String
+ *
+ * Singleton method to return the name of a block cipher mode.
+ */
+VALUE rb_module_block_mode_name(VALUE self, VALUE m)
+{
+  return rb_tainted_str_new2(JCipher::getModeName(mode_sym_to_const(m)).c_str());
+}
+
+
+/**
+ * call-seq:
+ *    block_mode_name() => String
+ *
+ * Returns the name of the mode being used.
+ */
+VALUE rb_cipher_block_mode_name(VALUE self)
+{
+  JBase *cipher = NULL;
+  Data_Get_Struct(self, JBase, cipher);
+  if (IS_STREAM_CIPHER(cipher->getCipherType())) {
+    return Qnil;
+  }
+  else {
+    return rb_tainted_str_new2(JCipher::getModeName(((JCipher*) cipher)->getMode()).c_str());
+  }
+}
+
+
+/**
+ * call-seq:
+ *    padding_name(padding) => String
+ *
+ * Singleton method to return the name of the a block cipher padding mode.
+ */
+VALUE rb_module_padding_name(VALUE self, VALUE p)
+{
+  return rb_tainted_str_new2(JCipher::getPaddingName(padding_sym_to_const(p)).c_str());
+}
+
+
+/**
+ * call-seq:
+ *    padding_name() => String
+ *
+ * Returns the name of the padding being used.
+ */
+VALUE rb_cipher_padding_name(VALUE self)
+{
+  JBase *cipher = NULL;
+  Data_Get_Struct(self, JBase, cipher);
+  if (IS_STREAM_CIPHER(cipher->getCipherType())) {
+    return Qnil;
+  }
+  else {
+    return rb_tainted_str_new2(JCipher::getPaddingName(((JCipher*) cipher)->getPadding()).c_str());
+  }
+}
+
+
+/**
+ * call-seq:
+ *    rng_name(rng) => String
+ *
+ * Singleton method to return the name of the random number generator being
+ * used.
+ */
+VALUE rb_module_rng_name(VALUE self, VALUE r)
+{
+  return rb_tainted_str_new2(JCipher::getRNGName(rng_sym_to_const(r)).c_str());
+}
+
+
+/**
+ * call-seq:
+ *    rng_name() => String
+ *
+ * Returns the name of the random number generator being used.
+ */
+VALUE rb_cipher_rng_name(VALUE self)
+{
+  JBase *cipher = NULL;
+  Data_Get_Struct(self, JBase, cipher);
+  return rb_tainted_str_new2(JCipher::getRNGName(cipher->getRNG()).c_str());
+}
+
+
+/**
+ * call-seq:
+ *    cipher_type() => Symbol
+ *
+ * Returns the type of cipher being used as a Symbol.
+ */
+VALUE rb_cipher_cipher_type(VALUE self)
+{
+  JBase *cipher = NULL;
+  Data_Get_Struct(self, JBase, cipher);
+
+  switch (cipher->getCipherType()) {
+#    define CIPHER_ALGORITHM_X(klass, r, c, s) \
+      case r ## _CIPHER: \
+        return ID2SYM(rb_intern(# s));
+#    include "defs/ciphers.def"
+
+    default:
+      return Qnil;
+  }
+}
+
+
+/**
+ * call-seq:
+ *    cipher_enabled?(algorithm) => boolean
+ *
+ * Singleton method to check for the availability of a cipher algorithm.
+ */
+VALUE rb_module_cipher_enabled(VALUE self, VALUE c)
+{
+  switch (cipher_sym_to_const(c)) {
+    default:
+      return Qfalse;
+
+#  define CIPHER_ALGORITHM_X(klass, r, c, s) \
+    case r ## _CIPHER:
+#  include "defs/ciphers.def"
+      return Qtrue;
+  }
+}
+
+
+/**
+ * call-seq:
+ *    rng_available?(rng) => boolean
+ *
+ * Singleton method to check for the availability of a random number generator.
+ * <tt>:rdrand</tt> and <tt>:rdseed</tt> are always available, as they fall
+ * back to the default RNG on CPUs without the instructions.
+ */
+VALUE rb_module_rng_available(VALUE self, VALUE r)
+{
+  ID id = SYM2ID(r);
+  if (id == rb_intern("rand") || id == rb_intern("rdrand") || id == rb_intern("rdseed")) {
+    return Qtrue;
+  }
+#  ifdef NONBLOCKING_RNG_AVAILABLE
+    else if (id == rb_intern("non_blocking")) {
+      return Qtrue;
+    }
+#  endif
+
+#  ifdef BLOCKING_RNG_AVAILABLE
+    else if (id == rb_intern("blocking")) {
+      return Qtrue;
+    }
+#  endif
+
+  else {
+    return Qfalse;
+  }
+}
+
+
+/**
+ * call-seq:
+ *    random_bytes(length) => String
+ *    random_bytes(length, rng) => String
+ *
+ * Returns a String of length random bytes from the same generator used for
+ * <tt>rand_iv</tt>. Each thread has its own AES-based generator for each
+ * RNG, seeded from the RNG the first time it's used, so after that this
+ * doesn't need to go to the OS. The default RNG is the same as for ciphers.
+ */
+VALUE rb_module_random_bytes(int argc, VALUE *argv, VALUE self)
+{
+  VALUE l, r, retval;
+  RNGEnum rng = DEFAULT_RNG;
+
+  rb_scan_args(argc, argv, "11", &l, &r);
+  long length = NUM2LONG(l);
+  if (length < 0) {
+    rb_raise(rb_eArgError, "negative length");
+  }
+  if (!NIL_P(r)) {
+    Check_Type(r, T_SYMBOL);
+    if (!RTEST(rb_module_rng_available(self, r))) {
+      rb_raise(rb_eCryptoPP_Error, "RNG '%s' is unavailable", rb_id2name(SYM2ID(r)));
+    }
+    rng = rng_sym_to_const(r);
+  }
+
+  retval = rb_tainted_str_new(NULL, length);
+  try {
+    generateRandomBytes(RSTRING_PTR(retval), length, rng);
+  }
+  catch (Exception& e) {
+    rb_raise(rb_eCryptoPP_Error, "Crypto++ exception: %s", e.GetWhat().c_str());
+  }
+  return retval;
+}
+
+
+/**
+ * call-seq:
+ *    cipher_list() => Array
+ *
+ * Returns an Array of available ciphers.
+ */
+VALUE rb_module_cipher_list(VALUE self)
+{
+  VALUE ary = rb_ary_new();
+
+#  define CIPHER_ALGORITHM_X(klass, r, c, s) \
+    rb_ary_push(ary, ID2SYM(rb_intern(# s)));
+#  include "defs/ciphers.def"
+
+  return ary;
+}
+
+
+/* Takes the next nonce from a NonceSequence. */
+static string nonce_sequence_next(VALUE self)
+{
+  JNonceSequence *nonces = NULL;
+  Data_Get_Struct(self, JNonceSequence, nonces);
+  try {
+    return nonces->next();
+  }
+  catch (Exception& e) {
     rb_raise(rb_eCryptoPP_Error, "Crypto++ exception: %s", e.GetWhat().c_str());
   }
 }
 
+/* A block cipher only reads a block's worth of IV, so a longer nonce would
+ * lose the low bytes of its counter and repeat. */
+static void nonce_sequence_check_size(VALUE self, JBase* cipher)
+{
+  JNonceSequence *nonces = NULL;
+  Data_Get_Struct(self, JNonceSequence, nonces);
+  if (cipher->getBlockSize() > 0 && nonces->getSize() != cipher->getBlockSize()) {
+    rb_raise(rb_eArgError, "NonceSequence size of %u doesn't match the cipher's %u byte IV", nonces->getSize(), cipher->getBlockSize());
+  }
+}
 
 /**
  * call-seq:
- *    cipher_name(algorithm) => String
+ *    new => CryptoPP::NonceSequence
+ *    new(options) => CryptoPP::NonceSequence
  *
- * Returns the name of a Cipher.
+ * Creates a NonceSequence. Each nonce is a random prefix picked when the
+ * sequence is created, followed by a 64-bit message counter, followed by
+ * zero bytes for the cipher mode's block counter. Nonces are unique for as
+ * long as the sequence lives, and taking one costs an atomic increment
+ * rather than a trip to the RNG.
+ *
+ * Available options:
+ *
+ * * <tt>:size</tt> - the size of each nonce in bytes. The default is 16.
+ * * <tt>:block_counter_size</tt> - the number of trailing zero bytes left
+ *   for CTR mode to count blocks in, which limits each message to
+ *   2^(8 * block_counter_size) blocks. The default is 4. Use 0 for modes
+ *   that keep their own block counter.
+ * * <tt>:rng</tt> - the RNG to draw the prefix from.
+ *
+ * Example:
+ *
+ *  nonces = CryptoPP::NonceSequence.new
+ *  cipher = CryptoPP::AES.new(:key => key, :block_mode => :ctr, :iv => nonces)
  */
-VALUE rb_module_cipher_name(VALUE self, VALUE c)
+VALUE rb_nonce_sequence_new(int argc, VALUE *argv, VALUE self)
 {
-  switch (cipher_sym_to_const(c)) {
-    default:
-      rb_raise(rb_eCryptoPP_Error, "could not find a valid cipher type");
-    break;
+  VALUE options;
+  unsigned int size = 16;
+  unsigned int block_counter_size = 4;
+  RNGEnum rng = DEFAULT_RNG;
 
-#    define CIPHER_ALGORITHM_X(klass, r, c, s) \
-      case r ## _CIPHER: \
-        return rb_tainted_str_new2(c::getStaticCipherName().c_str());
-#    include "defs/ciphers.def"
+  rb_scan_args(argc, argv, "01", &options);
+  if (!NIL_P(options)) {
+    Check_Type(options, T_HASH);
+
+    VALUE s = rb_hash_aref(options, ID2SYM(rb_intern("size")));
+    VALUE b = rb_hash_aref(options, ID2SYM(rb_intern("block_counter_size")));
+    VALUE r = rb_hash_aref(options, ID2SYM(rb_intern("rng")));
+
+    if (!NIL_P(s)) {
+      size = NUM2UINT(s);
+    }
+    if (!NIL_P(b)) {
+      block_counter_size = NUM2UINT(b);
+    }
+    if (!NIL_P(r)) {
+      Check_Type(r, T_SYMBOL);
+      if (!RTEST(rb_module_rng_available(self, r))) {
+        rb_raise(rb_eCryptoPP_Error, "RNG '%s' is unavailable", rb_id2name(SYM2ID(r)));
+      }
+      rng = rng_sym_to_const(r);
+    }
   }
-}
 
+  try {
+    JNonceSequence* nonces = new JNonceSequence(size, block_counter_size, rng);
+    return Data_Wrap_Struct(rb_cCryptoPP_NonceSequence, NULL, nonce_sequence_free, nonces);
+  }
+  catch (Exception& e) {
+    rb_raise(rb_eCryptoPP_Error, "Crypto++ exception: %s", e.GetWhat().c_str());
+  }
+}
 
 /**
  * call-seq:
- *    algorithm_name() => String
+ *    next => String
  *
- * Returns the name of the cipher algorithm being used.
+ * Returns the next nonce in binary. Raises a CryptoPPError once 2^63 nonces
+ * have been handed out rather than repeating one.
  */
-VALUE rb_cipher_algorithm_name(VALUE self)
+VALUE rb_nonce_sequence_next(VALUE self)
 {
-  JBase *cipher = NULL;
-  Data_Get_Struct(self, JBase, cipher);
-  return rb_tainted_str_new2(cipher->getCipherName().c_str());
+  string retval = nonce_sequence_next(self);
+  return rb_tainted_str_new(retval.data(), retval.length());
 }
 
-
 /**
  * call-seq:
- *    block_mode_name(block_mode) => String
+ *    size => Fixnum
  *
- * Singleton method to return the name of a block cipher mode.
+ * Returns the size of the nonces in bytes.
  */
-VALUE rb_module_block_mode_name(VALUE self, VALUE m)
+VALUE rb_nonce_sequence_size(VALUE self)
 {
-  return rb_tainted_str_new2(JCipher::getModeName(mode_sym_to_const(m)).c_str());
+  JNonceSequence *nonces = NULL;
+  Data_Get_Struct(self, JNonceSequence, nonces);
+  return UINT2NUM(nonces->getSize());
 }
 
-
 /**
  * call-seq:
- *    block_mode_name() => String
+ *    prefix => String
  *
- * Returns the name of the mode being used.
+ * Returns the random prefix shared by every nonce in the sequence.
  */
-VALUE rb_cipher_block_mode_name(VALUE self)
+VALUE rb_nonce_sequence_prefix(VALUE self)
 {
-  JBase *cipher = NULL;
-  Data_Get_Struct(self, JBase, cipher);
-  if (IS_STREAM_CIPHER(cipher->getCipherType())) {
-    return Qnil;
-  }
-  else {
-    return rb_tainted_str_new2(JCipher::getModeName(((JCipher*) cipher)->getMode()).c_str());
-  }
+  JNonceSequence *nonces = NULL;
+  Data_Get_Struct(self, JNonceSequence, nonces);
+  string retval = nonces->getPrefix();
+  return rb_tainted_str_new(retval.data(), retval.length());
 }
 
-
 /**
  * call-seq:
- *    padding_name(padding) => String
+ *    count => Integer
  *
- * Singleton method to return the name of the a block cipher padding mode.
+ * Returns how many nonces have been handed out.
  */
-VALUE rb_module_padding_name(VALUE self, VALUE p)
+VALUE rb_nonce_sequence_count(VALUE self)
 {
-  return rb_tainted_str_new2(JCipher::getPaddingName(padding_sym_to_const(p)).c_str());
+  JNonceSequence *nonces = NULL;
+  Data_Get_Struct(self, JNonceSequence, nonces);
+  return ULL2NUM(nonces->getCount());
+}
+
+
+/* Arguments for a CipherSpec operation, copied out of their Ruby objects so
+ * it can run without the GVL. */
+struct cipher_spec_args
+{
+  const JCipherSpec* spec;
+  bool encryption;
+  string input;
+  string iv;
+  CompressionEnum compression;
+  string output;
+  string error;
+};
+
+static void* cipher_spec_run_without_gvl(void* data)
+{
+  struct cipher_spec_args* args = (struct cipher_spec_args*) data;
+
+  try {
+    if (args->encryption) {
+      args->output = args->spec->encrypt(args->input, args->iv, args->compression);
+    }
+    else {
+      args->output = args->spec->decrypt(args->input, args->iv, args->compression);
+    }
+  }
+  catch (Exception& e) {
+    args->error = e.GetWhat();
+  }
+  return NULL;
 }
 
+/* Encrypts or decrypts data with a CipherSpec. Nothing is written to the
+ * spec, so any number of threads can be in here with the same one. */
+static VALUE cipher_spec_run(int argc, VALUE *argv, VALUE self, bool encryption)
+{
+  JCipherSpec *spec = NULL;
+  RubyEncodingEnum encoding = BINARY_ENCODING;
+  VALUE data, options, iv = Qnil, retval, error = Qnil;
+
+  rb_scan_args(argc, argv, "11", &data, &options);
+  Check_Type(data, T_STRING);
+  CompressionEnum compression = compression_option(options, encryption ? "compress" : "decompress");
+
+  if (!NIL_P(options)) {
+    Check_Type(options, T_HASH);
+    iv = getEncodedRubyOption(options, "iv", &encoding);
+    if (!NIL_P(iv)) {
+      Check_Type(iv, T_STRING);
+    }
+  }
+
+  Data_Get_Struct(self, JCipherSpec, spec);
+
+  // nothing in here raises, so the strings are always cleaned up...
+  {
+    struct cipher_spec_args args;
+
+    args.spec = spec;
+    args.encryption = encryption;
+    args.input = string(RSTRING_PTR(data), RSTRING_LEN(data));
+    args.compression = compression;
+    if (!NIL_P(iv)) {
+      args.iv = decodeRubyString(iv, encoding);
+    }
+
+    if (args.input.length() >= CIPHER_WITHOUT_GVL_THRESHOLD) {
+      callWithoutGVL(cipher_spec_run_without_gvl, &args);
+    }
+    else {
+      cipher_spec_run_without_gvl(&args);
+    }
+
+    if (!args.error.empty()) {
+      error = rb_str_new(args.error.data(), args.error.length());
+    }
+    retval = rb_tainted_str_new(args.output.data(), args.output.length());
+  }
+
+  if (!NIL_P(error)) {
+    rb_raise(rb_eCryptoPP_Error, "Crypto++ exception: %s", RSTRING_PTR(error));
+  }
+
+  return retval;
+}
 
 /**
  * call-seq:
- *    padding_name() => String
+ *    new(algorithm, options) => CryptoPP::CipherSpec
  *
- * Returns the name of the padding being used.
+ * Creates a frozen CipherSpec for a block cipher. The options are the same
+ * as the Cipher options for the key, key length, rounds, block mode and
+ * padding. The key is expanded once here and shared by every call made with
+ * the spec.
+ *
+ * Per-message state such as the IV and the plaintext can't be given here.
+ * It's passed to each <tt>encrypt</tt> and <tt>decrypt</tt> call instead,
+ * which is what makes a spec safe to share between threads.
+ *
+ * Example:
+ *
+ *  SPEC = CryptoPP::CipherSpec.new(:aes, :key => key, :block_mode => :cbc)
+ *  ciphertext = SPEC.encrypt(data, :iv => iv)
  */
-VALUE rb_cipher_padding_name(VALUE self)
+VALUE rb_cipher_spec_new(VALUE self, VALUE algorithm, VALUE options)
 {
+  static const char* per_message[] = { "plaintext", "ciphertext", "iv" };
   JBase *cipher = NULL;
-  Data_Get_Struct(self, JBase, cipher);
+  VALUE tmp;
+
+  Check_Type(options, T_HASH);
+  for (size_t i = 0; i < sizeof(per_message) / sizeof(per_message[0]); ++i) {
+    RubyEncodingEnum encoding;
+    if (!NIL_P(getEncodedRubyOption(options, per_message[i], &encoding))) {
+      rb_raise(rb_eCryptoPP_Error, "can't set %s in CipherSpec options, pass it to each call instead", per_message[i]);
+    }
+  }
+  if (!NIL_P(rb_hash_aref(options, ID2SYM(rb_intern("rand_iv"))))) {
+    rb_raise(rb_eCryptoPP_Error, "can't set rand_iv in CipherSpec options, pass an iv to each call instead");
+  }
+
+  // configure a throwaway Cipher the usual way, which frees the cipher for
+  // us if any of the options are bad...
+  try {
+    tmp = wrap_cipher_in_ruby(cipher_factory(algorithm));
+  }
+  catch (Exception& e) {
+    rb_raise(rb_eCryptoPP_Error, "%s", e.GetWhat().c_str());
+  }
+  cipher_options(tmp, options);
+
+  Data_Get_Struct(tmp, JBase, cipher);
   if (IS_STREAM_CIPHER(cipher->getCipherType())) {
-    return Qnil;
+    rb_raise(rb_eCryptoPP_Error, "CipherSpec only supports block ciphers");
   }
-  else {
-    return rb_tainted_str_new2(JCipher::getPaddingName(((JCipher*) cipher)->getPadding()).c_str());
+
+  try {
+    JCipherSpec* spec = new JCipherSpec((JCipher*) cipher);
+
+    // the spec owns the cipher now...
+    DATA_PTR(tmp) = NULL;
+    return rb_obj_freeze(Data_Wrap_Struct(rb_cCryptoPP_CipherSpec, NULL, cipher_spec_free, spec));
+  }
+  catch (Exception& e) {
+    rb_raise(rb_eCryptoPP_Error, "Crypto++ exception: %s", e.GetWhat().c_str());
   }
 }
 
-
 /**
  * call-seq:
- *    rng_name(rng) => String
+ *    encrypt(plaintext) => String
+ *    encrypt(plaintext, options) => String
  *
- * Singleton method to return the name of the random number generator being
- * used.
+ * Encrypts plaintext and returns the ciphertext in binary. Safe to call from
+ * many threads at once, and long messages are encrypted with the GVL
+ * released.
+ *
+ * Available options:
+ *
+ * * <tt>:iv</tt> - the IV for this message in binary, or <tt>:iv_hex</tt>,
+ *   <tt>:iv_b64</tt> or <tt>:iv_b64url</tt>. Required for every mode but
+ *   ECB.
+ * * <tt>:compress</tt> - <tt>:deflate</tt> or <tt>:gzip</tt> to compress
+ *   the plaintext on its way into the cipher.
  */
-VALUE rb_module_rng_name(VALUE self, VALUE r)
+VALUE rb_cipher_spec_encrypt(int argc, VALUE *argv, VALUE self)
 {
-  return rb_tainted_str_new2(JCipher::getRNGName(rng_sym_to_const(r)).c_str());
+  return cipher_spec_run(argc, argv, self, true);
 }
 
-
 /**
  * call-seq:
- *    rng_name() => String
+ *    decrypt(ciphertext) => String
+ *    decrypt(ciphertext, options) => String
  *
- * Returns the name of the random number generator being used.
+ * Decrypts ciphertext and returns the plaintext in binary. Takes the
+ * <tt>:iv</tt> options of <tt>encrypt</tt>, and <tt>:decompress</tt> to
+ * undo its <tt>:compress</tt>.
  */
-VALUE rb_cipher_rng_name(VALUE self)
+VALUE rb_cipher_spec_decrypt(int argc, VALUE *argv, VALUE self)
 {
-  JBase *cipher = NULL;
-  Data_Get_Struct(self, JBase, cipher);
-  return rb_tainted_str_new2(JCipher::getRNGName(cipher->getRNG()).c_str());
+  return cipher_spec_run(argc, argv, self, false);
 }
 
-
 /**
  * call-seq:
- *    cipher_type() => Symbol
+ *    algorithm_name => String
  *
- * Returns the type of cipher being used as a Symbol.
+ * Returns the name of the spec's cipher.
  */
-VALUE rb_cipher_cipher_type(VALUE self)
+VALUE rb_cipher_spec_algorithm_name(VALUE self)
 {
-  JBase *cipher = NULL;
-  Data_Get_Struct(self, JBase, cipher);
+  JCipherSpec *spec = NULL;
+  Data_Get_Struct(self, JCipherSpec, spec);
+  return rb_tainted_str_new2(spec->getCipher()->getCipherName().c_str());
+}
 
-  switch (cipher->getCipherType()) {
-#    define CIPHER_ALGORITHM_X(klass, r, c, s) \
-      case r ## _CIPHER: \
+/**
+ * call-seq:
+ *    block_mode => Symbol
+ *
+ * Returns the spec's block mode.
+ */
+VALUE rb_cipher_spec_block_mode(VALUE self)
+{
+  JCipherSpec *spec = NULL;
+  Data_Get_Struct(self, JCipherSpec, spec);
+  switch (spec->getCipher()->getMode()) {
+#    define BLOCK_MODE_X(c, s) \
+      case c ## _MODE: \
         return ID2SYM(rb_intern(# s));
-#    include "defs/ciphers.def"
+#    include "defs/block_modes.def"
 
     default:
       return Qnil;
   }
 }
 
+/**
+ * call-seq:
+ *    block_size => Fixnum
+ *
+ * Returns the spec's block size in bytes, which is also the size of the IVs
+ * it takes.
+ */
+VALUE rb_cipher_spec_block_size(VALUE self)
+{
+  JCipherSpec *spec = NULL;
+  Data_Get_Struct(self, JCipherSpec, spec);
+  return UINT2NUM(spec->getCipher()->getBlockSize());
+}
+
 
 /**
  * call-seq:
- *    cipher_enabled?(algorithm) => boolean
+ *    enable => true
+ *    enable(max_bytes) => true
  *
- * Singleton method to check for the availability of a cipher algorithm.
+ * Turns on the process-wide key schedule cache, or changes its memory cap
+ * if it's already on. Block ciphers then copy their expanded keys out of
+ * the cache rather than running the key setup again for keys that have
+ * been used recently. The default cap is 16 MB, and the least recently used
+ * schedules are evicted to stay under it.
  */
-VALUE rb_module_cipher_enabled(VALUE self, VALUE c)
+VALUE rb_key_schedule_cache_enable(int argc, VALUE *argv, VALUE self)
 {
-  switch (cipher_sym_to_const(c)) {
-    default:
-      return Qfalse;
+  VALUE max_bytes;
+  size_t bytes = JKEYSCHEDULECACHE_DEFAULT_MAX_BYTES;
 
-#  define CIPHER_ALGORITHM_X(klass, r, c, s) \
-    case r ## _CIPHER:
-#  include "defs/ciphers.def"
-      return Qtrue;
+  rb_scan_args(argc, argv, "01", &max_bytes);
+  if (!NIL_P(max_bytes)) {
+    bytes = NUM2SIZET(max_bytes);
+    if (bytes == 0) {
+      rb_raise(rb_eCryptoPP_Error, "max_bytes must be greater than 0, use disable to turn the cache off");
+    }
   }
-}
 
+  JKeyScheduleCache::getInstance().setMaxBytes(bytes);
+  return Qtrue;
+}
 
 /**
  * call-seq:
- *    rng_available?(rng) => boolean
+ *    disable => false
  *
- * Singleton method to check for the availability of a random number generator.
+ * Turns off the key schedule cache and wipes out everything in it.
  */
-VALUE rb_module_rng_available(VALUE self, VALUE r)
+VALUE rb_key_schedule_cache_disable(VALUE self)
 {
-  ID id = SYM2ID(r);
-  if (id == rb_intern("rand")) {
-    return Qtrue;
-  }
-#  ifdef NONBLOCKING_RNG_AVAILABLE
-    else if (id == rb_intern("non_blocking")) {
-      return Qtrue;
-    }
-#  endif
+  JKeyScheduleCache::getInstance().setMaxBytes(0);
+  return Qfalse;
+}
 
-#  ifdef BLOCKING_RNG_AVAILABLE
-    else if (id == rb_intern("blocking")) {
-      return Qtrue;
-    }
-#  endif
+/**
+ * call-seq:
+ *    enabled? => Boolean
+ *
+ * Whether the key schedule cache is on.
+ */
+VALUE rb_key_schedule_cache_enabled(VALUE self)
+{
+  return JKeyScheduleCache::getInstance().isEnabled() ? Qtrue : Qfalse;
+}
 
-  else {
-    return Qfalse;
-  }
+/**
+ * call-seq:
+ *    clear => nil
+ *
+ * Wipes out everything in the key schedule cache, leaving it on.
+ */
+VALUE rb_key_schedule_cache_clear(VALUE self)
+{
+  JKeyScheduleCache::getInstance().clear();
+  return Qnil;
 }
 
+/**
+ * call-seq:
+ *    stats => Hash
+ *
+ * Returns the key schedule cache's <tt>:hits</tt>, <tt>:misses</tt> and
+ * <tt>:evictions</tt> since the process started, along with the number of
+ * <tt>:entries</tt> and <tt>:bytes</tt> in it now and its
+ * <tt>:max_bytes</tt>.
+ */
+VALUE rb_key_schedule_cache_stats(VALUE self)
+{
+  JKeyScheduleCache::Stats stats = JKeyScheduleCache::getInstance().getStats();
+  VALUE retval = rb_hash_new();
+
+  rb_hash_aset(retval, ID2SYM(rb_intern("hits")), ULL2NUM(stats.hits));
+  rb_hash_aset(retval, ID2SYM(rb_intern("misses")), ULL2NUM(stats.misses));
+  rb_hash_aset(retval, ID2SYM(rb_intern("evictions")), ULL2NUM(stats.evictions));
+  rb_hash_aset(retval, ID2SYM(rb_intern("entries")), SIZET2NUM(stats.entries));
+  rb_hash_aset(retval, ID2SYM(rb_intern("bytes")), SIZET2NUM(stats.bytes));
+  rb_hash_aset(retval, ID2SYM(rb_intern("max_bytes")), SIZET2NUM(stats.maxBytes));
+
+  return retval;
+}
 
 /**
  * call-seq:
- *    cipher_list() => Array
+ *    preload(algorithm, keys) => Fixnum
+ *    preload(algorithm, keys, options) => Fixnum
  *
- * Returns an Array of available ciphers.
+ * Runs the key setup for each of the keys, in binary, and puts the results
+ * in the key schedule cache, e.g. to warm it up for the busiest keys when a
+ * process starts. The options are the Cipher options. The block mode picks
+ * whether the inverse cipher's schedule is loaded as well, as ECB, CBC and
+ * CBC with CTS decrypt with it. Returns the number of keys loaded.
  */
-VALUE rb_module_cipher_list(VALUE self)
+VALUE rb_key_schedule_cache_preload(int argc, VALUE *argv, VALUE self)
 {
-  VALUE ary = rb_ary_new();
+  VALUE algorithm, keys, options, tmp;
+  JBase *cipher = NULL;
 
-#  define CIPHER_ALGORITHM_X(klass, r, c, s) \
-    rb_ary_push(ary, ID2SYM(rb_intern(# s)));
-#  include "defs/ciphers.def"
+  rb_scan_args(argc, argv, "21", &algorithm, &keys, &options);
+  Check_Type(keys, T_ARRAY);
 
-  return ary;
+  if (!JKeyScheduleCache::getInstance().isEnabled()) {
+    rb_raise(rb_eCryptoPP_Error, "the key schedule cache isn't enabled");
+  }
+
+  try {
+    tmp = wrap_cipher_in_ruby(cipher_factory(algorithm));
+  }
+  catch (Exception& e) {
+    rb_raise(rb_eCryptoPP_Error, "%s", e.GetWhat().c_str());
+  }
+  if (!NIL_P(options)) {
+    cipher_options(tmp, options);
+  }
+
+  Data_Get_Struct(tmp, JBase, cipher);
+  if (IS_STREAM_CIPHER(cipher->getCipherType())) {
+    rb_raise(rb_eCryptoPP_Error, "only block cipher key schedules are cached");
+  }
+
+  for (long i = 0; i < RARRAY_LEN(keys); ++i) {
+    cipher_key_eq(tmp, rb_ary_entry(keys, i), BINARY_ENCODING);
+
+    try {
+      JCipher* blockCipher = (JCipher*) cipher;
+
+      delete blockCipher->getKeySchedule(true);
+      if (JCipher::usesInverseCipher(blockCipher->getMode())) {
+        delete blockCipher->getKeySchedule(false);
+      }
+    }
+    catch (Exception& e) {
+      rb_raise(rb_eCryptoPP_Error, "Crypto++ exception: %s", e.GetWhat().c_str());
+    }
+  }
+
+  return LONG2NUM(RARRAY_LEN(keys));
 }
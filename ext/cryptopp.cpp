@@ -12,7 +12,9 @@
 #endif
 
 #include "jbase.h"
+#include "jcipherspec.h"
 #include "jhash.h"
+#include "jnoncesequence.h"
 #include "jconfig.h"
 
 #include "cryptopp_ruby_api.h"
@@ -24,6 +26,10 @@ VALUE rb_eCryptoPP_Error;
 VALUE rb_cCryptoPP_Cipher;
 VALUE rb_cCryptoPP_Digest;
 VALUE rb_cCryptoPP_Digest_HMAC;
+VALUE rb_mCryptoPP_FileCrypter;
+VALUE rb_cCryptoPP_NonceSequence;
+VALUE rb_cCryptoPP_CipherSpec;
+VALUE rb_mCryptoPP_KeyScheduleCache;
 
 #define CIPHER_ALGORITHM_X(klass, r, c, s) \
   VALUE rb_cCryptoPP_Cipher_ ## r ;
@@ -52,6 +58,18 @@ void cipher_free(JBase *c)
   delete c;
 }
 
+/* Free up memory. */
+void nonce_sequence_free(JNonceSequence *n)
+{
+  delete n;
+}
+
+/* Free up memory. */
+void cipher_spec_free(JCipherSpec *s)
+{
+  delete s;
+}
+
 /* Marking function for garbage collector. */
 void hash_mark (JHash *c)
 {
@@ -108,23 +126,29 @@ extern "C" void Init_cryptopp()
    *
    * Options include:
    *
-   * * <tt>:plaintext</tt> and <tt>:plaintext_hex</tt> - set the plaintext. You
-   *   can only use one at a time.
-   * * <tt>:ciphertext</tt> and <tt>:ciphertext_hex</tt> - set the ciphertext.
-   *   You can only use one at a time.
-   * * <tt>:key</tt> and <tt>:key_hex</tt> - set the key. You can only use one
+   * * <tt>:plaintext</tt>, <tt>:plaintext_hex</tt>, <tt>:plaintext_b64</tt>
+   *   and <tt>:plaintext_b64url</tt> - set the plaintext. You can only use one
    *   at a time.
+   * * <tt>:ciphertext</tt>, <tt>:ciphertext_hex</tt>,
+   *   <tt>:ciphertext_b64</tt> and <tt>:ciphertext_b64url</tt> - set the
+   *   ciphertext. You can only use one at a time.
+   * * <tt>:key</tt>, <tt>:key_hex</tt>, <tt>:key_b64</tt> and
+   *   <tt>:key_b64url</tt> - set the key. You can only use one at a time.
    * * <tt>:key_length</tt> - set the length of the key. Normally this is done
    *   automatically, but you can force a different key length if necessary.
    * * <tt>:effective_key_length</tt> - sets the effective key length on RC2
    *   ciphers.
+   * * <tt>:backend</tt> - picks the implementation of AES, either
+   *   <tt>:crypto_pp</tt> or the constant-time <tt>:bitsliced</tt>.
    * * <tt>:rounds</tt> - sets the number of rounds a cipher performs on
    *   block ciphers that support them.
    * * <tt>:rng</tt> - sets the random number generator to be used for things
    *   like creating initialization vectors and such. Not all operating
    *   systems and environments will support all RNGs. You can check which
    *   ones are supported with <tt>CryptoPP#rng_available?</tt>. Possible
-   *   values are :blocking, :non_blocking and :rand.
+   *   values are :blocking, :non_blocking, :rand, :rdrand and :rdseed. The
+   *   last two use the CPU's RDRAND and RDSEED instructions and fall back to
+   *   the default RNG when the CPU doesn't have them.
    *
    * All of these options have their equivalent setter and getter methods
    * if you need to modify them after initialization.
@@ -143,9 +167,39 @@ extern "C" void Init_cryptopp()
    */
   rb_cCryptoPP_Digest_HMAC = rb_define_class_under(rb_mCryptoPP, "HMAC", rb_cCryptoPP_Digest);
 
+  /**
+   * Encrypts and decrypts batches of files, path to path, on a pool of
+   * native threads with the GVL released. See
+   * <tt>CryptoPP::FileCrypter.encrypt_files</tt>.
+   */
+  rb_mCryptoPP_FileCrypter = rb_define_module_under(rb_mCryptoPP, "FileCrypter");
+
+  /**
+   * Hands out unique nonces for CTR and similar modes from a random prefix
+   * and a counter. Can be passed as <tt>:iv</tt> to ciphers and to
+   * <tt>CryptoPP::FileCrypter.encrypt_files</tt>.
+   */
+  rb_cCryptoPP_NonceSequence = rb_define_class_under(rb_mCryptoPP, "NonceSequence", rb_cObject);
+
+  /**
+   * A frozen block cipher set up with its key, mode and padding, which can
+   * be shared between threads. The IV is passed to each call. See
+   * <tt>CryptoPP::CipherSpec.new</tt>.
+   */
+  rb_cCryptoPP_CipherSpec = rb_define_class_under(rb_mCryptoPP, "CipherSpec", rb_cObject);
+
+  /**
+   * An opt-in, process-wide LRU of expanded block cipher keys, so ciphers
+   * for recently used keys skip the key setup. See
+   * <tt>CryptoPP::KeyScheduleCache.enable</tt>.
+   */
+  rb_mCryptoPP_KeyScheduleCache = rb_define_module_under(rb_mCryptoPP, "KeyScheduleCache");
+
   rb_undef_alloc_func(rb_cCryptoPP_Cipher);
   rb_undef_alloc_func(rb_cCryptoPP_Digest);
   rb_undef_alloc_func(rb_cCryptoPP_Digest_HMAC);
+  rb_undef_alloc_func(rb_cCryptoPP_NonceSequence);
+  rb_undef_alloc_func(rb_cCryptoPP_CipherSpec);
 
 # define XCRYPTOPP_EXT_VERSION(s) #s
 # define CRYPTOPP_EXT_VERSION(s) XCRYPTOPP_EXT_VERSION(s)
@@ -180,6 +234,7 @@ extern "C" void Init_cryptopp()
   rb_define_module_function(rb_mCryptoPP, "rng_name",         RUBY_METHOD_FUNC(rb_module_rng_name),        1); /* in ciphers.cpp */
   rb_define_module_function(rb_mCryptoPP, "cipher_enabled?",  RUBY_METHOD_FUNC(rb_module_cipher_enabled),  1); /* in ciphers.cpp */
   rb_define_module_function(rb_mCryptoPP, "rng_available?",   RUBY_METHOD_FUNC(rb_module_rng_available),   1); /* in ciphers.cpp */
+  rb_define_module_function(rb_mCryptoPP, "random_bytes",     RUBY_METHOD_FUNC(rb_module_random_bytes),   -1); /* in ciphers.cpp */
 
   rb_define_module_function(rb_mCryptoPP, "cipher_factory",   RUBY_METHOD_FUNC(rb_module_cipher_factory),        -1); /* in ciphers.cpp */
   rb_define_module_function(rb_mCryptoPP, "digest_factory",   RUBY_METHOD_FUNC(rb_module_digest_factory),        -1); /* in digests.cpp */
@@ -195,21 +250,34 @@ extern "C" void Init_cryptopp()
 
   rb_define_module_function(rb_mCryptoPP, "digest",          RUBY_METHOD_FUNC(rb_module_digest),     -1); /* in digests.cpp */
   rb_define_module_function(rb_mCryptoPP, "digest_hex",      RUBY_METHOD_FUNC(rb_module_digest_hex), -1); /* in digests.cpp */
+  rb_define_module_function(rb_mCryptoPP, "digest_b64",      RUBY_METHOD_FUNC(rb_module_digest_b64), -1); /* in digests.cpp */
+  rb_define_module_function(rb_mCryptoPP, "digest_b64url",   RUBY_METHOD_FUNC(rb_module_digest_b64url), -1); /* in digests.cpp */
 
   rb_define_alias(rb_singleton_class(rb_mCryptoPP), "hexdigest", "digest_hex");
 
   rb_define_module_function(rb_mCryptoPP, "digest_io",     RUBY_METHOD_FUNC(rb_module_digest_io),         -1); /* in digests.cpp */
   rb_define_module_function(rb_mCryptoPP, "digest_io_hex", RUBY_METHOD_FUNC(rb_module_digest_io_hex),     -1); /* in digests.cpp */
+  rb_define_module_function(rb_mCryptoPP, "copy_stream",   RUBY_METHOD_FUNC(rb_module_copy_stream),       -1); /* in digests.cpp */
 
   rb_define_module_function(rb_mCryptoPP, "digest_hmac",     RUBY_METHOD_FUNC(rb_module_hmac_digest),        -1);  /* in digests.cpp */
   rb_define_module_function(rb_mCryptoPP, "digest_hmac_hex", RUBY_METHOD_FUNC(rb_module_hmac_digest_hex),    -1);  /* in digests.cpp */
+  rb_define_module_function(rb_mCryptoPP, "digest_hmac_b64", RUBY_METHOD_FUNC(rb_module_hmac_digest_b64),    -1);  /* in digests.cpp */
+  rb_define_module_function(rb_mCryptoPP, "digest_hmac_b64url", RUBY_METHOD_FUNC(rb_module_hmac_digest_b64url), -1);  /* in digests.cpp */
   rb_define_module_function(rb_mCryptoPP, "hmac_list",       RUBY_METHOD_FUNC(rb_module_hmac_list),           0);  /* in digests.cpp */
+  rb_define_module_function(rb_mCryptoPP, "hmac_many",       RUBY_METHOD_FUNC(rb_module_hmac_many),           3);  /* in digests.cpp */
+  rb_define_module_function(rb_mCryptoPP, "hmac_verify_many", RUBY_METHOD_FUNC(rb_module_hmac_verify_many),   3);  /* in digests.cpp */
+  rb_define_module_function(rb_mCryptoPP, "pbkdf2",          RUBY_METHOD_FUNC(rb_module_pbkdf2),              5);  /* in digests.cpp */
+  rb_define_module_function(rb_mCryptoPP, "hkdf",            RUBY_METHOD_FUNC(rb_module_hkdf),                5);  /* in digests.cpp */
 
   rb_define_method(rb_cCryptoPP_Cipher, "rand_iv",            RUBY_METHOD_FUNC(rb_cipher_rand_iv),            1); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "iv=",                RUBY_METHOD_FUNC(rb_cipher_iv_eq),              1); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "iv_hex=",            RUBY_METHOD_FUNC(rb_cipher_iv_hex_eq),          1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "iv_b64=",            RUBY_METHOD_FUNC(rb_cipher_iv_b64_eq),          1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "iv_b64url=",         RUBY_METHOD_FUNC(rb_cipher_iv_b64url_eq),       1); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "iv",                 RUBY_METHOD_FUNC(rb_cipher_iv),                 0); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "iv_hex",             RUBY_METHOD_FUNC(rb_cipher_iv_hex),             0); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "iv_b64",             RUBY_METHOD_FUNC(rb_cipher_iv_b64),             0); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "iv_b64url",          RUBY_METHOD_FUNC(rb_cipher_iv_b64url),          0); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "block_mode=",        RUBY_METHOD_FUNC(rb_cipher_block_mode_eq),      1); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "block_mode",         RUBY_METHOD_FUNC(rb_cipher_block_mode),         0); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "padding=",           RUBY_METHOD_FUNC(rb_cipher_padding_eq),         1); /* in ciphers.cpp */
@@ -218,16 +286,28 @@ extern "C" void Init_cryptopp()
   rb_define_method(rb_cCryptoPP_Cipher, "rng",                RUBY_METHOD_FUNC(rb_cipher_rng),                0); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "plaintext=",         RUBY_METHOD_FUNC(rb_cipher_plaintext_eq),       1); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "plaintext_hex=",     RUBY_METHOD_FUNC(rb_cipher_plaintext_hex_eq),   1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "plaintext_b64=",     RUBY_METHOD_FUNC(rb_cipher_plaintext_b64_eq),   1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "plaintext_b64url=",  RUBY_METHOD_FUNC(rb_cipher_plaintext_b64url_eq), 1); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "plaintext",          RUBY_METHOD_FUNC(rb_cipher_plaintext),          0); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "plaintext_hex",      RUBY_METHOD_FUNC(rb_cipher_plaintext_hex),      0); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "plaintext_b64",      RUBY_METHOD_FUNC(rb_cipher_plaintext_b64),      0); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "plaintext_b64url",   RUBY_METHOD_FUNC(rb_cipher_plaintext_b64url),   0); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "ciphertext=",        RUBY_METHOD_FUNC(rb_cipher_ciphertext_eq),      1); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "ciphertext_hex=",    RUBY_METHOD_FUNC(rb_cipher_ciphertext_hex_eq),  1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "ciphertext_b64=",    RUBY_METHOD_FUNC(rb_cipher_ciphertext_b64_eq),  1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "ciphertext_b64url=", RUBY_METHOD_FUNC(rb_cipher_ciphertext_b64url_eq), 1); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "ciphertext",         RUBY_METHOD_FUNC(rb_cipher_ciphertext),         0); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "ciphertext_hex",     RUBY_METHOD_FUNC(rb_cipher_ciphertext_hex),     0); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "ciphertext_b64",     RUBY_METHOD_FUNC(rb_cipher_ciphertext_b64),     0); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "ciphertext_b64url",  RUBY_METHOD_FUNC(rb_cipher_ciphertext_b64url),  0); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "key=",               RUBY_METHOD_FUNC(rb_cipher_key_eq),             1); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "key_hex=",           RUBY_METHOD_FUNC(rb_cipher_key_hex_eq),         1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "key_b64=",           RUBY_METHOD_FUNC(rb_cipher_key_b64_eq),         1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "key_b64url=",        RUBY_METHOD_FUNC(rb_cipher_key_b64url_eq),      1); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "key",                RUBY_METHOD_FUNC(rb_cipher_key),                0); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "key_hex",            RUBY_METHOD_FUNC(rb_cipher_key_hex),            0); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "key_b64",            RUBY_METHOD_FUNC(rb_cipher_key_b64),            0); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "key_b64url",         RUBY_METHOD_FUNC(rb_cipher_key_b64url),         0); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "key_length=",        RUBY_METHOD_FUNC(rb_cipher_key_length_eq),      1); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "key_length",         RUBY_METHOD_FUNC(rb_cipher_key_length),         0); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "default_key_length", RUBY_METHOD_FUNC(rb_cipher_default_key_length), 0); /* in ciphers.cpp */
@@ -238,6 +318,10 @@ extern "C" void Init_cryptopp()
 #  if ENABLED_RC2_CIPHER
   rb_define_method(rb_cCryptoPP_Cipher_RC2, "effective_key_length=", RUBY_METHOD_FUNC(rb_cipher_effective_key_length_eq), 1); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher_RC2, "effective_key_length",  RUBY_METHOD_FUNC(rb_cipher_effective_key_length),    0); /* in ciphers.cpp */
+#  endif
+#  if ENABLED_AES_CIPHER
+  rb_define_method(rb_cCryptoPP_Cipher_AES, "backend=", RUBY_METHOD_FUNC(rb_cipher_backend_eq), 1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher_AES, "backend",  RUBY_METHOD_FUNC(rb_cipher_backend),    0); /* in ciphers.cpp */
 #  endif
   rb_define_method(rb_cCryptoPP_Cipher, "block_size",          RUBY_METHOD_FUNC(rb_cipher_block_size),      1); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "rounds=",             RUBY_METHOD_FUNC(rb_cipher_rounds_eq),       1); /* in ciphers.cpp */
@@ -247,25 +331,69 @@ extern "C" void Init_cryptopp()
   rb_define_method(rb_cCryptoPP_Cipher, "padding_name",        RUBY_METHOD_FUNC(rb_cipher_padding_name),    0); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "rng_name",            RUBY_METHOD_FUNC(rb_cipher_rng_name),        0); /* in ciphers.cpp */
   rb_define_method(rb_cCryptoPP_Cipher, "cipher_type",         RUBY_METHOD_FUNC(rb_cipher_cipher_type),     0); /* in ciphers.cpp */
-  rb_define_method(rb_cCryptoPP_Cipher, "encrypt",             RUBY_METHOD_FUNC(rb_cipher_encrypt),         0); /* in ciphers.cpp */
-  rb_define_method(rb_cCryptoPP_Cipher, "encrypt_hex",         RUBY_METHOD_FUNC(rb_cipher_encrypt_hex),     0); /* in ciphers.cpp */
-  rb_define_method(rb_cCryptoPP_Cipher, "decrypt",             RUBY_METHOD_FUNC(rb_cipher_decrypt),         0); /* in ciphers.cpp */
-  rb_define_method(rb_cCryptoPP_Cipher, "decrypt_hex",         RUBY_METHOD_FUNC(rb_cipher_decrypt_hex),     0); /* in ciphers.cpp */
-  rb_define_method(rb_cCryptoPP_Cipher, "encrypt_io",          RUBY_METHOD_FUNC(rb_cipher_encrypt_io),      2); /* in ciphers.cpp */
-  rb_define_method(rb_cCryptoPP_Cipher, "decrypt_io",          RUBY_METHOD_FUNC(rb_cipher_decrypt_io),      2); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "encrypt",             RUBY_METHOD_FUNC(rb_cipher_encrypt),        -1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "encrypt_hex",         RUBY_METHOD_FUNC(rb_cipher_encrypt_hex),    -1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "encrypt_b64",         RUBY_METHOD_FUNC(rb_cipher_encrypt_b64),    -1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "encrypt_b64url",      RUBY_METHOD_FUNC(rb_cipher_encrypt_b64url), -1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "decrypt",             RUBY_METHOD_FUNC(rb_cipher_decrypt),        -1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "decrypt_hex",         RUBY_METHOD_FUNC(rb_cipher_decrypt_hex),    -1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "decrypt_b64",         RUBY_METHOD_FUNC(rb_cipher_decrypt_b64),    -1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "decrypt_b64url",      RUBY_METHOD_FUNC(rb_cipher_decrypt_b64url), -1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "encrypt_blocks",      RUBY_METHOD_FUNC(rb_cipher_encrypt_blocks),  1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "decrypt_blocks",      RUBY_METHOD_FUNC(rb_cipher_decrypt_blocks),  1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "encrypt_many",        RUBY_METHOD_FUNC(rb_cipher_encrypt_many),    2); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "encrypt_each",        RUBY_METHOD_FUNC(rb_cipher_encrypt_each),   -1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "decrypt_each",        RUBY_METHOD_FUNC(rb_cipher_decrypt_each),   -1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "encrypt_io",          RUBY_METHOD_FUNC(rb_cipher_encrypt_io),     -1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "decrypt_io",          RUBY_METHOD_FUNC(rb_cipher_decrypt_io),     -1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "encrypt_file",        RUBY_METHOD_FUNC(rb_cipher_encrypt_file),   -1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_Cipher, "decrypt_file",        RUBY_METHOD_FUNC(rb_cipher_decrypt_file),   -1); /* in ciphers.cpp */
+
+  rb_define_module_function(rb_mCryptoPP_FileCrypter, "encrypt_files", RUBY_METHOD_FUNC(rb_file_crypter_encrypt_files), -1); /* in ciphers.cpp */
+  rb_define_module_function(rb_mCryptoPP_FileCrypter, "decrypt_files", RUBY_METHOD_FUNC(rb_file_crypter_decrypt_files), -1); /* in ciphers.cpp */
+
+  rb_define_singleton_method(rb_cCryptoPP_NonceSequence, "new", RUBY_METHOD_FUNC(rb_nonce_sequence_new), -1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_NonceSequence, "next",          RUBY_METHOD_FUNC(rb_nonce_sequence_next),    0); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_NonceSequence, "size",          RUBY_METHOD_FUNC(rb_nonce_sequence_size),    0); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_NonceSequence, "prefix",        RUBY_METHOD_FUNC(rb_nonce_sequence_prefix),  0); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_NonceSequence, "count",         RUBY_METHOD_FUNC(rb_nonce_sequence_count),   0); /* in ciphers.cpp */
+
+  rb_define_singleton_method(rb_cCryptoPP_CipherSpec, "new",  RUBY_METHOD_FUNC(rb_cipher_spec_new),            2); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_CipherSpec, "encrypt",        RUBY_METHOD_FUNC(rb_cipher_spec_encrypt),       -1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_CipherSpec, "decrypt",        RUBY_METHOD_FUNC(rb_cipher_spec_decrypt),       -1); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_CipherSpec, "algorithm_name", RUBY_METHOD_FUNC(rb_cipher_spec_algorithm_name), 0); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_CipherSpec, "block_mode",     RUBY_METHOD_FUNC(rb_cipher_spec_block_mode),     0); /* in ciphers.cpp */
+  rb_define_method(rb_cCryptoPP_CipherSpec, "block_size",     RUBY_METHOD_FUNC(rb_cipher_spec_block_size),     0); /* in ciphers.cpp */
+
+  rb_define_module_function(rb_mCryptoPP_KeyScheduleCache, "enable",   RUBY_METHOD_FUNC(rb_key_schedule_cache_enable),  -1); /* in ciphers.cpp */
+  rb_define_module_function(rb_mCryptoPP_KeyScheduleCache, "disable",  RUBY_METHOD_FUNC(rb_key_schedule_cache_disable),  0); /* in ciphers.cpp */
+  rb_define_module_function(rb_mCryptoPP_KeyScheduleCache, "enabled?", RUBY_METHOD_FUNC(rb_key_schedule_cache_enabled),  0); /* in ciphers.cpp */
+  rb_define_module_function(rb_mCryptoPP_KeyScheduleCache, "clear",    RUBY_METHOD_FUNC(rb_key_schedule_cache_clear),    0); /* in ciphers.cpp */
+  rb_define_module_function(rb_mCryptoPP_KeyScheduleCache, "stats",    RUBY_METHOD_FUNC(rb_key_schedule_cache_stats),    0); /* in ciphers.cpp */
+  rb_define_module_function(rb_mCryptoPP_KeyScheduleCache, "preload",  RUBY_METHOD_FUNC(rb_key_schedule_cache_preload), -1); /* in ciphers.cpp */
 
   rb_define_method(rb_cCryptoPP_Digest, "digest",              RUBY_METHOD_FUNC(rb_digest_digest),             0); /* in digests.cpp */
   rb_define_method(rb_cCryptoPP_Digest, "digest_hex",          RUBY_METHOD_FUNC(rb_digest_digest_hex),         0); /* in digests.cpp */
+  rb_define_method(rb_cCryptoPP_Digest, "digest_b64",          RUBY_METHOD_FUNC(rb_digest_digest_b64),         0); /* in digests.cpp */
+  rb_define_method(rb_cCryptoPP_Digest, "digest_b64url",       RUBY_METHOD_FUNC(rb_digest_digest_b64url),      0); /* in digests.cpp */
   rb_define_method(rb_cCryptoPP_Digest, "digest=",             RUBY_METHOD_FUNC(rb_digest_digest_eq),          1); /* in digests.cpp */
   rb_define_method(rb_cCryptoPP_Digest, "digest_hex=",         RUBY_METHOD_FUNC(rb_digest_digest_hex_eq),      1); /* in digests.cpp */
+  rb_define_method(rb_cCryptoPP_Digest, "digest_b64=",         RUBY_METHOD_FUNC(rb_digest_digest_b64_eq),      1); /* in digests.cpp */
+  rb_define_method(rb_cCryptoPP_Digest, "digest_b64url=",      RUBY_METHOD_FUNC(rb_digest_digest_b64url_eq),   1); /* in digests.cpp */
   rb_define_method(rb_cCryptoPP_Digest, "plaintext",           RUBY_METHOD_FUNC(rb_digest_plaintext),          0); /* in digests.cpp */
   rb_define_method(rb_cCryptoPP_Digest, "plaintext=",          RUBY_METHOD_FUNC(rb_digest_plaintext_eq),       1); /* in digests.cpp */
   rb_define_method(rb_cCryptoPP_Digest, "plaintext_hex",       RUBY_METHOD_FUNC(rb_digest_plaintext_hex),      0); /* in digests.cpp */
+  rb_define_method(rb_cCryptoPP_Digest, "plaintext_b64",       RUBY_METHOD_FUNC(rb_digest_plaintext_b64),      0); /* in digests.cpp */
+  rb_define_method(rb_cCryptoPP_Digest, "plaintext_b64url",    RUBY_METHOD_FUNC(rb_digest_plaintext_b64url),   0); /* in digests.cpp */
   rb_define_method(rb_cCryptoPP_Digest, "plaintext_hex=",      RUBY_METHOD_FUNC(rb_digest_plaintext_hex_eq),   1); /* in digests.cpp */
+  rb_define_method(rb_cCryptoPP_Digest, "plaintext_b64=",      RUBY_METHOD_FUNC(rb_digest_plaintext_b64_eq),   1); /* in digests.cpp */
+  rb_define_method(rb_cCryptoPP_Digest, "plaintext_b64url=",   RUBY_METHOD_FUNC(rb_digest_plaintext_b64url_eq), 1); /* in digests.cpp */
   rb_define_method(rb_cCryptoPP_Digest, "calculate",           RUBY_METHOD_FUNC(rb_digest_calculate),          0); /* in digests.cpp */
   rb_define_method(rb_cCryptoPP_Digest, "calculate_hex",       RUBY_METHOD_FUNC(rb_digest_calculate_hex),      0); /* in digests.cpp */
-  rb_define_method(rb_cCryptoPP_Digest, "digest_io",           RUBY_METHOD_FUNC(rb_digest_digest_io),          1); /* in digests.cpp */
-  rb_define_method(rb_cCryptoPP_Digest, "digest_io_hex",       RUBY_METHOD_FUNC(rb_digest_digest_io_hex),      1); /* in digests.cpp */
+  rb_define_method(rb_cCryptoPP_Digest, "calculate_b64",       RUBY_METHOD_FUNC(rb_digest_calculate_b64),      0); /* in digests.cpp */
+  rb_define_method(rb_cCryptoPP_Digest, "calculate_b64url",    RUBY_METHOD_FUNC(rb_digest_calculate_b64url),   0); /* in digests.cpp */
+  rb_define_method(rb_cCryptoPP_Digest, "digest_io",           RUBY_METHOD_FUNC(rb_digest_digest_io),         -1); /* in digests.cpp */
+  rb_define_method(rb_cCryptoPP_Digest, "digest_io_hex",       RUBY_METHOD_FUNC(rb_digest_digest_io_hex),     -1); /* in digests.cpp */
   rb_define_method(rb_cCryptoPP_Digest, "update",              RUBY_METHOD_FUNC(rb_digest_update),             1); /* in digests.cpp */
   rb_define_method(rb_cCryptoPP_Digest, "to_s",                RUBY_METHOD_FUNC(rb_digest_digest_hex),         0); /* in digests.cpp */
   rb_define_method(rb_cCryptoPP_Digest, "inspect",             RUBY_METHOD_FUNC(rb_digest_inspect),            0); /* in digests.cpp */
@@ -281,8 +409,12 @@ extern "C" void Init_cryptopp()
 
   rb_define_method(rb_cCryptoPP_Digest_HMAC, "key=",           RUBY_METHOD_FUNC(rb_digest_hmac_key_eq),        1); /* in digests.cpp */
   rb_define_method(rb_cCryptoPP_Digest_HMAC, "key_hex=",       RUBY_METHOD_FUNC(rb_digest_hmac_key_hex_eq),    1); /* in digests.cpp */
+  rb_define_method(rb_cCryptoPP_Digest_HMAC, "key_b64=",       RUBY_METHOD_FUNC(rb_digest_hmac_key_b64_eq),    1); /* in digests.cpp */
+  rb_define_method(rb_cCryptoPP_Digest_HMAC, "key_b64url=",    RUBY_METHOD_FUNC(rb_digest_hmac_key_b64url_eq), 1); /* in digests.cpp */
   rb_define_method(rb_cCryptoPP_Digest_HMAC, "key",            RUBY_METHOD_FUNC(rb_digest_hmac_key),           0); /* in digests.cpp */
   rb_define_method(rb_cCryptoPP_Digest_HMAC, "key_hex",        RUBY_METHOD_FUNC(rb_digest_hmac_key_hex),       0); /* in digests.cpp */
+  rb_define_method(rb_cCryptoPP_Digest_HMAC, "key_b64",        RUBY_METHOD_FUNC(rb_digest_hmac_key_b64),       0); /* in digests.cpp */
+  rb_define_method(rb_cCryptoPP_Digest_HMAC, "key_b64url",     RUBY_METHOD_FUNC(rb_digest_hmac_key_b64url),    0); /* in digests.cpp */
   rb_define_method(rb_cCryptoPP_Digest_HMAC, "key_length=",    RUBY_METHOD_FUNC(rb_digest_hmac_key_length_eq), 1); /* in digests.cpp */
   rb_define_method(rb_cCryptoPP_Digest_HMAC, "key_length",     RUBY_METHOD_FUNC(rb_digest_hmac_key_length),    0); /* in digests.cpp */
 }
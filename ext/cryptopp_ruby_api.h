@@ -8,6 +8,8 @@
 #ifndef __CRYPTOPP_RUBY_API_H__
 #define __CRYPTOPP_RUBY_API_H__
 
+#include <string>
+
 #include "ruby.h"
 
 extern VALUE rb_mCryptoPP;
@@ -15,6 +17,10 @@ extern VALUE rb_eCryptoPP_Error;
 extern VALUE rb_cCryptoPP_Cipher;
 extern VALUE rb_cCryptoPP_Digest;
 extern VALUE rb_cCryptoPP_Digest_HMAC;
+extern VALUE rb_mCryptoPP_FileCrypter;
+extern VALUE rb_cCryptoPP_NonceSequence;
+extern VALUE rb_cCryptoPP_CipherSpec;
+extern VALUE rb_mCryptoPP_KeyScheduleCache;
 
 #define CIPHER_ALGORITHM_X(klass, r, c, s) \
   extern VALUE rb_cCryptoPP_Cipher_ ## r ;
@@ -32,6 +38,19 @@ extern VALUE rb_cCryptoPP_Digest_HMAC;
   extern VALUE rb_cCryptoPP_Digest_HMAC_ ## r ;
 #include "defs/hmacs.def"
 
+// how Strings are passed in and out of the _hex, _b64 and _b64url methods
+enum RubyEncodingEnum {
+  BINARY_ENCODING,
+  HEX_ENCODING,
+  BASE64_ENCODING,
+  BASE64URL_ENCODING
+};
+
+/* in utils.cpp */
+VALUE encodeRubyString(const std::string& bin, RubyEncodingEnum encoding);
+std::string decodeRubyString(VALUE str, RubyEncodingEnum encoding);
+VALUE getEncodedRubyOption(VALUE options, const char* name, RubyEncodingEnum* encoding);
+
 VALUE rb_module_cipher_factory(int argc, VALUE *argv, VALUE self);
 #define CIPHER_ALGORITHM_X(klass, r, n, s) \
 VALUE rb_cipher_ ## r ##_new(int argc, VALUE *argv, VALUE self);
@@ -39,8 +58,12 @@ VALUE rb_cipher_ ## r ##_new(int argc, VALUE *argv, VALUE self);
 VALUE rb_cipher_rand_iv(VALUE self, VALUE l);
 VALUE rb_cipher_iv_eq(VALUE self, VALUE iv);
 VALUE rb_cipher_iv_hex_eq(VALUE self, VALUE iv);
+VALUE rb_cipher_iv_b64_eq(VALUE self, VALUE iv);
+VALUE rb_cipher_iv_b64url_eq(VALUE self, VALUE iv);
 VALUE rb_cipher_iv(VALUE self);
 VALUE rb_cipher_iv_hex(VALUE self);
+VALUE rb_cipher_iv_b64(VALUE self);
+VALUE rb_cipher_iv_b64url(VALUE self);
 VALUE rb_cipher_block_mode_eq(VALUE self, VALUE m);
 VALUE rb_cipher_block_mode(VALUE self);
 VALUE rb_cipher_padding_eq(VALUE self, VALUE p);
@@ -49,16 +72,28 @@ VALUE rb_cipher_rng_eq(VALUE self, VALUE r);
 VALUE rb_cipher_rng(VALUE self);
 VALUE rb_cipher_plaintext_eq(VALUE self, VALUE plaintext);
 VALUE rb_cipher_plaintext_hex_eq(VALUE self, VALUE plaintext);
+VALUE rb_cipher_plaintext_b64_eq(VALUE self, VALUE plaintext);
+VALUE rb_cipher_plaintext_b64url_eq(VALUE self, VALUE plaintext);
 VALUE rb_cipher_plaintext(VALUE self);
 VALUE rb_cipher_plaintext_hex(VALUE self);
+VALUE rb_cipher_plaintext_b64(VALUE self);
+VALUE rb_cipher_plaintext_b64url(VALUE self);
 VALUE rb_cipher_ciphertext_eq(VALUE self, VALUE ciphertext);
 VALUE rb_cipher_ciphertext_hex_eq(VALUE self, VALUE ciphertext);
+VALUE rb_cipher_ciphertext_b64_eq(VALUE self, VALUE ciphertext);
+VALUE rb_cipher_ciphertext_b64url_eq(VALUE self, VALUE ciphertext);
 VALUE rb_cipher_ciphertext(VALUE self);
 VALUE rb_cipher_ciphertext_hex(VALUE self);
+VALUE rb_cipher_ciphertext_b64(VALUE self);
+VALUE rb_cipher_ciphertext_b64url(VALUE self);
 VALUE rb_cipher_key_eq(VALUE self, VALUE key);
 VALUE rb_cipher_key_hex_eq(VALUE self, VALUE key);
+VALUE rb_cipher_key_b64_eq(VALUE self, VALUE key);
+VALUE rb_cipher_key_b64url_eq(VALUE self, VALUE key);
 VALUE rb_cipher_key(VALUE self);
 VALUE rb_cipher_key_hex(VALUE self);
+VALUE rb_cipher_key_b64(VALUE self);
+VALUE rb_cipher_key_b64url(VALUE self);
 VALUE rb_cipher_key_length_eq(VALUE self, VALUE l);
 VALUE rb_cipher_key_length(VALUE self);
 VALUE rb_cipher_default_key_length(VALUE self);
@@ -68,15 +103,30 @@ VALUE rb_cipher_mult_key_length(VALUE self);
 VALUE rb_cipher_valid_key_length(VALUE self, VALUE l);
 VALUE rb_cipher_effective_key_length_eq(VALUE self, VALUE l);
 VALUE rb_cipher_effective_key_length(VALUE self);
+VALUE rb_cipher_backend_eq(VALUE self, VALUE b);
+VALUE rb_cipher_backend(VALUE self);
 VALUE rb_cipher_block_size(VALUE self);
 VALUE rb_cipher_rounds_eq(VALUE self, VALUE r);
 VALUE rb_cipher_rounds(VALUE self);
-VALUE rb_cipher_encrypt(VALUE self);
-VALUE rb_cipher_encrypt_hex(VALUE self);
-VALUE rb_cipher_decrypt(VALUE self);
-VALUE rb_cipher_decrypt_hex(VALUE self);
-VALUE rb_cipher_encrypt_io(VALUE self, VALUE in, VALUE out);
-VALUE rb_cipher_decrypt_io(VALUE self, VALUE in, VALUE out);
+VALUE rb_cipher_encrypt(int argc, VALUE *argv, VALUE self);
+VALUE rb_cipher_encrypt_hex(int argc, VALUE *argv, VALUE self);
+VALUE rb_cipher_encrypt_b64(int argc, VALUE *argv, VALUE self);
+VALUE rb_cipher_encrypt_b64url(int argc, VALUE *argv, VALUE self);
+VALUE rb_cipher_decrypt(int argc, VALUE *argv, VALUE self);
+VALUE rb_cipher_decrypt_hex(int argc, VALUE *argv, VALUE self);
+VALUE rb_cipher_decrypt_b64(int argc, VALUE *argv, VALUE self);
+VALUE rb_cipher_decrypt_b64url(int argc, VALUE *argv, VALUE self);
+VALUE rb_cipher_encrypt_blocks(VALUE self, VALUE blocks);
+VALUE rb_cipher_decrypt_blocks(VALUE self, VALUE blocks);
+VALUE rb_cipher_encrypt_many(VALUE self, VALUE plaintexts, VALUE ivs);
+VALUE rb_cipher_encrypt_each(int argc, VALUE *argv, VALUE self);
+VALUE rb_cipher_decrypt_each(int argc, VALUE *argv, VALUE self);
+VALUE rb_cipher_encrypt_io(int argc, VALUE *argv, VALUE self);
+VALUE rb_cipher_decrypt_io(int argc, VALUE *argv, VALUE self);
+VALUE rb_cipher_encrypt_file(int argc, VALUE *argv, VALUE self);
+VALUE rb_cipher_decrypt_file(int argc, VALUE *argv, VALUE self);
+VALUE rb_file_crypter_encrypt_files(int argc, VALUE *argv, VALUE self);
+VALUE rb_file_crypter_decrypt_files(int argc, VALUE *argv, VALUE self);
 VALUE rb_module_cipher_name(VALUE self, VALUE c);
 VALUE rb_cipher_algorithm_name(VALUE self);
 VALUE rb_module_block_mode_name(VALUE self, VALUE m);
@@ -88,6 +138,24 @@ VALUE rb_cipher_rng_name(VALUE self);
 VALUE rb_cipher_cipher_type(VALUE self);
 VALUE rb_module_cipher_enabled(VALUE self, VALUE c);
 VALUE rb_module_rng_available(VALUE self, VALUE r);
+VALUE rb_module_random_bytes(int argc, VALUE *argv, VALUE self);
+VALUE rb_nonce_sequence_new(int argc, VALUE *argv, VALUE self);
+VALUE rb_nonce_sequence_next(VALUE self);
+VALUE rb_nonce_sequence_size(VALUE self);
+VALUE rb_nonce_sequence_prefix(VALUE self);
+VALUE rb_nonce_sequence_count(VALUE self);
+VALUE rb_cipher_spec_new(VALUE self, VALUE algorithm, VALUE options);
+VALUE rb_cipher_spec_encrypt(int argc, VALUE *argv, VALUE self);
+VALUE rb_cipher_spec_decrypt(int argc, VALUE *argv, VALUE self);
+VALUE rb_cipher_spec_algorithm_name(VALUE self);
+VALUE rb_cipher_spec_block_mode(VALUE self);
+VALUE rb_cipher_spec_block_size(VALUE self);
+VALUE rb_key_schedule_cache_enable(int argc, VALUE *argv, VALUE self);
+VALUE rb_key_schedule_cache_disable(VALUE self);
+VALUE rb_key_schedule_cache_enabled(VALUE self);
+VALUE rb_key_schedule_cache_clear(VALUE self);
+VALUE rb_key_schedule_cache_stats(VALUE self);
+VALUE rb_key_schedule_cache_preload(int argc, VALUE *argv, VALUE self);
 VALUE rb_module_cipher_list(VALUE self);
 VALUE rb_module_digest_factory(int argc, VALUE *argv, VALUE self);
 #define CHECKSUM_ALGORITHM_X(klass, r, n, s) \
@@ -100,27 +168,40 @@ VALUE rb_digest_ ## r ##_new(int argc, VALUE *argv, VALUE self);
 VALUE rb_digest_update(VALUE self, VALUE plaintext);
 VALUE rb_digest_digest(VALUE self);
 VALUE rb_digest_digest_hex(VALUE self);
+VALUE rb_digest_digest_b64(VALUE self);
+VALUE rb_digest_digest_b64url(VALUE self);
 VALUE rb_digest_plaintext(VALUE self);
 VALUE rb_digest_plaintext_hex(VALUE self);
+VALUE rb_digest_plaintext_b64(VALUE self);
+VALUE rb_digest_plaintext_b64url(VALUE self);
 VALUE rb_digest_plaintext_eq(VALUE self, VALUE plaintext);
 VALUE rb_digest_plaintext_hex_eq(VALUE self, VALUE plaintext);
+VALUE rb_digest_plaintext_b64_eq(VALUE self, VALUE plaintext);
+VALUE rb_digest_plaintext_b64url_eq(VALUE self, VALUE plaintext);
 VALUE rb_digest_calculate(VALUE self);
 VALUE rb_digest_calculate_hex(VALUE self);
+VALUE rb_digest_calculate_b64(VALUE self);
+VALUE rb_digest_calculate_b64url(VALUE self);
 VALUE rb_digest_digest_eq(VALUE self, VALUE digest);
 VALUE rb_digest_digest_hex_eq(VALUE self, VALUE digest);
+VALUE rb_digest_digest_b64_eq(VALUE self, VALUE digest);
+VALUE rb_digest_digest_b64url_eq(VALUE self, VALUE digest);
 VALUE rb_digest_inspect(VALUE self);
 VALUE rb_digest_equals(VALUE self, VALUE compare);
 VALUE rb_module_digest(int argc, VALUE *argv, VALUE self);
 VALUE rb_module_digest_hex(int argc, VALUE *argv, VALUE self);
+VALUE rb_module_digest_b64(int argc, VALUE *argv, VALUE self);
+VALUE rb_module_digest_b64url(int argc, VALUE *argv, VALUE self);
 VALUE rb_module_digest_io(int argc, VALUE *argv, VALUE self);
 VALUE rb_module_digest_io_hex(int argc, VALUE *argv, VALUE self);
+VALUE rb_module_copy_stream(int argc, VALUE *argv, VALUE self);
 VALUE rb_module_digest_enabled(VALUE self, VALUE d);
 VALUE rb_module_digest_name(VALUE self, VALUE h);
 VALUE rb_digest_algorithm_name(VALUE self);
 VALUE rb_digest_clear(VALUE self);
 VALUE rb_digest_validate(VALUE self);
-VALUE rb_digest_digest_io(VALUE self, VALUE io);
-VALUE rb_digest_digest_io_hex(VALUE self, VALUE io);
+VALUE rb_digest_digest_io(int argc, VALUE *argv, VALUE self);
+VALUE rb_digest_digest_io_hex(int argc, VALUE *argv, VALUE self);
 VALUE rb_module_digest_list(VALUE self);
 VALUE rb_module_hmac_factory(int argc, VALUE *argv, VALUE self);
 #define HMAC_ALGORITHM_X(klass, r, n, s) \
@@ -128,12 +209,22 @@ VALUE rb_digest_hmac_ ## r ##_new(int argc, VALUE *argv, VALUE self);
 #include "defs/hmacs.def"
 VALUE rb_digest_hmac_key_eq(VALUE self, VALUE key);
 VALUE rb_digest_hmac_key_hex_eq(VALUE self, VALUE key);
+VALUE rb_digest_hmac_key_b64_eq(VALUE self, VALUE key);
+VALUE rb_digest_hmac_key_b64url_eq(VALUE self, VALUE key);
 VALUE rb_digest_hmac_key(VALUE self);
 VALUE rb_digest_hmac_key_hex(VALUE self);
+VALUE rb_digest_hmac_key_b64(VALUE self);
+VALUE rb_digest_hmac_key_b64url(VALUE self);
 VALUE rb_digest_hmac_key_length_eq(VALUE self, VALUE l);
 VALUE rb_digest_hmac_key_length(VALUE self);
 VALUE rb_module_hmac_digest(int argc, VALUE *argv, VALUE self);
 VALUE rb_module_hmac_digest_hex(int argc, VALUE *argv, VALUE self);
+VALUE rb_module_hmac_digest_b64(int argc, VALUE *argv, VALUE self);
+VALUE rb_module_hmac_digest_b64url(int argc, VALUE *argv, VALUE self);
 VALUE rb_module_hmac_list(VALUE self);
+VALUE rb_module_hmac_many(VALUE self, VALUE algorithm, VALUE key, VALUE messages);
+VALUE rb_module_hmac_verify_many(VALUE self, VALUE algorithm, VALUE key, VALUE pairs);
+VALUE rb_module_pbkdf2(VALUE self, VALUE algorithm, VALUE password, VALUE salt, VALUE iterations, VALUE length);
+VALUE rb_module_hkdf(VALUE self, VALUE algorithm, VALUE ikm, VALUE salt, VALUE info, VALUE length);
 
 #endif
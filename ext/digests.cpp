@@ -21,6 +21,7 @@
 #include "jwhirlpool.h"
 
 #include "jexception.h"
+#include "jgvl.h"
 
 #include "cryptopp_ruby_api.h"
 
@@ -36,18 +37,21 @@ static bool digest_enabled(HashEnum hash);
 static void digest_options(VALUE self, VALUE options);
 static JHash* digest_factory(VALUE algorithm);
 static VALUE wrap_digest_in_ruby(JHash* hash);
-static string digest_digest(VALUE self, bool hex);
-static string digest_plaintext(VALUE self, bool hex);
-static string digest_plaintext_eq(VALUE self, VALUE plaintext, bool hex);
-static string digest_calculate(VALUE self, bool hex);
-static string digest_digest_eq(VALUE self, VALUE digest, bool hex);
-static string module_digest(int argc, VALUE *argv, VALUE self, bool hex);
+static VALUE digest_digest(VALUE self, RubyEncodingEnum encoding);
+static VALUE digest_plaintext(VALUE self, RubyEncodingEnum encoding);
+static void digest_plaintext_eq(VALUE self, VALUE plaintext, RubyEncodingEnum encoding);
+static VALUE digest_calculate(VALUE self, RubyEncodingEnum encoding);
+static void digest_digest_eq(VALUE self, VALUE digest, RubyEncodingEnum encoding);
+static VALUE module_digest(int argc, VALUE *argv, VALUE self, RubyEncodingEnum encoding);
 static string module_digest_io(int argc, VALUE *argv, VALUE self, bool hex);
-static string digest_digest_io(VALUE self, VALUE io, bool hex);
+static string digest_digest_io(int argc, VALUE *argv, VALUE self, bool hex);
 static void digest_hmac_options(VALUE self, VALUE options);
-static string digest_hmac_key_eq(VALUE self, VALUE key, bool hex);
-static string digest_hmac_key(VALUE self, bool hex);
-static string module_hmac_digest(int argc, VALUE *argv, VALUE self, bool hex);
+static void digest_hmac_key_eq(VALUE self, VALUE key, RubyEncodingEnum encoding);
+static VALUE digest_hmac_key(VALUE self, RubyEncodingEnum encoding);
+static VALUE module_hmac_digest(int argc, VALUE *argv, VALUE self, RubyEncodingEnum encoding);
+static VALUE module_hmac_keyed_factory(VALUE algorithm, VALUE key);
+static VALUE kdf_hmac_sym(VALUE algorithm);
+static void* module_kdf_without_gvl(void* data);
 
 static HashEnum digest_sym_to_const(VALUE c)
 {
@@ -145,30 +149,18 @@ static void digest_options(VALUE self, VALUE options)
   Check_Type(options, T_HASH);
 
   {
-    VALUE plaintext = rb_hash_aref(options, ID2SYM(rb_intern("plaintext")));
-    VALUE plaintext_hex = rb_hash_aref(options, ID2SYM(rb_intern("plaintext_hex")));
-    if (!NIL_P(plaintext) && !NIL_P(plaintext_hex)) {
-      rb_raise(rb_eCryptoPP_Error, "can't set both plaintext and plaintext_hex in options");
-    }
-    else if (!NIL_P(plaintext)) {
-      digest_plaintext_eq(self, plaintext, false);
-    }
-    else if (!NIL_P(plaintext_hex)) {
-      digest_plaintext_eq(self, plaintext_hex, true);
+    RubyEncodingEnum encoding;
+    VALUE plaintext = getEncodedRubyOption(options, "plaintext", &encoding);
+    if (!NIL_P(plaintext)) {
+      digest_plaintext_eq(self, plaintext, encoding);
     }
   }
 
   {
-    VALUE digest = rb_hash_aref(options, ID2SYM(rb_intern("digest")));
-    VALUE digest_hex = rb_hash_aref(options, ID2SYM(rb_intern("digest_hex")));
-    if (!NIL_P(digest) && !NIL_P(digest_hex)) {
-      rb_raise(rb_eCryptoPP_Error, "can't set both digest and digest_hex in options");
-    }
-    else if (!NIL_P(digest)) {
-      digest_digest_eq(self, digest, false);
-    }
-    else if (!NIL_P(digest_hex)) {
-      digest_digest_eq(self, digest_hex, true);
+    RubyEncodingEnum encoding;
+    VALUE digest = getEncodedRubyOption(options, "digest", &encoding);
+    if (!NIL_P(digest)) {
+      digest_digest_eq(self, digest, encoding);
     }
   }
 }
@@ -357,11 +349,11 @@ VALUE rb_digest_update(VALUE self, VALUE plaintext)
 
 
 /* Returns the digested text. */
-static string digest_digest(VALUE self, bool hex)
+static VALUE digest_digest(VALUE self, RubyEncodingEnum encoding)
 {
   JHash *hash = NULL;
   Data_Get_Struct(self, JHash, hash);
-  return hash->getHashtext(hex);
+  return encodeRubyString(hash->getHashtext(false), encoding);
 }
 
 /**
@@ -372,8 +364,7 @@ static string digest_digest(VALUE self, bool hex)
  */
 VALUE rb_digest_digest(VALUE self)
 {
-  string retval = digest_digest(self, false);
-  return rb_tainted_str_new(retval.data(), retval.length());
+  return digest_digest(self, BINARY_ENCODING);
 }
 
 /**
@@ -384,17 +375,38 @@ VALUE rb_digest_digest(VALUE self)
  */
 VALUE rb_digest_digest_hex(VALUE self)
 {
-  string retval = digest_digest(self, true);
-  return rb_tainted_str_new(retval.data(), retval.length());
+  return digest_digest(self, HEX_ENCODING);
+}
+
+/**
+ * call-seq:
+ *     digest_b64 => String
+ *
+ * Returns the digested text in Base64.
+ */
+VALUE rb_digest_digest_b64(VALUE self)
+{
+  return digest_digest(self, BASE64_ENCODING);
+}
+
+/**
+ * call-seq:
+ *     digest_b64url => String
+ *
+ * Returns the digested text in URL-safe Base64.
+ */
+VALUE rb_digest_digest_b64url(VALUE self)
+{
+  return digest_digest(self, BASE64URL_ENCODING);
 }
 
 
 /* Gets the plaintext from a hash. */
-static string digest_plaintext(VALUE self, bool hex)
+static VALUE digest_plaintext(VALUE self, RubyEncodingEnum encoding)
 {
   JHash *hash = NULL;
   Data_Get_Struct(self, JHash, hash);
-  return hash->getPlaintext(hex);;
+  return encodeRubyString(hash->getPlaintext(false), encoding);
 }
 
 /**
@@ -405,8 +417,7 @@ static string digest_plaintext(VALUE self, bool hex)
  */
 VALUE rb_digest_plaintext(VALUE self)
 {
-  string retval = digest_plaintext(self, false);
-  return rb_tainted_str_new(retval.data(), retval.length());
+  return digest_plaintext(self, BINARY_ENCODING);
 }
 
 /**
@@ -417,19 +428,38 @@ VALUE rb_digest_plaintext(VALUE self)
  */
 VALUE rb_digest_plaintext_hex(VALUE self)
 {
-  string retval = digest_plaintext(self, true);
-  return rb_tainted_str_new(retval.data(), retval.length());
+  return digest_plaintext(self, HEX_ENCODING);
+}
+
+/**
+ * call-seq:
+ *     plaintext_b64 => String
+ *
+ * Returns the plaintext used to generate the digest in Base64.
+ */
+VALUE rb_digest_plaintext_b64(VALUE self)
+{
+  return digest_plaintext(self, BASE64_ENCODING);
+}
+
+/**
+ * call-seq:
+ *     plaintext_b64url => String
+ *
+ * Returns the plaintext used to generate the digest in URL-safe Base64.
+ */
+VALUE rb_digest_plaintext_b64url(VALUE self)
+{
+  return digest_plaintext(self, BASE64URL_ENCODING);
 }
 
 
 /* Sets the plaintext on a digest. */
-static string digest_plaintext_eq(VALUE self, VALUE plaintext, bool hex)
+static void digest_plaintext_eq(VALUE self, VALUE plaintext, RubyEncodingEnum encoding)
 {
   JHash *hash = NULL;
-  Check_Type(plaintext, T_STRING);
   Data_Get_Struct(self, JHash, hash);
-  hash->setPlaintext(string(StringValuePtr(plaintext), RSTRING_LEN(plaintext)), hex);
-  return hash->getPlaintext(hex);
+  hash->setPlaintext(decodeRubyString(plaintext, encoding), false);
 }
 
 /**
@@ -440,7 +470,7 @@ static string digest_plaintext_eq(VALUE self, VALUE plaintext, bool hex)
  */
 VALUE rb_digest_plaintext_eq(VALUE self, VALUE plaintext)
 {
-  digest_plaintext_eq(self, plaintext, false);
+  digest_plaintext_eq(self, plaintext, BINARY_ENCODING);
   return plaintext;
 }
 
@@ -452,18 +482,42 @@ VALUE rb_digest_plaintext_eq(VALUE self, VALUE plaintext)
  */
 VALUE rb_digest_plaintext_hex_eq(VALUE self, VALUE plaintext)
 {
-  digest_plaintext_eq(self, plaintext, true);
+  digest_plaintext_eq(self, plaintext, HEX_ENCODING);
+  return plaintext;
+}
+
+/**
+ * call-seq:
+ *    plaintext_b64=(plaintext)
+ *
+ * Sets the plaintext on a Digest in Base64.
+ */
+VALUE rb_digest_plaintext_b64_eq(VALUE self, VALUE plaintext)
+{
+  digest_plaintext_eq(self, plaintext, BASE64_ENCODING);
+  return plaintext;
+}
+
+/**
+ * call-seq:
+ *    plaintext_b64url=(plaintext)
+ *
+ * Sets the plaintext on a Digest in URL-safe Base64.
+ */
+VALUE rb_digest_plaintext_b64url_eq(VALUE self, VALUE plaintext)
+{
+  digest_plaintext_eq(self, plaintext, BASE64URL_ENCODING);
   return plaintext;
 }
 
 
 /* Calculates the digest. */
-static string digest_calculate(VALUE self, bool hex)
+static VALUE digest_calculate(VALUE self, RubyEncodingEnum encoding)
 {
   JHash *hash = NULL;
   Data_Get_Struct(self, JHash, hash);
   hash->hash();
-  return hash->getHashtext(hex);
+  return encodeRubyString(hash->getHashtext(false), encoding);
 }
 
 /**
@@ -474,8 +528,7 @@ static string digest_calculate(VALUE self, bool hex)
  */
 VALUE rb_digest_calculate(VALUE self)
 {
-  string retval = digest_calculate(self, false);
-  return rb_tainted_str_new(retval.data(), retval.length());
+  return digest_calculate(self, BINARY_ENCODING);
 }
 
 /**
@@ -486,19 +539,38 @@ VALUE rb_digest_calculate(VALUE self)
  */
 VALUE rb_digest_calculate_hex(VALUE self)
 {
-  string retval = digest_calculate(self, true);
-  return rb_tainted_str_new(retval.data(), retval.length());
+  return digest_calculate(self, HEX_ENCODING);
+}
+
+/**
+ * call-seq:
+ *     calculate_b64 => String
+ *
+ * Calculates the digest and returns the result in Base64.
+ */
+VALUE rb_digest_calculate_b64(VALUE self)
+{
+  return digest_calculate(self, BASE64_ENCODING);
+}
+
+/**
+ * call-seq:
+ *     calculate_b64url => String
+ *
+ * Calculates the digest and returns the result in URL-safe Base64.
+ */
+VALUE rb_digest_calculate_b64url(VALUE self)
+{
+  return digest_calculate(self, BASE64URL_ENCODING);
 }
 
 
 /* Sets the hashtext on a digest. */
-static string digest_digest_eq(VALUE self, VALUE digest, bool hex)
+static void digest_digest_eq(VALUE self, VALUE digest, RubyEncodingEnum encoding)
 {
   JHash *hash = NULL;
-  Check_Type(digest, T_STRING);
   Data_Get_Struct(self, JHash, hash);
-  hash->setHashtext(string(StringValuePtr(digest), RSTRING_LEN(digest)), hex);
-  return hash->getHashtext(hex);
+  hash->setHashtext(decodeRubyString(digest, encoding), false);
 }
 
 /**
@@ -509,7 +581,7 @@ static string digest_digest_eq(VALUE self, VALUE digest, bool hex)
  */
 VALUE rb_digest_digest_eq(VALUE self, VALUE digest)
 {
-  digest_digest_eq(self, digest, false);
+  digest_digest_eq(self, digest, BINARY_ENCODING);
   return digest;
 }
 
@@ -521,7 +593,31 @@ VALUE rb_digest_digest_eq(VALUE self, VALUE digest)
  */
 VALUE rb_digest_digest_hex_eq(VALUE self, VALUE digest)
 {
-  digest_digest_eq(self, digest, true);
+  digest_digest_eq(self, digest, HEX_ENCODING);
+  return digest;
+}
+
+/**
+ * call-seq:
+ *     digest_b64=(b64)
+ *
+ * Sets the digest text on a Digest in Base64.
+ */
+VALUE rb_digest_digest_b64_eq(VALUE self, VALUE digest)
+{
+  digest_digest_eq(self, digest, BASE64_ENCODING);
+  return digest;
+}
+
+/**
+ * call-seq:
+ *     digest_b64url=(b64url)
+ *
+ * Sets the digest text on a Digest in URL-safe Base64.
+ */
+VALUE rb_digest_digest_b64url_eq(VALUE self, VALUE digest)
+{
+  digest_digest_eq(self, digest, BASE64URL_ENCODING);
   return digest;
 }
 
@@ -577,7 +673,7 @@ VALUE rb_digest_equals(VALUE self, VALUE compare)
 
 
 /* Singleton method for digesting good stuff. */
-static string module_digest(int argc, VALUE *argv, VALUE self, bool hex)
+static VALUE module_digest(int argc, VALUE *argv, VALUE self, RubyEncodingEnum encoding)
 {
   JHash* hash = NULL;
   VALUE algorithm, plaintext, key;
@@ -603,10 +699,10 @@ static string module_digest(int argc, VALUE *argv, VALUE self, bool hex)
       ((JHMAC*) hash)->setKey(string(StringValuePtr(key), RSTRING_LEN(key)));
     }
     hash->hash();
-    retval = hash->getHashtext(hex);
+    retval = hash->getHashtext(false);
 
     delete hash;
-    return retval;
+    return encodeRubyString(retval, encoding);
   }
   catch (Exception& e) {
     if (hash != NULL) {
@@ -624,8 +720,7 @@ static string module_digest(int argc, VALUE *argv, VALUE self, bool hex)
  */
 VALUE rb_module_digest(int argc, VALUE *argv, VALUE self)
 {
-  string retval = module_digest(argc, argv, self, false);
-  return rb_tainted_str_new(retval.data(), retval.length());
+  return module_digest(argc, argv, self, BINARY_ENCODING);
 }
 
 /**
@@ -636,8 +731,29 @@ VALUE rb_module_digest(int argc, VALUE *argv, VALUE self)
  */
 VALUE rb_module_digest_hex(int argc, VALUE *argv, VALUE self)
 {
-  string retval = module_digest(argc, argv, self, true);
-  return rb_tainted_str_new(retval.data(), retval.length());
+  return module_digest(argc, argv, self, HEX_ENCODING);
+}
+
+/**
+ * call-seq:
+ *    digest_b64(algorithm, plaintext) => String
+ *
+ * Digest the plaintext and returns the result in Base64.
+ */
+VALUE rb_module_digest_b64(int argc, VALUE *argv, VALUE self)
+{
+  return module_digest(argc, argv, self, BASE64_ENCODING);
+}
+
+/**
+ * call-seq:
+ *    digest_b64url(algorithm, plaintext) => String
+ *
+ * Digest the plaintext and returns the result in URL-safe Base64.
+ */
+VALUE rb_module_digest_b64url(int argc, VALUE *argv, VALUE self)
+{
+  return module_digest(argc, argv, self, BASE64URL_ENCODING);
 }
 
 
@@ -645,13 +761,14 @@ VALUE rb_module_digest_hex(int argc, VALUE *argv, VALUE self)
 static string module_digest_io(int argc, VALUE *argv, VALUE self, bool hex)
 {
   JHash* hash = NULL;
-  VALUE algorithm, io;
+  VALUE algorithm, io, options;
 
-  rb_scan_args(argc, argv, "2", &algorithm, &io);
+  rb_scan_args(argc, argv, "21", &algorithm, &io, &options);
+  RubyIOOptions io_options = getRubyIOOptions(options);
   try {
     string retval;
     hash = digest_factory(algorithm);
-    retval = hash->hashRubyIO(&io, hex);
+    retval = hash->hashRubyIO(&io, hex, io_options);
 
     delete hash;
     return retval;
@@ -666,12 +783,20 @@ static string module_digest_io(int argc, VALUE *argv, VALUE self, bool hex)
 
 /**
  * call-seq:
- *    digest_io(io) => String
+ *    digest_io(algorithm, io) => String
+ *    digest_io(algorithm, io, options) => String
  *
  * Digests a Ruby IO object and spits out the result in binary. You can use
  * any sort of Ruby object as long as it implements <tt>eof?</tt>,
  * <tt>read</tt>, <tt>write</tt> and <tt>flush</tt>.
  *
+ * Available options:
+ *
+ * * <tt>:buffer_size</tt> - the size in bytes of the chunks read from io.
+ *   The default is 64 KB.
+ * * <tt>:pipeline</tt> - when true, the hashing is done on a native thread
+ *   without the GVL while the next chunks are being read.
+ *
  * Example:
  *
  *  cipher.digest_io(File.open("http://example.com/"))
@@ -684,12 +809,20 @@ VALUE rb_module_digest_io(int argc, VALUE *argv, VALUE self)
 
 /**
  * call-seq:
- *    digest_io_hex(io) => String
+ *    digest_io_hex(algorithm, io) => String
+ *    digest_io_hex(algorithm, io, options) => String
  *
  * Digests a Ruby IO object and spits out the result in hex. You can use
  * any sort of Ruby object as long as it implements <tt>eof?</tt>,
  * <tt>read</tt>, <tt>write</tt> and <tt>flush</tt>.
  *
+ * Available options:
+ *
+ * * <tt>:buffer_size</tt> - the size in bytes of the chunks read from io.
+ *   The default is 64 KB.
+ * * <tt>:pipeline</tt> - when true, the hashing is done on a native thread
+ *   without the GVL while the next chunks are being read.
+ *
  * Example:
  *
  *  cipher.digest_io_hex(File.open("http://example.com/"))
@@ -701,6 +834,84 @@ VALUE rb_module_digest_io_hex(int argc, VALUE *argv, VALUE self)
 }
 
 
+/* Adds a digest to tee for each of the algorithms. The algorithms are
+ * checked before anything is created so a bad one raises cleanly. May throw
+ * a JException if an algorithm is unknown, is an HMAC or isn't available. */
+void addRubyDigests(JDigestTee& tee, VALUE algorithms)
+{
+  long i;
+
+  for (i = 0; i < RARRAY_LEN(algorithms); ++i) {
+    Check_Type(rb_ary_entry(algorithms, i), T_SYMBOL);
+    if (!digest_is_non_hmac(digest_sym_to_const(rb_ary_entry(algorithms, i)))) {
+      throw JException("invalid digest algorithm");
+    }
+  }
+  for (i = 0; i < RARRAY_LEN(algorithms); ++i) {
+    tee.Add(digest_factory(rb_ary_entry(algorithms, i)));
+  }
+}
+
+/* Collects the digests from tee into a Hash keyed by algorithm. */
+VALUE getRubyDigests(const JDigestTee& tee, VALUE algorithms)
+{
+  VALUE retval = rb_hash_new();
+
+  for (size_t i = 0; i < tee.GetCount(); ++i) {
+    const string& digest = tee.GetDigest(i);
+    rb_hash_aset(retval, rb_ary_entry(algorithms, i), rb_tainted_str_new(digest.data(), digest.length()));
+  }
+  return retval;
+}
+
+/**
+ * call-seq:
+ *    copy_stream(in, out) => Hash
+ *    copy_stream(in, out, options) => Hash
+ *
+ * Copies a Ruby IO object into another one, optionally digesting the data
+ * on the way through. You can use any sort of Ruby object as long as it
+ * implements <tt>eof?</tt>, <tt>read</tt>, <tt>write</tt> and
+ * <tt>flush</tt>.
+ *
+ * Returns a Hash of algorithm => binary digest. Available options:
+ *
+ * * <tt>:digests</tt> - an Array of the digest algorithms to compute.
+ * * <tt>:buffer_size</tt> - the size in bytes of the chunks read from in
+ *   and written to out. The default is 64 KB.
+ * * <tt>:pipeline</tt> - when true, the digests are computed on a native
+ *   thread without the GVL while in is read and out is written.
+ *
+ * Example:
+ *
+ *  digests = CryptoPP.copy_stream(upload, File.open('test.out', 'w'), :digests => [ :sha256, :md5 ])
+ *  digests[:md5].unpack('H*').first
+ */
+VALUE rb_module_copy_stream(int argc, VALUE *argv, VALUE self)
+{
+  VALUE in, out, options, algorithms = Qnil;
+
+  rb_scan_args(argc, argv, "21", &in, &out, &options);
+  RubyIOOptions io_options = getRubyIOOptions(options);
+  if (!NIL_P(options)) {
+    algorithms = rb_hash_aref(options, ID2SYM(rb_intern("digests")));
+  }
+  algorithms = rb_Array(algorithms);
+
+  try {
+    JDigestTee digests;
+    addRubyDigests(digests, algorithms);
+
+    RubyIOPipeline pipeline(&in, &out, io_options);
+    pipeline.Run(digests.Tee(pipeline.CreateSink()));
+    return getRubyDigests(digests, algorithms);
+  }
+  catch (Exception& e) {
+    rb_raise(rb_eCryptoPP_Error, "%s", e.GetWhat().c_str());
+  }
+}
+
+
 /**
  * call-seq:
  *     digest_enabled? => Boolean
@@ -790,12 +1001,16 @@ VALUE rb_digest_validate(VALUE self)
 
 
 /* Instance version of <tt>CryptoPP#digest_io</tt>. */
-static string digest_digest_io(VALUE self, VALUE io, bool hex)
+static string digest_digest_io(int argc, VALUE *argv, VALUE self, bool hex)
 {
+  VALUE io, options;
+
+  rb_scan_args(argc, argv, "11", &io, &options);
+  RubyIOOptions io_options = getRubyIOOptions(options);
   try {
     JHash *hash;
     Data_Get_Struct(self, JHash, hash);
-    return hash->hashRubyIO(&io, hex);
+    return hash->hashRubyIO(&io, hex, io_options);
   }
   catch (Exception& e) {
     rb_raise(rb_eCryptoPP_Error, "%s", e.GetWhat().c_str());
@@ -805,24 +1020,26 @@ static string digest_digest_io(VALUE self, VALUE io, bool hex)
 /**
  * call-seq:
  *     digest_io(in) => String
+ *     digest_io(in, options) => String
  *
  * Instance version of <tt>CryptoPP#digest_io</tt>.
  */
-VALUE rb_digest_digest_io(VALUE self, VALUE io)
+VALUE rb_digest_digest_io(int argc, VALUE *argv, VALUE self)
 {
-  string retval = digest_digest_io(self, io, false);
+  string retval = digest_digest_io(argc, argv, self, false);
   return rb_tainted_str_new(retval.data(), retval.length());
 }
 
 /**
  * call-seq:
  *     digest_io_hex(in) => String
+ *     digest_io_hex(in, options) => String
  *
  * Instance version of <tt>CryptoPP#digest_io_hex</tt>.
  */
-VALUE rb_digest_digest_io_hex(VALUE self, VALUE io)
+VALUE rb_digest_digest_io_hex(int argc, VALUE *argv, VALUE self)
 {
-  string retval = digest_digest_io(self, io, true);
+  string retval = digest_digest_io(argc, argv, self, true);
   return rb_tainted_str_new(retval.data(), retval.length());
 }
 
@@ -856,16 +1073,10 @@ static void digest_hmac_options(VALUE self, VALUE options)
   digest_options(self, options);
 
   {
-    VALUE key = rb_hash_aref(options, ID2SYM(rb_intern("key")));
-    VALUE key_hex = rb_hash_aref(options, ID2SYM(rb_intern("key_hex")));
-    if (!NIL_P(key) && !NIL_P(key_hex)) {
-      rb_raise(rb_eCryptoPP_Error, "can't set both key and key_hex in options");
-    }
-    else if (!NIL_P(key)) {
-      digest_hmac_key_eq(self, key, false);
-    }
-    else if (!NIL_P(key_hex)) {
-      digest_hmac_key_eq(self, key_hex, true);
+    RubyEncodingEnum encoding;
+    VALUE key = getEncodedRubyOption(options, "key", &encoding);
+    if (!NIL_P(key)) {
+      digest_hmac_key_eq(self, key, encoding);
     }
   }
 
@@ -912,10 +1123,10 @@ VALUE rb_module_hmac_factory(int argc, VALUE *argv, VALUE self)
       }
       if (argc >= 2) {
         if (TYPE(argv[1]) == T_STRING) {
-          digest_plaintext_eq(retval, argv[1], false);
+          digest_plaintext_eq(retval, argv[1], BINARY_ENCODING);
           if (argc == 3) {
             Check_Type(argv[2], T_STRING);
-            digest_hmac_key_eq(retval, argv[2], false);
+            digest_hmac_key_eq(retval, argv[2], BINARY_ENCODING);
           }
           hash->hash();
         }
@@ -952,10 +1163,10 @@ VALUE rb_digest_hmac_ ## r ##_new(int argc, VALUE *argv, VALUE self) \
     } \
     if (argc >= 1) { \
       if (TYPE(argv[0]) == T_STRING) { \
-        digest_plaintext_eq(retval, argv[0], false); \
+        digest_plaintext_eq(retval, argv[0], BINARY_ENCODING); \
         if (argc == 2) { \
           Check_Type(argv[1], T_STRING); \
-          digest_hmac_key_eq(retval, argv[1], false); \
+          digest_hmac_key_eq(retval, argv[1], BINARY_ENCODING); \
         } \
         hash->hash(); \
       } \
@@ -974,13 +1185,11 @@ VALUE rb_digest_hmac_ ## r ##_new(int argc, VALUE *argv, VALUE self) \
 
 /* Set the key. The true length of the key might not be what you expect,
  * as different algorithms behave differently */
-static string digest_hmac_key_eq(VALUE self, VALUE key, bool hex)
+static void digest_hmac_key_eq(VALUE self, VALUE key, RubyEncodingEnum encoding)
 {
   JHash *hash = NULL;
-  Check_Type(key, T_STRING);
   Data_Get_Struct(self, JHash, hash);
-  ((JHMAC*) hash)->setKey(string(StringValuePtr(key), RSTRING_LEN(key)), hex);
-  return ((JHMAC*) hash)->getKey(hex);
+  ((JHMAC*) hash)->setKey(decodeRubyString(key, encoding), false);
 }
 
 /**
@@ -991,7 +1200,7 @@ static string digest_hmac_key_eq(VALUE self, VALUE key, bool hex)
  */
 VALUE rb_digest_hmac_key_eq(VALUE self, VALUE key)
 {
-  digest_hmac_key_eq(self, key, false);
+  digest_hmac_key_eq(self, key, BINARY_ENCODING);
   return key;
 }
 
@@ -1003,17 +1212,41 @@ VALUE rb_digest_hmac_key_eq(VALUE self, VALUE key)
  */
 VALUE rb_digest_hmac_key_hex_eq(VALUE self, VALUE key)
 {
-  digest_hmac_key_eq(self, key, true);
+  digest_hmac_key_eq(self, key, HEX_ENCODING);
+  return key;
+}
+
+/**
+ * call-seq:
+ *     key_b64=(key)
+ *
+ * Sets the key on a HMAC in Base64.
+ */
+VALUE rb_digest_hmac_key_b64_eq(VALUE self, VALUE key)
+{
+  digest_hmac_key_eq(self, key, BASE64_ENCODING);
+  return key;
+}
+
+/**
+ * call-seq:
+ *     key_b64url=(key)
+ *
+ * Sets the key on a HMAC in URL-safe Base64.
+ */
+VALUE rb_digest_hmac_key_b64url_eq(VALUE self, VALUE key)
+{
+  digest_hmac_key_eq(self, key, BASE64URL_ENCODING);
   return key;
 }
 
 
 /* Get the key. */
-static string digest_hmac_key(VALUE self, bool hex)
+static VALUE digest_hmac_key(VALUE self, RubyEncodingEnum encoding)
 {
   JHash *hash = NULL;
   Data_Get_Struct(self, JHash, hash);
-  return ((JHMAC*) hash)->getKey(hex);
+  return encodeRubyString(((JHMAC*) hash)->getKey(false), encoding);
 }
 
 /**
@@ -1024,8 +1257,7 @@ static string digest_hmac_key(VALUE self, bool hex)
  */
 VALUE rb_digest_hmac_key(VALUE self)
 {
-  string retval = digest_hmac_key(self, false);
-  return rb_tainted_str_new(retval.data(), retval.length());
+  return digest_hmac_key(self, BINARY_ENCODING);
 }
 
 /**
@@ -1036,8 +1268,29 @@ VALUE rb_digest_hmac_key(VALUE self)
  */
 VALUE rb_digest_hmac_key_hex(VALUE self)
 {
-  string retval = digest_hmac_key(self, false);
-  return rb_tainted_str_new(retval.data(), retval.length());
+  return digest_hmac_key(self, HEX_ENCODING);
+}
+
+/**
+ * call-seq:
+ *     key_b64 => String
+ *
+ * Returns the key from the HMAC in Base64.
+ */
+VALUE rb_digest_hmac_key_b64(VALUE self)
+{
+  return digest_hmac_key(self, BASE64_ENCODING);
+}
+
+/**
+ * call-seq:
+ *     key_b64url => String
+ *
+ * Returns the key from the HMAC in URL-safe Base64.
+ */
+VALUE rb_digest_hmac_key_b64url(VALUE self)
+{
+  return digest_hmac_key(self, BASE64URL_ENCODING);
 }
 
 
@@ -1083,7 +1336,7 @@ VALUE rb_digest_hmac_key_length(VALUE self)
 
 
 /* Digest the plaintext. */
-static string module_hmac_digest(int argc, VALUE *argv, VALUE self, bool hex)
+static VALUE module_hmac_digest(int argc, VALUE *argv, VALUE self, RubyEncodingEnum encoding)
 {
   JHash *hash;
   VALUE algorithm, plaintext, key;
@@ -1099,10 +1352,10 @@ static string module_hmac_digest(int argc, VALUE *argv, VALUE self, bool hex)
       ((JHMAC*) hash)->setKey(string(StringValuePtr(key), RSTRING_LEN(key)));
     }
     hash->hash();
-    retval = hash->getHashtext(hex);
+    retval = hash->getHashtext(false);
 
     delete hash;
-    return retval;
+    return encodeRubyString(retval, encoding);
   }
 }
 
@@ -1116,8 +1369,7 @@ static string module_hmac_digest(int argc, VALUE *argv, VALUE self, bool hex)
  */
 VALUE rb_module_hmac_digest(int argc, VALUE *argv, VALUE self)
 {
-  string retval = module_hmac_digest(argc, argv, self, false);
-  return rb_tainted_str_new(retval.data(), retval.length());
+  return module_hmac_digest(argc, argv, self, BINARY_ENCODING);
 }
 
 /**
@@ -1130,10 +1382,351 @@ VALUE rb_module_hmac_digest(int argc, VALUE *argv, VALUE self)
  */
 VALUE rb_module_hmac_digest_hex(int argc, VALUE *argv, VALUE self)
 {
-  string retval = module_hmac_digest(argc, argv, self, true);
-  return rb_tainted_str_new(retval.data(), retval.length());
+  return module_hmac_digest(argc, argv, self, HEX_ENCODING);
+}
+
+/**
+ * call-seq:
+ *    digest_b64(algorithm, plaintext) => String
+ *    digest_b64(algorithm, plaintext, key) => String
+ *
+ * Singleton method for digesting with a HMAC. The plaintext and key values
+ * are in binary and the return value is in Base64.
+ */
+VALUE rb_module_hmac_digest_b64(int argc, VALUE *argv, VALUE self)
+{
+  return module_hmac_digest(argc, argv, self, BASE64_ENCODING);
 }
 
+/**
+ * call-seq:
+ *    digest_b64url(algorithm, plaintext) => String
+ *    digest_b64url(algorithm, plaintext, key) => String
+ *
+ * Singleton method for digesting with a HMAC. The plaintext and key values
+ * are in binary and the return value is in URL-safe Base64.
+ */
+VALUE rb_module_hmac_digest_b64url(int argc, VALUE *argv, VALUE self)
+{
+  return module_hmac_digest(argc, argv, self, BASE64URL_ENCODING);
+}
+
+
+/* Creates an HMAC keyed once with key for use across a batch of messages.
+ * The HMAC is wrapped in a Ruby object so that it gets cleaned up by the GC
+ * if we raise part way through the batch. */
+static VALUE module_hmac_keyed_factory(VALUE algorithm, VALUE key)
+{
+  JHash* hash = NULL;
+  VALUE retval;
+
+  if (!digest_is_hmac(digest_sym_to_const(algorithm))) {
+    rb_raise(rb_eCryptoPP_Error, "invalid HMAC algorithm");
+  }
+  Check_Type(key, T_STRING);
+
+  try {
+    hash = digest_factory(algorithm);
+    retval = wrap_digest_in_ruby(hash);
+  }
+  catch (Exception& e) {
+    if (hash != NULL) {
+      delete hash;
+    }
+    rb_raise(rb_eCryptoPP_Error, "%s", e.GetWhat().c_str());
+  }
+  digest_hmac_key_eq(retval, key, BINARY_ENCODING);
+  return retval;
+}
+
+/**
+ * call-seq:
+ *    hmac_many(algorithm, key, messages) => Array
+ *
+ * Computes the HMAC of each String in messages under the same key and
+ * returns an Array of the binary MACs in the same order. The key is only
+ * set up once for the whole batch, so this is considerably faster than
+ * calling digest_hmac for every message.
+ */
+VALUE rb_module_hmac_many(VALUE self, VALUE algorithm, VALUE key, VALUE messages)
+{
+  JHash *hash = NULL;
+  VALUE hmac, retval;
+  long i, len;
+
+  Check_Type(messages, T_ARRAY);
+  len = RARRAY_LEN(messages);
+  for (i = 0; i < len; ++i) {
+    Check_Type(RARRAY_PTR(messages)[i], T_STRING);
+  }
+
+  hmac = module_hmac_keyed_factory(algorithm, key);
+  Data_Get_Struct(hmac, JHash, hash);
+
+  retval = rb_ary_new2(len);
+  for (i = 0; i < len; ++i) {
+    VALUE message = RARRAY_PTR(messages)[i];
+    VALUE mac = rb_str_new(NULL, hash->getDigestSize());
+
+    ((JHMAC*) hash)->hashMessage((const byte*) RSTRING_PTR(message), RSTRING_LEN(message), (byte*) RSTRING_PTR(mac));
+    OBJ_TAINT(mac);
+    rb_ary_push(retval, mac);
+  }
+  return retval;
+}
+
+/**
+ * call-seq:
+ *    hmac_verify_many(algorithm, key, pairs) => Array
+ *
+ * Verifies a batch of [ message, mac ] pairs under the same key and returns
+ * an Array of true or false values in the same order. MACs are in binary
+ * and are compared in constant time.
+ */
+VALUE rb_module_hmac_verify_many(VALUE self, VALUE algorithm, VALUE key, VALUE pairs)
+{
+  JHash *hash = NULL;
+  VALUE hmac, retval;
+  long i, len;
+
+  Check_Type(pairs, T_ARRAY);
+  len = RARRAY_LEN(pairs);
+  for (i = 0; i < len; ++i) {
+    VALUE pair = RARRAY_PTR(pairs)[i];
+    Check_Type(pair, T_ARRAY);
+    if (RARRAY_LEN(pair) != 2) {
+      rb_raise(rb_eArgError, "expected [ message, mac ] pairs");
+    }
+    Check_Type(RARRAY_PTR(pair)[0], T_STRING);
+    Check_Type(RARRAY_PTR(pair)[1], T_STRING);
+  }
+
+  hmac = module_hmac_keyed_factory(algorithm, key);
+  Data_Get_Struct(hmac, JHash, hash);
+
+  retval = rb_ary_new2(len);
+  for (i = 0; i < len; ++i) {
+    VALUE message = RARRAY_PTR(RARRAY_PTR(pairs)[i])[0];
+    VALUE mac = RARRAY_PTR(RARRAY_PTR(pairs)[i])[1];
+
+    if (((JHMAC*) hash)->validateMessage(
+      (const byte*) RSTRING_PTR(message), RSTRING_LEN(message),
+      (const byte*) RSTRING_PTR(mac), RSTRING_LEN(mac)
+    )) {
+      rb_ary_push(retval, Qtrue);
+    }
+    else {
+      rb_ary_push(retval, Qfalse);
+    }
+  }
+  return retval;
+}
+
+/* Key derivation arguments, copied out of their Ruby objects so the
+ * derivation can run without the GVL. The secret and the derived key are
+ * kept in SecByteBlocks and wiped by kdf_wipe before we return or raise. */
+struct kdf_args
+{
+  enum { PBKDF2, HKDF } kdf;
+  JHMAC* hmac;
+  SecByteBlock secret;
+  string salt;
+  string info;
+  unsigned int iterations;
+  SecByteBlock derived;
+  string error;
+  volatile bool cancelled;
+  bool done;
+  VALUE retval;
+};
+
+/* The KDFs take either a hash like :sha256 or its HMAC like :sha256_hmac. */
+static VALUE kdf_hmac_sym(VALUE algorithm)
+{
+  Check_Type(algorithm, T_SYMBOL);
+  if (digest_is_hmac(digest_sym_to_const(algorithm))) {
+    return algorithm;
+  }
+  else {
+    string name = string(rb_id2name(SYM2ID(algorithm))) + "_hmac";
+    VALUE hmac = ID2SYM(rb_intern(name.c_str()));
+
+    if (!digest_is_hmac(digest_sym_to_const(hmac))) {
+      rb_raise(rb_eCryptoPP_Error, "invalid hash algorithm for key derivation");
+    }
+    return hmac;
+  }
+}
+
+static void* module_kdf_without_gvl(void* data)
+{
+  struct kdf_args* args = (struct kdf_args*) data;
+
+  args->done = true;
+  try {
+    if (args->kdf == kdf_args::PBKDF2) {
+      args->hmac->pbkdf2(args->secret, args->salt, args->iterations, args->derived, args->derived.size(), &args->cancelled);
+    }
+    else {
+      args->hmac->hkdf(args->secret, args->salt, args->info, args->derived, args->derived.size());
+    }
+  }
+  catch (Exception& e) {
+    args->error = e.GetWhat();
+  }
+  return NULL;
+}
+
+/* Called by Ruby to interrupt the derivation, e.g. on Ctrl-C, Thread#kill
+ * or Timeout. PBKDF2 checks the flag between iterations. */
+static void module_kdf_cancel(void* data)
+{
+  ((struct kdf_args*) data)->cancelled = true;
+}
+
+static VALUE module_kdf_check_ints(VALUE data)
+{
+  rb_thread_check_ints();
+  return Qnil;
+}
+
+/* Wipes and frees the secret and the derived key. Nothing is left for the
+ * SecByteBlocks' destructors to do, so it doesn't matter if a raise skips
+ * them. */
+static void kdf_wipe(struct kdf_args* args)
+{
+  args->secret.New(0);
+  args->derived.New(0);
+}
+
+/* Validates the algorithm and length, makes the String the key will be
+ * returned in and creates the HMAC, which is everything that can raise, so
+ * the secret can be copied in afterwards. */
+static void kdf_setup(struct kdf_args* args, VALUE algorithm, VALUE length)
+{
+  VALUE hmac = kdf_hmac_sym(algorithm);
+
+  if (NUM2LONG(length) <= 0) {
+    rb_raise(rb_eArgError, "length must be greater than 0");
+  }
+  unsigned int len = NUM2UINT(length);
+
+  args->retval = rb_str_new(NULL, len);
+  args->cancelled = false;
+
+  try {
+    args->hmac = (JHMAC*) digest_factory(hmac);
+  }
+  catch (Exception& e) {
+    rb_raise(rb_eCryptoPP_Error, "%s", e.GetWhat().c_str());
+  }
+  args->derived.New(len);
+}
+
+/* Runs the derivation with the GVL released and returns the derived key.
+ * The secret has to have been copied into args last thing before this, as
+ * nothing between here and kdf_wipe raises. */
+static VALUE module_kdf(struct kdf_args* args)
+{
+  VALUE retval = args->retval;
+
+  args->done = false;
+  while (!args->done) {
+#ifdef HAVE_RB_THREAD_CALL_WITHOUT_GVL2
+    callWithoutGVLInterruptibly(module_kdf_without_gvl, args, module_kdf_cancel, args);
+#else
+    callWithoutGVL(module_kdf_without_gvl, args, module_kdf_cancel, args);
+#endif
+
+    // rb_thread_call_without_gvl2 doesn't call us at all if an interrupt,
+    // even just the thread switch timer, is already pending. Deal with it
+    // and go again, wiping the secret first if it raises...
+    if (!args->done) {
+      int state = 0;
+
+      rb_protect(module_kdf_check_ints, Qnil, &state);
+      if (state != 0) {
+        delete args->hmac;
+        kdf_wipe(args);
+        rb_jump_tag(state);
+      }
+      args->cancelled = false;
+    }
+  }
+  delete args->hmac;
+
+  if (!args->cancelled && args->error.empty()) {
+    memcpy(RSTRING_PTR(retval), args->derived, args->derived.size());
+  }
+  kdf_wipe(args);
+
+  if (args->cancelled) {
+    // raises whatever interrupted us, or Interrupt if it's already been
+    // dealt with...
+    rb_thread_check_ints();
+    rb_raise(rb_eInterrupt, "key derivation cancelled");
+  }
+  else if (!args->error.empty()) {
+    rb_raise(rb_eCryptoPP_Error, "%s", args->error.c_str());
+  }
+
+  OBJ_TAINT(retval);
+  return retval;
+}
+
+/**
+ * call-seq:
+ *    pbkdf2(hash, password, salt, iterations, length) => String
+ *
+ * Derives length bytes from the password and salt using PBKDF2 with the
+ * HMAC of hash, which may be given as either :sha256 or :sha256_hmac.
+ * All of the values are in binary. The GVL is released while deriving, so
+ * other threads can carry on through a long run of iterations, and the
+ * derivation stops early if the thread is interrupted.
+ */
+VALUE rb_module_pbkdf2(VALUE self, VALUE algorithm, VALUE password, VALUE salt, VALUE iterations, VALUE length)
+{
+  struct kdf_args args;
+
+  Check_Type(password, T_STRING);
+  Check_Type(salt, T_STRING);
+  args.kdf = kdf_args::PBKDF2;
+  if (NUM2LONG(iterations) <= 0) {
+    rb_raise(rb_eArgError, "iterations must be greater than 0");
+  }
+  args.iterations = NUM2UINT(iterations);
+  kdf_setup(&args, algorithm, length);
+  args.salt = string(RSTRING_PTR(salt), RSTRING_LEN(salt));
+  args.secret.Assign((const byte*) RSTRING_PTR(password), RSTRING_LEN(password));
+
+  return module_kdf(&args);
+}
+
+/**
+ * call-seq:
+ *    hkdf(hash, ikm, salt, info, length) => String
+ *
+ * Derives length bytes from the input keying material using HKDF with the
+ * HMAC of hash, which may be given as either :sha256 or :sha256_hmac. An
+ * empty salt is treated as a string of zeroes as per RFC 5869. All of the
+ * values are in binary.
+ */
+VALUE rb_module_hkdf(VALUE self, VALUE algorithm, VALUE ikm, VALUE salt, VALUE info, VALUE length)
+{
+  struct kdf_args args;
+
+  Check_Type(ikm, T_STRING);
+  Check_Type(salt, T_STRING);
+  Check_Type(info, T_STRING);
+  args.kdf = kdf_args::HKDF;
+  args.iterations = 0;
+  kdf_setup(&args, algorithm, length);
+  args.salt = string(RSTRING_PTR(salt), RSTRING_LEN(salt));
+  args.info = string(RSTRING_PTR(info), RSTRING_LEN(info));
+  args.secret.Assign((const byte*) RSTRING_PTR(ikm), RSTRING_LEN(ikm));
+
+  return module_kdf(&args);
+}
 
 /**
  * call-seq:
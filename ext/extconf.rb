@@ -77,5 +77,88 @@ if have_blocksize
   $defs << "-DHAVE_CRYPTOPP_SHA3_BLOCKSIZE"
 end
 
+# Long running work like key derivation releases the GVL when we can.
+if have_header('ruby/thread.h')
+  have_func('rb_thread_call_without_gvl', 'ruby/thread.h')
+  have_func('rb_thread_call_without_gvl2', 'ruby/thread.h')
+end
+
+# The *_io methods wait through the fiber scheduler when there is one.
+if have_header('ruby/fiber/scheduler.h')
+  have_func('rb_fiber_scheduler_current', 'ruby/fiber/scheduler.h')
+  have_func('rb_io_wait', 'ruby/io.h')
+end
+
+# The pipelined *_io methods run the crypto on a native worker thread.
+have_header('pthread.h')
+
+# encrypt_file and decrypt_file work on memory-mapped files.
+have_header('sys/mman.h')
+
+# The key schedule cache measures its entries with malloc when it can.
+have_func('malloc_usable_size', 'malloc.h')
+
+# FileCrypter drives its reads and writes through io_uring when it can.
+if have_header('liburing.h') && have_library('uring', 'io_uring_queue_init', 'liburing.h')
+  $defs << "-DHAVE_LIBURING"
+end
+
+# The hex helpers pick SSSE3 or AVX2 kernels at runtime when the compiler
+# lets us build them without -m flags.
+have_x86_simd = try_link(<<SRC)
+#include <immintrin.h>
+
+__attribute__((target("avx2")))
+static void kernel(char* out) {
+  _mm256_storeu_si256((__m256i*) out, _mm256_set1_epi8('0'));
+}
+
+int main() {
+  char out[32];
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("ssse3")) {
+    kernel(out);
+  }
+  return 0;
+}
+SRC
+
+if have_x86_simd
+  $defs << "-DHAVE_X86_SIMD"
+end
+
+# The :rdrand and :rdseed RNGs use the CPU instructions when it has them.
+have_x86_rdrand = try_link(<<SRC)
+#include <cpuid.h>
+#include <immintrin.h>
+
+__attribute__((target("rdrnd")))
+static int rdrand(unsigned long long* value) {
+  return _rdrand64_step(value);
+}
+
+__attribute__((target("rdseed")))
+static int rdseed(unsigned long long* value) {
+  return _rdseed64_step(value);
+}
+
+int main() {
+  unsigned int eax, ebx, ecx, edx;
+  unsigned long long value;
+  if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_RDRND)) {
+    rdrand(&value);
+  }
+  __cpuid_count(7, 0, eax, ebx, ecx, edx);
+  if (ebx & bit_RDSEED) {
+    rdseed(&value);
+  }
+  return 0;
+}
+SRC
+
+if have_x86_rdrand
+  $defs << "-DHAVE_X86_RDRAND"
+end
+
 create_makefile('cryptopp')
 
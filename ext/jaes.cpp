@@ -9,14 +9,48 @@
 
 #if ENABLED_AES_CIPHER
 
+#include "jbitslicedaes.h"
+
+JAES::JAES()
+{
+  itsBackend = CRYPTOPP_AES_BACKEND;
+}
+
+enum AESBackendEnum JAES::getBackend() const
+{
+  return itsBackend;
+}
+
+void JAES::setBackend(const enum AESBackendEnum backend)
+{
+  itsBackend = backend;
+}
+
 BlockCipher* JAES::getEncryptionObject()
 {
+  if (itsBackend == BITSLICED_AES_BACKEND) {
+    return new BitslicedAESEncryption((byte*) itsKey.data(), itsKeylength);
+  }
   return new AESEncryption((byte*) itsKey.data(), itsKeylength);
 }
 
 BlockCipher* JAES::getDecryptionObject()
 {
+  if (itsBackend == BITSLICED_AES_BACKEND) {
+    return new BitslicedAESDecryption((byte*) itsKey.data(), itsKeylength);
+  }
   return new AESDecryption((byte*) itsKey.data(), itsKeylength);
 }
 
+unsigned int JAES::getKeyScheduleParameter() const
+{
+  return itsBackend;
+}
+
+// the fast paths are compiled against Crypto++'s AES...
+bool JAES::usesFastPath() const
+{
+  return itsBackend == CRYPTOPP_AES_BACKEND;
+}
+
 #endif
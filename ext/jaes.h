@@ -18,11 +18,27 @@
 
 #include "aes.h"
 
+// which implementation of AES does the work...
+enum AESBackendEnum {
+  CRYPTOPP_AES_BACKEND,
+  BITSLICED_AES_BACKEND
+};
+
 class JAES : public JCipher_Template<Rijndael_Info, AES_CIPHER>
 {
+  public:
+    JAES();
+
+    enum AESBackendEnum getBackend() const;
+    void setBackend(const enum AESBackendEnum backend);
+
   protected:
     BlockCipher* getEncryptionObject();
     BlockCipher* getDecryptionObject();
+    unsigned int getKeyScheduleParameter() const;
+    bool usesFastPath() const;
+
+    enum AESBackendEnum itsBackend;
 };
 
 typedef JAES JRijndael;
@@ -6,6 +6,11 @@
  */
 
 #include "jbase.h"
+#include "jhash.h"
+
+#include "zdeflate.h"
+#include "zinflate.h"
+#include "gzip.h"
 
 JBase::JBase()
 {
@@ -115,6 +120,18 @@ string JBase::getRNGName(const enum RNGEnum rng)
 
     case RAND_RNG:
       return "System rand() function";
+
+    case RDRAND_RNG:
+      if (hardwareRandomAvailable(rng)) {
+        return "CPU RDRAND instruction";
+      }
+      return "CPU RDRAND instruction (unsupported, using the default RNG)";
+
+    case RDSEED_RNG:
+      if (hardwareRandomAvailable(rng)) {
+        return "CPU RDSEED instruction";
+      }
+      return "CPU RDSEED instruction (unsupported, using the default RNG)";
   }
 
   return "Unknown";
@@ -139,7 +156,8 @@ enum RNGEnum JBase::setRNG(const enum RNGEnum rng)
   }
   #endif
 
-  if (rng == RAND_RNG) {
+  // these fall back to the default RNG when the CPU doesn't have them...
+  if (rng == RAND_RNG || rng == RDRAND_RNG || rng == RDSEED_RNG) {
     itsRNG = rng;
   }
 
@@ -170,3 +188,100 @@ void JBase::setRandIV(const unsigned int size)
 {
   itsIV = generateIV(size, itsRNG);
 }
+
+BufferedTransformation* compressor(CompressionEnum compression, BufferedTransformation* attachment)
+{
+  switch (compression) {
+    case DEFLATE_COMPRESSION:
+      return new Deflator(attachment);
+
+    case GZIP_COMPRESSION:
+      return new Gzip(attachment);
+
+    default:
+      return attachment;
+  }
+}
+
+BufferedTransformation* decompressor(CompressionEnum compression, BufferedTransformation* attachment)
+{
+  switch (compression) {
+    case DEFLATE_COMPRESSION:
+      return new Inflator(attachment);
+
+    case GZIP_COMPRESSION:
+      return new Gunzip(attachment);
+
+    default:
+      return attachment;
+  }
+}
+
+bool JBase::encrypt(CompressionEnum compression)
+{
+  JCipherFilter* filter = getEncryptionFilter();
+
+  if (filter == NULL) {
+    return false;
+  }
+
+  itsCiphertext.erase();
+  filter->Attach(new StringSink(itsCiphertext));
+  StringSource(itsPlaintext, true, compressor(compression, filter));
+
+  return true;
+}
+
+bool JBase::decrypt(CompressionEnum compression)
+{
+  JCipherFilter* filter = getDecryptionFilter();
+
+  if (filter == NULL) {
+    return false;
+  }
+
+  itsPlaintext.erase();
+  filter->Attach(decompressor(compression, new StringSink(itsPlaintext)));
+  StringSource(itsCiphertext, true, filter);
+
+  return true;
+}
+
+/* Puts the tee in front of attachment, if there is one. */
+static BufferedTransformation* tee(JDigestTee* digests, BufferedTransformation* attachment)
+{
+  if (digests == NULL) {
+    return attachment;
+  }
+  return digests->Tee(attachment);
+}
+
+bool JBase::encryptRubyIO(VALUE* in, VALUE* out, const RubyIOOptions& options, JDigestTee* inputDigests, JDigestTee* outputDigests, CompressionEnum compression)
+{
+  RubyIOPipeline pipeline(in, out, options);
+  JCipherFilter* filter = getEncryptionFilter();
+
+  if (filter == NULL) {
+    return false;
+  }
+
+  filter->Attach(tee(outputDigests, pipeline.CreateSink()));
+  pipeline.Run(tee(inputDigests, compressor(compression, filter)));
+
+  return true;
+}
+
+bool JBase::decryptRubyIO(VALUE* in, VALUE* out, const RubyIOOptions& options, JDigestTee* inputDigests, JDigestTee* outputDigests, CompressionEnum compression)
+{
+  RubyIOPipeline pipeline(in, out, options);
+  JCipherFilter* filter = getDecryptionFilter();
+
+  if (filter == NULL) {
+    return false;
+  }
+
+  filter->Attach(decompressor(compression, tee(outputDigests, pipeline.CreateSink())));
+  pipeline.Run(tee(inputDigests, filter));
+
+  return true;
+}
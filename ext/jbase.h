@@ -12,15 +12,52 @@
 
 #include "jhelpers.h"
 #include "jconstants.h"
-#include "jsink.h"
+#include "jpipeline.h"
 
 // Crypto++ headers...
 
 #include "hex.h"
 #include "files.h"
+#include "filters.h"
 
 using namespace CryptoPP;
 
+class JDigestTee;
+
+// Owns the objects a JCipherFilter is built on. It's a base class rather than
+// a member so that they're created before the StreamTransformationFilter and
+// destroyed after it...
+struct JCipherFilterObjects
+{
+  JCipherFilterObjects(StreamTransformation* cipher, BlockCipher* blockCipher) :
+    itsCipher(cipher), itsBlockCipher(blockCipher) {}
+
+  ~JCipherFilterObjects()
+  {
+    delete itsCipher;
+    delete itsBlockCipher;
+  }
+
+  StreamTransformation* itsCipher;
+  BlockCipher* itsBlockCipher;
+};
+
+/* A StreamTransformationFilter that owns its cipher, and for block ciphers
+ * the BlockCipher its mode object runs on, so it can be handed off to a
+ * Source or a pipeline and cleaned up along with it. */
+class JCipherFilter : private JCipherFilterObjects, public StreamTransformationFilter
+{
+  public:
+    JCipherFilter(StreamTransformation* cipher, BlockCipher* blockCipher, BufferedTransformation* attachment = NULL, BlockPaddingScheme padding = DEFAULT_PADDING) :
+      JCipherFilterObjects(cipher, blockCipher),
+      StreamTransformationFilter(*cipher, attachment, padding) {}
+};
+
+// Put a compressor, or the matching decompressor, in front of attachment if
+// compression is wanted. Otherwise attachment is returned as is.
+BufferedTransformation* compressor(CompressionEnum compression, BufferedTransformation* attachment);
+BufferedTransformation* decompressor(CompressionEnum compression, BufferedTransformation* attachment);
+
 class JBase
 {
   public:
@@ -55,11 +92,21 @@ class JBase
     virtual enum CipherEnum getCipherType() const = 0;
     virtual string getCipherName() const = 0;
 
-    virtual bool encrypt() = 0;
-    virtual bool decrypt() = 0;
-
-    virtual bool encryptRubyIO(VALUE* in, VALUE* out) = 0;
-    virtual bool decryptRubyIO(VALUE* in, VALUE* out) = 0;
+    // Filters that run the cipher with its current key, IV, mode and
+    // padding. They return NULL if the cipher can't be set up, e.g. for an
+    // unknown block mode. The caller owns the filter.
+    virtual JCipherFilter* getEncryptionFilter(BufferedTransformation* attachment = NULL) = 0;
+    virtual JCipherFilter* getDecryptionFilter(BufferedTransformation* attachment = NULL) = 0;
+
+    // The plaintext is compressed before it's encrypted, and decompressed
+    // after it's decrypted, when a compression is given.
+    bool encrypt(CompressionEnum compression = NO_COMPRESSION);
+    bool decrypt(CompressionEnum compression = NO_COMPRESSION);
+
+    // Pump in through the cipher into out. The optional tees digest the
+    // input and output on the way through.
+    bool encryptRubyIO(VALUE* in, VALUE* out, const RubyIOOptions& options = RubyIOOptions(), JDigestTee* inputDigests = NULL, JDigestTee* outputDigests = NULL, CompressionEnum compression = NO_COMPRESSION);
+    bool decryptRubyIO(VALUE* in, VALUE* out, const RubyIOOptions& options = RubyIOOptions(), JDigestTee* inputDigests = NULL, JDigestTee* outputDigests = NULL, CompressionEnum compression = NO_COMPRESSION);
 
   protected:
     string itsPlaintext;
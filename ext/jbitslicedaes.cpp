@@ -0,0 +1,572 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#include "jbitslicedaes.h"
+
+// Crypto++ headers...
+
+#include "misc.h"
+
+/* The state is eight 64-bit words, q[0] through q[7]. Word q[i] holds bit i
+ * of every byte of the four blocks, 64 bits to a word, so each byte
+ * position of each block has a bit lane in all eight words. ortho() moves
+ * between that and the plain layout, where q[i] and q[i + 4] hold block i
+ * as two interleaved halves. */
+
+static inline word32 loadWord(const byte* in)
+{
+  return (word32) in[0] | ((word32) in[1] << 8) | ((word32) in[2] << 16) | ((word32) in[3] << 24);
+}
+
+static inline void storeWord(byte* out, word32 x)
+{
+  out[0] = (byte) x;
+  out[1] = (byte) (x >> 8);
+  out[2] = (byte) (x >> 16);
+  out[3] = (byte) (x >> 24);
+}
+
+static inline word64 rotr32(word64 x)
+{
+  return (x << 32) | (x >> 32);
+}
+
+// Boyar and Peralta's S-box circuit, 113 gates
+static void sbox(word64* q)
+{
+  word64 x0, x1, x2, x3, x4, x5, x6, x7;
+  word64 y1, y2, y3, y4, y5, y6, y7, y8, y9;
+  word64 y10, y11, y12, y13, y14, y15, y16, y17, y18, y19;
+  word64 y20, y21;
+  word64 z0, z1, z2, z3, z4, z5, z6, z7, z8, z9;
+  word64 z10, z11, z12, z13, z14, z15, z16, z17;
+  word64 t0, t1, t2, t3, t4, t5, t6, t7, t8, t9;
+  word64 t10, t11, t12, t13, t14, t15, t16, t17, t18, t19;
+  word64 t20, t21, t22, t23, t24, t25, t26, t27, t28, t29;
+  word64 t30, t31, t32, t33, t34, t35, t36, t37, t38, t39;
+  word64 t40, t41, t42, t43, t44, t45, t46, t47, t48, t49;
+  word64 t50, t51, t52, t53, t54, t55, t56, t57, t58, t59;
+  word64 t60, t61, t62, t63, t64, t65, t66, t67;
+  word64 s0, s1, s2, s3, s4, s5, s6, s7;
+
+  x0 = q[7];
+  x1 = q[6];
+  x2 = q[5];
+  x3 = q[4];
+  x4 = q[3];
+  x5 = q[2];
+  x6 = q[1];
+  x7 = q[0];
+
+  // the top linear transformation...
+  y14 = x3 ^ x5;
+  y13 = x0 ^ x6;
+  y9 = x0 ^ x3;
+  y8 = x0 ^ x5;
+  t0 = x1 ^ x2;
+  y1 = t0 ^ x7;
+  y4 = y1 ^ x3;
+  y12 = y13 ^ y14;
+  y2 = y1 ^ x0;
+  y5 = y1 ^ x6;
+  y3 = y5 ^ y8;
+  t1 = x4 ^ y12;
+  y15 = t1 ^ x5;
+  y20 = t1 ^ x1;
+  y6 = y15 ^ x7;
+  y10 = y15 ^ t0;
+  y11 = y20 ^ y9;
+  y7 = x7 ^ y11;
+  y17 = y10 ^ y11;
+  y19 = y10 ^ y8;
+  y16 = t0 ^ y11;
+  y21 = y13 ^ y16;
+  y18 = x0 ^ y16;
+
+  // the inversion in GF(2^8)...
+  t2 = y12 & y15;
+  t3 = y3 & y6;
+  t4 = t3 ^ t2;
+  t5 = y4 & x7;
+  t6 = t5 ^ t2;
+  t7 = y13 & y16;
+  t8 = y5 & y1;
+  t9 = t8 ^ t7;
+  t10 = y2 & y7;
+  t11 = t10 ^ t7;
+  t12 = y9 & y11;
+  t13 = y14 & y17;
+  t14 = t13 ^ t12;
+  t15 = y8 & y10;
+  t16 = t15 ^ t12;
+  t17 = t4 ^ t14;
+  t18 = t6 ^ t16;
+  t19 = t9 ^ t14;
+  t20 = t11 ^ t16;
+  t21 = t17 ^ y20;
+  t22 = t18 ^ y19;
+  t23 = t19 ^ y21;
+  t24 = t20 ^ y18;
+
+  t25 = t21 ^ t22;
+  t26 = t21 & t23;
+  t27 = t24 ^ t26;
+  t28 = t25 & t27;
+  t29 = t28 ^ t22;
+  t30 = t23 ^ t24;
+  t31 = t22 ^ t26;
+  t32 = t31 & t30;
+  t33 = t32 ^ t24;
+  t34 = t23 ^ t33;
+  t35 = t27 ^ t33;
+  t36 = t24 & t35;
+  t37 = t36 ^ t34;
+  t38 = t27 ^ t36;
+  t39 = t29 & t38;
+  t40 = t25 ^ t39;
+
+  t41 = t40 ^ t37;
+  t42 = t29 ^ t33;
+  t43 = t29 ^ t40;
+  t44 = t33 ^ t37;
+  t45 = t42 ^ t41;
+  z0 = t44 & y15;
+  z1 = t37 & y6;
+  z2 = t33 & x7;
+  z3 = t43 & y16;
+  z4 = t40 & y1;
+  z5 = t29 & y7;
+  z6 = t42 & y11;
+  z7 = t45 & y17;
+  z8 = t41 & y10;
+  z9 = t44 & y12;
+  z10 = t37 & y3;
+  z11 = t33 & y4;
+  z12 = t43 & y13;
+  z13 = t40 & y5;
+  z14 = t29 & y2;
+  z15 = t42 & y9;
+  z16 = t45 & y14;
+  z17 = t41 & y8;
+
+  // and the bottom linear transformation, with the affine constant
+  // folded in
+  t46 = z15 ^ z16;
+  t47 = z10 ^ z11;
+  t48 = z5 ^ z13;
+  t49 = z9 ^ z10;
+  t50 = z2 ^ z12;
+  t51 = z2 ^ z5;
+  t52 = z7 ^ z8;
+  t53 = z0 ^ z3;
+  t54 = z6 ^ z7;
+  t55 = z16 ^ z17;
+  t56 = z12 ^ t48;
+  t57 = t50 ^ t53;
+  t58 = z4 ^ t46;
+  t59 = z3 ^ t54;
+  t60 = t46 ^ t57;
+  t61 = z14 ^ t57;
+  t62 = t52 ^ t58;
+  t63 = t49 ^ t58;
+  t64 = z4 ^ t59;
+  t65 = t61 ^ t62;
+  t66 = z1 ^ t63;
+  s0 = t59 ^ t63;
+  s6 = t56 ^ ~t62;
+  s7 = t48 ^ ~t60;
+  t67 = t64 ^ t65;
+  s3 = t53 ^ t66;
+  s4 = t51 ^ t66;
+  s5 = t47 ^ t65;
+  s1 = t64 ^ ~s3;
+  s2 = t55 ^ ~t67;
+
+  q[7] = s0;
+  q[6] = s1;
+  q[5] = s2;
+  q[4] = s3;
+  q[3] = s4;
+  q[2] = s5;
+  q[1] = s6;
+  q[0] = s7;
+}
+
+// the inverse of the S-box's affine transformation, constant included
+static inline void invAffine(word64* q)
+{
+  word64 q0 = ~q[0], q1 = ~q[1], q2 = q[2], q3 = q[3];
+  word64 q4 = q[4], q5 = ~q[5], q6 = ~q[6], q7 = q[7];
+
+  q[7] = q1 ^ q4 ^ q6;
+  q[6] = q0 ^ q3 ^ q5;
+  q[5] = q7 ^ q2 ^ q4;
+  q[4] = q6 ^ q1 ^ q3;
+  q[3] = q5 ^ q0 ^ q2;
+  q[2] = q4 ^ q7 ^ q1;
+  q[1] = q3 ^ q6 ^ q0;
+  q[0] = q2 ^ q5 ^ q7;
+}
+
+// The S-box is an inversion followed by an affine map A, so the inverse
+// S-box is A^-1 . S . A^-1, which reuses the forward circuit.
+static void invSbox(word64* q)
+{
+  invAffine(q);
+  sbox(q);
+  invAffine(q);
+}
+
+#define SWAPN(cl, ch, s, x, y) do { \
+    word64 a = (x), b = (y); \
+    (x) = (a & (word64) cl) | ((b & (word64) cl) << (s)); \
+    (y) = ((a & (word64) ch) >> (s)) | (b & (word64) ch); \
+  } while (0)
+
+#define SWAP2(x, y) SWAPN(W64LIT(0x5555555555555555), W64LIT(0xAAAAAAAAAAAAAAAA), 1, x, y)
+#define SWAP4(x, y) SWAPN(W64LIT(0x3333333333333333), W64LIT(0xCCCCCCCCCCCCCCCC), 2, x, y)
+#define SWAP8(x, y) SWAPN(W64LIT(0x0F0F0F0F0F0F0F0F), W64LIT(0xF0F0F0F0F0F0F0F0), 4, x, y)
+
+// Transposes between the plain and bitsliced layouts. It's its own inverse.
+static void ortho(word64* q)
+{
+  SWAP2(q[0], q[1]);
+  SWAP2(q[2], q[3]);
+  SWAP2(q[4], q[5]);
+  SWAP2(q[6], q[7]);
+
+  SWAP4(q[0], q[2]);
+  SWAP4(q[1], q[3]);
+  SWAP4(q[4], q[6]);
+  SWAP4(q[5], q[7]);
+
+  SWAP8(q[0], q[4]);
+  SWAP8(q[1], q[5]);
+  SWAP8(q[2], q[6]);
+  SWAP8(q[3], q[7]);
+}
+
+#undef SWAP8
+#undef SWAP4
+#undef SWAP2
+#undef SWAPN
+
+// spreads the four words of a block across two state words, 16 bits at a
+// time, so ortho() lines the bytes up by column
+static void interleaveIn(word64* q0, word64* q1, const word32* w)
+{
+  word64 x0 = w[0], x1 = w[1], x2 = w[2], x3 = w[3];
+
+  x0 |= (x0 << 16);
+  x1 |= (x1 << 16);
+  x2 |= (x2 << 16);
+  x3 |= (x3 << 16);
+  x0 &= W64LIT(0x0000FFFF0000FFFF);
+  x1 &= W64LIT(0x0000FFFF0000FFFF);
+  x2 &= W64LIT(0x0000FFFF0000FFFF);
+  x3 &= W64LIT(0x0000FFFF0000FFFF);
+  x0 |= (x0 << 8);
+  x1 |= (x1 << 8);
+  x2 |= (x2 << 8);
+  x3 |= (x3 << 8);
+  x0 &= W64LIT(0x00FF00FF00FF00FF);
+  x1 &= W64LIT(0x00FF00FF00FF00FF);
+  x2 &= W64LIT(0x00FF00FF00FF00FF);
+  x3 &= W64LIT(0x00FF00FF00FF00FF);
+  *q0 = x0 | (x2 << 8);
+  *q1 = x1 | (x3 << 8);
+}
+
+static void interleaveOut(word32* w, word64 q0, word64 q1)
+{
+  word64 x0 = q0 & W64LIT(0x00FF00FF00FF00FF);
+  word64 x1 = q1 & W64LIT(0x00FF00FF00FF00FF);
+  word64 x2 = (q0 >> 8) & W64LIT(0x00FF00FF00FF00FF);
+  word64 x3 = (q1 >> 8) & W64LIT(0x00FF00FF00FF00FF);
+
+  x0 |= (x0 >> 8);
+  x1 |= (x1 >> 8);
+  x2 |= (x2 >> 8);
+  x3 |= (x3 >> 8);
+  x0 &= W64LIT(0x0000FFFF0000FFFF);
+  x1 &= W64LIT(0x0000FFFF0000FFFF);
+  x2 &= W64LIT(0x0000FFFF0000FFFF);
+  x3 &= W64LIT(0x0000FFFF0000FFFF);
+  w[0] = (word32) x0 | (word32) (x0 >> 16);
+  w[1] = (word32) x1 | (word32) (x1 >> 16);
+  w[2] = (word32) x2 | (word32) (x2 >> 16);
+  w[3] = (word32) x3 | (word32) (x3 >> 16);
+}
+
+static inline void addRoundKey(word64* q, const word64* key)
+{
+  for (unsigned int i = 0; i < 8; ++i) {
+    q[i] ^= key[i];
+  }
+}
+
+static inline void shiftRows(word64* q)
+{
+  for (unsigned int i = 0; i < 8; ++i) {
+    word64 x = q[i];
+
+    q[i] = (x & W64LIT(0x000000000000FFFF))
+      | ((x & W64LIT(0x00000000FFF00000)) >> 4)
+      | ((x & W64LIT(0x00000000000F0000)) << 12)
+      | ((x & W64LIT(0x0000FF0000000000)) >> 8)
+      | ((x & W64LIT(0x000000FF00000000)) << 8)
+      | ((x & W64LIT(0xF000000000000000)) >> 12)
+      | ((x & W64LIT(0x0FFF000000000000)) << 4);
+  }
+}
+
+static inline void invShiftRows(word64* q)
+{
+  for (unsigned int i = 0; i < 8; ++i) {
+    word64 x = q[i];
+
+    q[i] = (x & W64LIT(0x000000000000FFFF))
+      | ((x & W64LIT(0x000000000FFF0000)) << 4)
+      | ((x & W64LIT(0x00000000F0000000)) >> 12)
+      | ((x & W64LIT(0x000000FF00000000)) << 8)
+      | ((x & W64LIT(0x0000FF0000000000)) >> 8)
+      | ((x & W64LIT(0x000F000000000000)) << 12)
+      | ((x & W64LIT(0xFFF0000000000000)) >> 4);
+  }
+}
+
+static inline void mixColumns(word64* q)
+{
+  word64 q0 = q[0], q1 = q[1], q2 = q[2], q3 = q[3];
+  word64 q4 = q[4], q5 = q[5], q6 = q[6], q7 = q[7];
+  word64 r0 = (q0 >> 16) | (q0 << 48);
+  word64 r1 = (q1 >> 16) | (q1 << 48);
+  word64 r2 = (q2 >> 16) | (q2 << 48);
+  word64 r3 = (q3 >> 16) | (q3 << 48);
+  word64 r4 = (q4 >> 16) | (q4 << 48);
+  word64 r5 = (q5 >> 16) | (q5 << 48);
+  word64 r6 = (q6 >> 16) | (q6 << 48);
+  word64 r7 = (q7 >> 16) | (q7 << 48);
+
+  q[0] = q7 ^ r7 ^ r0 ^ rotr32(q0 ^ r0);
+  q[1] = q0 ^ r0 ^ q7 ^ r7 ^ r1 ^ rotr32(q1 ^ r1);
+  q[2] = q1 ^ r1 ^ r2 ^ rotr32(q2 ^ r2);
+  q[3] = q2 ^ r2 ^ q7 ^ r7 ^ r3 ^ rotr32(q3 ^ r3);
+  q[4] = q3 ^ r3 ^ q7 ^ r7 ^ r4 ^ rotr32(q4 ^ r4);
+  q[5] = q4 ^ r4 ^ r5 ^ rotr32(q5 ^ r5);
+  q[6] = q5 ^ r5 ^ r6 ^ rotr32(q6 ^ r6);
+  q[7] = q6 ^ r6 ^ r7 ^ rotr32(q7 ^ r7);
+}
+
+static inline void invMixColumns(word64* q)
+{
+  word64 q0 = q[0], q1 = q[1], q2 = q[2], q3 = q[3];
+  word64 q4 = q[4], q5 = q[5], q6 = q[6], q7 = q[7];
+  word64 r0 = (q0 >> 16) | (q0 << 48);
+  word64 r1 = (q1 >> 16) | (q1 << 48);
+  word64 r2 = (q2 >> 16) | (q2 << 48);
+  word64 r3 = (q3 >> 16) | (q3 << 48);
+  word64 r4 = (q4 >> 16) | (q4 << 48);
+  word64 r5 = (q5 >> 16) | (q5 << 48);
+  word64 r6 = (q6 >> 16) | (q6 << 48);
+  word64 r7 = (q7 >> 16) | (q7 << 48);
+
+  q[0] = q5 ^ q6 ^ q7 ^ r0 ^ r5 ^ r7 ^ rotr32(q0 ^ q5 ^ q6 ^ r0 ^ r5);
+  q[1] = q0 ^ q5 ^ r0 ^ r1 ^ r5 ^ r6 ^ r7 ^ rotr32(q1 ^ q5 ^ q7 ^ r1 ^ r5 ^ r6);
+  q[2] = q0 ^ q1 ^ q6 ^ r1 ^ r2 ^ r6 ^ r7 ^ rotr32(q0 ^ q2 ^ q6 ^ r2 ^ r6 ^ r7);
+  q[3] = q0 ^ q1 ^ q2 ^ q5 ^ q6 ^ r0 ^ r2 ^ r3 ^ r5 ^ rotr32(q0 ^ q1 ^ q3 ^ q5 ^ q6 ^ q7 ^ r0 ^ r3 ^ r5 ^ r7);
+  q[4] = q1 ^ q2 ^ q3 ^ q5 ^ r1 ^ r3 ^ r4 ^ r5 ^ r6 ^ r7 ^ rotr32(q1 ^ q2 ^ q4 ^ q5 ^ q7 ^ r1 ^ r4 ^ r5 ^ r6);
+  q[5] = q2 ^ q3 ^ q4 ^ q6 ^ r2 ^ r4 ^ r5 ^ r6 ^ r7 ^ rotr32(q2 ^ q3 ^ q5 ^ q6 ^ r2 ^ r5 ^ r6 ^ r7);
+  q[6] = q3 ^ q4 ^ q5 ^ q7 ^ r3 ^ r5 ^ r6 ^ r7 ^ rotr32(q3 ^ q4 ^ q6 ^ q7 ^ r3 ^ r6 ^ r7);
+  q[7] = q4 ^ q5 ^ q6 ^ r4 ^ r6 ^ r7 ^ rotr32(q4 ^ q5 ^ q7 ^ r4 ^ r7);
+}
+
+static void encryptState(word64* q, const word64* roundKeys, unsigned int rounds)
+{
+  addRoundKey(q, roundKeys);
+  for (unsigned int i = 1; i < rounds; ++i) {
+    sbox(q);
+    shiftRows(q);
+    mixColumns(q);
+    addRoundKey(q, roundKeys + (i << 3));
+  }
+  sbox(q);
+  shiftRows(q);
+  addRoundKey(q, roundKeys + (rounds << 3));
+}
+
+static void decryptState(word64* q, const word64* roundKeys, unsigned int rounds)
+{
+  addRoundKey(q, roundKeys + (rounds << 3));
+  for (unsigned int i = rounds - 1; i > 0; --i) {
+    invShiftRows(q);
+    invSbox(q);
+    addRoundKey(q, roundKeys + (i << 3));
+    invMixColumns(q);
+  }
+  invShiftRows(q);
+  invSbox(q);
+  addRoundKey(q, roundKeys);
+}
+
+static word32 subWord(word32 x)
+{
+  word64 q[8] = { x, 0, 0, 0, 0, 0, 0, 0 };
+
+  ortho(q);
+  sbox(q);
+  ortho(q);
+
+  return (word32) q[0];
+}
+
+void BitslicedAES::Base::UncheckedSetKey(const byte* userKey, unsigned int keyLength, const NameValuePairs&)
+{
+  static const byte rcon[10] = { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36 };
+
+  AssertValidKeyLength(keyLength);
+
+  FixedSizeSecBlock<word32, 4 * 15> keyWords;
+  const unsigned int nk = keyLength / 4;
+  const unsigned int words = (keyLength / 4 + 7) * 4;
+
+  m_rounds = keyLength / 4 + 6;
+
+  for (unsigned int i = 0; i < nk; ++i) {
+    keyWords[i] = loadWord(userKey + i * 4);
+  }
+
+  // the usual FIPS-197 expansion, with the words in little-endian order
+  word32 tmp = keyWords[nk - 1];
+  for (unsigned int i = nk, j = 0, k = 0; i < words; ++i) {
+    if (j == 0) {
+      tmp = (tmp << 24) | (tmp >> 8);
+      tmp = subWord(tmp) ^ rcon[k];
+    }
+    else if (nk > 6 && j == 4) {
+      tmp = subWord(tmp);
+    }
+    tmp ^= keyWords[i - nk];
+    keyWords[i] = tmp;
+
+    if (++j == nk) {
+      j = 0;
+      ++k;
+    }
+  }
+
+  // each round key is loaded into every block of a state and sliced, so
+  // adding it is a plain xor of the state words
+  for (unsigned int i = 0; i <= m_rounds; ++i) {
+    word64* q = m_roundKeys + (i << 3);
+
+    interleaveIn(&q[0], &q[4], keyWords + (i << 2));
+    q[1] = q[2] = q[3] = q[0];
+    q[5] = q[6] = q[7] = q[4];
+    ortho(q);
+  }
+}
+
+size_t BitslicedAES::Base::ProcessBlocks(const byte* inBlocks, const byte* xorBlocks, byte* outBlocks, size_t length, word32 flags, bool encryption) const
+{
+  const size_t blocks = length / 16;
+  const bool counter = (flags & BT_InBlockIsCounter) != 0;
+  const bool reverse = (flags & BT_ReverseDirection) != 0;
+  byte buffer[16 * BITSLICED_AES_PARALLEL_BLOCKS];
+  word32 w[4];
+  word64 q[8];
+
+  for (size_t done = 0; done < blocks;) {
+    const size_t n = STDMIN(blocks - done, (size_t) BITSLICED_AES_PARALLEL_BLOCKS);
+
+    // when the blocks are chained backwards, as in CBC decryption, each
+    // block's xor block is the input block before it, and when working in
+    // place that input has to be read before it's overwritten, so we run
+    // the batches from the end
+    const size_t first = reverse ? blocks - done - n : done;
+
+    for (size_t i = 0; i < n; ++i) {
+      if (counter) {
+        memcpy(buffer + i * 16, inBlocks, 16);
+        buffer[i * 16 + 15] += (byte) (done + i);
+      }
+      else {
+        memcpy(buffer + i * 16, inBlocks + (first + i) * 16, 16);
+      }
+    }
+
+    memset(q, 0, sizeof(q));
+    for (size_t i = 0; i < n; ++i) {
+      for (unsigned int j = 0; j < 4; ++j) {
+        w[j] = loadWord(buffer + i * 16 + j * 4);
+      }
+      interleaveIn(&q[i], &q[i + 4], w);
+    }
+
+    ortho(q);
+    if (encryption) {
+      encryptState(q, m_roundKeys, m_rounds);
+    }
+    else {
+      decryptState(q, m_roundKeys, m_rounds);
+    }
+    ortho(q);
+
+    for (size_t i = 0; i < n; ++i) {
+      interleaveOut(w, q[i], q[i + 4]);
+      for (unsigned int j = 0; j < 4; ++j) {
+        storeWord(buffer + i * 16 + j * 4, w[j]);
+      }
+    }
+
+    if (xorBlocks != NULL) {
+      xorbuf(buffer, xorBlocks + first * 16, n * 16);
+    }
+    memcpy(outBlocks + first * 16, buffer, n * 16);
+
+    done += n;
+  }
+
+  // CTR mode picks the counter up from where we leave it...
+  if (counter) {
+    const_cast<byte*>(inBlocks)[15] += (byte) blocks;
+  }
+
+  SecureWipeArray(buffer, sizeof(buffer));
+  SecureWipeArray(q, 8);
+
+  return length % 16;
+}
+
+void BitslicedAES::Enc::ProcessAndXorBlock(const byte* inBlock, const byte* xorBlock, byte* outBlock) const
+{
+  ProcessBlocks(inBlock, xorBlock, outBlock, 16, 0, true);
+}
+
+size_t BitslicedAES::Enc::AdvancedProcessBlocks(const byte* inBlocks, const byte* xorBlocks, byte* outBlocks, size_t length, word32 flags) const
+{
+  // chained and strided calls, like CBC encryption's, go a block at a time
+  if (flags & (BT_XorInput | BT_DontIncrementInOutPointers)) {
+    return BlockTransformation::AdvancedProcessBlocks(inBlocks, xorBlocks, outBlocks, length, flags);
+  }
+
+  return ProcessBlocks(inBlocks, xorBlocks, outBlocks, length, flags, true);
+}
+
+void BitslicedAES::Dec::ProcessAndXorBlock(const byte* inBlock, const byte* xorBlock, byte* outBlock) const
+{
+  ProcessBlocks(inBlock, xorBlock, outBlock, 16, 0, false);
+}
+
+size_t BitslicedAES::Dec::AdvancedProcessBlocks(const byte* inBlocks, const byte* xorBlocks, byte* outBlocks, size_t length, word32 flags) const
+{
+  if (flags & (BT_XorInput | BT_DontIncrementInOutPointers)) {
+    return BlockTransformation::AdvancedProcessBlocks(inBlocks, xorBlocks, outBlocks, length, flags);
+  }
+
+  return ProcessBlocks(inBlocks, xorBlocks, outBlocks, length, flags, false);
+}
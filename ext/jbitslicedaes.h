@@ -0,0 +1,81 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#ifndef __JBITSLICEDAES_H__
+#define __JBITSLICEDAES_H__
+
+// Crypto++ headers...
+
+#include "seckey.h"
+#include "secblock.h"
+
+// the number of blocks a bitsliced state holds, and so the number run
+// through the cipher at once
+#define BITSLICED_AES_PARALLEL_BLOCKS 4
+
+using namespace CryptoPP;
+
+struct BitslicedAES_Info : public FixedBlockSize<16>, public VariableKeyLength<16, 16, 32, 8>
+{
+  static const char* StaticAlgorithmName() { return "AES (bitsliced)"; }
+};
+
+/* A constant-time AES for CPUs without AES instructions, in portable 64-bit
+ * code. It's a Crypto++ block cipher, so it can go anywhere AESEncryption
+ * and AESDecryption can.
+ *
+ * The table-driven AES looks up its S-boxes and T-tables by secret
+ * indices, which leaks key bits through the cache, and with
+ * CRYPTOPP_DISABLE_ASM that's the AES we get. Here the state is instead
+ * bitsliced across eight 64-bit words holding four blocks. Each S-box is
+ * a fixed circuit of ANDs and XORs over all 128 bytes at once, so there
+ * are no lookups and no branches on secret data. The circuit is Boyar and
+ * Peralta's, and the layout follows Thomas Pornin's ct64 AES from BearSSL.
+ *
+ * AdvancedProcessBlocks runs ECB, CTR and CBC decryption four blocks at a
+ * time. CBC encryption chains each block into the next, so it goes one
+ * block at a time, and a lone block costs as much as four. */
+class BitslicedAES : public BitslicedAES_Info, public BlockCipherDocumentation
+{
+  protected:
+    class Base : public BlockCipherImpl<BitslicedAES_Info>
+    {
+      public:
+        void UncheckedSetKey(const byte* userKey, unsigned int keyLength, const NameValuePairs& params);
+        unsigned int OptimalNumberOfParallelBlocks() const { return BITSLICED_AES_PARALLEL_BLOCKS; }
+
+      protected:
+        size_t ProcessBlocks(const byte* inBlocks, const byte* xorBlocks, byte* outBlocks, size_t length, word32 flags, bool encryption) const;
+
+        // the round keys expanded to fill a bitsliced state each
+        FixedSizeSecBlock<word64, 8 * 15> m_roundKeys;
+        unsigned int m_rounds;
+    };
+
+    class Enc : public Base
+    {
+      public:
+        void ProcessAndXorBlock(const byte* inBlock, const byte* xorBlock, byte* outBlock) const;
+        size_t AdvancedProcessBlocks(const byte* inBlocks, const byte* xorBlocks, byte* outBlocks, size_t length, word32 flags) const;
+    };
+
+    class Dec : public Base
+    {
+      public:
+        void ProcessAndXorBlock(const byte* inBlock, const byte* xorBlock, byte* outBlock) const;
+        size_t AdvancedProcessBlocks(const byte* inBlocks, const byte* xorBlocks, byte* outBlocks, size_t length, word32 flags) const;
+    };
+
+  public:
+    typedef BlockCipherFinal<ENCRYPTION, Enc> Encryption;
+    typedef BlockCipherFinal<DECRYPTION, Dec> Decryption;
+};
+
+typedef BitslicedAES::Encryption BitslicedAESEncryption;
+typedef BitslicedAES::Decryption BitslicedAESDecryption;
+
+#endif
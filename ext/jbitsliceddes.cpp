@@ -0,0 +1,205 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#include <algorithm>
+
+#include "jbitsliceddes.h"
+#include "jbitsliceddes_sboxes.h"
+
+// The tables are in the usual FIPS 46-3 form, bits numbered from 1 at the
+// most significant end.
+
+static const byte initialPermutation[64] = {
+  58, 50, 42, 34, 26, 18, 10,  2, 60, 52, 44, 36, 28, 20, 12,  4,
+  62, 54, 46, 38, 30, 22, 14,  6, 64, 56, 48, 40, 32, 24, 16,  8,
+  57, 49, 41, 33, 25, 17,  9,  1, 59, 51, 43, 35, 27, 19, 11,  3,
+  61, 53, 45, 37, 29, 21, 13,  5, 63, 55, 47, 39, 31, 23, 15,  7
+};
+
+static const byte finalPermutation[64] = {
+  40,  8, 48, 16, 56, 24, 64, 32, 39,  7, 47, 15, 55, 23, 63, 31,
+  38,  6, 46, 14, 54, 22, 62, 30, 37,  5, 45, 13, 53, 21, 61, 29,
+  36,  4, 44, 12, 52, 20, 60, 28, 35,  3, 43, 11, 51, 19, 59, 27,
+  34,  2, 42, 10, 50, 18, 58, 26, 33,  1, 41,  9, 49, 17, 57, 25
+};
+
+static const byte permutedChoice1[56] = {
+  57, 49, 41, 33, 25, 17,  9,  1, 58, 50, 42, 34, 26, 18,
+  10,  2, 59, 51, 43, 35, 27, 19, 11,  3, 60, 52, 44, 36,
+  63, 55, 47, 39, 31, 23, 15,  7, 62, 54, 46, 38, 30, 22,
+  14,  6, 61, 53, 45, 37, 29, 21, 13,  5, 28, 20, 12,  4
+};
+
+static const byte permutedChoice2[48] = {
+  14, 17, 11, 24,  1,  5,  3, 28, 15,  6, 21, 10,
+  23, 19, 12,  4, 26,  8, 16,  7, 27, 20, 13,  2,
+  41, 52, 31, 37, 47, 55, 30, 40, 51, 45, 33, 48,
+  44, 49, 39, 56, 34, 53, 46, 42, 50, 36, 29, 32
+};
+
+static const byte keyRotations[16] = {
+  1, 1, 2, 2, 2, 2, 2, 2, 1, 2, 2, 2, 2, 2, 2, 1
+};
+
+// Transposes a 64x64 bit matrix in place, so that going in with a block in
+// each word, word i comes out with bit i + 1 of every block.
+static void transpose(word64* a)
+{
+  word64 m = W64LIT(0x00000000FFFFFFFF);
+
+  for (unsigned int j = 32; j != 0; j >>= 1, m ^= (m << j)) {
+    for (unsigned int k = 0; k < 64; k = ((k | j) + 1) & ~j) {
+      word64 t = (a[k] ^ (a[k | j] >> j)) & m;
+      a[k] ^= t;
+      a[k | j] ^= (t << j);
+    }
+  }
+}
+
+void BitslicedDESEngine::setKey(const byte* key, size_t keylength, const bool encryption)
+{
+  if (keylength == 8) {
+    m_passes = 1;
+    setPass(0, key, encryption);
+  }
+  else {
+    // the keys run E, D, E to encrypt and D, E, D the other way round, and
+    // two-key triple DES uses its first key for the third
+    const byte* last = (keylength == 24) ? key + 16 : key;
+
+    m_passes = 3;
+    setPass(0, encryption ? key : last, encryption);
+    setPass(1, key + 8, !encryption);
+    setPass(2, encryption ? last : key, encryption);
+  }
+}
+
+void BitslicedDESEngine::setPass(const unsigned int pass, const byte* key, const bool encryption)
+{
+  byte cd[56];
+  byte* roundKeys = m_roundKeys + pass * 16 * 48;
+
+  for (unsigned int i = 0; i < 56; ++i) {
+    const unsigned int bit = permutedChoice1[i] - 1;
+    cd[i] = (key[bit >> 3] >> (7 - (bit & 7))) & 1;
+  }
+
+  for (unsigned int round = 0; round < 16; ++round) {
+    // C and D each rotate left...
+    for (unsigned int n = 0; n < keyRotations[round]; ++n) {
+      const byte c = cd[0], d = cd[28];
+
+      memmove(cd, cd + 1, 27);
+      memmove(cd + 28, cd + 29, 27);
+      cd[27] = c;
+      cd[55] = d;
+    }
+
+    byte* roundKey = roundKeys + (encryption ? round : 15 - round) * 48;
+    for (unsigned int i = 0; i < 48; ++i) {
+      roundKey[i] = cd[permutedChoice2[i] - 1];
+    }
+  }
+
+  SecureWipeArray(cd, sizeof(cd));
+}
+
+void BitslicedDESEngine::processBlocks(const byte* in, byte* out, const size_t blocks) const
+{
+  word64 state[64];
+  word64 l[32], r[32];
+  word64 k[48];
+
+  for (size_t i = 0; i < 64; ++i) {
+    state[i] = (i < blocks) ? GetWord<word64>(false, BIG_ENDIAN_ORDER, in + i * 8) : 0;
+  }
+  transpose(state);
+
+  for (unsigned int i = 0; i < 32; ++i) {
+    l[i] = state[initialPermutation[i] - 1];
+    r[i] = state[initialPermutation[i + 32] - 1];
+  }
+
+  word64* left = l;
+  word64* right = r;
+
+  for (unsigned int pass = 0; pass < m_passes; ++pass) {
+    const byte* roundKeys = m_roundKeys + pass * 16 * 48;
+
+    for (unsigned int round = 0; round < 16; ++round) {
+      // every block has the same key, so each key bit is all 0s or all 1s
+      for (unsigned int i = 0; i < 48; ++i) {
+        k[i] = 0 - (word64) roundKeys[round * 48 + i];
+      }
+      desRound(left, right, k);
+      std::swap(left, right);
+    }
+
+    // the final permutation and the next pass's initial permutation
+    // cancel out, leaving just the swap of the halves
+    std::swap(left, right);
+  }
+
+  for (unsigned int i = 0; i < 64; ++i) {
+    const unsigned int bit = finalPermutation[i] - 1;
+    state[i] = (bit < 32) ? left[bit] : right[bit - 32];
+  }
+  transpose(state);
+
+  for (size_t i = 0; i < blocks; ++i) {
+    PutWord<word64>(false, BIG_ENDIAN_ORDER, out + i * 8, state[i]);
+  }
+
+  SecureWipeArray(state, 64);
+  SecureWipeArray(l, 32);
+  SecureWipeArray(r, 32);
+  SecureWipeArray(k, 48);
+}
+
+size_t BitslicedDESEngine::processBlocks(const byte* inBlocks, const byte* xorBlocks, byte* outBlocks, size_t length, word32 flags) const
+{
+  const size_t blocks = length / 8;
+  const bool counter = (flags & BlockTransformation::BT_InBlockIsCounter) != 0;
+  const bool reverse = (flags & BlockTransformation::BT_ReverseDirection) != 0;
+  byte buffer[8 * BITSLICED_DES_PARALLEL_BLOCKS];
+
+  for (size_t done = 0; done < blocks;) {
+    const size_t n = STDMIN(blocks - done, (size_t) BITSLICED_DES_PARALLEL_BLOCKS);
+
+    // as with CBC decryption, where each xor block is the input block
+    // before it, so working backwards is what makes it safe in place
+    const size_t first = reverse ? blocks - done - n : done;
+
+    if (counter) {
+      for (size_t i = 0; i < n; ++i) {
+        memcpy(buffer + i * 8, inBlocks, 8);
+        buffer[i * 8 + 7] += (byte) (done + i);
+      }
+    }
+    else {
+      memcpy(buffer, inBlocks + first * 8, n * 8);
+    }
+
+    processBlocks(buffer, buffer, n);
+
+    if (xorBlocks != NULL) {
+      xorbuf(buffer, xorBlocks + first * 8, n * 8);
+    }
+    memcpy(outBlocks + first * 8, buffer, n * 8);
+
+    done += n;
+  }
+
+  // CTR mode picks the counter up from where we leave it...
+  if (counter) {
+    const_cast<byte*>(inBlocks)[7] += (byte) blocks;
+  }
+
+  SecureWipeArray(buffer, sizeof(buffer));
+
+  return length % 8;
+}
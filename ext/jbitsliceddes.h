@@ -0,0 +1,69 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#ifndef __JBITSLICEDDES_H__
+#define __JBITSLICEDDES_H__
+
+// Crypto++ headers...
+
+#include "des.h"
+#include "misc.h"
+#include "secblock.h"
+
+#include "jparallelcipher.h"
+
+// the number of blocks a bitsliced pass runs, one per bit of a word64
+#define BITSLICED_DES_PARALLEL_BLOCKS 64
+
+// Shorter runs than this go through the table-driven DES instead, as a
+// bitsliced pass costs the same however few of its blocks are used.
+#define BITSLICED_DES_MIN_BLOCKS 16
+
+using namespace CryptoPP;
+
+/* Runs DES, two-key triple DES or three-key triple DES over 64 blocks at
+ * once. The state is 64 word64s, word i holding bit i of every block, so
+ * the permutations and the expansion are just a matter of which words go
+ * where, and each S-box is a circuit of ANDs, ORs and XORs generated by
+ * extras/bitsliced_des_sboxes.rb. There are no table lookups, so it runs in
+ * constant time too.
+ *
+ * The key is given in the same form as Crypto++ takes it for DES, DES_EDE2
+ * or DES_EDE3, going by its length. It's wrapped up as a Crypto++ block
+ * cipher by ParallelCipher_Template. */
+class BitslicedDESEngine
+{
+  public:
+    void setKey(const byte* key, size_t keylength, const bool encryption);
+
+    unsigned int parallelBlocks() const { return BITSLICED_DES_PARALLEL_BLOCKS; }
+    unsigned int minimumBlocks() const { return BITSLICED_DES_MIN_BLOCKS; }
+
+    // Runs up to BITSLICED_DES_PARALLEL_BLOCKS blocks from in to out, which
+    // may be the same.
+    void processBlocks(const byte* in, byte* out, const size_t blocks) const;
+
+    // Runs whole blocks with the semantics of
+    // BlockTransformation::AdvancedProcessBlocks, except that it doesn't do
+    // BT_XorInput or BT_DontIncrementInOutPointers, and returns the bytes
+    // left over.
+    size_t processBlocks(const byte* inBlocks, const byte* xorBlocks, byte* outBlocks, size_t length, word32 flags) const;
+
+  private:
+    // one DES pass worth of round keys, one bit to a byte, already in the
+    // order the rounds use them
+    void setPass(const unsigned int pass, const byte* key, const bool encryption);
+
+    FixedSizeSecBlock<byte, 3 * 16 * 48> m_roundKeys;
+    unsigned int m_passes;
+};
+
+typedef ParallelCipher_Template<DES_Info, DES, BitslicedDESEngine> BitslicedDES;
+typedef ParallelCipher_Template<DES_EDE2_Info, DES_EDE2, BitslicedDESEngine> BitslicedDES_EDE2;
+typedef ParallelCipher_Template<DES_EDE3_Info, DES_EDE3, BitslicedDESEngine> BitslicedDES_EDE3;
+
+#endif
@@ -0,0 +1,698 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+/* Generated by extras/bitsliced_des_sboxes.rb. Don't edit this by hand,
+ * change the generator and run it again. */
+
+#ifndef __JBITSLICEDDES_SBOXES_H__
+#define __JBITSLICEDDES_SBOXES_H__
+
+// 81 gates
+static inline void sbox1(const word64 a1, const word64 a2, const word64 a3, const word64 a4, const word64 a5, const word64 a6,
+  word64& out1, word64& out2, word64& out3, word64& out4)
+{
+  const word64 x1 = ~a3;
+  const word64 x2 = x1 & ~a2;
+  const word64 x3 = x2 ^ a5;
+  const word64 x4 = x3 ^ a6;
+  const word64 x5 = a3 & ~a2;
+  const word64 x6 = a5 & a3;
+  const word64 x7 = x5 ^ x6;
+  const word64 x8 = a5 ^ a3;
+  const word64 x9 = x8 & a6;
+  const word64 x10 = x7 ^ x9;
+  const word64 x11 = x10 & a4;
+  const word64 x12 = x4 ^ x11;
+  const word64 x13 = x1 | ~a2;
+  const word64 x14 = a5 & ~a3;
+  const word64 x15 = x13 ^ x14;
+  const word64 x16 = x8 & x3;
+  const word64 x17 = x9 & x3;
+  const word64 x18 = x15 ^ x17;
+  const word64 x19 = a3 ^ a2;
+  const word64 x20 = x19 & a5;
+  const word64 x21 = x2 ^ x20;
+  const word64 x22 = x2 & a6;
+  const word64 x23 = x21 ^ x22;
+  const word64 x24 = x23 & a4;
+  const word64 x25 = x18 ^ x24;
+  const word64 x26 = x25 & a1;
+  const word64 x27 = x12 ^ x26;
+  const word64 x28 = x1 ^ a2;
+  const word64 x29 = x28 ^ x6;
+  const word64 x30 = x3 | a3;
+  const word64 x31 = x30 & a6;
+  const word64 x32 = x29 ^ x31;
+  const word64 x33 = a5 | a2;
+  const word64 x34 = x29 & a6;
+  const word64 x35 = x33 ^ x34;
+  const word64 x36 = x35 & a4;
+  const word64 x37 = x32 ^ x36;
+  const word64 x38 = x8 | ~x3;
+  const word64 x39 = x7 | ~x19;
+  const word64 x40 = x39 & a6;
+  const word64 x41 = x38 ^ x40;
+  const word64 x42 = x5 ^ a5;
+  const word64 x43 = x33 & x31;
+  const word64 x44 = x42 ^ x43;
+  const word64 x45 = x44 & a4;
+  const word64 x46 = x41 ^ x45;
+  const word64 x47 = x46 & a1;
+  const word64 x48 = x37 ^ x47;
+  const word64 x49 = x16 | x15;
+  const word64 x50 = x49 ^ x22;
+  const word64 x51 = x34 | x4;
+  const word64 x52 = x51 & a4;
+  const word64 x53 = x50 ^ x52;
+  const word64 x54 = x39 ^ x14;
+  const word64 x55 = a5 | ~x30;
+  const word64 x56 = x55 & a6;
+  const word64 x57 = x54 ^ x56;
+  const word64 x58 = x42 ^ x33;
+  const word64 x59 = x56 & ~x10;
+  const word64 x60 = x58 ^ x59;
+  const word64 x61 = x60 & a4;
+  const word64 x62 = x57 ^ x61;
+  const word64 x63 = x62 & a1;
+  const word64 x64 = x53 ^ x63;
+  const word64 x65 = x20 ^ a2;
+  const word64 x66 = a6 & ~x54;
+  const word64 x67 = x65 ^ x66;
+  const word64 x68 = x32 | ~x4;
+  const word64 x69 = x68 & a4;
+  const word64 x70 = x67 ^ x69;
+  const word64 x71 = x42 ^ x20;
+  const word64 x72 = x16 | ~a5;
+  const word64 x73 = x72 & a6;
+  const word64 x74 = x71 ^ x73;
+  const word64 x75 = x65 ^ x3;
+  const word64 x76 = a6 & ~x7;
+  const word64 x77 = x75 ^ x76;
+  const word64 x78 = x77 & a4;
+  const word64 x79 = x74 ^ x78;
+  const word64 x80 = x79 & a1;
+  const word64 x81 = x70 ^ x80;
+
+  out1 ^= x27;
+  out2 ^= x48;
+  out3 ^= x64;
+  out4 ^= x81;
+}
+
+// 69 gates
+static inline void sbox2(const word64 a1, const word64 a2, const word64 a3, const word64 a4, const word64 a5, const word64 a6,
+  word64& out1, word64& out2, word64& out3, word64& out4)
+{
+  const word64 x1 = ~a1;
+  const word64 x2 = a1 | ~a4;
+  const word64 x3 = x2 & a5;
+  const word64 x4 = x1 ^ x3;
+  const word64 x5 = x4 ^ a3;
+  const word64 x6 = a5 & ~x2;
+  const word64 x7 = a4 ^ x6;
+  const word64 x8 = a3 & ~a1;
+  const word64 x9 = x7 ^ x8;
+  const word64 x10 = x9 & a2;
+  const word64 x11 = x5 ^ x10;
+  const word64 x12 = a4 | ~a1;
+  const word64 x13 = x12 | ~a5;
+  const word64 x14 = a5 & a1;
+  const word64 x15 = x14 & a3;
+  const word64 x16 = x13 ^ x15;
+  const word64 x17 = x13 ^ a1;
+  const word64 x18 = x17 ^ x8;
+  const word64 x19 = x18 & a2;
+  const word64 x20 = x16 ^ x19;
+  const word64 x21 = x20 & a6;
+  const word64 x22 = x11 ^ x21;
+  const word64 x23 = x7 ^ x4;
+  const word64 x24 = x3 | ~a4;
+  const word64 x25 = a3 & ~x14;
+  const word64 x26 = x24 ^ x25;
+  const word64 x27 = x26 & a2;
+  const word64 x28 = x23 ^ x27;
+  const word64 x29 = x24 ^ x7;
+  const word64 x30 = x29 & ~a3;
+  const word64 x31 = x15 | ~x24;
+  const word64 x32 = x31 & a2;
+  const word64 x33 = x30 ^ x32;
+  const word64 x34 = x33 & a6;
+  const word64 x35 = x28 ^ x34;
+  const word64 x36 = x23 | x14;
+  const word64 x37 = a4 | a1;
+  const word64 x38 = x37 | a5;
+  const word64 x39 = x38 & a3;
+  const word64 x40 = x36 ^ x39;
+  const word64 x41 = x14 ^ x12;
+  const word64 x42 = x41 | a3;
+  const word64 x43 = x42 & a2;
+  const word64 x44 = x40 ^ x43;
+  const word64 x45 = a3 & ~x2;
+  const word64 x46 = x14 ^ x45;
+  const word64 x47 = x4 ^ x2;
+  const word64 x48 = x47 ^ x25;
+  const word64 x49 = x48 & a2;
+  const word64 x50 = x46 ^ x49;
+  const word64 x51 = x50 & a6;
+  const word64 x52 = x44 ^ x51;
+  const word64 x53 = x1 ^ a4;
+  const word64 x54 = x1 & ~a5;
+  const word64 x55 = x8 & ~a5;
+  const word64 x56 = x53 ^ x55;
+  const word64 x57 = x6 | ~x17;
+  const word64 x58 = a5 & a3;
+  const word64 x59 = x57 ^ x58;
+  const word64 x60 = x59 & a2;
+  const word64 x61 = x56 ^ x60;
+  const word64 x62 = x29 ^ x17;
+  const word64 x63 = x15 | x8;
+  const word64 x64 = x62 ^ x63;
+  const word64 x65 = x54 | ~x40;
+  const word64 x66 = x65 & a2;
+  const word64 x67 = x64 ^ x66;
+  const word64 x68 = x67 & a6;
+  const word64 x69 = x61 ^ x68;
+
+  out1 ^= x22;
+  out2 ^= x35;
+  out3 ^= x52;
+  out4 ^= x69;
+}
+
+// 71 gates
+static inline void sbox3(const word64 a1, const word64 a2, const word64 a3, const word64 a4, const word64 a5, const word64 a6,
+  word64& out1, word64& out2, word64& out3, word64& out4)
+{
+  const word64 x1 = ~a5;
+  const word64 x2 = x1 ^ a2;
+  const word64 x3 = a6 ^ a2;
+  const word64 x4 = x3 & a1;
+  const word64 x5 = x2 ^ x4;
+  const word64 x6 = a5 & ~a6;
+  const word64 x7 = x6 & a2;
+  const word64 x8 = x1 ^ x7;
+  const word64 x9 = x6 ^ x2;
+  const word64 x10 = x9 & a1;
+  const word64 x11 = x8 ^ x10;
+  const word64 x12 = x11 & a3;
+  const word64 x13 = x5 ^ x12;
+  const word64 x14 = x6 | x3;
+  const word64 x15 = x14 | a1;
+  const word64 x16 = x9 & ~a1;
+  const word64 x17 = x16 & a3;
+  const word64 x18 = x15 ^ x17;
+  const word64 x19 = x18 & a4;
+  const word64 x20 = x13 ^ x19;
+  const word64 x21 = a6 | a5;
+  const word64 x22 = x21 & a2;
+  const word64 x23 = a6 ^ x22;
+  const word64 x24 = x21 | ~a2;
+  const word64 x25 = x24 & a1;
+  const word64 x26 = x23 ^ x25;
+  const word64 x27 = x22 ^ x2;
+  const word64 x28 = x4 & ~x21;
+  const word64 x29 = x27 ^ x28;
+  const word64 x30 = x29 & a3;
+  const word64 x31 = x26 ^ x30;
+  const word64 x32 = a6 | ~x2;
+  const word64 x33 = a1 & ~x9;
+  const word64 x34 = x32 ^ x33;
+  const word64 x35 = x33 ^ a2;
+  const word64 x36 = x35 & a3;
+  const word64 x37 = x34 ^ x36;
+  const word64 x38 = x37 & a4;
+  const word64 x39 = x31 ^ x38;
+  const word64 x40 = x8 ^ x3;
+  const word64 x41 = a1 & ~x23;
+  const word64 x42 = x40 ^ x41;
+  const word64 x43 = x6 & a1;
+  const word64 x44 = x32 ^ x43;
+  const word64 x45 = x44 & a3;
+  const word64 x46 = x42 ^ x45;
+  const word64 x47 = a5 | ~x3;
+  const word64 x48 = x47 & x2;
+  const word64 x49 = x48 & a1;
+  const word64 x50 = x47 ^ x49;
+  const word64 x51 = x2 & ~a6;
+  const word64 x52 = x32 ^ a5;
+  const word64 x53 = x52 & a1;
+  const word64 x54 = x51 ^ x53;
+  const word64 x55 = x54 & a3;
+  const word64 x56 = x50 ^ x55;
+  const word64 x57 = x56 & a4;
+  const word64 x58 = x46 ^ x57;
+  const word64 x59 = x25 & x5;
+  const word64 x60 = x3 ^ x59;
+  const word64 x61 = x27 | ~x14;
+  const word64 x62 = x61 & a1;
+  const word64 x63 = a5 ^ x62;
+  const word64 x64 = x63 & a3;
+  const word64 x65 = x60 ^ x64;
+  const word64 x66 = a1 & ~x5;
+  const word64 x67 = x1 ^ x66;
+  const word64 x68 = x62 & x12;
+  const word64 x69 = x67 ^ x68;
+  const word64 x70 = x69 & a4;
+  const word64 x71 = x65 ^ x70;
+
+  out1 ^= x20;
+  out2 ^= x39;
+  out3 ^= x58;
+  out4 ^= x71;
+}
+
+// 56 gates
+static inline void sbox4(const word64 a1, const word64 a2, const word64 a3, const word64 a4, const word64 a5, const word64 a6,
+  word64& out1, word64& out2, word64& out3, word64& out4)
+{
+  const word64 x1 = a5 & ~a3;
+  const word64 x2 = x1 ^ a4;
+  const word64 x3 = a3 & ~a5;
+  const word64 x4 = x3 | ~a4;
+  const word64 x5 = x4 & a1;
+  const word64 x6 = x2 ^ x5;
+  const word64 x7 = a5 | a3;
+  const word64 x8 = a5 & a4;
+  const word64 x9 = x7 ^ x8;
+  const word64 x10 = x1 | ~x4;
+  const word64 x11 = x10 & a1;
+  const word64 x12 = x9 ^ x11;
+  const word64 x13 = x12 & a2;
+  const word64 x14 = x6 ^ x13;
+  const word64 x15 = ~a5;
+  const word64 x16 = x15 ^ a3;
+  const word64 x17 = a4 & ~a5;
+  const word64 x18 = x16 ^ x17;
+  const word64 x19 = x11 & x2;
+  const word64 x20 = x18 ^ x19;
+  const word64 x21 = x16 | ~x2;
+  const word64 x22 = x1 & a1;
+  const word64 x23 = x21 ^ x22;
+  const word64 x24 = x23 & a2;
+  const word64 x25 = x20 ^ x24;
+  const word64 x26 = x25 & a6;
+  const word64 x27 = x14 ^ x26;
+  const word64 x28 = x25 ^ x14;
+  const word64 x29 = a6 & ~x25;
+  const word64 x30 = x28 ^ x29;
+  const word64 x31 = x16 | ~x4;
+  const word64 x32 = x1 | a4;
+  const word64 x33 = x32 & a1;
+  const word64 x34 = x31 ^ x33;
+  const word64 x35 = ~a3;
+  const word64 x36 = x35 | ~a4;
+  const word64 x37 = x5 & ~x1;
+  const word64 x38 = x36 ^ x37;
+  const word64 x39 = x38 & a2;
+  const word64 x40 = x34 ^ x39;
+  const word64 x41 = x31 ^ x18;
+  const word64 x42 = x15 ^ x41;
+  const word64 x43 = x18 & x5;
+  const word64 x44 = x42 ^ x43;
+  const word64 x45 = x31 | ~x38;
+  const word64 x46 = x45 & a2;
+  const word64 x47 = x44 ^ x46;
+  const word64 x48 = x47 & a6;
+  const word64 x49 = x40 ^ x48;
+  const word64 x50 = x18 ^ a5;
+  const word64 x51 = a1 & ~x3;
+  const word64 x52 = x50 ^ x51;
+  const word64 x53 = x46 ^ x39;
+  const word64 x54 = x52 ^ x53;
+  const word64 x55 = a6 & ~x47;
+  const word64 x56 = x54 ^ x55;
+
+  out1 ^= x27;
+  out2 ^= x30;
+  out3 ^= x49;
+  out4 ^= x56;
+}
+
+// 82 gates
+static inline void sbox5(const word64 a1, const word64 a2, const word64 a3, const word64 a4, const word64 a5, const word64 a6,
+  word64& out1, word64& out2, word64& out3, word64& out4)
+{
+  const word64 x1 = a2 & ~a4;
+  const word64 x2 = a2 | ~a4;
+  const word64 x3 = x2 & a5;
+  const word64 x4 = x1 ^ x3;
+  const word64 x5 = a4 & a2;
+  const word64 x6 = x5 | a5;
+  const word64 x7 = x6 & a1;
+  const word64 x8 = x4 ^ x7;
+  const word64 x9 = a4 & ~a5;
+  const word64 x10 = x3 | ~x6;
+  const word64 x11 = x10 & a1;
+  const word64 x12 = x9 ^ x11;
+  const word64 x13 = x12 & a3;
+  const word64 x14 = x8 ^ x13;
+  const word64 x15 = x2 ^ a5;
+  const word64 x16 = a4 & ~a2;
+  const word64 x17 = a5 & ~x1;
+  const word64 x18 = x16 ^ x17;
+  const word64 x19 = x18 & a1;
+  const word64 x20 = x15 ^ x19;
+  const word64 x21 = x2 ^ x1;
+  const word64 x22 = x21 | a5;
+  const word64 x23 = ~a2;
+  const word64 x24 = x23 ^ a5;
+  const word64 x25 = x24 & a1;
+  const word64 x26 = x22 ^ x25;
+  const word64 x27 = x26 & a3;
+  const word64 x28 = x20 ^ x27;
+  const word64 x29 = x28 & a6;
+  const word64 x30 = x14 ^ x29;
+  const word64 x31 = ~x15;
+  const word64 x32 = x9 | ~a4;
+  const word64 x33 = x32 & a1;
+  const word64 x34 = x31 ^ x33;
+  const word64 x35 = x10 ^ a2;
+  const word64 x36 = x35 | ~a1;
+  const word64 x37 = x36 & a3;
+  const word64 x38 = x34 ^ x37;
+  const word64 x39 = x24 | ~x11;
+  const word64 x40 = x24 & ~a4;
+  const word64 x41 = x1 & a1;
+  const word64 x42 = x40 ^ x41;
+  const word64 x43 = x42 & a3;
+  const word64 x44 = x39 ^ x43;
+  const word64 x45 = x44 & a6;
+  const word64 x46 = x38 ^ x45;
+  const word64 x47 = x35 ^ x18;
+  const word64 x48 = x15 | x4;
+  const word64 x49 = x48 & a1;
+  const word64 x50 = x47 ^ x49;
+  const word64 x51 = x17 | ~x2;
+  const word64 x52 = x25 & ~a4;
+  const word64 x53 = x51 ^ x52;
+  const word64 x54 = x53 & a3;
+  const word64 x55 = x50 ^ x54;
+  const word64 x56 = x18 & ~a2;
+  const word64 x57 = x11 & ~x4;
+  const word64 x58 = x56 ^ x57;
+  const word64 x59 = x48 & ~a1;
+  const word64 x60 = x59 & a3;
+  const word64 x61 = x58 ^ x60;
+  const word64 x62 = x61 & a6;
+  const word64 x63 = x55 ^ x62;
+  const word64 x64 = x6 & ~x56;
+  const word64 x65 = x33 & ~x58;
+  const word64 x66 = x64 ^ x65;
+  const word64 x67 = x1 | ~x3;
+  const word64 x68 = x21 | ~x15;
+  const word64 x69 = x68 & a1;
+  const word64 x70 = x67 ^ x69;
+  const word64 x71 = x70 & a3;
+  const word64 x72 = x66 ^ x71;
+  const word64 x73 = x1 | a5;
+  const word64 x74 = x53 & a1;
+  const word64 x75 = x73 ^ x74;
+  const word64 x76 = x2 & ~x6;
+  const word64 x77 = x22 & a1;
+  const word64 x78 = x76 ^ x77;
+  const word64 x79 = x78 & a3;
+  const word64 x80 = x75 ^ x79;
+  const word64 x81 = x80 & a6;
+  const word64 x82 = x72 ^ x81;
+
+  out1 ^= x30;
+  out2 ^= x46;
+  out3 ^= x63;
+  out4 ^= x82;
+}
+
+// 71 gates
+static inline void sbox6(const word64 a1, const word64 a2, const word64 a3, const word64 a4, const word64 a5, const word64 a6,
+  word64& out1, word64& out2, word64& out3, word64& out4)
+{
+  const word64 x1 = ~a5;
+  const word64 x2 = x1 ^ a2;
+  const word64 x3 = a6 & a5;
+  const word64 x4 = x2 ^ x3;
+  const word64 x5 = a6 & ~a5;
+  const word64 x6 = a2 ^ x5;
+  const word64 x7 = x6 & a3;
+  const word64 x8 = x4 ^ x7;
+  const word64 x9 = a6 | a5;
+  const word64 x10 = x2 & a6;
+  const word64 x11 = x1 ^ x10;
+  const word64 x12 = x11 & a3;
+  const word64 x13 = x9 ^ x12;
+  const word64 x14 = x13 & a4;
+  const word64 x15 = x8 ^ x14;
+  const word64 x16 = x13 | a5;
+  const word64 x17 = x5 & ~a2;
+  const word64 x18 = x12 & a6;
+  const word64 x19 = x17 ^ x18;
+  const word64 x20 = x19 & a4;
+  const word64 x21 = x16 ^ x20;
+  const word64 x22 = x21 & a1;
+  const word64 x23 = x15 ^ x22;
+  const word64 x24 = x2 ^ a6;
+  const word64 x25 = a3 & ~a5;
+  const word64 x26 = x24 ^ x25;
+  const word64 x27 = x3 | ~a2;
+  const word64 x28 = a5 & a3;
+  const word64 x29 = x27 ^ x28;
+  const word64 x30 = x29 & a4;
+  const word64 x31 = x26 ^ x30;
+  const word64 x32 = a2 & ~a5;
+  const word64 x33 = x1 & ~a2;
+  const word64 x34 = x32 ^ x17;
+  const word64 x35 = x34 | ~a3;
+  const word64 x36 = a5 & ~x4;
+  const word64 x37 = x10 ^ x9;
+  const word64 x38 = x28 ^ x18;
+  const word64 x39 = x36 ^ x38;
+  const word64 x40 = x39 & a4;
+  const word64 x41 = x35 ^ x40;
+  const word64 x42 = x41 & a1;
+  const word64 x43 = x31 ^ x42;
+  const word64 x44 = a6 & ~x36;
+  const word64 x45 = a3 & ~x33;
+  const word64 x46 = x44 ^ x45;
+  const word64 x47 = x1 | ~x4;
+  const word64 x48 = x47 & a4;
+  const word64 x49 = x46 ^ x48;
+  const word64 x50 = x7 | ~x26;
+  const word64 x51 = x3 | ~x47;
+  const word64 x52 = x51 & a4;
+  const word64 x53 = x50 ^ x52;
+  const word64 x54 = x53 & a1;
+  const word64 x55 = x49 ^ x54;
+  const word64 x56 = a3 & ~a2;
+  const word64 x57 = a5 ^ x56;
+  const word64 x58 = x3 | a2;
+  const word64 x59 = x29 & ~x35;
+  const word64 x60 = x58 ^ x59;
+  const word64 x61 = x60 & a4;
+  const word64 x62 = x57 ^ x61;
+  const word64 x63 = a2 | ~a6;
+  const word64 x64 = x63 ^ x38;
+  const word64 x65 = x37 & ~x3;
+  const word64 x66 = a3 & ~x9;
+  const word64 x67 = x65 ^ x66;
+  const word64 x68 = x67 & a4;
+  const word64 x69 = x64 ^ x68;
+  const word64 x70 = x69 & a1;
+  const word64 x71 = x62 ^ x70;
+
+  out1 ^= x23;
+  out2 ^= x43;
+  out3 ^= x55;
+  out4 ^= x71;
+}
+
+// 72 gates
+static inline void sbox7(const word64 a1, const word64 a2, const word64 a3, const word64 a4, const word64 a5, const word64 a6,
+  word64& out1, word64& out2, word64& out3, word64& out4)
+{
+  const word64 x1 = a4 & a2;
+  const word64 x2 = a5 ^ x1;
+  const word64 x3 = ~a2;
+  const word64 x4 = a5 ^ a2;
+  const word64 x5 = x2 & a4;
+  const word64 x6 = x3 ^ x5;
+  const word64 x7 = x6 & a3;
+  const word64 x8 = x2 ^ x7;
+  const word64 x9 = x6 | ~a3;
+  const word64 x10 = x9 & a6;
+  const word64 x11 = x8 ^ x10;
+  const word64 x12 = a5 | ~a2;
+  const word64 x13 = x12 & a4;
+  const word64 x14 = x4 ^ x13;
+  const word64 x15 = a5 | a2;
+  const word64 x16 = x15 ^ x5;
+  const word64 x17 = x16 & a3;
+  const word64 x18 = x14 ^ x17;
+  const word64 x19 = a4 | ~a5;
+  const word64 x20 = x19 ^ x7;
+  const word64 x21 = x20 & a6;
+  const word64 x22 = x18 ^ x21;
+  const word64 x23 = x22 & a1;
+  const word64 x24 = x11 ^ x23;
+  const word64 x25 = x3 ^ a5;
+  const word64 x26 = a4 & ~a2;
+  const word64 x27 = x25 ^ x26;
+  const word64 x28 = a3 & a2;
+  const word64 x29 = x27 ^ x28;
+  const word64 x30 = a2 & ~x13;
+  const word64 x31 = a4 & ~x9;
+  const word64 x32 = x30 ^ x31;
+  const word64 x33 = x32 & a6;
+  const word64 x34 = x29 ^ x33;
+  const word64 x35 = x29 ^ x8;
+  const word64 x36 = a5 | ~x1;
+  const word64 x37 = x36 ^ x28;
+  const word64 x38 = x37 & a6;
+  const word64 x39 = x35 ^ x38;
+  const word64 x40 = x39 & a1;
+  const word64 x41 = x34 ^ x40;
+  const word64 x42 = x14 ^ x5;
+  const word64 x43 = x42 ^ a3;
+  const word64 x44 = a5 & ~x5;
+  const word64 x45 = x2 | ~a4;
+  const word64 x46 = x45 & a3;
+  const word64 x47 = x44 ^ x46;
+  const word64 x48 = x47 & a6;
+  const word64 x49 = x43 ^ x48;
+  const word64 x50 = x1 | a5;
+  const word64 x51 = x7 & ~x2;
+  const word64 x52 = x50 ^ x51;
+  const word64 x53 = ~a5;
+  const word64 x54 = x16 ^ a4;
+  const word64 x55 = x51 ^ x46;
+  const word64 x56 = x53 ^ x55;
+  const word64 x57 = x56 & a6;
+  const word64 x58 = x52 ^ x57;
+  const word64 x59 = x58 & a1;
+  const word64 x60 = x49 ^ x59;
+  const word64 x61 = x15 & x14;
+  const word64 x62 = x26 ^ x6;
+  const word64 x63 = x46 & x37;
+  const word64 x64 = x61 ^ x63;
+  const word64 x65 = x36 & a6;
+  const word64 x66 = x64 ^ x65;
+  const word64 x67 = x4 | ~x54;
+  const word64 x68 = a3 & ~x62;
+  const word64 x69 = x67 ^ x68;
+  const word64 x70 = x69 | ~a6;
+  const word64 x71 = x70 & a1;
+  const word64 x72 = x66 ^ x71;
+
+  out1 ^= x24;
+  out2 ^= x41;
+  out3 ^= x60;
+  out4 ^= x72;
+}
+
+// 74 gates
+static inline void sbox8(const word64 a1, const word64 a2, const word64 a3, const word64 a4, const word64 a5, const word64 a6,
+  word64& out1, word64& out2, word64& out3, word64& out4)
+{
+  const word64 x1 = ~a2;
+  const word64 x2 = x1 | ~a4;
+  const word64 x3 = a2 | ~a4;
+  const word64 x4 = x3 & a3;
+  const word64 x5 = x2 ^ x4;
+  const word64 x6 = a4 | ~a2;
+  const word64 x7 = x6 & a5;
+  const word64 x8 = x5 ^ x7;
+  const word64 x9 = x3 | ~a3;
+  const word64 x10 = a4 ^ a3;
+  const word64 x11 = x10 & a5;
+  const word64 x12 = x9 ^ x11;
+  const word64 x13 = x12 & a1;
+  const word64 x14 = x8 ^ x13;
+  const word64 x15 = x1 & ~a4;
+  const word64 x16 = a3 & ~x3;
+  const word64 x17 = x15 ^ x16;
+  const word64 x18 = a4 ^ a2;
+  const word64 x19 = x18 & a5;
+  const word64 x20 = x17 ^ x19;
+  const word64 x21 = x4 & ~a2;
+  const word64 x22 = x2 ^ x21;
+  const word64 x23 = a3 & a2;
+  const word64 x24 = x3 ^ x23;
+  const word64 x25 = x24 & a5;
+  const word64 x26 = x22 ^ x25;
+  const word64 x27 = x26 & a1;
+  const word64 x28 = x20 ^ x27;
+  const word64 x29 = x28 & a6;
+  const word64 x30 = x14 ^ x29;
+  const word64 x31 = x15 | x4;
+  const word64 x32 = x6 ^ a3;
+  const word64 x33 = x32 & a5;
+  const word64 x34 = x31 ^ x33;
+  const word64 x35 = x21 | ~x3;
+  const word64 x36 = a5 & ~x32;
+  const word64 x37 = x35 ^ x36;
+  const word64 x38 = x37 & a1;
+  const word64 x39 = x34 ^ x38;
+  const word64 x40 = x9 ^ a4;
+  const word64 x41 = a5 & ~a3;
+  const word64 x42 = x40 ^ x41;
+  const word64 x43 = x42 | ~a1;
+  const word64 x44 = x43 & a6;
+  const word64 x45 = x39 ^ x44;
+  const word64 x46 = a3 ^ a2;
+  const word64 x47 = a5 & ~x10;
+  const word64 x48 = x46 ^ x47;
+  const word64 x49 = x38 ^ x27;
+  const word64 x50 = x48 ^ x49;
+  const word64 x51 = x5 & ~x6;
+  const word64 x52 = a5 & ~x6;
+  const word64 x53 = x51 ^ x52;
+  const word64 x54 = x25 ^ a4;
+  const word64 x55 = x54 & a1;
+  const word64 x56 = x53 ^ x55;
+  const word64 x57 = x56 & a6;
+  const word64 x58 = x50 ^ x57;
+  const word64 x59 = x10 ^ x1;
+  const word64 x60 = x3 & a5;
+  const word64 x61 = x59 ^ x60;
+  const word64 x62 = x27 ^ x13;
+  const word64 x63 = x61 ^ x62;
+  const word64 x64 = x23 | ~x40;
+  const word64 x65 = x51 ^ x22;
+  const word64 x66 = x65 & a5;
+  const word64 x67 = x64 ^ x66;
+  const word64 x68 = x5 ^ a3;
+  const word64 x69 = x33 ^ x25;
+  const word64 x70 = x68 ^ x69;
+  const word64 x71 = x70 & a1;
+  const word64 x72 = x67 ^ x71;
+  const word64 x73 = x72 & a6;
+  const word64 x74 = x63 ^ x73;
+
+  out1 ^= x30;
+  out2 ^= x45;
+  out3 ^= x58;
+  out4 ^= x74;
+}
+
+static inline void desRound(word64* l, const word64* r, const word64* k)
+{
+  sbox1(r[31] ^ k[0], r[0] ^ k[1], r[1] ^ k[2], r[2] ^ k[3], r[3] ^ k[4], r[4] ^ k[5],
+    l[8], l[16], l[22], l[30]);
+  sbox2(r[3] ^ k[6], r[4] ^ k[7], r[5] ^ k[8], r[6] ^ k[9], r[7] ^ k[10], r[8] ^ k[11],
+    l[12], l[27], l[1], l[17]);
+  sbox3(r[7] ^ k[12], r[8] ^ k[13], r[9] ^ k[14], r[10] ^ k[15], r[11] ^ k[16], r[12] ^ k[17],
+    l[23], l[15], l[29], l[5]);
+  sbox4(r[11] ^ k[18], r[12] ^ k[19], r[13] ^ k[20], r[14] ^ k[21], r[15] ^ k[22], r[16] ^ k[23],
+    l[25], l[19], l[9], l[0]);
+  sbox5(r[15] ^ k[24], r[16] ^ k[25], r[17] ^ k[26], r[18] ^ k[27], r[19] ^ k[28], r[20] ^ k[29],
+    l[7], l[13], l[24], l[2]);
+  sbox6(r[19] ^ k[30], r[20] ^ k[31], r[21] ^ k[32], r[22] ^ k[33], r[23] ^ k[34], r[24] ^ k[35],
+    l[3], l[28], l[10], l[18]);
+  sbox7(r[23] ^ k[36], r[24] ^ k[37], r[25] ^ k[38], r[26] ^ k[39], r[27] ^ k[40], r[28] ^ k[41],
+    l[31], l[11], l[21], l[6]);
+  sbox8(r[27] ^ k[42], r[28] ^ k[43], r[29] ^ k[44], r[30] ^ k[45], r[31] ^ k[46], r[0] ^ k[47],
+    l[4], l[26], l[14], l[20]);
+}
+
+#endif
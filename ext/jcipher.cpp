@@ -6,11 +6,13 @@
  */
 
 #include "jcipher.h"
+#include "jkeyschedulecache.h"
 
 JCipher::JCipher()
 {
   itsMode = ECB_MODE;
   itsPadding = ZEROS_PADDING;
+  itsFastPath = NULL;
 }
 
 string JCipher::getModeName() const
@@ -47,6 +49,7 @@ void JCipher::setMode(const enum ModeEnum mode)
 {
   itsMode = mode;
   itsPadding = DEFAULT_PADDING;
+  itsFastPath = getFastPath(getCipherType(), mode);
 }
 
 string JCipher::getPaddingName() const
@@ -110,3 +113,116 @@ unsigned int JCipher::setRounds(const unsigned int rounds)
 
   return itsRounds;
 }
+
+StreamTransformation* JCipher::getModeObject(BlockCipher& blockCipher, const enum ModeEnum mode, const bool encryption, const string& iv)
+{
+  const byte* ivData = (const byte*) iv.data();
+
+  if (encryption) {
+    switch (mode) {
+      case ECB_MODE:
+        return new ECB_Mode_ExternalCipher::Encryption(blockCipher, ivData);
+
+      case CBC_MODE:
+        return new CBC_Mode_ExternalCipher::Encryption(blockCipher, ivData);
+
+      case CBC_CTS_MODE:
+        return new CBC_CTS_Mode_ExternalCipher::Encryption(blockCipher, ivData);
+
+      case CFB_MODE:
+        return new CFB_Mode_ExternalCipher::Encryption(blockCipher, ivData);
+
+      case CTR_MODE:
+        return new CTR_Mode_ExternalCipher::Encryption(blockCipher, ivData);
+
+      case OFB_MODE:
+        return new OFB_Mode_ExternalCipher::Encryption(blockCipher, ivData);
+
+      default:
+        break;
+    }
+  }
+  else {
+    switch (mode) {
+      case ECB_MODE:
+        return new ECB_Mode_ExternalCipher::Decryption(blockCipher);
+
+      case CBC_MODE:
+        return new CBC_Mode_ExternalCipher::Decryption(blockCipher, ivData);
+
+      case CBC_CTS_MODE:
+        return new CBC_CTS_Mode_ExternalCipher::Decryption(blockCipher, ivData);
+
+      case CFB_MODE:
+        return new CFB_Mode_ExternalCipher::Decryption(blockCipher, ivData);
+
+      case CTR_MODE:
+        return new CTR_Mode_ExternalCipher::Decryption(blockCipher, ivData);
+
+      case OFB_MODE:
+        return new OFB_Mode_ExternalCipher::Decryption(blockCipher, ivData);
+
+      default:
+        break;
+    }
+  }
+
+  return NULL;
+}
+
+bool JCipher::usesInverseCipher(const enum ModeEnum mode)
+{
+  switch (mode) {
+    case ECB_MODE:
+    case CBC_MODE:
+    case CBC_CTS_MODE:
+      return true;
+
+    default:
+      return false;
+  }
+}
+
+BlockCipher* JCipher::getKeySchedule(const bool encryption)
+{
+  JKeyScheduleCache& cache = JKeyScheduleCache::getInstance();
+
+  if (!cache.isEnabled()) {
+    return createKeySchedule(encryption);
+  }
+
+  string id = JKeyScheduleCache::getID(getCipherType(), encryption, itsRounds, getKeyScheduleParameter(), itsKey);
+  BlockCipher* retval = cache.get(id);
+
+  if (retval == NULL) {
+    retval = createKeySchedule(encryption);
+    try {
+      cache.put(id, *retval);
+    }
+    catch (...) {
+      delete retval;
+      throw;
+    }
+  }
+
+  return retval;
+}
+
+unsigned int JCipher::getKeyScheduleParameter() const
+{
+  return 0;
+}
+
+bool JCipher::usesFastPath() const
+{
+  return true;
+}
+
+StreamTransformation* JCipher::getFastModeObject(const bool encryption)
+{
+  if (itsFastPath == NULL || !usesFastPath() || JKeyScheduleCache::getInstance().isEnabled()) {
+    return NULL;
+  }
+
+  return itsFastPath((const byte*) itsKey.data(), itsKeylength, (const byte*) itsIV.data(), encryption);
+}
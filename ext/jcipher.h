@@ -14,6 +14,10 @@
 
 #include "modes.h"
 
+// Creates a mode object keyed with its own cipher for one of the cipher and
+// mode pairs in defs/fast_paths.def. The caller owns it.
+typedef StreamTransformation* (*JFastPath)(const byte* key, const size_t keylength, const byte* iv, const bool encryption);
+
 class JCipher : public JBase
 {
   public:
@@ -33,10 +37,47 @@ class JCipher : public JBase
     unsigned int setRounds(const unsigned int rounds);
     virtual unsigned int getValidRounds(const unsigned int rounds) const = 0;
 
+    // Creates a block cipher object keyed with the current key, for
+    // encryption or for its inverse. When the key schedule cache is enabled
+    // the schedule is copied out of it if it's there. The caller owns it.
+    BlockCipher* getKeySchedule(const bool encryption);
+
+    // Creates the mode object that runs blockCipher in mode. The mode object
+    // only refers to blockCipher, it doesn't own it. Returns NULL for an
+    // unknown mode.
+    static StreamTransformation* getModeObject(BlockCipher& blockCipher, const enum ModeEnum mode, const bool encryption, const string& iv);
+
+    // Whether decrypting in mode needs the inverse of the block cipher. The
+    // feedback and counter modes only ever use it in the forward direction.
+    static bool usesInverseCipher(const enum ModeEnum mode);
+
+    // The fast path compiled for cipher in mode, or NULL if there isn't one.
+    static JFastPath getFastPath(const enum CipherEnum cipher, const enum ModeEnum mode);
+
+    // Runs the fast path for the cipher's current mode with its key and IV.
+    // Returns NULL if there's no fast path, if the cipher doesn't use it, or
+    // if the key schedule cache is enabled, as the fast paths key their own
+    // ciphers and can't use it.
+    StreamTransformation* getFastModeObject(const bool encryption);
+
   protected:
+    // Runs the key setup for getKeySchedule.
+    virtual BlockCipher* createKeySchedule(const bool encryption) = 0;
+
+    // Anything besides the key and the rounds that goes into the key
+    // schedule, for telling cached schedules apart.
+    virtual unsigned int getKeyScheduleParameter() const;
+
+    // Whether the fast path for the mode runs the same block cipher as
+    // createKeySchedule, so it can stand in for it.
+    virtual bool usesFastPath() const;
+
     enum ModeEnum itsMode;
     enum PaddingEnum itsPadding;
     unsigned int itsRounds;
+
+    // picked by setMode...
+    JFastPath itsFastPath;
 };
 
 #endif
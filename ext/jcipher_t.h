@@ -20,11 +20,8 @@ class JCipher_Template : public JBasicCipherInfo<INFO, JCipher>
     inline enum CipherEnum getCipherType() const;
     inline unsigned int getBlockSize() const;
 
-    bool encrypt();
-    bool decrypt();
-
-    bool encryptRubyIO(VALUE* in, VALUE* out);
-    bool decryptRubyIO(VALUE* in, VALUE* out);
+    JCipherFilter* getEncryptionFilter(BufferedTransformation* attachment = NULL);
+    JCipherFilter* getDecryptionFilter(BufferedTransformation* attachment = NULL);
 
     /* These are deprecated. They were used before using RubyIO. Use them
        if you're using this code in something other than the CryptoPP Ruby
@@ -33,6 +30,8 @@ class JCipher_Template : public JBasicCipherInfo<INFO, JCipher>
 //     bool decryptFile(const string in, const string out);
 
   protected:
+    BlockCipher* createKeySchedule(const bool encryption);
+
     virtual BlockCipher* getEncryptionObject() = 0;
     virtual BlockCipher* getDecryptionObject() = 0;
 };
@@ -42,6 +41,7 @@ JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::JCipher_Te
 {
   this->itsKeylength = INFO::DEFAULT_KEYLENGTH;
   this->itsRounds = DEFAULT_ROUNDS;
+  this->itsFastPath = JCipher::getFastPath(TYPE, this->itsMode);
 }
 
 template <typename INFO, enum CipherEnum TYPE, unsigned int DEFAULT_ROUNDS, unsigned int MIN_ROUNDS, unsigned int MAX_ROUNDS>
@@ -63,263 +63,63 @@ unsigned int JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS
 }
 
 template <typename INFO, enum CipherEnum TYPE, unsigned int DEFAULT_ROUNDS, unsigned int MIN_ROUNDS, unsigned int MAX_ROUNDS>
-bool JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::encrypt()
+BlockCipher* JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::createKeySchedule(const bool encryption)
 {
-  BlockCipher* bc = NULL;
-  CipherModeBase* cipher = NULL;
-
-  bc = getEncryptionObject();
-
-  if (bc != NULL) {
-    switch (this->itsMode) {
-      case ECB_MODE:
-        cipher = new ECB_Mode_ExternalCipher::Encryption(*bc, (const byte*) this->itsIV.data());
-      break;
-
-      case CBC_MODE:
-        cipher = new CBC_Mode_ExternalCipher::Encryption(*bc, (const byte*) this->itsIV.data());
-      break;
-
-      case CBC_CTS_MODE:
-        cipher = new CBC_CTS_Mode_ExternalCipher::Encryption(*bc, (const byte*) this->itsIV.data());
-      break;
-
-      case CFB_MODE:
-        cipher = new CFB_Mode_ExternalCipher::Encryption(*bc, (const byte*) this->itsIV.data());
-      break;
-
-      case CTR_MODE:
-        cipher = new CTR_Mode_ExternalCipher::Encryption(*bc, (const byte*) this->itsIV.data());
-      break;
-
-      case OFB_MODE:
-        cipher = new OFB_Mode_ExternalCipher::Encryption(*bc, (const byte*) this->itsIV.data());
-      break;
-
-      default:
-        return false;
-    }
-
-    this->itsCiphertext.erase();
-    StringSource(this->itsPlaintext, true, new StreamTransformationFilter(*cipher, new StringSink(this->itsCiphertext), (StreamTransformationFilter::BlockPaddingScheme) this->itsPadding));
-
-    delete bc;
-  }
-  else {
-    return false;
-  }
-
-  if (cipher != NULL) {
-    delete cipher;
-  }
-
-  return true;
+  return encryption ? getEncryptionObject() : getDecryptionObject();
 }
 
 template <typename INFO, enum CipherEnum TYPE, unsigned int DEFAULT_ROUNDS, unsigned int MIN_ROUNDS, unsigned int MAX_ROUNDS>
-bool JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::decrypt()
+JCipherFilter* JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::getEncryptionFilter(BufferedTransformation* attachment)
 {
-  BlockCipher* bc = NULL;
-  CipherModeBase* cipher = NULL;
+  StreamTransformation* fast = this->getFastModeObject(true);
 
-  switch (this->itsMode) {
-    case ECB_MODE:
-    case CBC_MODE:
-    case CBC_CTS_MODE:
-      bc = getDecryptionObject();
-    break;
-
-    case CFB_MODE:
-    case CTR_MODE:
-    case OFB_MODE:
-      bc = getEncryptionObject();
-    break;
-
-    default:
-      return false;
+  if (fast != NULL) {
+    return new JCipherFilter(fast, NULL, attachment, (StreamTransformationFilter::BlockPaddingScheme) this->itsPadding);
   }
 
-  if (bc != NULL) {
-    switch (this->itsMode) {
-      case ECB_MODE:
-        cipher = new ECB_Mode_ExternalCipher::Decryption(*bc);
-      break;
-
-      case CBC_MODE:
-        cipher = new CBC_Mode_ExternalCipher::Decryption(*bc, (const byte*) this->itsIV.data());
-      break;
-
-      case CBC_CTS_MODE:
-        cipher = new CBC_CTS_Mode_ExternalCipher::Decryption(*bc, (const byte*) this->itsIV.data());
-      break;
-
-      case CFB_MODE:
-        cipher = new CFB_Mode_ExternalCipher::Decryption(*bc, (const byte*) this->itsIV.data());
-      break;
-
-      case CTR_MODE:
-        cipher = new CTR_Mode_ExternalCipher::Decryption(*bc, (const byte*) this->itsIV.data());
-      break;
-
-      case OFB_MODE:
-        cipher = new OFB_Mode_ExternalCipher::Decryption(*bc, (const byte*) this->itsIV.data());
-      break;
-
-      default:
-        return false;
-    }
-
-    this->itsPlaintext.erase();
-    StringSource(this->itsCiphertext, true, new StreamTransformationFilter(*cipher, new StringSink(this->itsPlaintext), (StreamTransformationFilter::BlockPaddingScheme) this->itsPadding));
+  BlockCipher* bc = this->getKeySchedule(true);
 
-    delete bc;
-  }
-  else {
-    return false;
+  if (bc == NULL) {
+    return NULL;
   }
 
-  if (cipher != NULL) {
-    delete cipher;
-  }
-
-  return true;
-}
-
-template <typename INFO, enum CipherEnum TYPE, unsigned int DEFAULT_ROUNDS, unsigned int MIN_ROUNDS, unsigned int MAX_ROUNDS>
-bool JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::encryptRubyIO(VALUE* in, VALUE* out)
-{
-  BlockCipher* bc = NULL;
-  CipherModeBase* cipher = NULL;
-
-  bc = getEncryptionObject();
-
-  if (bc != NULL) {
-    switch (this->itsMode) {
-      case ECB_MODE:
-        cipher = new ECB_Mode_ExternalCipher::Encryption(*bc, (const byte*) this->itsIV.data());
-      break;
-
-      case CBC_MODE:
-        cipher = new CBC_Mode_ExternalCipher::Encryption(*bc, (const byte*) this->itsIV.data());
-      break;
-
-      case CBC_CTS_MODE:
-        cipher = new CBC_CTS_Mode_ExternalCipher::Encryption(*bc, (const byte*) this->itsIV.data());
-      break;
-
-      case CFB_MODE:
-        cipher = new CFB_Mode_ExternalCipher::Encryption(*bc, (const byte*) this->itsIV.data());
-      break;
-
-      case CTR_MODE:
-        cipher = new CTR_Mode_ExternalCipher::Encryption(*bc, (const byte*) this->itsIV.data());
-      break;
-
-      case OFB_MODE:
-        cipher = new OFB_Mode_ExternalCipher::Encryption(*bc, (const byte*) this->itsIV.data());
-      break;
-
-      default:
-        return false;
-    }
-
-    try {
-      RubyIOSource(&in, true, new StreamTransformationFilter(*cipher, new RubyIOSink(&out), (StreamTransformationFilter::BlockPaddingScheme) this->itsPadding));
-    }
-    catch (RubyIOStore::OpenErr e) {
-      delete bc;
-      if (cipher != NULL)
-        delete cipher;
-      throw e;
-    }
+  StreamTransformation* cipher = JCipher::getModeObject(*bc, this->itsMode, true, this->itsIV);
 
+  if (cipher == NULL) {
     delete bc;
-  }
-  else {
-    return false;
+    return NULL;
   }
 
-  if (cipher != NULL) {
-    delete cipher;
-  }
-
-  return true;
+  return new JCipherFilter(cipher, bc, attachment, (StreamTransformationFilter::BlockPaddingScheme) this->itsPadding);
 }
 
 template <typename INFO, enum CipherEnum TYPE, unsigned int DEFAULT_ROUNDS, unsigned int MIN_ROUNDS, unsigned int MAX_ROUNDS>
-bool JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::decryptRubyIO(VALUE* in, VALUE* out)
+JCipherFilter* JCipher_Template<INFO, TYPE, DEFAULT_ROUNDS, MIN_ROUNDS, MAX_ROUNDS>::getDecryptionFilter(BufferedTransformation* attachment)
 {
-  BlockCipher* bc = NULL;
-  CipherModeBase* cipher = NULL;
-
-  switch (this->itsMode) {
-    case ECB_MODE:
-    case CBC_MODE:
-    case CBC_CTS_MODE:
-      bc = getDecryptionObject();
-    break;
-
-    case CFB_MODE:
-    case CTR_MODE:
-    case OFB_MODE:
-      bc = getEncryptionObject();
-    break;
-
-    default:
-      return false;
+  if (!VALID_MODE(this->itsMode)) {
+    return NULL;
   }
 
-  if (bc != NULL) {
-    switch (this->itsMode) {
-      case ECB_MODE:
-        cipher = new ECB_Mode_ExternalCipher::Decryption(*bc);
-      break;
-
-      case CBC_MODE:
-        cipher = new CBC_Mode_ExternalCipher::Decryption(*bc, (const byte*) this->itsIV.data());
-      break;
-
-      case CBC_CTS_MODE:
-        cipher = new CBC_CTS_Mode_ExternalCipher::Decryption(*bc, (const byte*) this->itsIV.data());
-      break;
-
-      case CFB_MODE:
-        cipher = new CFB_Mode_ExternalCipher::Decryption(*bc, (const byte*) this->itsIV.data());
-      break;
+  StreamTransformation* fast = this->getFastModeObject(false);
 
-      case CTR_MODE:
-        cipher = new CTR_Mode_ExternalCipher::Decryption(*bc, (const byte*) this->itsIV.data());
-      break;
+  if (fast != NULL) {
+    return new JCipherFilter(fast, NULL, attachment, (StreamTransformationFilter::BlockPaddingScheme) this->itsPadding);
+  }
 
-      case OFB_MODE:
-        cipher = new OFB_Mode_ExternalCipher::Decryption(*bc, (const byte*) this->itsIV.data());
-      break;
+  BlockCipher* bc = this->getKeySchedule(!JCipher::usesInverseCipher(this->itsMode));
 
-      default:
-        return false;
-    }
+  if (bc == NULL) {
+    return NULL;
+  }
 
-    try {
-      RubyIOSource(&in, true, new StreamTransformationFilter(*cipher, new RubyIOSink(&out), (StreamTransformationFilter::BlockPaddingScheme) this->itsPadding));
-    }
-    catch (RubyIOStore::OpenErr e) {
-      delete bc;
-      if (cipher != NULL)
-        delete cipher;
-      throw e;
-    }
+  StreamTransformation* cipher = JCipher::getModeObject(*bc, this->itsMode, false, this->itsIV);
 
+  if (cipher == NULL) {
     delete bc;
-  }
-  else {
-    return false;
-  }
-
-  if (cipher != NULL) {
-    delete cipher;
+    return NULL;
   }
 
-  return true;
+  return new JCipherFilter(cipher, bc, attachment, (StreamTransformationFilter::BlockPaddingScheme) this->itsPadding);
 }
 
 /* These are deprecated. They were used before using RubyIO. Use them
@@ -0,0 +1,93 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#include "jcipherspec.h"
+#include "jexception.h"
+
+JCipherSpec::JCipherSpec(JCipher* cipher)
+{
+  if (!VALID_MODE(cipher->getMode())) {
+    throw JException("invalid cipher mode");
+  }
+
+  itsCipher = cipher;
+  itsMode = cipher->getMode();
+  itsPadding = cipher->getPadding();
+  itsEncryption = cipher->getKeySchedule(true);
+  itsDecryption = NULL;
+
+  if (JCipher::usesInverseCipher(itsMode)) {
+    try {
+      itsDecryption = cipher->getKeySchedule(false);
+    }
+    catch (...) {
+      delete itsEncryption;
+      throw;
+    }
+  }
+}
+
+JCipherSpec::~JCipherSpec()
+{
+  delete itsEncryption;
+  delete itsDecryption;
+  delete itsCipher;
+}
+
+const JCipher* JCipherSpec::getCipher() const
+{
+  return itsCipher;
+}
+
+JCipherFilter* JCipherSpec::getFilter(const bool encryption, const string& iv) const
+{
+  // the modes read a whole block of IV...
+  if (itsMode != ECB_MODE && iv.length() < itsCipher->getBlockSize()) {
+    throw JException("the IV is shorter than the cipher's block size");
+  }
+
+  const BlockCipher* keySchedule = (encryption || itsDecryption == NULL) ? itsEncryption : itsDecryption;
+  BlockCipher* bc = static_cast<BlockCipher*>(keySchedule->Clone());
+  StreamTransformation* cipher = NULL;
+
+  try {
+    cipher = JCipher::getModeObject(*bc, itsMode, encryption, iv);
+  }
+  catch (...) {
+    delete bc;
+    throw;
+  }
+
+  if (cipher == NULL) {
+    delete bc;
+    throw JException("invalid cipher mode");
+  }
+
+  return new JCipherFilter(cipher, bc, NULL, (StreamTransformationFilter::BlockPaddingScheme) itsPadding);
+}
+
+string JCipherSpec::encrypt(const string& plaintext, const string& iv, CompressionEnum compression) const
+{
+  string retval;
+  JCipherFilter* filter = getFilter(true, iv);
+
+  filter->Attach(new StringSink(retval));
+  StringSource(plaintext, true, compressor(compression, filter));
+
+  return retval;
+}
+
+string JCipherSpec::decrypt(const string& ciphertext, const string& iv, CompressionEnum compression) const
+{
+  string retval;
+  JCipherFilter* filter = getFilter(false, iv);
+
+  filter->Attach(decompressor(compression, new StringSink(retval)));
+  StringSource(ciphertext, true, filter);
+
+  return retval;
+}
@@ -0,0 +1,60 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#ifndef __JCIPHERSPEC_H__
+#define __JCIPHERSPEC_H__
+
+#include <string>
+
+#include "jcipher.h"
+
+/* A block cipher's algorithm, key schedule, mode and padding, fixed once
+ * they've been set up so they can be shared between threads. The key is
+ * expanded once, when the spec is created. Everything that changes from
+ * message to message, the IV and the buffers, is passed in or kept on the
+ * stack, so the spec itself is never written to after construction.
+ *
+ * Crypto++ block ciphers may keep scratch space inside the keyed object, so
+ * each call works on its own copy of the key schedule. Copying it is a
+ * memcpy rather than a rerun of the key setup, which matters for ciphers
+ * like Blowfish and Twofish with expensive key setup.
+ *
+ * Usage:
+ *
+ *   JCipherSpec spec(cipher);
+ *   string ciphertext = spec.encrypt(plaintext, iv);
+ */
+class JCipherSpec
+{
+  public:
+    // Keys the spec from cipher's key, mode and padding. The spec takes
+    // ownership of cipher once it has been constructed; if the constructor
+    // throws, cipher still belongs to the caller.
+    JCipherSpec(JCipher* cipher);
+    ~JCipherSpec();
+
+    string encrypt(const string& plaintext, const string& iv, CompressionEnum compression = NO_COMPRESSION) const;
+    string decrypt(const string& ciphertext, const string& iv, CompressionEnum compression = NO_COMPRESSION) const;
+
+    const JCipher* getCipher() const;
+
+  private:
+    JCipherSpec(const JCipherSpec&);
+    JCipherSpec& operator=(const JCipherSpec&);
+
+    // A filter running a copy of the key schedule with iv. The caller owns
+    // the filter, which owns the copy.
+    JCipherFilter* getFilter(const bool encryption, const string& iv) const;
+
+    JCipher* itsCipher;
+    enum ModeEnum itsMode;
+    enum PaddingEnum itsPadding;
+    BlockCipher* itsEncryption;
+    BlockCipher* itsDecryption;
+};
+
+#endif
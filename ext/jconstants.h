@@ -95,6 +95,17 @@ enum PaddingEnum {
 #define VALID_PADDING(x) (x > UNKNOWN_PADDING && x <= DEFAULT_PADDING)
 
 
+// Compression run in front of the cipher, and decompression after it...
+
+enum CompressionEnum {
+  UNKNOWN_COMPRESSION = -1,
+  NO_COMPRESSION,
+#  define COMPRESSION_X(c, s) \
+    c ## _COMPRESSION,
+#  include "defs/compressions.def"
+};
+
+
 // Hashes... and HMAC stuff, too...
 
 enum HashEnum {
@@ -174,7 +185,7 @@ enum RNGEnum {
 #  include "defs/rngs.def"
 };
 
-#define VALID_RNG(x) (x > UNKNOWN_RNG && x <= RAND_RNG)
+#define VALID_RNG(x) (x > UNKNOWN_RNG && x <= RDSEED_RNG)
 
 #ifdef NONBLOCKING_RNG_AVAILABLE
   #define DEFAULT_RNG NON_BLOCKING_RNG
@@ -9,14 +9,16 @@
 
 #if ENABLED_DES_CIPHER
 
+#include "jbitsliceddes.h"
+
 BlockCipher* JDES::getEncryptionObject()
 {
-  return new DESEncryption((byte*) itsKey.data(), itsKeylength);
+  return new BitslicedDES::Encryption((byte*) itsKey.data(), itsKeylength);
 }
 
 BlockCipher* JDES::getDecryptionObject()
 {
-  return new DESDecryption((byte*) itsKey.data(), itsKeylength);
+  return new BitslicedDES::Decryption((byte*) itsKey.data(), itsKeylength);
 }
 
 #endif
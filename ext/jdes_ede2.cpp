@@ -9,14 +9,16 @@
 
 #if ENABLED_DES_EDE2_CIPHER
 
+#include "jbitsliceddes.h"
+
 BlockCipher* JDES_EDE2::getEncryptionObject()
 {
-  return new DES_EDE2_Encryption((byte*) itsKey.data(), itsKeylength);
+  return new BitslicedDES_EDE2::Encryption((byte*) itsKey.data(), itsKeylength);
 }
 
 BlockCipher* JDES_EDE2::getDecryptionObject()
 {
-  return new DES_EDE2_Decryption((byte*) itsKey.data(), itsKeylength);
+  return new BitslicedDES_EDE2::Decryption((byte*) itsKey.data(), itsKeylength);
 }
 
 #endif
@@ -9,14 +9,16 @@
 
 #if ENABLED_DES_EDE3_CIPHER
 
+#include "jbitsliceddes.h"
+
 BlockCipher* JDES_EDE3::getEncryptionObject()
 {
-  return new DES_EDE3_Encryption((byte*) itsKey.data(), itsKeylength);
+  return new BitslicedDES_EDE3::Encryption((byte*) itsKey.data(), itsKeylength);
 }
 
 BlockCipher* JDES_EDE3::getDecryptionObject()
 {
-  return new DES_EDE3_Decryption((byte*) itsKey.data(), itsKeylength);
+  return new BitslicedDES_EDE3::Decryption((byte*) itsKey.data(), itsKeylength);
 }
 
 #endif
@@ -0,0 +1,62 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#include "jcipher.h"
+#include "jconfig.h"
+
+// Crypto++ headers...
+
+#include "aes.h"
+
+/* Builds a mode object with its own cipher, e.g. CTR_Mode<AES>::Encryption,
+ * rather than an ExternalCipher mode that calls into a BlockCipher through a
+ * reference. With the concrete types the compiler can inline the block
+ * function into the mode's loop, and the mode gets at the cipher's multi-
+ * block AdvancedProcessBlocks without going through a virtual call. */
+template <class MODE>
+static StreamTransformation* fastPath(const byte* key, const size_t keylength, const byte* iv)
+{
+  MODE* retval = new MODE;
+
+  try {
+    if (retval->IsResynchronizable()) {
+      retval->SetKeyWithIV(key, keylength, iv);
+    }
+    else {
+      retval->SetKey(key, keylength);
+    }
+  }
+  catch (...) {
+    delete retval;
+    throw;
+  }
+
+  return retval;
+}
+
+#define FAST_PATH_X(c, m, klass, mode) \
+  static StreamTransformation* fastPath_ ## c ## _ ## m(const byte* key, const size_t keylength, const byte* iv, const bool encryption) \
+  { \
+    if (encryption) { \
+      return fastPath<mode<klass>::Encryption>(key, keylength, iv); \
+    } \
+    else { \
+      return fastPath<mode<klass>::Decryption>(key, keylength, iv); \
+    } \
+  }
+#include "defs/fast_paths.def"
+
+JFastPath JCipher::getFastPath(const enum CipherEnum cipher, const enum ModeEnum mode)
+{
+#define FAST_PATH_X(c, m, klass, mode_klass) \
+  if (cipher == c ## _CIPHER && mode == m ## _MODE) { \
+    return fastPath_ ## c ## _ ## m; \
+  }
+#include "defs/fast_paths.def"
+
+  return NULL;
+}
@@ -0,0 +1,676 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#include "jfilecrypter.h"
+#include "jgvl.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_SYS_MMAN_H
+#  include <sys/mman.h>
+#endif
+
+#ifndef O_CLOEXEC
+#  define O_CLOEXEC 0
+#endif
+
+/* Offsets of -1 are for files without a position, which are read and written
+ * in order. io_uring takes -1 to mean the same thing. */
+static ssize_t readAt(int fd, void* buffer, size_t length, off_t offset)
+{
+  return offset < 0 ? read(fd, buffer, length) : pread(fd, buffer, length, offset);
+}
+
+static ssize_t writeAt(int fd, const void* buffer, size_t length, off_t offset)
+{
+  return offset < 0 ? write(fd, buffer, length) : pwrite(fd, buffer, length, offset);
+}
+
+static void advance(off_t& offset, size_t length)
+{
+  if (offset >= 0) {
+    offset += length;
+  }
+}
+
+static VALUE checkInterrupts(VALUE data)
+{
+  rb_thread_check_ints();
+  return Qnil;
+}
+
+JFileCrypter::JFileCrypter(size_t bufferSize, unsigned int threads, unsigned int depth, bool mapped) :
+  m_next(0), m_bufferSize(bufferSize), m_threads(threads), m_depth(depth), m_mapped(mapped), m_cancelled(false), m_ran(false)
+{
+  if (m_threads == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    m_threads = cpus > 0 ? (unsigned int) cpus : 1;
+  }
+
+  if (m_depth == 0) {
+    m_depth = JFILECRYPTER_DEFAULT_DEPTH;
+  }
+
+#ifdef HAVE_PTHREAD_H
+  pthread_mutex_init(&m_mutex, NULL);
+#endif
+}
+
+JFileCrypter::~JFileCrypter()
+{
+  for (std::vector<Job>::iterator i = m_jobs.begin(); i != m_jobs.end(); ++i) {
+    delete i->filter;
+  }
+
+#ifdef HAVE_PTHREAD_H
+  pthread_mutex_destroy(&m_mutex);
+#endif
+}
+
+void JFileCrypter::Add(const std::string& in, const std::string& out, BufferedTransformation* filter)
+{
+  Job job;
+  job.in = in;
+  job.out = out;
+  job.filter = filter;
+  m_jobs.push_back(job);
+}
+
+int JFileCrypter::Run()
+{
+  int state = 0;
+
+  if (m_jobs.empty()) {
+    return 0;
+  }
+
+  while (!m_ran) {
+#ifdef HAVE_RB_THREAD_CALL_WITHOUT_GVL2
+    callWithoutGVLInterruptibly(RunWithoutGVL, this, Cancel, this);
+#else
+    callWithoutGVL(RunWithoutGVL, this, Cancel, this);
+#endif
+
+    // rb_thread_call_without_gvl2 doesn't call us at all if an interrupt,
+    // even just the thread switch timer, is already pending. Deal with it
+    // and go again unless it raised...
+    if (!m_ran) {
+      rb_protect(checkInterrupts, Qnil, &state);
+      if (state != 0) {
+        break;
+      }
+      m_cancelled = false;
+    }
+  }
+
+  // nothing was written for the files we never got to, but they can't be
+  // allowed to pass for done...
+  for (size_t i = m_next; i < m_jobs.size(); ++i) {
+    m_jobs[i].error = "cancelled";
+  }
+
+  return state;
+}
+
+void* JFileCrypter::RunWithoutGVL(void* data)
+{
+  JFileCrypter* crypter = static_cast<JFileCrypter*>(data);
+
+  crypter->m_ran = true;
+
+#ifdef HAVE_PTHREAD_H
+  std::vector<pthread_t> threads;
+  unsigned int count = crypter->m_threads;
+
+  if (count > crypter->m_jobs.size()) {
+    count = crypter->m_jobs.size();
+  }
+
+  // the calling thread makes up the last worker of the pool...
+  for (unsigned int i = 1; i < count; ++i) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, Worker, crypter) == 0) {
+      threads.push_back(thread);
+    }
+  }
+
+  crypter->Work();
+
+  for (std::vector<pthread_t>::iterator i = threads.begin(); i != threads.end(); ++i) {
+    pthread_join(*i, NULL);
+  }
+#else
+  crypter->Work();
+#endif
+
+  return NULL;
+}
+
+void* JFileCrypter::Worker(void* data)
+{
+  static_cast<JFileCrypter*>(data)->Work();
+  return NULL;
+}
+
+void JFileCrypter::Cancel(void* data)
+{
+  static_cast<JFileCrypter*>(data)->m_cancelled = true;
+}
+
+bool JFileCrypter::Cancelled()
+{
+  return m_cancelled;
+}
+
+JFileCrypter::Job* JFileCrypter::NextJob()
+{
+  Job* job = NULL;
+
+#ifdef HAVE_PTHREAD_H
+  pthread_mutex_lock(&m_mutex);
+#endif
+
+  if (!Cancelled() && m_next < m_jobs.size()) {
+    job = &m_jobs[m_next++];
+  }
+
+#ifdef HAVE_PTHREAD_H
+  pthread_mutex_unlock(&m_mutex);
+#endif
+
+  return job;
+}
+
+void JFileCrypter::Work()
+{
+#ifdef HAVE_LIBURING
+  if (!m_mapped && WorkWithRing()) {
+    return;
+  }
+#endif
+  WorkWithPread();
+}
+
+void JFileCrypter::WorkWithPread()
+{
+  Slot slot;
+  Job* job;
+
+  AllocateBuffers(slot);
+
+  while ((job = NextJob()) != NULL) {
+    if (!Start(slot, job)) {
+      continue;
+    }
+
+#ifdef HAVE_SYS_MMAN_H
+    if (m_mapped && TransformMapped(slot)) {
+      Finish(slot);
+      continue;
+    }
+#endif
+
+    while (!slot.eof) {
+      if (Cancelled()) {
+        Fail(slot, "cancelled");
+        break;
+      }
+
+      ssize_t length = readAt(slot.in, slot.input.begin(), slot.input.size(), slot.inOffset);
+
+      if (length < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        Fail(slot, "error reading " + job->in, errno);
+        break;
+      }
+
+      advance(slot.inOffset, length);
+
+      if (!Transform(slot, length) || !WriteOutput(slot)) {
+        break;
+      }
+    }
+
+    Finish(slot);
+  }
+}
+
+#ifdef HAVE_LIBURING
+bool JFileCrypter::WorkWithRing()
+{
+  struct io_uring ring;
+
+  if (io_uring_queue_init(m_depth, &ring, 0) < 0) {
+    return false;
+  }
+
+  std::vector<Slot> slots(m_depth);
+  std::vector<struct iovec> buffers;
+
+  for (std::vector<Slot>::iterator i = slots.begin(); i != slots.end(); ++i) {
+    struct iovec input, output;
+
+    AllocateBuffers(*i);
+    input.iov_base = i->input.begin();
+    input.iov_len = i->input.size();
+    output.iov_base = i->output.begin();
+    output.iov_len = i->output.size();
+    buffers.push_back(input);
+    buffers.push_back(output);
+  }
+
+  // registering the buffers saves the kernel mapping them for every read
+  // and write, but it counts against RLIMIT_MEMLOCK so it can fail, in
+  // which case plain reads and writes do the job...
+  bool registered = io_uring_register_buffers(&ring, &buffers[0], buffers.size()) == 0;
+  unsigned int active = 0;
+
+  if (registered) {
+    for (unsigned int i = 0; i < slots.size(); ++i) {
+      slots[i].buffer = i * 2;
+    }
+  }
+
+  for (;;) {
+    for (unsigned int i = 0; i < slots.size(); ++i) {
+      Slot& slot = slots[i];
+
+      if (slot.job != NULL) {
+        continue;
+      }
+
+      Job* job = NextJob();
+
+      if (job == NULL) {
+        break;
+      }
+
+      if (Start(slot, job)) {
+        Submit(&ring, slot);
+        ++active;
+      }
+    }
+
+    if (active == 0) {
+      break;
+    }
+
+    struct io_uring_cqe* cqe;
+    int error = io_uring_submit(&ring);
+
+    if (error >= 0) {
+      error = io_uring_wait_cqe(&ring, &cqe);
+    }
+
+    if (error == -EINTR) {
+      continue;
+    }
+    else if (error < 0) {
+      // the ring is broken, so the files in it can't be finished...
+      for (std::vector<Slot>::iterator i = slots.begin(); i != slots.end(); ++i) {
+        if (i->job != NULL) {
+          Fail(*i, "io_uring failure", -error);
+          Finish(*i);
+        }
+      }
+      break;
+    }
+
+    Slot* slot = static_cast<Slot*>(io_uring_cqe_get_data(cqe));
+    int result = cqe->res;
+
+    io_uring_cqe_seen(&ring, cqe);
+
+    if (!Complete(&ring, *slot, result)) {
+      Finish(*slot);
+      --active;
+    }
+  }
+
+  if (registered) {
+    io_uring_unregister_buffers(&ring);
+  }
+  io_uring_queue_exit(&ring);
+
+  return true;
+}
+
+/* Handles the result of a slot's read or write. Returns false once the slot's
+ * file is done with, whether it succeeded or not. */
+bool JFileCrypter::Complete(struct io_uring* ring, Slot& slot, int result)
+{
+  if (result == -EINTR || result == -EAGAIN) {
+    Submit(ring, slot);
+    return true;
+  }
+  else if (result < 0) {
+    Fail(slot, (slot.writing ? "error writing " + slot.job->out : "error reading " + slot.job->in), -result);
+    return false;
+  }
+
+  if (slot.writing) {
+    slot.written += result;
+    advance(slot.outOffset, result);
+
+    if (slot.written < slot.outputLength) {
+      Submit(ring, slot);
+      return true;
+    }
+
+    slot.outputLength = 0;
+    slot.written = 0;
+  }
+  else {
+    advance(slot.inOffset, result);
+
+    if (!Transform(slot, result)) {
+      return false;
+    }
+  }
+
+  return Next(ring, slot);
+}
+
+/* Moves a slot on to its next read or write. Returns false if there's
+ * nothing left to do. */
+bool JFileCrypter::Next(struct io_uring* ring, Slot& slot)
+{
+  if (slot.outputLength == 0 && slot.eof) {
+    return false;
+  }
+  else if (Cancelled()) {
+    Fail(slot, "cancelled");
+    return false;
+  }
+
+  Submit(ring, slot);
+  return true;
+}
+
+/* Queues a slot's next read, or the rest of its output if it has any. */
+void JFileCrypter::Submit(struct io_uring* ring, Slot& slot)
+{
+  struct io_uring_sqe* sqe = io_uring_get_sqe(ring);
+
+  slot.writing = slot.outputLength > 0;
+
+  if (slot.writing && slot.buffer >= 0) {
+    io_uring_prep_write_fixed(sqe, slot.out, slot.output.begin() + slot.written, slot.outputLength - slot.written, slot.outOffset, slot.buffer + 1);
+  }
+  else if (slot.writing) {
+    io_uring_prep_write(sqe, slot.out, slot.output.begin() + slot.written, slot.outputLength - slot.written, slot.outOffset);
+  }
+  else if (slot.buffer >= 0) {
+    io_uring_prep_read_fixed(sqe, slot.in, slot.input.begin(), slot.input.size(), slot.inOffset, slot.buffer);
+  }
+  else {
+    io_uring_prep_read(sqe, slot.in, slot.input.begin(), slot.input.size(), slot.inOffset);
+  }
+
+  io_uring_sqe_set_data(sqe, &slot);
+}
+#endif
+
+#ifdef HAVE_SYS_MMAN_H
+/* Maps the input, sizes the output for the most the filter could produce and
+ * maps that too, then runs the whole file through in one go and trims the
+ * output to what was actually written. Returns false, with the output left
+ * empty, if either file can't be mapped, e.g. because it's a pipe. */
+bool JFileCrypter::TransformMapped(Slot& slot)
+{
+  struct stat st;
+
+  if (fstat(slot.in, &st) != 0 || !S_ISREG(st.st_mode)) {
+    return false;
+  }
+
+  size_t length = st.st_size;
+  size_t capacity = length + JFILECRYPTER_OUTPUT_SLACK;
+  void* input = NULL;
+  void* output;
+
+  // mmap won't map an empty file...
+  if (length > 0) {
+    input = mmap(NULL, length, PROT_READ, MAP_PRIVATE, slot.in, 0);
+    if (input == MAP_FAILED) {
+      return false;
+    }
+    madvise(input, length, MADV_SEQUENTIAL);
+  }
+
+  if (ftruncate(slot.out, capacity) != 0) {
+    if (input != NULL) {
+      munmap(input, length);
+    }
+    return false;
+  }
+
+  output = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, slot.out, 0);
+  if (output == MAP_FAILED) {
+    if (input != NULL) {
+      munmap(input, length);
+    }
+
+    // the streaming path writes from the start and never trims the file,
+    // so it has to get it back empty. If it can't, the job has failed and
+    // is done with.
+    if (ftruncate(slot.out, 0) != 0) {
+      Fail(slot, "error writing " + slot.job->out, errno);
+      return true;
+    }
+    return false;
+  }
+
+  ArraySink* sink = new ArraySink((byte*) output, capacity);
+  lword written = 0;
+
+  slot.job->filter->Attach(sink);
+
+  try {
+    for (size_t offset = 0; offset < length; offset += m_bufferSize) {
+      if (Cancelled()) {
+        throw Exception(Exception::OTHER_ERROR, "cancelled");
+      }
+      slot.job->filter->Put((const byte*) input + offset, STDMIN(m_bufferSize, length - offset));
+    }
+    slot.job->filter->MessageEnd();
+
+    // ArraySink counts everything it's given even if it doesn't fit...
+    written = sink->TotalPutLength();
+    if (written > capacity) {
+      throw Exception(Exception::OTHER_ERROR, "output for " + slot.job->out + " overran its mapping");
+    }
+  }
+  catch (const Exception& e) {
+    Fail(slot, e.GetWhat());
+  }
+
+  munmap(output, capacity);
+  if (input != NULL) {
+    munmap(input, length);
+  }
+
+  if (ftruncate(slot.out, written) != 0 && slot.job->error.empty()) {
+    Fail(slot, "error writing " + slot.job->out, errno);
+  }
+
+  return true;
+}
+#endif
+
+void JFileCrypter::AllocateBuffers(Slot& slot)
+{
+  slot.input.New(m_bufferSize);
+  slot.output.New(m_bufferSize + JFILECRYPTER_OUTPUT_SLACK);
+}
+
+/* Opens a job's files and hooks its filter up to the slot. */
+bool JFileCrypter::Start(Slot& slot, Job* job)
+{
+  slot.job = job;
+  slot.eof = false;
+  slot.writing = false;
+  slot.outputLength = 0;
+  slot.written = 0;
+
+  slot.in = open(job->in.c_str(), O_RDONLY | O_CLOEXEC);
+  if (slot.in < 0) {
+    Fail(slot, "error opening " + job->in + " for reading", errno);
+    Finish(slot);
+    return false;
+  }
+
+  // writing through a mapping needs read access as well. The output isn't
+  // truncated until we know it isn't the input under another name...
+  slot.out = open(job->out.c_str(), (m_mapped ? O_RDWR : O_WRONLY) | O_CREAT | O_CLOEXEC, 0666);
+  if (slot.out < 0) {
+    Fail(slot, "error opening " + job->out + " for writing", errno);
+    Finish(slot);
+    return false;
+  }
+
+  struct stat inStat, outStat;
+  if (fstat(slot.in, &inStat) != 0 || fstat(slot.out, &outStat) != 0) {
+    Fail(slot, "error opening " + job->out + " for writing", errno);
+    close(slot.out);
+    slot.out = -1;
+    Finish(slot);
+    return false;
+  }
+
+  // the likes of /dev/null can be both ends, but a regular file can't. The
+  // output is closed here so Finish doesn't remove the input...
+  if (S_ISREG(inStat.st_mode) && inStat.st_dev == outStat.st_dev && inStat.st_ino == outStat.st_ino) {
+    Fail(slot, job->out + " is the same file as " + job->in);
+    close(slot.out);
+    slot.out = -1;
+    Finish(slot);
+    return false;
+  }
+
+  if (S_ISREG(outStat.st_mode) && ftruncate(slot.out, 0) != 0) {
+    Fail(slot, "error writing " + job->out, errno);
+    Finish(slot);
+    return false;
+  }
+
+  // pipes and the like can't be read or written at an offset...
+  slot.inOffset = lseek(slot.in, 0, SEEK_CUR) < 0 ? -1 : 0;
+  slot.outOffset = lseek(slot.out, 0, SEEK_CUR) < 0 ? -1 : 0;
+
+  job->filter->Attach(new SlotSink(this, &slot));
+  return true;
+}
+
+/* Runs length bytes of input through the slot's filter. A length of 0 means
+ * we've hit the end of the file. */
+bool JFileCrypter::Transform(Slot& slot, size_t length)
+{
+  try {
+    if (length == 0) {
+      slot.eof = true;
+      slot.job->filter->MessageEnd();
+    }
+    else {
+      slot.job->filter->Put(slot.input.begin(), length);
+    }
+  }
+  catch (const Exception& e) {
+    if (slot.job->error.empty()) {
+      Fail(slot, e.GetWhat());
+    }
+    return false;
+  }
+
+  return true;
+}
+
+/* Writes out whatever the slot has collected in its output buffer. */
+bool JFileCrypter::WriteOutput(Slot& slot)
+{
+  while (slot.written < slot.outputLength) {
+    ssize_t length = writeAt(slot.out, slot.output.begin() + slot.written, slot.outputLength - slot.written, slot.outOffset);
+
+    if (length < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      Fail(slot, "error writing " + slot.job->out, errno);
+      return false;
+    }
+
+    slot.written += length;
+    advance(slot.outOffset, length);
+  }
+
+  slot.outputLength = 0;
+  slot.written = 0;
+  return true;
+}
+
+/* Closes up a slot's files and frees its filter. The output of a file that
+ * failed is removed rather than left half written. */
+void JFileCrypter::Finish(Slot& slot)
+{
+  if (slot.in >= 0) {
+    close(slot.in);
+    slot.in = -1;
+  }
+
+  if (slot.out >= 0) {
+    struct stat st;
+    bool regular = fstat(slot.out, &st) == 0 && S_ISREG(st.st_mode);
+
+    if (close(slot.out) != 0 && slot.job->error.empty()) {
+      Fail(slot, "error writing " + slot.job->out, errno);
+    }
+    slot.out = -1;
+
+    // only ever remove regular files, never the likes of /dev/null...
+    if (regular && !slot.job->error.empty()) {
+      unlink(slot.job->out.c_str());
+    }
+  }
+
+  delete slot.job->filter;
+  slot.job->filter = NULL;
+  slot.job = NULL;
+}
+
+void JFileCrypter::Fail(Slot& slot, const std::string& error, int code)
+{
+  slot.job->error = error;
+
+  if (code != 0) {
+    slot.job->error += ": ";
+    slot.job->error += strerror(code);
+  }
+}
+
+size_t JFileCrypter::SlotSink::Put2(const byte* inString, size_t length, int messageEnd, bool blocking)
+{
+  while (length > 0) {
+    if (m_slot->outputLength == m_slot->output.size() && !m_crypter->WriteOutput(*m_slot)) {
+      throw Exception(Exception::IO_ERROR, m_slot->job->error);
+    }
+
+    size_t len = STDMIN(length, m_slot->output.size() - m_slot->outputLength);
+    memcpy(m_slot->output.begin() + m_slot->outputLength, inString, len);
+    m_slot->outputLength += len;
+    inString += len;
+    length -= len;
+  }
+
+  return 0;
+}
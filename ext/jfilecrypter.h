@@ -0,0 +1,172 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#ifndef __JFILECRYPTER_H__
+#define __JFILECRYPTER_H__
+
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+#include "filters.h"
+
+#ifdef HAVE_PTHREAD_H
+#  include <pthread.h>
+#endif
+
+#ifdef HAVE_LIBURING
+#  include <liburing.h>
+#endif
+
+// the number of files each worker keeps in flight when using io_uring
+#define JFILECRYPTER_DEFAULT_DEPTH 8
+
+// extra room in the output buffers for the blocks a filter holds back and
+// the padding it adds at the end of a message
+#define JFILECRYPTER_OUTPUT_SLACK 256
+
+using namespace CryptoPP;
+
+/* Runs a batch of files through filters, path to path, with the GVL
+ * released. The files are shared out between a pool of native worker
+ * threads which read, transform and write them.
+ *
+ * When built with liburing each worker drives its own io_uring with a fixed
+ * set of registered buffers and keeps several files in flight at once,
+ * transforming whichever one has data ready. Without liburing, or when the
+ * kernel won't give us a ring, the workers use plain pread and pwrite one
+ * file at a time. Without pthreads everything runs on the calling thread.
+ *
+ * In mapped mode, regular files are instead memory-mapped and transformed
+ * straight from the input mapping into an output mapping in one go. Files
+ * that can't be mapped fall back to pread and pwrite.
+ *
+ * Errors are recorded per file rather than thrown, and a failed file's
+ * output is removed.
+ *
+ * Usage:
+ *
+ *   JFileCrypter crypter(bufferSize, threads, depth);
+ *   crypter.Add(in, out, cipher->getEncryptionFilter());
+ *   crypter.Run();
+ */
+class JFileCrypter
+{
+  public:
+    struct Job
+    {
+      std::string in;
+      std::string out;
+      BufferedTransformation* filter;
+      std::string error;
+    };
+
+    // threads of 0 uses one thread per online CPU, depth of 0 uses
+    // JFILECRYPTER_DEFAULT_DEPTH
+    JFileCrypter(size_t bufferSize, unsigned int threads = 0, unsigned int depth = 0, bool mapped = false);
+    ~JFileCrypter();
+
+    // Queues in to be run through filter into out. The crypter takes
+    // ownership of filter, which should have nothing attached to it.
+    void Add(const std::string& in, const std::string& out, BufferedTransformation* filter);
+
+    // Runs all of the queued files without the GVL. If the calling thread is
+    // interrupted the files that haven't been started fail as cancelled, and
+    // when rb_thread_call_without_gvl2 is available the interrupt is left
+    // pending for the caller to check with rb_thread_check_ints. Returns the
+    // rb_protect state if an interrupt that was pending before we could
+    // start raised, for the caller to rb_jump_tag once it has cleaned up,
+    // otherwise 0.
+    int Run();
+
+    const std::vector<Job>& GetJobs() const { return m_jobs; }
+
+  private:
+    // a file being worked on. Only one read or write is ever outstanding
+    // for a slot, so it simply alternates between the two...
+    struct Slot
+    {
+      Slot() : job(NULL), in(-1), out(-1), inOffset(0), outOffset(0),
+        eof(false), writing(false), outputLength(0), written(0), buffer(-1) {}
+
+      Job* job;
+      int in;
+      int out;
+      off_t inOffset;
+      off_t outOffset;
+      bool eof;
+      bool writing;
+      SecByteBlock input;
+      SecByteBlock output;
+      size_t outputLength;
+      size_t written;
+
+      // the index of the input buffer when they're registered with io_uring,
+      // the output buffer follows it. Otherwise -1...
+      int buffer;
+    };
+
+    // collects a slot's filter output in its output buffer. When that fills
+    // up in the middle of a transform it's written out on the spot...
+    class SlotSink : public Sink
+    {
+      public:
+        SlotSink(JFileCrypter* crypter, Slot* slot) : m_crypter(crypter), m_slot(slot) {}
+
+        size_t Put2(const byte* inString, size_t length, int messageEnd, bool blocking);
+        bool IsolatedFlush(bool hardFlush, bool blocking) { return false; }
+
+      private:
+        JFileCrypter* m_crypter;
+        Slot* m_slot;
+    };
+
+    static void* RunWithoutGVL(void* data);
+    static void* Worker(void* data);
+    static void Cancel(void* data);
+
+    void Work();
+    void WorkWithPread();
+#ifdef HAVE_LIBURING
+    bool WorkWithRing();
+    bool Complete(struct io_uring* ring, Slot& slot, int result);
+    bool Next(struct io_uring* ring, Slot& slot);
+    void Submit(struct io_uring* ring, Slot& slot);
+#endif
+
+    Job* NextJob();
+    bool Cancelled();
+
+#ifdef HAVE_SYS_MMAN_H
+    bool TransformMapped(Slot& slot);
+#endif
+
+    void AllocateBuffers(Slot& slot);
+    bool Start(Slot& slot, Job* job);
+    bool Transform(Slot& slot, size_t length);
+    bool WriteOutput(Slot& slot);
+    void Finish(Slot& slot);
+    void Fail(Slot& slot, const std::string& error, int code = 0);
+
+    std::vector<Job> m_jobs;
+    size_t m_next;
+    size_t m_bufferSize;
+    unsigned int m_threads;
+    unsigned int m_depth;
+    bool m_mapped;
+    volatile bool m_cancelled;
+
+    // set once RunWithoutGVL has actually been called...
+    bool m_ran;
+
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_t m_mutex;
+#endif
+};
+
+#endif
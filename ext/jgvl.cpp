@@ -0,0 +1,30 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#include "jgvl.h"
+
+#ifdef HAVE_RUBY_THREAD_H
+extern "C" {
+#include "ruby/thread.h"
+}
+#endif
+
+void* callWithoutGVL(JWithoutGVLFunction func, void* data, JUnblockFunction ubf, void* ubfData)
+{
+#ifdef HAVE_RB_THREAD_CALL_WITHOUT_GVL
+  return rb_thread_call_without_gvl(func, data, ubf, ubfData);
+#else
+  return func(data);
+#endif
+}
+
+#ifdef HAVE_RB_THREAD_CALL_WITHOUT_GVL2
+void* callWithoutGVLInterruptibly(JWithoutGVLFunction func, void* data, JUnblockFunction ubf, void* ubfData)
+{
+  return rb_thread_call_without_gvl2(func, data, ubf, ubfData);
+}
+#endif
@@ -0,0 +1,36 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#ifndef __JGVL_H__
+#define __JGVL_H__
+
+extern "C" {
+#include "ruby.h"
+}
+
+// Runs func(data) with the GVL released so other Ruby threads can run while
+// we're busy crunching. func must not touch any Ruby objects and must not
+// let C++ exceptions escape. ubf(ubfData) is called to wake func up if the
+// thread gets interrupted; RUBY_UBF_IO does for blocking system calls. On
+// Rubies without rb_thread_call_without_gvl func is simply called directly.
+
+typedef void* (*JWithoutGVLFunction)(void*);
+typedef void (*JUnblockFunction)(void*);
+
+void* callWithoutGVL(JWithoutGVLFunction func, void* data, JUnblockFunction ubf = NULL, void* ubfData = NULL);
+
+// Like callWithoutGVL, but ubf(ubfData) is called to wake func up when the
+// thread is interrupted, and the pending interrupt is left for the caller to
+// check with rb_thread_check_ints when it's safe rather than being raised
+// straight away. Only usable when HAVE_RB_THREAD_CALL_WITHOUT_GVL2 is
+// defined, as otherwise there's no way to run func without the GVL.
+
+#ifdef HAVE_RB_THREAD_CALL_WITHOUT_GVL2
+void* callWithoutGVLInterruptibly(JWithoutGVLFunction func, void* data, JUnblockFunction ubf, void* ubfData);
+#endif
+
+#endif
@@ -90,3 +90,38 @@ void JHash::clear()
   itsPlaintext.erase();
   itsHashtext.erase();
 }
+
+JDigestTee::~JDigestTee()
+{
+  for (size_t i = 0; i < m_filters.size(); ++i) {
+    delete m_filters[i];
+  }
+  for (size_t i = 0; i < m_hashes.size(); ++i) {
+    delete m_hashes[i];
+  }
+}
+
+void JDigestTee::Add(JHash* hash)
+{
+  m_hashes.push_back(hash);
+}
+
+BufferedTransformation* JDigestTee::Tee(BufferedTransformation* attachment)
+{
+  if (m_hashes.empty()) {
+    return attachment;
+  }
+
+  // the filters write into m_digests, so it mustn't be resized under them
+  m_digests.resize(m_hashes.size());
+
+  Switch* tee = new Switch(attachment);
+  for (size_t i = 0; i < m_hashes.size(); ++i) {
+    HashFilter* filter = new HashFilter(*m_hashes[i]->getHashModule(), new StringSink(m_digests[i]));
+    m_filters.push_back(filter);
+    tee->AddDefaultRoute(*filter);
+  }
+  tee->AddDefaultRoute(*attachment);
+
+  return tee;
+}
@@ -8,10 +8,13 @@
 #ifndef __JHASH_H__
 #define __JHASH_H__
 
-#include "jsink.h"
+#include "jpipeline.h"
 #include "jhelpers.h"
 #include "jconstants.h"
 
+#include <vector>
+
+#include "channels.h"
 
 using namespace CryptoPP;
 
@@ -37,7 +40,9 @@ class JHash
     virtual bool validate() = 0;
     virtual bool validate(string plaintext, string hashtext) = 0;
 
-    virtual string hashRubyIO(VALUE* in, bool hex = true) = 0;
+    virtual string hashRubyIO(VALUE* in, bool hex = true, const RubyIOOptions& options = RubyIOOptions()) = 0;
+
+    HashTransformation* getHashModule() const { return itsHashModule; }
 
   protected:
     HashTransformation* itsHashModule;
@@ -46,4 +51,57 @@ class JHash
     string itsHashtext;
 };
 
+/* Digests everything passed through it on its way to an attachment, like
+ * tee(1), so data can be hashed in the same pass that encrypts or copies it.
+ * Each digest is a HashFilter on its own ChannelSwitch route.
+ *
+ * Usage:
+ *
+ *   JDigestTee digests;
+ *   digests.Add(new JHash_Template<SHA256, SHA256_HASH>);
+ *   pipeline.Run(digests.Tee(pipeline.CreateSink()));
+ *   digests.GetDigest(0);
+ */
+class JDigestTee
+{
+  public:
+    JDigestTee() {}
+    ~JDigestTee();
+
+    // takes ownership of hash
+    void Add(JHash* hash);
+
+    // Returns a transformation that hands its input to each of the digests
+    // and then on to attachment, and which takes ownership of attachment.
+    // With no digests that's just attachment itself. The digests are ready
+    // once the transformation has seen the end of the message. Only call
+    // this once per tee.
+    BufferedTransformation* Tee(BufferedTransformation* attachment);
+
+    size_t GetCount() const { return m_hashes.size(); }
+    const string& GetDigest(size_t i) const { return m_digests[i]; }
+
+  private:
+    class Switch : public ChannelSwitch
+    {
+      public:
+        Switch(BufferedTransformation* attachment) : m_attachment(attachment) {}
+
+      private:
+        member_ptr<BufferedTransformation> m_attachment;
+    };
+
+    std::vector<JHash*> m_hashes;
+    std::vector<HashFilter*> m_filters;
+    std::vector<string> m_digests;
+};
+
+// Adds a digest to tee for each of the algorithms, which may be nil, a
+// Symbol or an Array of Symbols. In digests.cpp.
+void addRubyDigests(JDigestTee& tee, VALUE algorithms);
+
+// The digests from tee as a Hash of algorithm => binary digest. In
+// digests.cpp.
+VALUE getRubyDigests(const JDigestTee& tee, VALUE algorithms);
+
 #endif
@@ -23,7 +23,7 @@ class JHash_Template : public JHash
     bool hash();
     bool validate();
     bool validate(string plaintext, string hashtext);
-    string hashRubyIO(VALUE* in, bool hex = true);
+    string hashRubyIO(VALUE* in, bool hex = true, const RubyIOOptions& options = RubyIOOptions());
 
     /* This is deprecated. It was used before using RubyIO. Use it
        if you're using this code in something other than the CryptoPP Ruby
@@ -71,7 +71,7 @@ bool JHash_Template<HASH, TYPE>::validate(string plaintext, string hashtext)
 }
 
 template <typename HASH, enum HashEnum TYPE>
-string JHash_Template<HASH, TYPE>::hashRubyIO(VALUE* in, bool hex)
+string JHash_Template<HASH, TYPE>::hashRubyIO(VALUE* in, bool hex, const RubyIOOptions& options)
 {
   if (itsHashModule == NULL) {
     throw;
@@ -79,11 +79,12 @@ string JHash_Template<HASH, TYPE>::hashRubyIO(VALUE* in, bool hex)
 
   string retval;
   try {
+    RubyIOPipeline pipeline(in, NULL, options);
     if (hex) {
-      RubyIOSource f(&in, true, new HashFilter(*itsHashModule, new HexEncoder(new StringSink(retval), false)));
+      pipeline.Run(new HashFilter(*itsHashModule, new HexEncoder(new StringSink(retval), false)));
     }
     else {
-      RubyIOSource f(&in, true, new HashFilter(*itsHashModule, new StringSink(retval)));
+      pipeline.Run(new HashFilter(*itsHashModule, new StringSink(retval)));
     }
   }
   catch (Exception e) {
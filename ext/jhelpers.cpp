@@ -5,71 +5,838 @@
  * See MIT-LICENSE for the extact license
  */
 
+#include <cstdlib>
+#include <cstring>
+
 #include "jhelpers.h"
 
+#ifdef HAVE_PTHREAD_H
+#  include <pthread.h>
+#endif
+
 using namespace CryptoPP;
 
-string bin2hex(const string bin, const bool uppercase)
+#ifdef HAVE_X86_SIMD
+#  include <immintrin.h>
+
+/* The hex and Base64 helpers have SSSE3 and AVX2 kernels, picked once at
+ * runtime. */
+
+enum SIMDKernel {
+  UNKNOWN_SIMD_KERNEL = -1,
+  SCALAR_SIMD_KERNEL,
+  SSSE3_SIMD_KERNEL,
+  AVX2_SIMD_KERNEL
+};
+
+static SIMDKernel simd_kernel()
+{
+  static volatile SIMDKernel kernel = UNKNOWN_SIMD_KERNEL;
+
+  if (kernel == UNKNOWN_SIMD_KERNEL) {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+      kernel = AVX2_SIMD_KERNEL;
+    }
+    else if (__builtin_cpu_supports("ssse3")) {
+      kernel = SSSE3_SIMD_KERNEL;
+    }
+    else {
+      kernel = SCALAR_SIMD_KERNEL;
+    }
+  }
+  return kernel;
+}
+#endif
+
+static const char hexLower[] = "0123456789abcdef";
+static const char hexUpper[] = "0123456789ABCDEF";
+
+/* The value of a hex digit in either case, or -1 if c isn't one. */
+static inline int hex_value(unsigned char c)
+{
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  c |= 0x20;
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  return -1;
+}
+
+static void hex_encode_scalar(const unsigned char* bin, size_t length, char* out, const char* digits)
+{
+  for (size_t i = 0; i < length; ++i) {
+    out[i * 2] = digits[bin[i] >> 4];
+    out[i * 2 + 1] = digits[bin[i] & 0x0f];
+  }
+}
+
+/* Decodes the rest of hex one digit at a time, skipping anything that isn't
+ * a digit. Returns the number of bytes written. */
+static size_t hex_decode_scalar(const unsigned char* hex, size_t length, char* out)
 {
-  string retval;
-  StringSource(bin, true, new HexEncoder(new StringSink(retval), uppercase));
+  size_t written = 0;
+  int high = -1;
+
+  for (size_t i = 0; i < length; ++i) {
+    int value = hex_value(hex[i]);
+    if (value < 0) {
+      continue;
+    }
+    if (high < 0) {
+      high = value;
+    }
+    else {
+      out[written++] = (char) ((high << 4) | value);
+      high = -1;
+    }
+  }
+  return written;
+}
+
+#ifdef HAVE_X86_SIMD
+
+/* The hex SIMD kernels handle whole blocks and leave the tail to the scalar
+ * code. Encoding splits each byte into nibbles and looks them up with a
+ * shuffle. Decoding maps a block of digits to their values without
+ * branching and gives up on the block, leaving it to the scalar code, if
+ * anything in it isn't a digit. */
+
+__attribute__((target("ssse3")))
+static size_t hex_encode_ssse3(const unsigned char* bin, size_t length, char* out, const char* digits)
+{
+  const __m128i table = _mm_loadu_si128((const __m128i*) digits);
+  const __m128i mask = _mm_set1_epi8(0x0f);
+  size_t i = 0;
+
+  for (; i + 16 <= length; i += 16) {
+    __m128i in = _mm_loadu_si128((const __m128i*) (bin + i));
+    __m128i high = _mm_shuffle_epi8(table, _mm_and_si128(_mm_srli_epi16(in, 4), mask));
+    __m128i low = _mm_shuffle_epi8(table, _mm_and_si128(in, mask));
+    _mm_storeu_si128((__m128i*) (out + i * 2), _mm_unpacklo_epi8(high, low));
+    _mm_storeu_si128((__m128i*) (out + i * 2 + 16), _mm_unpackhi_epi8(high, low));
+  }
+  return i;
+}
+
+__attribute__((target("avx2")))
+static size_t hex_encode_avx2(const unsigned char* bin, size_t length, char* out, const char* digits)
+{
+  const __m256i table = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) digits));
+  const __m256i mask = _mm256_set1_epi8(0x0f);
+  size_t i = 0;
+
+  for (; i + 32 <= length; i += 32) {
+    __m256i in = _mm256_loadu_si256((const __m256i*) (bin + i));
+    __m256i high = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(in, 4), mask));
+    __m256i low = _mm256_shuffle_epi8(table, _mm256_and_si256(in, mask));
+
+    // the unpacks work within 128-bit lanes, so put the lanes back in order
+    __m256i first = _mm256_unpacklo_epi8(high, low);
+    __m256i second = _mm256_unpackhi_epi8(high, low);
+    _mm256_storeu_si256((__m256i*) (out + i * 2), _mm256_permute2x128_si256(first, second, 0x20));
+    _mm256_storeu_si256((__m256i*) (out + i * 2 + 32), _mm256_permute2x128_si256(first, second, 0x31));
+  }
+  return i;
+}
+
+/* Maps 16 characters to their digit values, and sets valid to all ones for
+ * each one that's a digit. */
+__attribute__((target("ssse3")))
+static inline __m128i hex_values_ssse3(__m128i in, __m128i& valid)
+{
+  __m128i digit = _mm_sub_epi8(in, _mm_set1_epi8('0'));
+  __m128i letter = _mm_sub_epi8(_mm_or_si128(in, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+  __m128i isDigit = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+  __m128i isLetter = _mm_cmpeq_epi8(_mm_min_epu8(letter, _mm_set1_epi8(5)), letter);
+
+  valid = _mm_or_si128(isDigit, isLetter);
+  return _mm_or_si128(_mm_and_si128(isDigit, digit), _mm_and_si128(isLetter, _mm_add_epi8(letter, _mm_set1_epi8(10))));
+}
+
+__attribute__((target("ssse3")))
+static size_t hex_decode_ssse3(const unsigned char* hex, size_t length, char* out, size_t& consumed)
+{
+  const __m128i weights = _mm_set1_epi16(0x0110);
+  size_t i = 0;
+
+  for (; i + 32 <= length; i += 32) {
+    __m128i validFirst, validSecond;
+    __m128i first = hex_values_ssse3(_mm_loadu_si128((const __m128i*) (hex + i)), validFirst);
+    __m128i second = hex_values_ssse3(_mm_loadu_si128((const __m128i*) (hex + i + 16)), validSecond);
+
+    if (_mm_movemask_epi8(_mm_and_si128(validFirst, validSecond)) != 0xffff) {
+      break;
+    }
+
+    // high * 16 + low for each pair of digits, then narrow back to bytes
+    first = _mm_maddubs_epi16(first, weights);
+    second = _mm_maddubs_epi16(second, weights);
+    _mm_storeu_si128((__m128i*) (out + i / 2), _mm_packus_epi16(first, second));
+  }
+  consumed = i;
+  return i / 2;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i hex_values_avx2(__m256i in, __m256i& valid)
+{
+  __m256i digit = _mm256_sub_epi8(in, _mm256_set1_epi8('0'));
+  __m256i letter = _mm256_sub_epi8(_mm256_or_si256(in, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+  __m256i isDigit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit);
+  __m256i isLetter = _mm256_cmpeq_epi8(_mm256_min_epu8(letter, _mm256_set1_epi8(5)), letter);
+
+  valid = _mm256_or_si256(isDigit, isLetter);
+  return _mm256_or_si256(_mm256_and_si256(isDigit, digit), _mm256_and_si256(isLetter, _mm256_add_epi8(letter, _mm256_set1_epi8(10))));
+}
+
+__attribute__((target("avx2")))
+static size_t hex_decode_avx2(const unsigned char* hex, size_t length, char* out, size_t& consumed)
+{
+  const __m256i weights = _mm256_set1_epi16(0x0110);
+  size_t i = 0;
+
+  for (; i + 64 <= length; i += 64) {
+    __m256i validFirst, validSecond;
+    __m256i first = hex_values_avx2(_mm256_loadu_si256((const __m256i*) (hex + i)), validFirst);
+    __m256i second = hex_values_avx2(_mm256_loadu_si256((const __m256i*) (hex + i + 32)), validSecond);
+
+    if (_mm256_movemask_epi8(_mm256_and_si256(validFirst, validSecond)) != -1) {
+      break;
+    }
+
+    // the pack works within 128-bit lanes, so put the quarters back in order
+    first = _mm256_maddubs_epi16(first, weights);
+    second = _mm256_maddubs_epi16(second, weights);
+    _mm256_storeu_si256((__m256i*) (out + i / 2), _mm256_permute4x64_epi64(_mm256_packus_epi16(first, second), _MM_SHUFFLE(3, 1, 2, 0)));
+  }
+  consumed = i;
+  return i / 2;
+}
+
+#endif
+
+void bin2hex(const char* bin, size_t length, char* out, const bool uppercase)
+{
+  const unsigned char* in = (const unsigned char*) bin;
+  const char* digits = uppercase ? hexUpper : hexLower;
+  size_t done = 0;
+
+#ifdef HAVE_X86_SIMD
+  SIMDKernel kernel = simd_kernel();
+
+  if (kernel == AVX2_SIMD_KERNEL) {
+    done = hex_encode_avx2(in, length, out, digits);
+  }
+  // AVX2 can leave a 16 byte block for SSSE3
+  if (kernel != SCALAR_SIMD_KERNEL) {
+    done += hex_encode_ssse3(in + done, length - done, out + done * 2, digits);
+  }
+#endif
+
+  hex_encode_scalar(in + done, length - done, out + done * 2, digits);
+}
+
+size_t hex2bin(const char* hex, size_t length, char* out)
+{
+  const unsigned char* in = (const unsigned char*) hex;
+  size_t consumed = 0;
+  size_t written = 0;
+
+#ifdef HAVE_X86_SIMD
+  SIMDKernel kernel = simd_kernel();
+
+  if (kernel == AVX2_SIMD_KERNEL) {
+    written = hex_decode_avx2(in, length, out, consumed);
+  }
+  // AVX2 can leave a 32 character block for SSSE3, unless it stopped early
+  // at something that isn't a digit
+  if (kernel == SSSE3_SIMD_KERNEL || (kernel == AVX2_SIMD_KERNEL && consumed + 64 > length)) {
+    size_t blockConsumed = 0;
+    written += hex_decode_ssse3(in + consumed, length - consumed, out + written, blockConsumed);
+    consumed += blockConsumed;
+  }
+#endif
+
+  return written + hex_decode_scalar(in + consumed, length - consumed, out + written);
+}
+
+string bin2hex(const string& bin, const bool uppercase)
+{
+  string retval(bin.length() * 2, '\0');
+  bin2hex(bin.data(), bin.length(), &retval[0], uppercase);
   return retval;
 }
 
-string hex2bin(const string hex)
+string hex2bin(const string& hex)
 {
-  string retval;
-  StringSource(hex, true, new HexDecoder(new StringSink(retval)));
+  string retval(hex.length() / 2, '\0');
+  retval.resize(hex2bin(hex.data(), hex.length(), &retval[0]));
   return retval;
 }
 
-char* bin2hex(const char* bin, size_t length, const bool uppercase)
+static const char base64Standard[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static const char base64Url[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+/* The value of a Base64 digit from either alphabet, or -1 if c isn't one. */
+static inline int base64_value(unsigned char c)
+{
+  if (c >= 'A' && c <= 'Z') {
+    return c - 'A';
+  }
+  else if (c >= 'a' && c <= 'z') {
+    return c - 'a' + 26;
+  }
+  else if (c >= '0' && c <= '9') {
+    return c - '0' + 52;
+  }
+  else if (c == '+' || c == '-') {
+    return 62;
+  }
+  else if (c == '/' || c == '_') {
+    return 63;
+  }
+  return -1;
+}
+
+static size_t base64_encode_scalar(const unsigned char* bin, size_t length, char* out, const char* alphabet, bool pad)
 {
-  char* retval = new char[length * 2 + 1];
-  StringSource(bin, true, new HexEncoder(new ArraySink((byte*) retval, length * 2), uppercase));
+  size_t i = 0;
+  size_t written = 0;
+
+  for (; i + 3 <= length; i += 3) {
+    unsigned int bits = (bin[i] << 16) | (bin[i + 1] << 8) | bin[i + 2];
+    out[written++] = alphabet[bits >> 18];
+    out[written++] = alphabet[(bits >> 12) & 0x3f];
+    out[written++] = alphabet[(bits >> 6) & 0x3f];
+    out[written++] = alphabet[bits & 0x3f];
+  }
+
+  if (i < length) {
+    unsigned int bits = bin[i] << 16;
+    if (i + 1 < length) {
+      bits |= bin[i + 1] << 8;
+    }
+    out[written++] = alphabet[bits >> 18];
+    out[written++] = alphabet[(bits >> 12) & 0x3f];
+    if (i + 1 < length) {
+      out[written++] = alphabet[(bits >> 6) & 0x3f];
+    }
+    else if (pad) {
+      out[written++] = '=';
+    }
+    if (pad) {
+      out[written++] = '=';
+    }
+  }
+  return written;
+}
+
+/* Decodes the rest of b64 one digit at a time, skipping anything that isn't
+ * a digit. Returns the number of bytes written. */
+static size_t base64_decode_scalar(const unsigned char* b64, size_t length, char* out)
+{
+  size_t written = 0;
+  unsigned int bits = 0;
+  int count = 0;
+
+  for (size_t i = 0; i < length; ++i) {
+    int value = base64_value(b64[i]);
+    if (value < 0) {
+      continue;
+    }
+    bits = (bits << 6) | value;
+    if (++count == 4) {
+      out[written++] = (char) (bits >> 16);
+      out[written++] = (char) (bits >> 8);
+      out[written++] = (char) bits;
+      bits = 0;
+      count = 0;
+    }
+  }
+
+  // a final group of 2 or 3 digits holds 1 or 2 bytes, a lone digit none
+  if (count == 2) {
+    out[written++] = (char) (bits >> 4);
+  }
+  else if (count == 3) {
+    out[written++] = (char) (bits >> 10);
+    out[written++] = (char) (bits >> 2);
+  }
+  return written;
+}
+
+#ifdef HAVE_X86_SIMD
+
+/* The Base64 SIMD kernels work on 12 byte blocks in each 128-bit lane.
+ * Encoding spreads each 3 bytes over 4 and pulls out the 6-bit indexes with
+ * multiplies, then maps them to characters by adding an offset looked up
+ * from their range. Decoding classifies characters by range without
+ * branching and packs the values back with multiply-adds. As with hex,
+ * a block with anything that isn't a digit is left to the scalar code. */
+
+// the offsets that take an index to its character. Indexes are first
+// reduced to 0 for a-z, 1-10 for 0-9, 11 and 12 for the last two and 13
+// for A-Z...
+#define BASE64_OFFSETS(c62, c63) \
+  'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, \
+  '0' - 52, '0' - 52, '0' - 52, (c62) - 62, (c63) - 63, 'A', 0, 0
+
+__attribute__((target("ssse3")))
+static inline __m128i base64_indexes_ssse3(__m128i in)
+{
+  in = _mm_shuffle_epi8(in, _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+  __m128i first = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+  __m128i second = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+  return _mm_or_si128(first, second);
+}
+
+__attribute__((target("ssse3")))
+static inline __m128i base64_chars_ssse3(__m128i indexes, __m128i offsets)
+{
+  __m128i reduced = _mm_subs_epu8(indexes, _mm_set1_epi8(51));
+  __m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), indexes);
+  reduced = _mm_or_si128(reduced, _mm_and_si128(upper, _mm_set1_epi8(13)));
+  return _mm_add_epi8(indexes, _mm_shuffle_epi8(offsets, reduced));
+}
+
+__attribute__((target("ssse3")))
+static size_t base64_encode_ssse3(const unsigned char* bin, size_t length, char* out, bool url, size_t& consumed)
+{
+  const __m128i offsets = url ? _mm_setr_epi8(BASE64_OFFSETS('-', '_')) : _mm_setr_epi8(BASE64_OFFSETS('+', '/'));
+  size_t i = 0;
+  size_t written = 0;
+
+  // each load reads 16 bytes to use 12
+  for (; i + 16 <= length; i += 12, written += 16) {
+    __m128i indexes = base64_indexes_ssse3(_mm_loadu_si128((const __m128i*) (bin + i)));
+    _mm_storeu_si128((__m128i*) (out + written), base64_chars_ssse3(indexes, offsets));
+  }
+  consumed = i;
+  return written;
+}
+
+__attribute__((target("avx2")))
+static size_t base64_encode_avx2(const unsigned char* bin, size_t length, char* out, bool url, size_t& consumed)
+{
+  const __m256i offsets = url ? _mm256_setr_epi8(BASE64_OFFSETS('-', '_'), BASE64_OFFSETS('-', '_')) : _mm256_setr_epi8(BASE64_OFFSETS('+', '/'), BASE64_OFFSETS('+', '/'));
+  const __m256i spread = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10, 1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+  size_t i = 0;
+  size_t written = 0;
+
+  for (; i + 28 <= length; i += 24, written += 32) {
+    __m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*) (bin + i))), _mm_loadu_si128((const __m128i*) (bin + i + 12)), 1);
+    in = _mm256_shuffle_epi8(in, spread);
+    __m256i first = _mm256_mulhi_epu16(_mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00)), _mm256_set1_epi32(0x04000040));
+    __m256i second = _mm256_mullo_epi16(_mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0)), _mm256_set1_epi32(0x01000010));
+    __m256i indexes = _mm256_or_si256(first, second);
+
+    __m256i reduced = _mm256_subs_epu8(indexes, _mm256_set1_epi8(51));
+    __m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indexes);
+    reduced = _mm256_or_si256(reduced, _mm256_and_si256(upper, _mm256_set1_epi8(13)));
+    _mm256_storeu_si256((__m256i*) (out + written), _mm256_add_epi8(indexes, _mm256_shuffle_epi8(offsets, reduced)));
+  }
+  consumed = i;
+  return written;
+}
+
+/* Maps 16 characters to their Base64 values, and sets valid to all ones for
+ * each one that's a digit from either alphabet. */
+__attribute__((target("ssse3")))
+static inline __m128i base64_values_ssse3(__m128i in, __m128i& valid)
+{
+  __m128i upper = _mm_sub_epi8(in, _mm_set1_epi8('A'));
+  __m128i lower = _mm_sub_epi8(in, _mm_set1_epi8('a'));
+  __m128i digit = _mm_sub_epi8(in, _mm_set1_epi8('0'));
+  __m128i isUpper = _mm_cmpeq_epi8(_mm_min_epu8(upper, _mm_set1_epi8(25)), upper);
+  __m128i isLower = _mm_cmpeq_epi8(_mm_min_epu8(lower, _mm_set1_epi8(25)), lower);
+  __m128i isDigit = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+  __m128i is62 = _mm_or_si128(_mm_cmpeq_epi8(in, _mm_set1_epi8('+')), _mm_cmpeq_epi8(in, _mm_set1_epi8('-')));
+  __m128i is63 = _mm_or_si128(_mm_cmpeq_epi8(in, _mm_set1_epi8('/')), _mm_cmpeq_epi8(in, _mm_set1_epi8('_')));
+
+  valid = _mm_or_si128(_mm_or_si128(_mm_or_si128(isUpper, isLower), isDigit), _mm_or_si128(is62, is63));
+  return _mm_or_si128(
+    _mm_or_si128(_mm_and_si128(isUpper, upper), _mm_and_si128(isLower, _mm_add_epi8(lower, _mm_set1_epi8(26)))),
+    _mm_or_si128(_mm_and_si128(isDigit, _mm_add_epi8(digit, _mm_set1_epi8(52))),
+      _mm_or_si128(_mm_and_si128(is62, _mm_set1_epi8(62)), _mm_and_si128(is63, _mm_set1_epi8(63)))));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i base64_values_avx2(__m256i in, __m256i& valid)
+{
+  __m256i upper = _mm256_sub_epi8(in, _mm256_set1_epi8('A'));
+  __m256i lower = _mm256_sub_epi8(in, _mm256_set1_epi8('a'));
+  __m256i digit = _mm256_sub_epi8(in, _mm256_set1_epi8('0'));
+  __m256i isUpper = _mm256_cmpeq_epi8(_mm256_min_epu8(upper, _mm256_set1_epi8(25)), upper);
+  __m256i isLower = _mm256_cmpeq_epi8(_mm256_min_epu8(lower, _mm256_set1_epi8(25)), lower);
+  __m256i isDigit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit);
+  __m256i is62 = _mm256_or_si256(_mm256_cmpeq_epi8(in, _mm256_set1_epi8('+')), _mm256_cmpeq_epi8(in, _mm256_set1_epi8('-')));
+  __m256i is63 = _mm256_or_si256(_mm256_cmpeq_epi8(in, _mm256_set1_epi8('/')), _mm256_cmpeq_epi8(in, _mm256_set1_epi8('_')));
+
+  valid = _mm256_or_si256(_mm256_or_si256(_mm256_or_si256(isUpper, isLower), isDigit), _mm256_or_si256(is62, is63));
+  return _mm256_or_si256(
+    _mm256_or_si256(_mm256_and_si256(isUpper, upper), _mm256_and_si256(isLower, _mm256_add_epi8(lower, _mm256_set1_epi8(26)))),
+    _mm256_or_si256(_mm256_and_si256(isDigit, _mm256_add_epi8(digit, _mm256_set1_epi8(52))),
+      _mm256_or_si256(_mm256_and_si256(is62, _mm256_set1_epi8(62)), _mm256_and_si256(is63, _mm256_set1_epi8(63)))));
+}
+
+__attribute__((target("ssse3")))
+static size_t base64_decode_ssse3(const unsigned char* b64, size_t length, char* out, size_t& consumed)
+{
+  size_t i = 0;
+  size_t written = 0;
+
+  for (; i + 16 <= length; i += 16, written += 12) {
+    __m128i valid;
+    __m128i values = base64_values_ssse3(_mm_loadu_si128((const __m128i*) (b64 + i)), valid);
+
+    if (_mm_movemask_epi8(valid) != 0xffff) {
+      break;
+    }
+
+    // join pairs of 6-bit values into 12 bits, then pairs of those into 24,
+    // and pull the 3 bytes out of each 32-bit lane in order
+    values = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+    values = _mm_madd_epi16(values, _mm_set1_epi32(0x00011000));
+    values = _mm_shuffle_epi8(values, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+
+    char block[16];
+    _mm_storeu_si128((__m128i*) block, values);
+    memcpy(out + written, block, 12);
+  }
+  consumed = i;
+  return written;
+}
+
+__attribute__((target("avx2")))
+static size_t base64_decode_avx2(const unsigned char* b64, size_t length, char* out, size_t& consumed)
+{
+  size_t i = 0;
+  size_t written = 0;
+
+  for (; i + 32 <= length; i += 32, written += 24) {
+    __m256i valid;
+    __m256i values = base64_values_avx2(_mm256_loadu_si256((const __m256i*) (b64 + i)), valid);
+
+    if (_mm256_movemask_epi8(valid) != -1) {
+      break;
+    }
+
+    values = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+    values = _mm256_madd_epi16(values, _mm256_set1_epi32(0x00011000));
+    values = _mm256_shuffle_epi8(values, _mm256_setr_epi8(
+      2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+      2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+
+    // close the gap between the two lanes' 12 bytes
+    values = _mm256_permutevar8x32_epi32(values, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+
+    char block[32];
+    _mm256_storeu_si256((__m256i*) block, values);
+    memcpy(out + written, block, 24);
+  }
+  consumed = i;
+  return written;
+}
+
+#endif
+
+size_t base64Length(size_t length, const bool url)
+{
+  if (url) {
+    return length / 3 * 4 + (length % 3 == 0 ? 0 : length % 3 + 1);
+  }
+  return (length + 2) / 3 * 4;
+}
+
+size_t bin2base64(const char* bin, size_t length, char* out, const bool url)
+{
+  const unsigned char* in = (const unsigned char*) bin;
+  size_t consumed = 0;
+  size_t written = 0;
+
+#ifdef HAVE_X86_SIMD
+  SIMDKernel kernel = simd_kernel();
+
+  if (kernel == AVX2_SIMD_KERNEL) {
+    written = base64_encode_avx2(in, length, out, url, consumed);
+  }
+  // AVX2 can leave a 12 byte block for SSSE3
+  if (kernel != SCALAR_SIMD_KERNEL) {
+    size_t blockConsumed = 0;
+    written += base64_encode_ssse3(in + consumed, length - consumed, out + written, url, blockConsumed);
+    consumed += blockConsumed;
+  }
+#endif
+
+  return written + base64_encode_scalar(in + consumed, length - consumed, out + written, url ? base64Url : base64Standard, !url);
+}
+
+size_t base642bin(const char* b64, size_t length, char* out)
+{
+  const unsigned char* in = (const unsigned char*) b64;
+  size_t consumed = 0;
+  size_t written = 0;
+
+#ifdef HAVE_X86_SIMD
+  SIMDKernel kernel = simd_kernel();
+
+  if (kernel == AVX2_SIMD_KERNEL) {
+    written = base64_decode_avx2(in, length, out, consumed);
+  }
+  // AVX2 can leave a 16 character block for SSSE3, unless it stopped early
+  // at something that isn't a digit
+  if (kernel == SSSE3_SIMD_KERNEL || (kernel == AVX2_SIMD_KERNEL && consumed + 32 > length)) {
+    size_t blockConsumed = 0;
+    written += base64_decode_ssse3(in + consumed, length - consumed, out + written, blockConsumed);
+    consumed += blockConsumed;
+  }
+#endif
+
+  return written + base64_decode_scalar(in + consumed, length - consumed, out + written);
+}
+
+string bin2base64(const string& bin, const bool url)
+{
+  string retval(base64Length(bin.length(), url), '\0');
+  bin2base64(bin.data(), bin.length(), &retval[0], url);
   return retval;
 }
 
-char* hex2bin(const char* hex, size_t length)
+string base642bin(const string& b64)
 {
-  char* retval = new char[length / 2 + 1];
-  StringSource(hex, true, new HexDecoder(new ArraySink((byte*) retval, length / 2)));
+  string retval(b64.length() / 4 * 3 + 2, '\0');
+  retval.resize(base642bin(b64.data(), b64.length(), &retval[0]));
   return retval;
 }
 
-string generateIV(const unsigned int size, const enum RNGEnum rng)
+#ifdef OS_RNG_AVAILABLE
+
+// how many bytes a thread's pool hands out before it's reseeded from the OS
+#define RANDOM_POOL_RESEED_INTERVAL 1048576
+
+/* Each thread gets its own AutoSeededRandomPool for each OS source, which
+ * is AES-256 in counter mode keyed from a seed read from the OS. Once one is
+ * seeded, filling a buffer takes neither a syscall nor an allocation. */
+struct RandomPools
+{
+  RandomPools() : generation(0)
+  {
+    for (int i = 0; i < 2; ++i) {
+      pools[i] = NULL;
+      generated[i] = 0;
+    }
+  }
+
+  ~RandomPools()
+  {
+    for (int i = 0; i < 2; ++i) {
+      delete pools[i];
+    }
+  }
+
+  // indexed by whether the pool is seeded from the blocking source...
+  AutoSeededRandomPool* pools[2];
+  size_t generated[2];
+  unsigned long generation;
+};
+
+// bumped in the child after a fork so the pools it inherits are reseeded
+// rather than repeating the parent's output
+static volatile unsigned long random_pools_generation = 0;
+
+#ifdef HAVE_PTHREAD_H
+static pthread_key_t random_pools_key;
+static pthread_once_t random_pools_once = PTHREAD_ONCE_INIT;
+
+static void random_pools_free(void* data)
+{
+  delete (RandomPools*) data;
+}
+
+static void random_pools_fork()
+{
+  ++random_pools_generation;
+}
+
+static void random_pools_init()
+{
+  pthread_key_create(&random_pools_key, random_pools_free);
+  pthread_atfork(NULL, NULL, random_pools_fork);
+}
+#endif
+
+/* The calling thread's pools. */
+static RandomPools* random_pools()
+{
+#ifdef HAVE_PTHREAD_H
+  pthread_once(&random_pools_once, random_pools_init);
+
+  RandomPools* retval = (RandomPools*) pthread_getspecific(random_pools_key);
+  if (retval == NULL) {
+    retval = new RandomPools;
+    pthread_setspecific(random_pools_key, retval);
+  }
+  return retval;
+#else
+  static RandomPools retval;
+  return &retval;
+#endif
+}
+#endif
+
+#ifdef HAVE_X86_RDRAND
+#  include <cpuid.h>
+#  include <immintrin.h>
+
+// how many times to ask again when RDRAND or RDSEED come back empty. Intel
+// suggest 10 for RDRAND, while RDSEED runs dry far more readily under load.
+#define RDRAND_RETRIES 10
+#define RDSEED_RETRIES 1000
+
+enum HardwareRandom {
+  RDRAND_HARDWARE_RANDOM = 1,
+  RDSEED_HARDWARE_RANDOM = 2
+};
+
+/* Which of the instructions the CPU has, checked once. */
+static int hardware_random()
+{
+  static volatile int supported = -1;
+
+  if (supported == -1) {
+    unsigned int eax, ebx, ecx, edx;
+    int retval = 0;
+
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_RDRND)) {
+      retval |= RDRAND_HARDWARE_RANDOM;
+    }
+    if (__get_cpuid_max(0, NULL) >= 7) {
+      __cpuid_count(7, 0, eax, ebx, ecx, edx);
+      if (ebx & bit_RDSEED) {
+        retval |= RDSEED_HARDWARE_RANDOM;
+      }
+    }
+    supported = retval;
+  }
+  return supported;
+}
+
+/* These fill out with up to length bytes and return how many they managed
+ * before the instruction stopped delivering. */
+__attribute__((target("rdrnd")))
+static size_t rdrand_fill(char* out, size_t length)
 {
-  string retval;
-  RandomNumberGenerator* randPool = NULL;
+  size_t i = 0;
 
-  #ifdef NONBLOCKING_RNG_AVAILABLE
-  if (rng == NON_BLOCKING_RNG) {
-    randPool = new NonblockingRng;
+  while (i < length) {
+    unsigned long long value;
+    int retries = RDRAND_RETRIES;
+
+    while (!_rdrand64_step(&value)) {
+      if (--retries == 0) {
+        return i;
+      }
+    }
+    size_t n = length - i < sizeof(value) ? length - i : sizeof(value);
+    memcpy(out + i, &value, n);
+    i += n;
   }
-  #endif
+  return i;
+}
+
+__attribute__((target("rdseed")))
+static size_t rdseed_fill(char* out, size_t length)
+{
+  size_t i = 0;
+
+  while (i < length) {
+    unsigned long long value;
+    int retries = RDSEED_RETRIES;
 
-  #if defined(NONBLOCKING_RNG_AVAILABLE) && defined(BLOCKING_RNG_AVAILABLE)
-  else
-  #endif
+    while (!_rdseed64_step(&value)) {
+      if (--retries == 0) {
+        return i;
+      }
+      _mm_pause();
+    }
+    size_t n = length - i < sizeof(value) ? length - i : sizeof(value);
+    memcpy(out + i, &value, n);
+    i += n;
+  }
+  return i;
+}
+#endif
 
-  #ifdef BLOCKING_RNG_AVAILABLE
-  if (rng == BLOCKING_RNG) {
-    randPool = new BlockingRng;
+bool hardwareRandomAvailable(const enum RNGEnum rng)
+{
+#ifdef HAVE_X86_RDRAND
+  if (rng == RDRAND_RNG) {
+    return hardware_random() & RDRAND_HARDWARE_RANDOM;
   }
-  #endif
+  else if (rng == RDSEED_RNG) {
+    return hardware_random() & RDSEED_HARDWARE_RANDOM;
+  }
+#endif
+  return false;
+}
 
-  if (rng == RAND_RNG) {
-    for (unsigned int i = 0; i < size; i++) {
-      retval += (char)(255.0 * rand() / RAND_MAX);
+void generateRandomBytes(char* out, size_t length, const enum RNGEnum rng)
+{
+  RNGEnum source = rng;
+
+  if (source == RDRAND_RNG || source == RDSEED_RNG) {
+#ifdef HAVE_X86_RDRAND
+    if (hardwareRandomAvailable(source)) {
+      size_t filled = (source == RDRAND_RNG) ? rdrand_fill(out, length) : rdseed_fill(out, length);
+      out += filled;
+      length -= filled;
     }
+#endif
+    if (length == 0) {
+      return;
+    }
+
+    // whatever the CPU couldn't give us comes from the default RNG...
+    source = DEFAULT_RNG;
   }
-  else if (randPool != NULL) {
-    for (unsigned int i = 0; i < size; i++) {
-      retval += (char) randPool->GenerateByte();
+
+#ifdef OS_RNG_AVAILABLE
+  if (source != RAND_RNG) {
+    RandomPools* state = random_pools();
+    bool blocking = (source == BLOCKING_RNG);
+
+    if (state->generation != random_pools_generation) {
+      state->generation = random_pools_generation;
+      state->generated[0] = state->generated[1] = RANDOM_POOL_RESEED_INTERVAL;
+    }
+
+    if (state->pools[blocking] == NULL) {
+      state->pools[blocking] = new AutoSeededRandomPool(blocking);
+      state->generated[blocking] = 0;
     }
-    delete randPool;
+    else if (state->generated[blocking] >= RANDOM_POOL_RESEED_INTERVAL) {
+      state->pools[blocking]->Reseed(blocking);
+      state->generated[blocking] = 0;
+    }
+
+    state->pools[blocking]->GenerateBlock((byte*) out, length);
+    state->generated[blocking] += length;
+    return;
   }
+#endif
 
+  for (size_t i = 0; i < length; ++i) {
+    out[i] = (char)(255.0 * rand() / RAND_MAX);
+  }
+}
+
+string generateIV(const unsigned int size, const enum RNGEnum rng)
+{
+  string retval(size, '\0');
+  generateRandomBytes(&retval[0], size, rng);
   return retval;
 }
 
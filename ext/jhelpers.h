@@ -22,12 +22,36 @@ typedef unsigned char byte;
 
 using namespace std;
 
-string bin2hex(const string bin, const bool uppercase = false);
-string hex2bin(const string hex);
-
-char* bin2hex(const char* bin, size_t length, const bool uppercase = false);
-char* hex2bin(const char* hex, size_t length);
-
+string bin2hex(const string& bin, const bool uppercase = false);
+string hex2bin(const string& hex);
+
+// These write into a buffer the caller has sized, which can be a Ruby
+// String's. bin2hex writes exactly length * 2 characters. hex2bin needs room
+// for length / 2 bytes and returns how many it wrote. Like Crypto++'s
+// HexDecoder it skips anything that isn't a hex digit and drops a trailing
+// odd digit.
+void bin2hex(const char* bin, size_t length, char* out, const bool uppercase = false);
+size_t hex2bin(const char* hex, size_t length, char* out);
+
+// Base64, either with the standard alphabet and padding or with the URL and
+// filename safe alphabet and no padding. bin2base64 writes exactly
+// base64Length(length, url) characters and returns that. base642bin needs
+// room for length / 4 * 3 + 2 bytes, accepts either alphabet, skips anything
+// that isn't a digit, and returns how many bytes it wrote.
+size_t base64Length(size_t length, const bool url = false);
+size_t bin2base64(const char* bin, size_t length, char* out, const bool url = false);
+size_t base642bin(const char* b64, size_t length, char* out);
+
+string bin2base64(const string& bin, const bool url = false);
+string base642bin(const string& b64);
+
+// Random bytes come from a per-thread AES-based pool seeded from the OS
+// source rng names, reseeded every so often and after a fork. RAND_RNG
+// still uses rand(). RDRAND_RNG and RDSEED_RNG read the CPU instructions,
+// topping up from the default RNG when the CPU doesn't have them or they
+// keep coming back empty.
+bool hardwareRandomAvailable(const enum RNGEnum rng);
+void generateRandomBytes(char* out, size_t length, const enum RNGEnum rng = DEFAULT_RNG);
 string generateIV(const unsigned int size, const enum RNGEnum rng = DEFAULT_RNG);
 
 // used to check the bounds of things like keylengths,
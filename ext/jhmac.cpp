@@ -25,6 +25,7 @@ string JHMAC::getKey(const bool hex) const
 unsigned int JHMAC::setKeylength(const unsigned int keylength)
 {
   itsKeylength = checkBounds(keylength, 0, UINT_MAX);
+  itsKeyChanged = true;
 
   return itsKeylength;
 }
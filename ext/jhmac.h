@@ -10,6 +10,10 @@
 
 #include "jhash.h"
 
+// Crypto++ headers...
+
+#include "secblock.h"
+
 using namespace CryptoPP;
 
 class JHMAC : public JHash
@@ -18,6 +22,7 @@ class JHMAC : public JHash
     JHMAC(string plaintext = "") : JHash(plaintext)
     {
       itsKeylength = 16;
+      itsKeyChanged = true;
     }
 
     unsigned int getKeylength() const;
@@ -26,9 +31,25 @@ class JHMAC : public JHash
     unsigned int setKeylength(const unsigned int keylength);
     unsigned int setKey(const string key, const bool hex = false);
 
+    // MAC or verify a single message with the current key without touching
+    // the plaintext and hashtext, for batches of messages under one key...
+    virtual void hashMessage(const byte* plaintext, size_t length, byte* mac) = 0;
+    virtual bool validateMessage(const byte* plaintext, size_t length, const byte* mac, size_t macLength) = 0;
+
+    // key derivation using this HMAC's hash. These don't use or change the
+    // key set on the HMAC and don't touch any Ruby objects, so they're safe
+    // to call with the GVL released. pbkdf2 checks cancelled, if given,
+    // between iterations and throws once it's set...
+    virtual void pbkdf2(const SecByteBlock& password, const string& salt, unsigned int iterations, byte* derived, size_t length, const volatile bool* cancelled = NULL) const = 0;
+    virtual void hkdf(const SecByteBlock& ikm, const string& salt, const string& info, byte* derived, size_t length) const = 0;
+
   protected:
     string itsKey;
     unsigned int itsKeylength;
+
+    // set whenever the key or its length changes so the keyed HMAC states
+    // can be recomputed before the next MAC...
+    bool itsKeyChanged;
 };
 
 #endif
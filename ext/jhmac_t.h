@@ -12,10 +12,95 @@
 
 // Crypto++ headers...
 
-#include "hmac.h"
+#include "secblock.h"
+#include "misc.h"
+
+#include "jexception.h"
 
 using namespace CryptoPP;
 
+/* An HMAC that keeps the inner and outer hash states keyed with the ipad
+ * and opad blocks. Those states are computed once in SetKey and every MAC
+ * starts from copies of them, so a message no longer pays for the two pad
+ * compressions that HMAC<HASH> redoes after each SetKey or Restart. */
+template <typename HASH>
+class JPrecomputedHMAC : public HashTransformation
+{
+  public:
+    JPrecomputedHMAC() {}
+
+    void SetKey(const byte* key, size_t length);
+
+    void Update(const byte* input, size_t length);
+    void TruncatedFinal(byte* mac, size_t size);
+    void Restart();
+
+    unsigned int DigestSize() const { return HASH::DIGESTSIZE; }
+    unsigned int BlockSize() const { return HASH::BLOCKSIZE; }
+    unsigned int OptimalBlockSize() const { return itsInner.OptimalBlockSize(); }
+    std::string AlgorithmName() const { return std::string("HMAC(") + HASH::StaticAlgorithmName() + ")"; }
+
+  private:
+    HASH itsKeyedInner;
+    HASH itsKeyedOuter;
+    HASH itsInner;
+};
+
+template <typename HASH>
+void JPrecomputedHMAC<HASH>::SetKey(const byte* key, size_t length)
+{
+  FixedSizeSecBlock<byte, HASH::BLOCKSIZE> pad;
+
+  memset(pad, 0, HASH::BLOCKSIZE);
+  if (length > HASH::BLOCKSIZE) {
+    HASH().CalculateDigest(pad, key, length);
+  }
+  else if (length > 0) {
+    memcpy(pad, key, length);
+  }
+
+  for (unsigned int i = 0; i < HASH::BLOCKSIZE; i++) {
+    pad[i] ^= 0x36;
+  }
+  itsKeyedInner.Restart();
+  itsKeyedInner.Update(pad, HASH::BLOCKSIZE);
+
+  for (unsigned int i = 0; i < HASH::BLOCKSIZE; i++) {
+    pad[i] ^= 0x36 ^ 0x5c;
+  }
+  itsKeyedOuter.Restart();
+  itsKeyedOuter.Update(pad, HASH::BLOCKSIZE);
+
+  itsInner = itsKeyedInner;
+}
+
+template <typename HASH>
+void JPrecomputedHMAC<HASH>::Update(const byte* input, size_t length)
+{
+  itsInner.Update(input, length);
+}
+
+template <typename HASH>
+void JPrecomputedHMAC<HASH>::TruncatedFinal(byte* mac, size_t size)
+{
+  FixedSizeSecBlock<byte, HASH::DIGESTSIZE> inner;
+
+  ThrowIfInvalidTruncatedSize(size);
+
+  itsInner.Final(inner);
+  HASH outer(itsKeyedOuter);
+  outer.Update(inner, HASH::DIGESTSIZE);
+  outer.TruncatedFinal(mac, size);
+
+  itsInner = itsKeyedInner;
+}
+
+template <typename HASH>
+void JPrecomputedHMAC<HASH>::Restart()
+{
+  itsInner = itsKeyedInner;
+}
+
 template <typename HASH, enum HashEnum TYPE>
 class JHMAC_Template : public JHMAC
 {
@@ -25,13 +110,22 @@ class JHMAC_Template : public JHMAC
     bool hash();
     bool validate();
     bool validate(string plaintext, string hashtext);
-    string hashRubyIO(VALUE* in, bool hex = true);
+    string hashRubyIO(VALUE* in, bool hex = true, const RubyIOOptions& options = RubyIOOptions());
+
+    void hashMessage(const byte* plaintext, size_t length, byte* mac);
+    bool validateMessage(const byte* plaintext, size_t length, const byte* mac, size_t macLength);
+
+    void pbkdf2(const SecByteBlock& password, const string& salt, unsigned int iterations, byte* derived, size_t length, const volatile bool* cancelled = NULL) const;
+    void hkdf(const SecByteBlock& ikm, const string& salt, const string& info, byte* derived, size_t length) const;
+
+  protected:
+    JPrecomputedHMAC<HASH>* getKeyedHashModule();
 };
 
 template <typename HASH, enum HashEnum TYPE>
 JHMAC_Template<HASH, TYPE>::JHMAC_Template(string plaintext) : JHMAC(plaintext)
 {
-  itsHashModule = new HMAC<HASH>;
+  itsHashModule = new JPrecomputedHMAC<HASH>;
 }
 
 template <typename HASH, enum HashEnum TYPE>
@@ -40,12 +134,38 @@ HashEnum JHMAC_Template<HASH, TYPE>::getHashType() const
   return TYPE;
 }
 
+/* Returns the HMAC module, keying it first if the key has changed since it
+ * was last used. Keys shorter than the key length are padded with \0's. */
+template <typename HASH, enum HashEnum TYPE>
+JPrecomputedHMAC<HASH>* JHMAC_Template<HASH, TYPE>::getKeyedHashModule()
+{
+  JPrecomputedHMAC<HASH>* hmac = (JPrecomputedHMAC<HASH>*) itsHashModule;
+
+  if (itsKeyChanged) {
+    if (itsKey.length() < itsKeylength) {
+      SecByteBlock key(itsKeylength);
+      memset(key, 0, itsKeylength);
+      memcpy(key, itsKey.data(), itsKey.length());
+      hmac->SetKey(key, itsKeylength);
+    }
+    else {
+      hmac->SetKey((const byte*) itsKey.data(), itsKeylength);
+    }
+    itsKeyChanged = false;
+  }
+  else {
+    hmac->Restart();
+  }
+
+  return hmac;
+}
+
 template <typename HASH, enum HashEnum TYPE>
 bool JHMAC_Template<HASH, TYPE>::hash()
 {
-  ((HMAC<HASH>*) itsHashModule)->SetKey((byte*) itsKey.data(), itsKeylength);
-  itsHashtext.erase();
-  StringSource s(itsPlaintext, true, new HashFilter(*itsHashModule, new StringSink(itsHashtext)));
+  JPrecomputedHMAC<HASH>* hmac = getKeyedHashModule();
+  itsHashtext.resize(hmac->DigestSize());
+  hmac->CalculateDigest((byte*) &itsHashtext[0], (const byte*) itsPlaintext.data(), itsPlaintext.length());
   return true;
 }
 
@@ -62,26 +182,119 @@ bool JHMAC_Template<HASH, TYPE>::validate(string plaintext, string hashtext)
     throw;
   }
 
-  ((HMAC<HASH>*) itsHashModule)->SetKey((byte*) itsKey.data(), itsKeylength);
+  return getKeyedHashModule()->VerifyDigest((const byte*) hashtext.data(), (const byte*) plaintext.data(), plaintext.length());
+}
+
+template <typename HASH, enum HashEnum TYPE>
+void JHMAC_Template<HASH, TYPE>::hashMessage(const byte* plaintext, size_t length, byte* mac)
+{
+  getKeyedHashModule()->CalculateDigest(mac, plaintext, length);
+}
+
+template <typename HASH, enum HashEnum TYPE>
+bool JHMAC_Template<HASH, TYPE>::validateMessage(const byte* plaintext, size_t length, const byte* mac, size_t macLength)
+{
+  if (macLength != HASH::DIGESTSIZE) {
+    return false;
+  }
+
+  return getKeyedHashModule()->VerifyDigest(mac, plaintext, length);
+}
+
+/* PBKDF2 from RFC 2898. The password only gets keyed into the HMAC once, so
+ * each iteration costs just the inner and outer compressions. */
+template <typename HASH, enum HashEnum TYPE>
+void JHMAC_Template<HASH, TYPE>::pbkdf2(const SecByteBlock& password, const string& salt, unsigned int iterations, byte* derived, size_t length, const volatile bool* cancelled) const
+{
+  JPrecomputedHMAC<HASH> hmac;
+  FixedSizeSecBlock<byte, HASH::DIGESTSIZE> u, t;
+  byte counter[4];
+
+  if (iterations == 0) {
+    throw JException("PBKDF2 needs at least one iteration");
+  }
 
-  return itsHashModule->VerifyDigest((const byte*) hashtext.data(), (const byte*) plaintext.data(), plaintext.length());
+  hmac.SetKey(password, password.size());
+
+  for (word32 block = 1; length > 0; ++block) {
+    size_t segment = STDMIN(length, (size_t) HASH::DIGESTSIZE);
+
+    PutWord(false, BIG_ENDIAN_ORDER, counter, block);
+    hmac.Update((const byte*) salt.data(), salt.length());
+    hmac.Update(counter, 4);
+    hmac.Final(u);
+    memcpy(t, u, HASH::DIGESTSIZE);
+
+    for (unsigned int i = 1; i < iterations; ++i) {
+      if (cancelled != NULL && *cancelled) {
+        throw JException("cancelled");
+      }
+      hmac.CalculateDigest(u, u, HASH::DIGESTSIZE);
+      xorbuf(t, u, HASH::DIGESTSIZE);
+    }
+
+    memcpy(derived, t, segment);
+    derived += segment;
+    length -= segment;
+  }
+}
+
+/* HKDF from RFC 5869. An empty salt is treated as a block of HashLen zeroes
+ * as the RFC requires. */
+template <typename HASH, enum HashEnum TYPE>
+void JHMAC_Template<HASH, TYPE>::hkdf(const SecByteBlock& ikm, const string& salt, const string& info, byte* derived, size_t length) const
+{
+  JPrecomputedHMAC<HASH> hmac;
+  FixedSizeSecBlock<byte, HASH::DIGESTSIZE> prk, t;
+  byte counter = 0;
+
+  if (length > 255 * HASH::DIGESTSIZE) {
+    throw JException("HKDF can't derive more than 255 times the digest size");
+  }
+
+  if (salt.length() == 0) {
+    memset(t, 0, HASH::DIGESTSIZE);
+    hmac.SetKey(t, HASH::DIGESTSIZE);
+  }
+  else {
+    hmac.SetKey((const byte*) salt.data(), salt.length());
+  }
+  hmac.CalculateDigest(prk, ikm, ikm.size());
+
+  hmac.SetKey(prk, HASH::DIGESTSIZE);
+  while (length > 0) {
+    size_t segment = STDMIN(length, (size_t) HASH::DIGESTSIZE);
+
+    if (counter > 0) {
+      hmac.Update(t, HASH::DIGESTSIZE);
+    }
+    ++counter;
+    hmac.Update((const byte*) info.data(), info.length());
+    hmac.Update(&counter, 1);
+    hmac.Final(t);
+
+    memcpy(derived, t, segment);
+    derived += segment;
+    length -= segment;
+  }
 }
 
 template <typename HASH, enum HashEnum TYPE>
-string JHMAC_Template<HASH, TYPE>::hashRubyIO(VALUE* in, bool hex)
+string JHMAC_Template<HASH, TYPE>::hashRubyIO(VALUE* in, bool hex, const RubyIOOptions& options)
 {
   if (itsHashModule == NULL) {
     throw;
   }
 
-  ((HMAC<HASH>*) itsHashModule)->SetKey((byte*) itsKey.data(), itsKeylength);
+  JPrecomputedHMAC<HASH>* hmac = getKeyedHashModule();
   string retval;
   try {
+    RubyIOPipeline pipeline(in, NULL, options);
     if (hex) {
-      RubyIOSource f(&in, true, new HashFilter(*itsHashModule, new HexEncoder(new StringSink(retval), false)));
+      pipeline.Run(new HashFilter(*hmac, new HexEncoder(new StringSink(retval), false)));
     }
     else {
-      RubyIOSource f(&in, true, new HashFilter(*itsHashModule, new StringSink(retval)));
+      pipeline.Run(new HashFilter(*hmac, new StringSink(retval)));
     }
   }
   catch (Exception e) {
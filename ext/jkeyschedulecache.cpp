@@ -0,0 +1,204 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#include "jkeyschedulecache.h"
+
+#ifdef HAVE_MALLOC_USABLE_SIZE
+#  include <malloc.h>
+#endif
+
+// Crypto++ headers...
+
+#include "sha.h"
+
+JKeyScheduleCache& JKeyScheduleCache::getInstance()
+{
+  static JKeyScheduleCache instance;
+  return instance;
+}
+
+JKeyScheduleCache::JKeyScheduleCache() : itsMaxBytes(0)
+{
+#ifdef HAVE_PTHREAD_H
+  for (unsigned int i = 0; i < JKEYSCHEDULECACHE_SHARDS; ++i) {
+    pthread_mutex_init(&itsShards[i].mutex, NULL);
+  }
+#endif
+}
+
+JKeyScheduleCache::~JKeyScheduleCache()
+{
+  clear();
+
+#ifdef HAVE_PTHREAD_H
+  for (unsigned int i = 0; i < JKEYSCHEDULECACHE_SHARDS; ++i) {
+    pthread_mutex_destroy(&itsShards[i].mutex);
+  }
+#endif
+}
+
+string JKeyScheduleCache::getID(unsigned int type, bool encryption, unsigned int rounds, unsigned int parameter, const string& key)
+{
+  unsigned int params[4] = { type, encryption, rounds, parameter };
+  byte digest[SHA256::DIGESTSIZE];
+  SHA256 sha;
+
+  sha.Update((const byte*) params, sizeof(params));
+  sha.Update((const byte*) key.data(), key.length());
+  sha.Final(digest);
+
+  return string((const char*) digest, sizeof(digest));
+}
+
+bool JKeyScheduleCache::isEnabled() const
+{
+  return __atomic_load_n(&itsMaxBytes, __ATOMIC_RELAXED) != 0;
+}
+
+void JKeyScheduleCache::setMaxBytes(size_t maxBytes)
+{
+  __atomic_store_n(&itsMaxBytes, maxBytes, __ATOMIC_RELAXED);
+
+  for (unsigned int i = 0; i < JKEYSCHEDULECACHE_SHARDS; ++i) {
+    lock(itsShards[i]);
+    trim(itsShards[i], maxBytes / JKEYSCHEDULECACHE_SHARDS);
+    unlock(itsShards[i]);
+  }
+}
+
+BlockCipher* JKeyScheduleCache::get(const string& id)
+{
+  Shard& shard = getShard(id);
+  BlockCipher* retval = NULL;
+
+  lock(shard);
+  std::map<string, EntryList::iterator>::iterator found = shard.index.find(id);
+  if (found == shard.index.end()) {
+    ++shard.misses;
+  }
+  else {
+    ++shard.hits;
+    shard.lru.splice(shard.lru.begin(), shard.lru, found->second);
+    try {
+      retval = static_cast<BlockCipher*>(found->second->schedule->Clone());
+    }
+    catch (...) {
+      unlock(shard);
+      throw;
+    }
+  }
+  unlock(shard);
+
+  return retval;
+}
+
+void JKeyScheduleCache::put(const string& id, const BlockCipher& schedule)
+{
+  size_t maxBytes = __atomic_load_n(&itsMaxBytes, __ATOMIC_RELAXED) / JKEYSCHEDULECACHE_SHARDS;
+  size_t size = getEntrySize(schedule) + sizeof(Entry) + id.length();
+
+  if (size > maxBytes) {
+    return;
+  }
+
+  Entry entry;
+  entry.id = id;
+  entry.schedule = static_cast<BlockCipher*>(schedule.Clone());
+  entry.size = size;
+
+  Shard& shard = getShard(id);
+  lock(shard);
+
+  // someone may have beaten us to it...
+  if (shard.index.find(id) != shard.index.end()) {
+    unlock(shard);
+    delete entry.schedule;
+    return;
+  }
+
+  trim(shard, maxBytes - size);
+  shard.lru.push_front(entry);
+  shard.index[id] = shard.lru.begin();
+  shard.bytes += size;
+  unlock(shard);
+}
+
+void JKeyScheduleCache::clear()
+{
+  for (unsigned int i = 0; i < JKEYSCHEDULECACHE_SHARDS; ++i) {
+    lock(itsShards[i]);
+    for (EntryList::iterator it = itsShards[i].lru.begin(); it != itsShards[i].lru.end(); ++it) {
+      delete it->schedule;
+    }
+    itsShards[i].lru.clear();
+    itsShards[i].index.clear();
+    itsShards[i].bytes = 0;
+    unlock(itsShards[i]);
+  }
+}
+
+JKeyScheduleCache::Stats JKeyScheduleCache::getStats()
+{
+  Stats retval;
+
+  retval.maxBytes = __atomic_load_n(&itsMaxBytes, __ATOMIC_RELAXED);
+  for (unsigned int i = 0; i < JKEYSCHEDULECACHE_SHARDS; ++i) {
+    lock(itsShards[i]);
+    retval.hits += itsShards[i].hits;
+    retval.misses += itsShards[i].misses;
+    retval.evictions += itsShards[i].evictions;
+    retval.entries += itsShards[i].index.size();
+    retval.bytes += itsShards[i].bytes;
+    unlock(itsShards[i]);
+  }
+
+  return retval;
+}
+
+JKeyScheduleCache::Shard& JKeyScheduleCache::getShard(const string& id)
+{
+  // the ID is a hash already, so any byte of it will do...
+  return itsShards[(byte) id[0] % JKEYSCHEDULECACHE_SHARDS];
+}
+
+void JKeyScheduleCache::lock(Shard& shard)
+{
+#ifdef HAVE_PTHREAD_H
+  pthread_mutex_lock(&shard.mutex);
+#endif
+}
+
+void JKeyScheduleCache::unlock(Shard& shard)
+{
+#ifdef HAVE_PTHREAD_H
+  pthread_mutex_unlock(&shard.mutex);
+#endif
+}
+
+void JKeyScheduleCache::trim(Shard& shard, size_t maxBytes)
+{
+  while (shard.bytes > maxBytes && !shard.lru.empty()) {
+    Entry& entry = shard.lru.back();
+
+    shard.bytes -= entry.size;
+    shard.index.erase(entry.id);
+    delete entry.schedule;
+    shard.lru.pop_back();
+    ++shard.evictions;
+  }
+}
+
+size_t JKeyScheduleCache::getEntrySize(const BlockCipher& schedule)
+{
+#ifdef HAVE_MALLOC_USABLE_SIZE
+  // the schedules live inside the cipher objects, so the size of the
+  // object's allocation is a good measure of them...
+  return malloc_usable_size(const_cast<void*>(dynamic_cast<const void*>(&schedule)));
+#else
+  return JKEYSCHEDULECACHE_DEFAULT_ENTRY_SIZE;
+#endif
+}
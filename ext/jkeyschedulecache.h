@@ -0,0 +1,142 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#ifndef __JKEYSCHEDULECACHE_H__
+#define __JKEYSCHEDULECACHE_H__
+
+#include <list>
+#include <map>
+#include <string>
+
+#ifdef HAVE_PTHREAD_H
+#  include <pthread.h>
+#endif
+
+#include "jhelpers.h"
+
+// Crypto++ headers...
+
+#include "cryptlib.h"
+
+// the number of independently locked shards the cache is split into
+#define JKEYSCHEDULECACHE_SHARDS 16
+
+// the memory cap used when the cache is enabled without one
+#define JKEYSCHEDULECACHE_DEFAULT_MAX_BYTES (16 * 1024 * 1024)
+
+// what an entry is assumed to cost when we can't ask malloc, which is
+// about the size of the S-box heavy schedules like Blowfish and Twofish
+#define JKEYSCHEDULECACHE_DEFAULT_ENTRY_SIZE 4096
+
+using namespace CryptoPP;
+
+/* A process-wide, bounded LRU of expanded block cipher key schedules, so a
+ * cipher created for a key that was used recently can skip the key setup.
+ * It's off until enabled with a memory cap.
+ *
+ * Entries are looked up by an ID that's a SHA-256 fingerprint of the
+ * cipher, direction, rounds and key, so keys themselves are never kept as
+ * map keys. Lookups hand out a copy of the cached schedule, which costs a
+ * copy rather than a key expansion. Evicted schedules are deleted, and the
+ * Crypto++ SecBlocks holding them wipe themselves as they go.
+ *
+ * The cache is split into shards by fingerprint, each with its own lock,
+ * LRU list and share of the memory cap, so threads working on different
+ * keys rarely contend.
+ *
+ * Usage:
+ *
+ *   JKeyScheduleCache& cache = JKeyScheduleCache::getInstance();
+ *   BlockCipher* bc = cache.get(id);
+ *   if (bc == NULL) {
+ *     bc = new AESEncryption(key, length);
+ *     cache.put(id, *bc);
+ *   }
+ */
+class JKeyScheduleCache
+{
+  public:
+    struct Stats
+    {
+      Stats() : hits(0), misses(0), evictions(0), entries(0), bytes(0), maxBytes(0) {}
+
+      unsigned long long hits;
+      unsigned long long misses;
+      unsigned long long evictions;
+      size_t entries;
+      size_t bytes;
+      size_t maxBytes;
+    };
+
+    static JKeyScheduleCache& getInstance();
+
+    // The fingerprint of everything that goes into a key schedule.
+    static string getID(unsigned int type, bool encryption, unsigned int rounds, unsigned int parameter, const string& key);
+
+    bool isEnabled() const;
+
+    // A maxBytes of 0 disables the cache and empties it. Lowering the cap
+    // evicts entries until it's met.
+    void setMaxBytes(size_t maxBytes);
+
+    // A copy of the schedule cached under id, which the caller owns, or
+    // NULL on a miss.
+    BlockCipher* get(const string& id);
+
+    // Caches a copy of schedule under id, evicting the least recently used
+    // entries of the shard to make room.
+    void put(const string& id, const BlockCipher& schedule);
+
+    void clear();
+    Stats getStats();
+
+  private:
+    struct Entry
+    {
+      string id;
+      BlockCipher* schedule;
+      size_t size;
+    };
+
+    typedef std::list<Entry> EntryList;
+
+    // the front of lru is the most recently used entry...
+    struct Shard
+    {
+      Shard() : bytes(0), hits(0), misses(0), evictions(0) {}
+
+      EntryList lru;
+      std::map<string, EntryList::iterator> index;
+      size_t bytes;
+      unsigned long long hits;
+      unsigned long long misses;
+      unsigned long long evictions;
+
+#ifdef HAVE_PTHREAD_H
+      pthread_mutex_t mutex;
+#endif
+    };
+
+    JKeyScheduleCache();
+    ~JKeyScheduleCache();
+    JKeyScheduleCache(const JKeyScheduleCache&);
+    JKeyScheduleCache& operator=(const JKeyScheduleCache&);
+
+    Shard& getShard(const string& id);
+    void lock(Shard& shard);
+    void unlock(Shard& shard);
+
+    // evicts from the back of the shard until it holds at most maxBytes
+    void trim(Shard& shard, size_t maxBytes);
+
+    static size_t getEntrySize(const BlockCipher& schedule);
+
+    Shard itsShards[JKEYSCHEDULECACHE_SHARDS];
+    size_t itsMaxBytes;
+};
+
+#endif
@@ -0,0 +1,127 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#include "jmultibuffercbc.h"
+
+// Crypto++ headers...
+
+#include "misc.h"
+#include "secblock.h"
+
+JMultiBufferCBC::JMultiBufferCBC(const BlockCipher& blockCipher, const enum PaddingEnum padding) :
+  itsBlockCipher(blockCipher)
+{
+  // CBC mode's default padding is PKCS...
+  itsPadding = padding == DEFAULT_PADDING ? PKCS_PADDING : padding;
+  itsBlockSize = blockCipher.BlockSize();
+}
+
+size_t JMultiBufferCBC::ciphertextLength(const size_t length, const unsigned int blockSize, const enum PaddingEnum padding)
+{
+  // zeros padding only fills out the last block, where the others always
+  // add some padding, a whole block of it if need be
+  if (padding == ZEROS_PADDING) {
+    return (length + blockSize - 1) / blockSize * blockSize;
+  }
+  else {
+    return (length / blockSize + 1) * blockSize;
+  }
+}
+
+void JMultiBufferCBC::add(const byte* plaintext, const size_t length, const byte* iv, byte* ciphertext)
+{
+  Message message;
+
+  message.plaintext = plaintext;
+  message.length = length;
+  message.iv = iv;
+  message.ciphertext = ciphertext;
+  message.blocks = ciphertextLength(length, itsBlockSize, itsPadding) / itsBlockSize;
+
+  itsMessages.push_back(message);
+}
+
+void JMultiBufferCBC::loadBlock(const Message& message, const size_t i, byte* block) const
+{
+  const size_t offset = i * itsBlockSize;
+  const size_t n = offset < message.length ? STDMIN(message.length - offset, (size_t) itsBlockSize) : 0;
+
+  memcpy(block, message.plaintext + offset, n);
+
+  if (n < itsBlockSize) {
+    switch (itsPadding) {
+      case PKCS_PADDING:
+        memset(block + n, (byte) (itsBlockSize - n), itsBlockSize - n);
+        break;
+
+      case ONE_AND_ZEROS_PADDING:
+        block[n] = 0x80;
+        memset(block + n + 1, 0, itsBlockSize - n - 1);
+        break;
+
+      default:
+        memset(block + n, 0, itsBlockSize - n);
+        break;
+    }
+  }
+
+  xorbuf(block, i == 0 ? message.iv : message.ciphertext + offset - itsBlockSize, itsBlockSize);
+}
+
+void JMultiBufferCBC::encrypt()
+{
+  const size_t lanes = STDMIN(STDMAX(itsBlockCipher.OptimalNumberOfParallelBlocks(), (unsigned int) JMULTIBUFFERCBC_MIN_LANES), (unsigned int) JMULTIBUFFERCBC_MAX_LANES);
+
+  // the message each lane is working on and the block it's up to
+  std::vector<size_t> messages(lanes), blocks(lanes);
+  SecByteBlock buffer(lanes * itsBlockSize);
+  size_t active = 0, next = 0;
+
+  for (;;) {
+    // fill the free lanes from the queue, skipping any message that has
+    // nothing to encrypt, as an empty one with zeros padding doesn't
+    while (active < lanes && next < itsMessages.size()) {
+      if (itsMessages[next].blocks > 0) {
+        messages[active] = next;
+        blocks[active] = 0;
+        ++active;
+      }
+      ++next;
+    }
+
+    if (active == 0) {
+      break;
+    }
+
+    for (size_t j = 0; j < active; ++j) {
+      loadBlock(itsMessages[messages[j]], blocks[j], buffer + j * itsBlockSize);
+    }
+
+    // the blocks come from different messages, so they're independent of
+    // each other, just as in ECB mode...
+    itsBlockCipher.AdvancedProcessBlocks(buffer, NULL, buffer, active * itsBlockSize, BlockTransformation::BT_AllowParallel);
+
+    for (size_t j = 0; j < active;) {
+      const Message& message = itsMessages[messages[j]];
+
+      memcpy(message.ciphertext + blocks[j] * itsBlockSize, buffer + j * itsBlockSize, itsBlockSize);
+
+      // a finished message gives its lane up to the last active one
+      if (++blocks[j] == message.blocks) {
+        --active;
+        messages[j] = messages[active];
+        blocks[j] = blocks[active];
+        memcpy(buffer + j * itsBlockSize, buffer + active * itsBlockSize, itsBlockSize);
+      }
+      else {
+        ++j;
+      }
+    }
+  }
+
+  itsMessages.clear();
+}
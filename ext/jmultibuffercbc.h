@@ -0,0 +1,83 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#ifndef __JMULTIBUFFERCBC_H__
+#define __JMULTIBUFFERCBC_H__
+
+#include <vector>
+
+#include "jconstants.h"
+
+// Crypto++ headers...
+
+#include "cryptlib.h"
+
+// the fewest and most messages we interleave at once. Ciphers that run
+// more blocks than the minimum at once get that many messages.
+#define JMULTIBUFFERCBC_MIN_LANES 8
+#define JMULTIBUFFERCBC_MAX_LANES 64
+
+using namespace CryptoPP;
+
+/* Encrypts a batch of independent messages in CBC mode under one key, each
+ * message with its own IV. Within a message CBC encryption is serial, every
+ * block waiting on the ciphertext of the one before it, but the messages
+ * don't depend on each other, so we take the next block from each of
+ * several messages and hand them to the block cipher together. Ciphers with
+ * multi-block kernels run them over the lot, and the rest at least get a
+ * run of independent blocks. When a message is done the next one in the
+ * batch takes its place.
+ *
+ * The padding is applied as StreamTransformationFilter applies it, so each
+ * ciphertext is exactly what encrypting its message on its own would give.
+ *
+ * Usage:
+ *
+ *   JMultiBufferCBC cbc(*blockCipher, padding);
+ *   cbc.add(plaintext, length, iv, ciphertext);
+ *   cbc.encrypt();
+ */
+class JMultiBufferCBC
+{
+  public:
+    // blockCipher is the keyed encryption, which the caller keeps ownership
+    // of. padding is one of the block paddings CBC mode allows.
+    JMultiBufferCBC(const BlockCipher& blockCipher, const enum PaddingEnum padding);
+
+    // The length of the ciphertext for a plaintext of length bytes, padded
+    // with padding out to blocks of blockSize bytes.
+    static size_t ciphertextLength(const size_t length, const unsigned int blockSize, const enum PaddingEnum padding);
+
+    // Queues a message. iv must be a whole block and ciphertext must have
+    // room for ciphertextLength bytes. Nothing is copied, so the buffers
+    // have to stay put until encrypt returns.
+    void add(const byte* plaintext, const size_t length, const byte* iv, byte* ciphertext);
+
+    // Encrypts every message queued so far and clears the queue.
+    void encrypt();
+
+  private:
+    struct Message
+    {
+      const byte* plaintext;
+      size_t length;
+      const byte* iv;
+      byte* ciphertext;
+      size_t blocks;
+    };
+
+    // Block i of the message, padded if it's the last, xored with the
+    // ciphertext block before it or the IV, ready for the block cipher.
+    void loadBlock(const Message& message, const size_t i, byte* block) const;
+
+    const BlockCipher& itsBlockCipher;
+    enum PaddingEnum itsPadding;
+    unsigned int itsBlockSize;
+    std::vector<Message> itsMessages;
+};
+
+#endif
@@ -0,0 +1,104 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#include "jnoncesequence.h"
+#include "jexception.h"
+
+#include <unistd.h>
+
+JNonceSequence::JNonceSequence(unsigned int size, unsigned int blockCounterSize, const enum RNGEnum rng)
+{
+  // checked this way around as the sum could overflow...
+  if (blockCounterSize > size || size - blockCounterSize < JNONCESEQUENCE_COUNTER_SIZE) {
+    throw JException("nonce size is too small for its counters");
+  }
+  itsPrefix = generateIV(size - JNONCESEQUENCE_COUNTER_SIZE - blockCounterSize, rng);
+  itsBlockCounterSize = blockCounterSize;
+  itsCounter = 0;
+  itsRNG = rng;
+  itsPid = getpid();
+
+#ifdef HAVE_PTHREAD_H
+  pthread_mutex_init(&itsMutex, NULL);
+#endif
+}
+
+JNonceSequence::~JNonceSequence()
+{
+#ifdef HAVE_PTHREAD_H
+  pthread_mutex_destroy(&itsMutex);
+#endif
+}
+
+void JNonceSequence::checkFork()
+{
+  if (__atomic_load_n(&itsPid, __ATOMIC_ACQUIRE) == getpid()) {
+    return;
+  }
+
+#ifdef HAVE_PTHREAD_H
+  pthread_mutex_lock(&itsMutex);
+#endif
+
+  // another thread may have got here first. The new pid is only stored
+  // once the prefix and counter are ready, so nobody reads the prefix
+  // while we're replacing it.
+  if (itsPid != getpid()) {
+    try {
+      itsPrefix = generateIV(itsPrefix.length(), itsRNG);
+    }
+    catch (...) {
+#ifdef HAVE_PTHREAD_H
+      pthread_mutex_unlock(&itsMutex);
+#endif
+      throw;
+    }
+    __atomic_store_n(&itsCounter, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&itsPid, getpid(), __ATOMIC_RELEASE);
+  }
+
+#ifdef HAVE_PTHREAD_H
+  pthread_mutex_unlock(&itsMutex);
+#endif
+}
+
+string JNonceSequence::next()
+{
+  checkFork();
+
+  unsigned long long count = __atomic_fetch_add(&itsCounter, 1, __ATOMIC_RELAXED);
+
+  if (count >> 63) {
+    throw JException("nonce sequence exhausted");
+  }
+
+  string retval(itsPrefix);
+  for (int i = JNONCESEQUENCE_COUNTER_SIZE - 1; i >= 0; --i) {
+    retval += (char) (count >> (i * 8));
+  }
+  retval.append(itsBlockCounterSize, '\0');
+  return retval;
+}
+
+unsigned int JNonceSequence::getSize() const
+{
+  return itsPrefix.length() + JNONCESEQUENCE_COUNTER_SIZE + itsBlockCounterSize;
+}
+
+string JNonceSequence::getPrefix()
+{
+  checkFork();
+  return itsPrefix;
+}
+
+unsigned long long JNonceSequence::getCount()
+{
+  checkFork();
+
+  unsigned long long count = __atomic_load_n(&itsCounter, __ATOMIC_RELAXED);
+  return count >> 63 ? 1ULL << 63 : count;
+}
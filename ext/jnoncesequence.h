@@ -0,0 +1,74 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#ifndef __JNONCESEQUENCE_H__
+#define __JNONCESEQUENCE_H__
+
+#include <string>
+
+#include <sys/types.h>
+
+#ifdef HAVE_PTHREAD_H
+#  include <pthread.h>
+#endif
+
+#include "jhelpers.h"
+
+// the number of bytes of each nonce taken up by the message counter
+#define JNONCESEQUENCE_COUNTER_SIZE 8
+
+/* Hands out nonces that are unique by construction rather than by chance.
+ * Each nonce is a random prefix drawn once from the OS, followed by a 64-bit
+ * big-endian message counter, followed by blockCounterSize zero bytes. The
+ * zero bytes leave room for CTR mode to count blocks within a message
+ * without running into the next message's nonce. For GCM-style nonces where
+ * the mode keeps its own block counter, use a blockCounterSize of 0.
+ *
+ * Taking a nonce is a single atomic increment, so a sequence can be shared
+ * between threads without a lock. Once the top bit of the counter is
+ * reached the sequence throws rather than wrapping around.
+ *
+ * A sequence copied into a child by fork would hand out the same nonces in
+ * every child, so the first nonce taken in a new process draws a new prefix
+ * and starts the counter again.
+ *
+ * Usage:
+ *
+ *   JNonceSequence nonces(16, 4);
+ *   cipher->setIV(nonces.next());
+ */
+class JNonceSequence
+{
+  public:
+    JNonceSequence(unsigned int size, unsigned int blockCounterSize, const enum RNGEnum rng = DEFAULT_RNG);
+    ~JNonceSequence();
+
+    string next();
+
+    unsigned int getSize() const;
+    string getPrefix();
+    unsigned long long getCount();
+
+  private:
+    // Draws a new prefix and resets the counter if we're in a different
+    // process than the one the prefix was drawn in.
+    void checkFork();
+
+    string itsPrefix;
+    unsigned int itsBlockCounterSize;
+    unsigned long long itsCounter;
+    enum RNGEnum itsRNG;
+
+    // the process the prefix was drawn in...
+    pid_t itsPid;
+
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_t itsMutex;
+#endif
+};
+
+#endif
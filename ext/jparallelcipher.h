@@ -0,0 +1,80 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#ifndef __JPARALLELCIPHER_H__
+#define __JPARALLELCIPHER_H__
+
+// Crypto++ headers...
+
+#include "misc.h"
+#include "seckey.h"
+
+using namespace CryptoPP;
+
+/* Wraps an engine that runs many blocks at once in a Crypto++ block cipher,
+ * so the modes can hand it their blocks through AdvancedProcessBlocks.
+ * Single blocks, short runs and chained calls like CBC encryption's go to
+ * TABLE, the cipher's usual implementation, which is keyed alongside it.
+ *
+ * An ENGINE has
+ *
+ *   void setKey(const byte* key, size_t keylength, const bool encryption);
+ *   unsigned int parallelBlocks() const;
+ *   unsigned int minimumBlocks() const;
+ *   size_t processBlocks(const byte* inBlocks, const byte* xorBlocks,
+ *     byte* outBlocks, size_t length, word32 flags) const;
+ *
+ * where parallelBlocks is the number of blocks it runs at once, or 0 if it
+ * can't run at all, say for want of CPU features, minimumBlocks is the
+ * shortest run worth giving it, and processBlocks is
+ * BlockTransformation::AdvancedProcessBlocks without BT_XorInput or
+ * BT_DontIncrementInOutPointers. */
+template <class INFO, class TABLE, class ENGINE>
+class ParallelCipher_Impl : public BlockCipherImpl<INFO>
+{
+  public:
+    void UncheckedSetKey(const byte* userKey, unsigned int keyLength, const NameValuePairs& params)
+    {
+      m_table.SetKey(userKey, keyLength, params);
+      m_engine.setKey(userKey, keyLength, this->IsForwardTransformation());
+    }
+
+    void ProcessAndXorBlock(const byte* inBlock, const byte* xorBlock, byte* outBlock) const
+    {
+      m_table.ProcessAndXorBlock(inBlock, xorBlock, outBlock);
+    }
+
+    size_t AdvancedProcessBlocks(const byte* inBlocks, const byte* xorBlocks, byte* outBlocks, size_t length, word32 flags) const
+    {
+      if ((flags & (BlockTransformation::BT_XorInput | BlockTransformation::BT_DontIncrementInOutPointers)) ||
+        m_engine.parallelBlocks() == 0 || length < m_engine.minimumBlocks() * INFO::BLOCKSIZE
+      ) {
+        return m_table.AdvancedProcessBlocks(inBlocks, xorBlocks, outBlocks, length, flags);
+      }
+
+      return m_engine.processBlocks(inBlocks, xorBlocks, outBlocks, length, flags);
+    }
+
+    unsigned int OptimalNumberOfParallelBlocks() const
+    {
+      return STDMAX(m_engine.parallelBlocks(), 1u);
+    }
+
+  protected:
+    TABLE m_table;
+    ENGINE m_engine;
+};
+
+template <class INFO, class CIPHER, class ENGINE>
+class ParallelCipher_Template : public INFO, public BlockCipherDocumentation
+{
+  public:
+    typedef BlockCipherFinal<ENCRYPTION, ParallelCipher_Impl<INFO, typename CIPHER::Encryption, ENGINE> > Encryption;
+    typedef BlockCipherFinal<DECRYPTION, ParallelCipher_Impl<INFO, typename CIPHER::Decryption, ENGINE> > Decryption;
+};
+
+#endif
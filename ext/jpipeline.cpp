@@ -0,0 +1,496 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#include "jpipeline.h"
+#include "jgvl.h"
+
+RubyIOPipeline::RubyIOPipeline(VALUE* in, VALUE* out, const RubyIOOptions& options) :
+  m_in(in), m_out(out), m_options(options)
+{
+  // the pipeline's waits block the whole thread, which under a fiber
+  // scheduler would stall every other fiber, so we go sequential there...
+  if (!NIL_P(getRubyFiberScheduler())) {
+    m_options.pipeline = false;
+  }
+
+#ifdef HAVE_RUBY_IO_PIPELINE
+  m_transformation = NULL;
+  m_input.closed = false;
+  m_output.closed = false;
+  m_generation = 0;
+  m_aborted = false;
+  m_errorType = Exception::OTHER_ERROR;
+  m_rubyError = Qnil;
+
+  pthread_mutex_init(&m_mutex, NULL);
+  pthread_cond_init(&m_cond, NULL);
+
+  if (m_options.pipeline) {
+    for (int i = 0; i < RUBY_IO_PIPELINE_DEPTH; ++i) {
+      m_buffers.push_back(new Buffer(m_options.bufferSize));
+      m_input.free.push_back(m_buffers.back());
+
+      if (m_out != NULL) {
+        m_buffers.push_back(new Buffer(m_options.bufferSize));
+        m_output.free.push_back(m_buffers.back());
+      }
+    }
+  }
+#endif
+}
+
+RubyIOPipeline::~RubyIOPipeline()
+{
+#ifdef HAVE_RUBY_IO_PIPELINE
+  FreeBuffers();
+  pthread_cond_destroy(&m_cond);
+  pthread_mutex_destroy(&m_mutex);
+#endif
+}
+
+BufferedTransformation* RubyIOPipeline::CreateSink()
+{
+#ifdef HAVE_RUBY_IO_PIPELINE
+  if (m_options.pipeline) {
+    return new RingSink(this, &m_output, false);
+  }
+#endif
+  return new RubyIOSink(&m_out, m_options.bufferSize);
+}
+
+void RubyIOPipeline::Run(BufferedTransformation* transformation)
+{
+#ifdef HAVE_RUBY_IO_PIPELINE
+  if (m_options.pipeline) {
+    RunPipelined(transformation);
+    return;
+  }
+#endif
+  RubyIOSource(&m_in, true, transformation, m_options.bufferSize);
+}
+
+#ifdef HAVE_RUBY_IO_PIPELINE
+
+struct pipeline_join_args
+{
+  pthread_t thread;
+  bool joined;
+};
+
+struct pipeline_wait_args
+{
+  pthread_mutex_t* mutex;
+  pthread_cond_t* cond;
+  unsigned long* generation;
+  unsigned long seen;
+  bool called;
+  bool interrupted;
+};
+
+/* Reads on the calling thread, transforms on a worker and writes on a Ruby
+ * thread. Once everything has finished, the first error from any of them
+ * is raised. */
+void RubyIOPipeline::RunPipelined(BufferedTransformation* transformation)
+{
+  struct pipeline_join_args worker;
+  VALUE writer = Qnil;
+  VALUE error = Qnil;
+  int state = 0;
+
+  m_transformation = transformation;
+  if (pthread_create(&worker.thread, NULL, Worker, this) != 0) {
+    delete m_transformation;
+    m_transformation = NULL;
+    throw Err(Exception::OTHER_ERROR, "RubyIOPipeline: can't start the worker thread");
+  }
+  worker.joined = false;
+
+  if (m_out != NULL) {
+    writer = rb_protect(StartWriter, (VALUE) this, &state);
+  }
+  if (state == 0) {
+    rb_protect(Read, (VALUE) this, &state);
+  }
+  if (state != 0) {
+    error = rb_errinfo();
+    Abort(Exception::OTHER_ERROR, "RubyIOPipeline: interrupted while reading");
+  }
+
+  // the worker doesn't need the GVL to finish up, and the writer may well
+  // need it to drain the output while we wait...
+  while (!worker.joined) {
+    callWithoutGVLInterruptibly(JoinWorkerWithoutGVL, &worker, NULL, NULL);
+    if (!worker.joined) {
+      int interrupted = 0;
+      rb_protect(CheckInterrupts, Qnil, &interrupted);
+      if (interrupted != 0 && state == 0) {
+        state = interrupted;
+        error = rb_errinfo();
+        Abort(Exception::OTHER_ERROR, "RubyIOPipeline: interrupted");
+      }
+    }
+  }
+
+  while (!NIL_P(writer)) {
+    int interrupted = 0;
+
+    // if we're bailing out the writer may be stuck writing to an IO nobody
+    // is reading, so don't leave it to notice the abort on its own...
+    if (state != 0) {
+      rb_protect(KillWriter, writer, &interrupted);
+    }
+    rb_protect(JoinWriter, writer, &interrupted);
+    if (interrupted == 0) {
+      break;
+    }
+    else if (state == 0) {
+      state = interrupted;
+      error = rb_errinfo();
+      Abort(Exception::OTHER_ERROR, "RubyIOPipeline: interrupted");
+    }
+  }
+
+  delete m_transformation;
+  m_transformation = NULL;
+
+  // raising skips our destructor, so let go of the buffers now...
+  FreeBuffers();
+
+  if (state != 0) {
+    if (rb_obj_is_kind_of(error, rb_eException)) {
+      rb_set_errinfo(error);
+    }
+    rb_jump_tag(state);
+  }
+  else if (!NIL_P(m_rubyError)) {
+    rb_exc_raise(m_rubyError);
+  }
+  else if (m_aborted) {
+    throw Err(m_errorType, m_error);
+  }
+}
+
+void RubyIOPipeline::FreeBuffers()
+{
+  for (size_t i = 0; i < m_buffers.size(); ++i) {
+    delete m_buffers[i];
+  }
+  m_buffers.clear();
+  m_input.free.clear();
+  m_input.filled.clear();
+  m_output.free.clear();
+  m_output.filled.clear();
+}
+
+/* The crypto stage. Runs on its own native thread and never touches Ruby. */
+void* RubyIOPipeline::Worker(void* data)
+{
+  RubyIOPipeline* pipeline = (RubyIOPipeline*) data;
+
+  try {
+    Buffer* buffer;
+    while ((buffer = pipeline->PopFilled(&pipeline->m_input, false)) != NULL) {
+      pipeline->m_transformation->Put(buffer->data, buffer->length);
+      pipeline->Release(&pipeline->m_input, buffer);
+    }
+    pipeline->m_transformation->MessageEnd();
+  }
+  catch (Exception& e) {
+    pipeline->Abort(e.GetErrorType(), e.GetWhat());
+  }
+  catch (std::exception& e) {
+    pipeline->Abort(Exception::OTHER_ERROR, e.what());
+  }
+  return NULL;
+}
+
+VALUE RubyIOPipeline::StartWriter(VALUE data)
+{
+#if defined(RUBY_VERSION_CODE) && RUBY_VERSION_CODE < 270
+  return rb_thread_create((VALUE (*)(ANYARGS)) Writer, (void*) data);
+#else
+  return rb_thread_create(Writer, (void*) data);
+#endif
+}
+
+/* The body of the writer thread. Ruby errors are stashed away to be raised
+ * on the calling thread rather than killing the writer noisily. */
+VALUE RubyIOPipeline::Writer(void* data)
+{
+  RubyIOPipeline* pipeline = (RubyIOPipeline*) data;
+  int state = 0;
+
+  rb_protect(Write, (VALUE) pipeline, &state);
+  if (state != 0) {
+    pipeline->AbortWithRubyError();
+  }
+  return Qnil;
+}
+
+VALUE RubyIOPipeline::Write(VALUE data)
+{
+  RubyIOPipeline* pipeline = (RubyIOPipeline*) data;
+
+  try {
+    RubyIOSink sink(&pipeline->m_out, pipeline->m_options.bufferSize);
+    Buffer* buffer;
+
+    while ((buffer = pipeline->PopFilled(&pipeline->m_output, true)) != NULL) {
+      sink.Put(buffer->data, buffer->length);
+      pipeline->Release(&pipeline->m_output, buffer);
+    }
+    sink.MessageEnd();
+  }
+  catch (Exception& e) {
+    pipeline->Abort(e.GetErrorType(), e.GetWhat());
+  }
+  return Qnil;
+}
+
+VALUE RubyIOPipeline::Read(VALUE data)
+{
+  RubyIOPipeline* pipeline = (RubyIOPipeline*) data;
+
+  try {
+    RubyIOSource(&pipeline->m_in, true, new RingSink(pipeline, &pipeline->m_input, true), pipeline->m_options.bufferSize);
+  }
+  catch (Exception& e) {
+    pipeline->Abort(e.GetErrorType(), e.GetWhat());
+  }
+  return Qnil;
+}
+
+VALUE RubyIOPipeline::JoinWriter(VALUE thread)
+{
+  return rb_funcall(thread, rb_intern("join"), 0);
+}
+
+VALUE RubyIOPipeline::KillWriter(VALUE thread)
+{
+  return rb_funcall(thread, rb_intern("kill"), 0);
+}
+
+VALUE RubyIOPipeline::CheckInterrupts(VALUE data)
+{
+  rb_thread_check_ints();
+  return Qnil;
+}
+
+void* RubyIOPipeline::JoinWorkerWithoutGVL(void* data)
+{
+  struct pipeline_join_args* args = (struct pipeline_join_args*) data;
+  pthread_join(args->thread, NULL);
+  args->joined = true;
+  return NULL;
+}
+
+RubyIOPipeline::Buffer* RubyIOPipeline::AcquireFree(Ring* ring, bool ruby)
+{
+  Buffer* retval;
+
+  pthread_mutex_lock(&m_mutex);
+  while (ring->free.empty() && !m_aborted) {
+    Wait(ruby);
+  }
+  if (m_aborted) {
+    pthread_mutex_unlock(&m_mutex);
+    throw Err(Exception::OTHER_ERROR, "RubyIOPipeline: aborted");
+  }
+  retval = ring->free.front();
+  ring->free.pop_front();
+  pthread_mutex_unlock(&m_mutex);
+
+  retval->length = 0;
+  return retval;
+}
+
+void RubyIOPipeline::PushFilled(Ring* ring, Buffer* buffer)
+{
+  pthread_mutex_lock(&m_mutex);
+  ring->filled.push_back(buffer);
+  Notify();
+  pthread_mutex_unlock(&m_mutex);
+}
+
+/* Returns the next filled buffer, or NULL once the ring has been closed and
+ * everything in it consumed. */
+RubyIOPipeline::Buffer* RubyIOPipeline::PopFilled(Ring* ring, bool ruby)
+{
+  Buffer* retval = NULL;
+
+  pthread_mutex_lock(&m_mutex);
+  while (ring->filled.empty() && !ring->closed && !m_aborted) {
+    Wait(ruby);
+  }
+  if (m_aborted) {
+    pthread_mutex_unlock(&m_mutex);
+    throw Err(Exception::OTHER_ERROR, "RubyIOPipeline: aborted");
+  }
+  if (!ring->filled.empty()) {
+    retval = ring->filled.front();
+    ring->filled.pop_front();
+  }
+  pthread_mutex_unlock(&m_mutex);
+
+  return retval;
+}
+
+void RubyIOPipeline::Release(Ring* ring, Buffer* buffer)
+{
+  pthread_mutex_lock(&m_mutex);
+  ring->free.push_back(buffer);
+  Notify();
+  pthread_mutex_unlock(&m_mutex);
+}
+
+void RubyIOPipeline::Close(Ring* ring)
+{
+  pthread_mutex_lock(&m_mutex);
+  ring->closed = true;
+  Notify();
+  pthread_mutex_unlock(&m_mutex);
+}
+
+/* Stops every stage. Only the first error is kept. */
+void RubyIOPipeline::Abort(Exception::ErrorType type, const std::string& error)
+{
+  pthread_mutex_lock(&m_mutex);
+  if (!m_aborted) {
+    m_aborted = true;
+    m_errorType = type;
+    m_error = error;
+  }
+  Notify();
+  pthread_mutex_unlock(&m_mutex);
+}
+
+/* Called on the writer thread after a Ruby exception. The exception is
+ * raised again on the calling thread once the pipeline has wound down. */
+void RubyIOPipeline::AbortWithRubyError()
+{
+  VALUE error = rb_errinfo();
+
+  rb_set_errinfo(Qnil);
+  pthread_mutex_lock(&m_mutex);
+  if (!m_aborted && rb_obj_is_kind_of(error, rb_eException)) {
+    m_rubyError = error;
+  }
+  pthread_mutex_unlock(&m_mutex);
+  Abort(Exception::IO_ERROR, "RubyIOPipeline: error writing IO stream");
+}
+
+/* Wakes up everyone waiting. Must be called with the mutex held. */
+void RubyIOPipeline::Notify()
+{
+  ++m_generation;
+  pthread_cond_broadcast(&m_cond);
+}
+
+/* Waits for a Notify. Must be called with the mutex held, and returns with
+ * it held again.
+ *
+ * A Ruby thread can't sit on the mutex while it waits to get the GVL back,
+ * or another Ruby thread holding the GVL could block on the mutex and
+ * neither would get anywhere. So Ruby threads let go of the mutex, wait
+ * without the GVL, and only then take the mutex again. The generation count
+ * makes sure no Notify gets lost in between. Interrupts are checked while
+ * we hold neither, so an exception raised there can't leave the mutex
+ * locked. */
+void RubyIOPipeline::Wait(bool ruby)
+{
+  if (!ruby) {
+    pthread_cond_wait(&m_cond, &m_mutex);
+    return;
+  }
+
+  struct pipeline_wait_args args;
+
+  args.mutex = &m_mutex;
+  args.cond = &m_cond;
+  args.generation = &m_generation;
+  args.seen = m_generation;
+  args.called = false;
+  args.interrupted = false;
+
+  pthread_mutex_unlock(&m_mutex);
+  callWithoutGVLInterruptibly(WaitWithoutGVL, &args, UnblockWait, &args);
+  if (!args.called || args.interrupted) {
+    rb_thread_check_ints();
+  }
+  pthread_mutex_lock(&m_mutex);
+}
+
+void* RubyIOPipeline::WaitWithoutGVL(void* data)
+{
+  struct pipeline_wait_args* args = (struct pipeline_wait_args*) data;
+
+  pthread_mutex_lock(args->mutex);
+  args->called = true;
+  while (*args->generation == args->seen && !args->interrupted) {
+    pthread_cond_wait(args->cond, args->mutex);
+  }
+  pthread_mutex_unlock(args->mutex);
+  return NULL;
+}
+
+void RubyIOPipeline::UnblockWait(void* data)
+{
+  struct pipeline_wait_args* args = (struct pipeline_wait_args*) data;
+
+  pthread_mutex_lock(args->mutex);
+  args->interrupted = true;
+  pthread_cond_broadcast(args->cond);
+  pthread_mutex_unlock(args->mutex);
+}
+
+RubyIOPipeline::Buffer* RubyIOPipeline::RingSink::Current()
+{
+  if (m_current == NULL) {
+    m_current = m_pipeline->AcquireFree(m_ring, m_ruby);
+  }
+  return m_current;
+}
+
+byte* RubyIOPipeline::RingSink::CreatePutSpace(size_t& size)
+{
+  Buffer* buffer = Current();
+  size = buffer->data.size() - buffer->length;
+  return buffer->data + buffer->length;
+}
+
+size_t RubyIOPipeline::RingSink::Put2(const byte* inString, size_t length, int messageEnd, bool blocking)
+{
+  while (length > 0) {
+    Buffer* buffer = Current();
+    size_t segment = STDMIN(length, buffer->data.size() - buffer->length);
+
+    // no need to copy if we were handed our own put space...
+    if (inString != buffer->data + buffer->length) {
+      memcpy(buffer->data + buffer->length, inString, segment);
+    }
+    buffer->length += segment;
+    inString += segment;
+    length -= segment;
+
+    if (buffer->length == buffer->data.size()) {
+      m_pipeline->PushFilled(m_ring, buffer);
+      m_current = NULL;
+    }
+  }
+
+  if (messageEnd) {
+    if (m_current != NULL && m_current->length > 0) {
+      m_pipeline->PushFilled(m_ring, m_current);
+      m_current = NULL;
+    }
+    m_pipeline->Close(m_ring);
+  }
+
+  return 0;
+}
+
+#endif
@@ -0,0 +1,155 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#ifndef __JPIPELINE_H__
+#define __JPIPELINE_H__
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "jsink.h"
+
+// The pipelined mode needs a way to wait without the GVL that leaves
+// interrupts to us, and a native thread to do the crypto on...
+#if defined(HAVE_RB_THREAD_CALL_WITHOUT_GVL2) && defined(HAVE_PTHREAD_H)
+#  define HAVE_RUBY_IO_PIPELINE 1
+#  include <pthread.h>
+#endif
+
+// the number of buffers in each ring of a pipeline
+#define RUBY_IO_PIPELINE_DEPTH 4
+
+using namespace CryptoPP;
+
+/* Pumps a Ruby IO through a transformation and optionally on to another Ruby
+ * IO. Usually that's just a RubyIOSource feeding the transformation with a
+ * RubyIOSink at the end of it, all in order on the calling thread.
+ *
+ * With the pipeline option, the transformation runs on a native worker
+ * thread without the GVL. The calling thread reads into a ring of buffers
+ * for the worker. The worker's output goes into a second ring, which a
+ * Ruby thread writes out. Reading, crypto and writing then overlap, and
+ * only the Ruby-facing IO steps hold the GVL. Without pthreads and
+ * rb_thread_call_without_gvl2, or when running under a fiber scheduler, the
+ * pipeline option is ignored.
+ *
+ * Usage:
+ *
+ *   RubyIOPipeline pipeline(in, out, options);
+ *   pipeline.Run(new StreamTransformationFilter(*cipher, pipeline.CreateSink()));
+ */
+class RubyIOPipeline
+{
+  public:
+    class Err : public Exception
+    {
+      public:
+        Err(ErrorType type, const std::string& s) : Exception(type, s) {}
+    };
+
+    RubyIOPipeline(VALUE* in, VALUE* out, const RubyIOOptions& options);
+    ~RubyIOPipeline();
+
+    // The sink to attach to the end of the transformation to get its
+    // output written to out.
+    BufferedTransformation* CreateSink();
+
+    // Pumps all of in through the transformation, which the pipeline takes
+    // ownership of.
+    void Run(BufferedTransformation* transformation);
+
+  private:
+    VALUE* m_in;
+    VALUE* m_out;
+    RubyIOOptions m_options;
+
+#ifdef HAVE_RUBY_IO_PIPELINE
+    struct Buffer
+    {
+      Buffer(size_t size) : data(size), length(0) {}
+
+      SecByteBlock data;
+      size_t length;
+    };
+
+    // buffers handed from one stage to the next. The consumer puts them
+    // back on free once it's done with them...
+    struct Ring
+    {
+      std::deque<Buffer*> free;
+      std::deque<Buffer*> filled;
+      bool closed;
+    };
+
+    // fills buffers from a ring and passes them on to the next stage. The
+    // put space is the buffer itself, so sources that use it avoid a copy...
+    class RingSink : public Sink
+    {
+      public:
+        RingSink(RubyIOPipeline* pipeline, Ring* ring, bool ruby) :
+          m_pipeline(pipeline), m_ring(ring), m_ruby(ruby), m_current(NULL) {}
+
+        byte* CreatePutSpace(size_t& size);
+        size_t Put2(const byte* inString, size_t length, int messageEnd, bool blocking);
+        bool IsolatedFlush(bool hardFlush, bool blocking) { return false; }
+
+      private:
+        Buffer* Current();
+
+        RubyIOPipeline* m_pipeline;
+        Ring* m_ring;
+        bool m_ruby;
+        Buffer* m_current;
+    };
+
+    void RunPipelined(BufferedTransformation* transformation);
+    void FreeBuffers();
+
+    // ring operations. ruby says whether we're on a Ruby thread, in which
+    // case waiting is done without the GVL. They throw an Err if the
+    // pipeline has been aborted...
+    Buffer* AcquireFree(Ring* ring, bool ruby);
+    void PushFilled(Ring* ring, Buffer* buffer);
+    Buffer* PopFilled(Ring* ring, bool ruby);
+    void Release(Ring* ring, Buffer* buffer);
+    void Close(Ring* ring);
+
+    void Abort(Exception::ErrorType type, const std::string& error);
+    void AbortWithRubyError();
+    void Notify();
+    void Wait(bool ruby);
+
+    static void* Worker(void* data);
+    static VALUE StartWriter(VALUE data);
+    static VALUE Writer(void* data);
+    static VALUE Write(VALUE data);
+    static VALUE Read(VALUE data);
+    static VALUE JoinWriter(VALUE thread);
+    static VALUE KillWriter(VALUE thread);
+    static VALUE CheckInterrupts(VALUE data);
+    static void* JoinWorkerWithoutGVL(void* data);
+    static void* WaitWithoutGVL(void* data);
+    static void UnblockWait(void* data);
+
+    BufferedTransformation* m_transformation;
+    std::vector<Buffer*> m_buffers;
+    Ring m_input;
+    Ring m_output;
+
+    pthread_mutex_t m_mutex;
+    pthread_cond_t m_cond;
+    unsigned long m_generation;
+
+    bool m_aborted;
+    Exception::ErrorType m_errorType;
+    std::string m_error;
+    VALUE m_rubyError;
+#endif
+};
+
+#endif
@@ -41,4 +41,9 @@ BlockCipher* JRC2::getDecryptionObject()
   return new RC2Decryption((byte*) itsKey.data(), itsKeylength, itsEffectiveKeylength);
 }
 
+unsigned int JRC2::getKeyScheduleParameter() const
+{
+  return itsEffectiveKeylength;
+}
+
 #endif
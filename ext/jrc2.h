@@ -31,6 +31,7 @@ class JRC2 : public JCipher_Template<RC2_Info, RC2_CIPHER>
   protected:
     BlockCipher* getEncryptionObject();
     BlockCipher* getDecryptionObject();
+    unsigned int getKeyScheduleParameter() const;
 
     unsigned int itsEffectiveKeylength;
 };
@@ -9,14 +9,16 @@
 
 #if ENABLED_SERPENT_CIPHER
 
+#include "jsimdserpent.h"
+
 BlockCipher* JSerpent::getEncryptionObject()
 {
-  return new SerpentEncryption((byte*) itsKey.data(), itsKeylength);
+  return new SIMDSerpent::Encryption((byte*) itsKey.data(), itsKeylength);
 }
 
 BlockCipher* JSerpent::getDecryptionObject()
 {
-  return new SerpentDecryption((byte*) itsKey.data(), itsKeylength);
+  return new SIMDSerpent::Decryption((byte*) itsKey.data(), itsKeylength);
 }
 
 #endif
@@ -0,0 +1,394 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#include "jsimdserpent.h"
+
+// Crypto++ headers...
+
+#include "misc.h"
+
+// Everything that works on vectors has to be inlined into the kernel that
+// calls it, so it's compiled for that kernel's target.
+#ifdef __GNUC__
+#  define SIMD_INLINE inline __attribute__((always_inline))
+#else
+#  define SIMD_INLINE inline
+#endif
+
+#include "jsimdserpent_sboxes.h"
+
+enum SerpentKernel {
+  UNKNOWN_SERPENT_KERNEL = -1,
+  NO_SERPENT_KERNEL,
+  SSE2_SERPENT_KERNEL,
+  AVX2_SERPENT_KERNEL
+};
+
+#ifdef HAVE_X86_SIMD
+#  include <immintrin.h>
+
+// word i of every block in the batch
+typedef word32 SerpentVector4 __attribute__((vector_size(16)));
+typedef word32 SerpentVector8 __attribute__((vector_size(32)));
+
+static SerpentKernel kernel()
+{
+  static volatile SerpentKernel kernel = UNKNOWN_SERPENT_KERNEL;
+
+  if (kernel == UNKNOWN_SERPENT_KERNEL) {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+      kernel = AVX2_SERPENT_KERNEL;
+    }
+    else if (__builtin_cpu_supports("sse2")) {
+      kernel = SSE2_SERPENT_KERNEL;
+    }
+    else {
+      kernel = NO_SERPENT_KERNEL;
+    }
+  }
+  return kernel;
+}
+
+template <class W>
+static SIMD_INLINE void rotateLeft(W& x, const unsigned int n)
+{
+  x = (x << n) | (x >> (32 - n));
+}
+
+template <class W>
+static SIMD_INLINE void keyMix(W& x0, W& x1, W& x2, W& x3, const word32* k)
+{
+  x0 ^= k[0];
+  x1 ^= k[1];
+  x2 ^= k[2];
+  x3 ^= k[3];
+}
+
+template <class W>
+static SIMD_INLINE void linearTransform(W& x0, W& x1, W& x2, W& x3)
+{
+  rotateLeft(x0, 13);
+  rotateLeft(x2, 3);
+  x1 ^= x0 ^ x2;
+  x3 ^= x2 ^ (x0 << 3);
+  rotateLeft(x1, 1);
+  rotateLeft(x3, 7);
+  x0 ^= x1 ^ x3;
+  x2 ^= x3 ^ (x1 << 7);
+  rotateLeft(x0, 5);
+  rotateLeft(x2, 22);
+}
+
+template <class W>
+static SIMD_INLINE void inverseLinearTransform(W& x0, W& x1, W& x2, W& x3)
+{
+  rotateLeft(x2, 10);
+  rotateLeft(x0, 27);
+  x2 ^= x3 ^ (x1 << 7);
+  x0 ^= x1 ^ x3;
+  rotateLeft(x3, 25);
+  rotateLeft(x1, 31);
+  x3 ^= x2 ^ (x0 << 3);
+  x1 ^= x0 ^ x2;
+  rotateLeft(x2, 29);
+  rotateLeft(x0, 19);
+}
+
+template <class W>
+static SIMD_INLINE void encryptState(W& x0, W& x1, W& x2, W& x3, const word32* k)
+{
+  for (unsigned int round = 0; ; round += 8, k += 32) {
+    keyMix(x0, x1, x2, x3, k);
+    serpentS0(x0, x1, x2, x3);
+    linearTransform(x0, x1, x2, x3);
+    keyMix(x0, x1, x2, x3, k + 4);
+    serpentS1(x0, x1, x2, x3);
+    linearTransform(x0, x1, x2, x3);
+    keyMix(x0, x1, x2, x3, k + 8);
+    serpentS2(x0, x1, x2, x3);
+    linearTransform(x0, x1, x2, x3);
+    keyMix(x0, x1, x2, x3, k + 12);
+    serpentS3(x0, x1, x2, x3);
+    linearTransform(x0, x1, x2, x3);
+    keyMix(x0, x1, x2, x3, k + 16);
+    serpentS4(x0, x1, x2, x3);
+    linearTransform(x0, x1, x2, x3);
+    keyMix(x0, x1, x2, x3, k + 20);
+    serpentS5(x0, x1, x2, x3);
+    linearTransform(x0, x1, x2, x3);
+    keyMix(x0, x1, x2, x3, k + 24);
+    serpentS6(x0, x1, x2, x3);
+    linearTransform(x0, x1, x2, x3);
+    keyMix(x0, x1, x2, x3, k + 28);
+    serpentS7(x0, x1, x2, x3);
+
+    // the last round has a key mix where the others have the linear
+    // transformation
+    if (round == 24) {
+      break;
+    }
+    linearTransform(x0, x1, x2, x3);
+  }
+  keyMix(x0, x1, x2, x3, k + 32);
+}
+
+template <class W>
+static SIMD_INLINE void decryptState(W& x0, W& x1, W& x2, W& x3, const word32* k)
+{
+  keyMix(x0, x1, x2, x3, k + 128);
+
+  for (unsigned int round = 24; ; round -= 8) {
+    const word32* rk = k + round * 4;
+
+    serpentInvS7(x0, x1, x2, x3);
+    keyMix(x0, x1, x2, x3, rk + 28);
+    inverseLinearTransform(x0, x1, x2, x3);
+    serpentInvS6(x0, x1, x2, x3);
+    keyMix(x0, x1, x2, x3, rk + 24);
+    inverseLinearTransform(x0, x1, x2, x3);
+    serpentInvS5(x0, x1, x2, x3);
+    keyMix(x0, x1, x2, x3, rk + 20);
+    inverseLinearTransform(x0, x1, x2, x3);
+    serpentInvS4(x0, x1, x2, x3);
+    keyMix(x0, x1, x2, x3, rk + 16);
+    inverseLinearTransform(x0, x1, x2, x3);
+    serpentInvS3(x0, x1, x2, x3);
+    keyMix(x0, x1, x2, x3, rk + 12);
+    inverseLinearTransform(x0, x1, x2, x3);
+    serpentInvS2(x0, x1, x2, x3);
+    keyMix(x0, x1, x2, x3, rk + 8);
+    inverseLinearTransform(x0, x1, x2, x3);
+    serpentInvS1(x0, x1, x2, x3);
+    keyMix(x0, x1, x2, x3, rk + 4);
+    inverseLinearTransform(x0, x1, x2, x3);
+    serpentInvS0(x0, x1, x2, x3);
+    keyMix(x0, x1, x2, x3, rk);
+
+    if (round == 0) {
+      break;
+    }
+    inverseLinearTransform(x0, x1, x2, x3);
+  }
+}
+
+template <class W>
+static SIMD_INLINE void runState(W& x0, W& x1, W& x2, W& x3, const word32* k, const bool encryption)
+{
+  if (encryption) {
+    encryptState(x0, x1, x2, x3, k);
+  }
+  else {
+    decryptState(x0, x1, x2, x3, k);
+  }
+}
+
+/* The kernels run a full batch from in to out. The blocks come in as rows
+ * and get transposed, so that vector i holds word i of every block, and
+ * transposed back on the way out. With AVX2 the transpose stays within each
+ * 128-bit half, which shuffles the order of the blocks across the lanes,
+ * but as every lane gets the same treatment the order doesn't matter, and
+ * the same transpose puts them back. */
+
+__attribute__((target("sse2")))
+static inline void transpose(__m128i& a, __m128i& b, __m128i& c, __m128i& d)
+{
+  const __m128i t0 = _mm_unpacklo_epi32(a, b);
+  const __m128i t1 = _mm_unpackhi_epi32(a, b);
+  const __m128i t2 = _mm_unpacklo_epi32(c, d);
+  const __m128i t3 = _mm_unpackhi_epi32(c, d);
+
+  a = _mm_unpacklo_epi64(t0, t2);
+  b = _mm_unpackhi_epi64(t0, t2);
+  c = _mm_unpacklo_epi64(t1, t3);
+  d = _mm_unpackhi_epi64(t1, t3);
+}
+
+__attribute__((target("avx2")))
+static inline void transpose(__m256i& a, __m256i& b, __m256i& c, __m256i& d)
+{
+  const __m256i t0 = _mm256_unpacklo_epi32(a, b);
+  const __m256i t1 = _mm256_unpackhi_epi32(a, b);
+  const __m256i t2 = _mm256_unpacklo_epi32(c, d);
+  const __m256i t3 = _mm256_unpackhi_epi32(c, d);
+
+  a = _mm256_unpacklo_epi64(t0, t2);
+  b = _mm256_unpackhi_epi64(t0, t2);
+  c = _mm256_unpacklo_epi64(t1, t3);
+  d = _mm256_unpackhi_epi64(t1, t3);
+}
+
+__attribute__((target("sse2")))
+static void runBlocksSSE2(const word32* k, const byte* in, byte* out, const bool encryption)
+{
+  __m128i a = _mm_loadu_si128((const __m128i*) in);
+  __m128i b = _mm_loadu_si128((const __m128i*) (in + 16));
+  __m128i c = _mm_loadu_si128((const __m128i*) (in + 32));
+  __m128i d = _mm_loadu_si128((const __m128i*) (in + 48));
+
+  transpose(a, b, c, d);
+  SerpentVector4 x0 = (SerpentVector4) a, x1 = (SerpentVector4) b, x2 = (SerpentVector4) c, x3 = (SerpentVector4) d;
+  runState(x0, x1, x2, x3, k, encryption);
+  a = (__m128i) x0;
+  b = (__m128i) x1;
+  c = (__m128i) x2;
+  d = (__m128i) x3;
+  transpose(a, b, c, d);
+
+  _mm_storeu_si128((__m128i*) out, a);
+  _mm_storeu_si128((__m128i*) (out + 16), b);
+  _mm_storeu_si128((__m128i*) (out + 32), c);
+  _mm_storeu_si128((__m128i*) (out + 48), d);
+}
+
+__attribute__((target("avx2")))
+static void runBlocksAVX2(const word32* k, const byte* in, byte* out, const bool encryption)
+{
+  __m256i a = _mm256_loadu_si256((const __m256i*) in);
+  __m256i b = _mm256_loadu_si256((const __m256i*) (in + 32));
+  __m256i c = _mm256_loadu_si256((const __m256i*) (in + 64));
+  __m256i d = _mm256_loadu_si256((const __m256i*) (in + 96));
+
+  transpose(a, b, c, d);
+  SerpentVector8 x0 = (SerpentVector8) a, x1 = (SerpentVector8) b, x2 = (SerpentVector8) c, x3 = (SerpentVector8) d;
+  runState(x0, x1, x2, x3, k, encryption);
+  a = (__m256i) x0;
+  b = (__m256i) x1;
+  c = (__m256i) x2;
+  d = (__m256i) x3;
+  transpose(a, b, c, d);
+
+  _mm256_storeu_si256((__m256i*) out, a);
+  _mm256_storeu_si256((__m256i*) (out + 32), b);
+  _mm256_storeu_si256((__m256i*) (out + 64), c);
+  _mm256_storeu_si256((__m256i*) (out + 96), d);
+}
+
+#endif
+
+unsigned int SIMDSerpentEngine::parallelBlocks() const
+{
+#ifdef HAVE_X86_SIMD
+  switch (kernel()) {
+    case AVX2_SERPENT_KERNEL:
+      return 8;
+
+    case SSE2_SERPENT_KERNEL:
+      return 4;
+
+    default:
+      return 0;
+  }
+#else
+  return 0;
+#endif
+}
+
+void SIMDSerpentEngine::setKey(const byte* key, size_t keylength, const bool encryption)
+{
+  m_encryption = encryption;
+
+  // no sense in a key schedule that nothing will use
+  if (parallelBlocks() == 0) {
+    return;
+  }
+
+  // the key is padded out to 256 bits with a 1 bit and then 0s, and the
+  // prekeys follow on from it
+  word32 w[8 + 33 * 4];
+
+  memset(w, 0, 8 * sizeof(word32));
+  for (size_t i = 0; i < keylength; ++i) {
+    w[i / 4] |= word32(key[i]) << ((i % 4) * 8);
+  }
+  if (keylength < 32) {
+    w[keylength / 4] |= word32(1) << ((keylength % 4) * 8);
+  }
+
+  for (unsigned int i = 8; i < 8 + 33 * 4; ++i) {
+    w[i] = rotlFixed(w[i - 8] ^ w[i - 5] ^ w[i - 3] ^ w[i - 1] ^ 0x9e3779b9 ^ (i - 8), 11);
+  }
+
+  // round key i is the prekeys 4i to 4i + 3 through S-box 3 - i, mod 8
+  for (unsigned int i = 0; i < 33; ++i) {
+    word32* k = m_roundKeys + i * 4;
+
+    k[0] = w[8 + i * 4];
+    k[1] = w[8 + i * 4 + 1];
+    k[2] = w[8 + i * 4 + 2];
+    k[3] = w[8 + i * 4 + 3];
+
+    switch ((3 - i) & 7) {
+      case 0: serpentS0(k[0], k[1], k[2], k[3]); break;
+      case 1: serpentS1(k[0], k[1], k[2], k[3]); break;
+      case 2: serpentS2(k[0], k[1], k[2], k[3]); break;
+      case 3: serpentS3(k[0], k[1], k[2], k[3]); break;
+      case 4: serpentS4(k[0], k[1], k[2], k[3]); break;
+      case 5: serpentS5(k[0], k[1], k[2], k[3]); break;
+      case 6: serpentS6(k[0], k[1], k[2], k[3]); break;
+      case 7: serpentS7(k[0], k[1], k[2], k[3]); break;
+    }
+  }
+
+  SecureWipeArray(w, 8 + 33 * 4);
+}
+
+size_t SIMDSerpentEngine::processBlocks(const byte* inBlocks, const byte* xorBlocks, byte* outBlocks, size_t length, word32 flags) const
+{
+  const unsigned int parallel = parallelBlocks();
+  const size_t blocks = length / 16;
+  const bool counter = (flags & BlockTransformation::BT_InBlockIsCounter) != 0;
+  const bool reverse = (flags & BlockTransformation::BT_ReverseDirection) != 0;
+  byte buffer[16 * SIMD_SERPENT_MAX_PARALLEL_BLOCKS];
+
+  for (size_t done = 0; done < blocks;) {
+    const size_t n = STDMIN(blocks - done, (size_t) parallel);
+
+    // as with CBC decryption, where each xor block is the input block
+    // before it, so working backwards is what makes it safe in place
+    const size_t first = reverse ? blocks - done - n : done;
+
+    if (counter) {
+      for (size_t i = 0; i < n; ++i) {
+        memcpy(buffer + i * 16, inBlocks, 16);
+        buffer[i * 16 + 15] += (byte) (done + i);
+      }
+    }
+    else {
+      memcpy(buffer, inBlocks + first * 16, n * 16);
+    }
+
+    // a short batch runs the whole kernel all the same, and the spare
+    // lanes are just thrown away
+    memset(buffer + n * 16, 0, (parallel - n) * 16);
+
+#ifdef HAVE_X86_SIMD
+    if (parallel == 8) {
+      runBlocksAVX2(m_roundKeys, buffer, buffer, m_encryption);
+    }
+    else {
+      runBlocksSSE2(m_roundKeys, buffer, buffer, m_encryption);
+    }
+#endif
+
+    if (xorBlocks != NULL) {
+      xorbuf(buffer, xorBlocks + first * 16, n * 16);
+    }
+    memcpy(outBlocks + first * 16, buffer, n * 16);
+
+    done += n;
+  }
+
+  // CTR mode picks the counter up from where we leave it...
+  if (counter) {
+    const_cast<byte*>(inBlocks)[15] += (byte) blocks;
+  }
+
+  SecureWipeArray(buffer, sizeof(buffer));
+
+  return length % 16;
+}
@@ -0,0 +1,51 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#ifndef __JSIMDSERPENT_H__
+#define __JSIMDSERPENT_H__
+
+// Crypto++ headers...
+
+#include "serpent.h"
+#include "secblock.h"
+
+#include "jparallelcipher.h"
+
+// the most blocks a kernel runs at once, eight with AVX2
+#define SIMD_SERPENT_MAX_PARALLEL_BLOCKS 8
+
+using namespace CryptoPP;
+
+/* Runs Serpent over four blocks at once with SSE2 or eight with AVX2,
+ * whichever the CPU has, picked at runtime. Serpent is bitsliced within a
+ * block to begin with, so each of the four words of the state becomes a
+ * vector holding that word from every block, and the rounds run on the
+ * vectors just as they would on words. The S-box circuits are generated by
+ * extras/serpent_sboxes.rb.
+ *
+ * It runs its own key schedule, the layout of Crypto++'s being private to
+ * its Serpent, and is wrapped up as a Crypto++ block cipher by
+ * ParallelCipher_Template. Without HAVE_X86_SIMD, or on a CPU without SSE2,
+ * parallelBlocks is 0 and it's never used. */
+class SIMDSerpentEngine
+{
+  public:
+    void setKey(const byte* key, size_t keylength, const bool encryption);
+
+    unsigned int parallelBlocks() const;
+    unsigned int minimumBlocks() const { return 2; }
+
+    size_t processBlocks(const byte* inBlocks, const byte* xorBlocks, byte* outBlocks, size_t length, word32 flags) const;
+
+  private:
+    FixedSizeSecBlock<word32, 33 * 4> m_roundKeys;
+    bool m_encryption;
+};
+
+typedef ParallelCipher_Template<Serpent_Info, Serpent, SIMDSerpentEngine> SIMDSerpent;
+
+#endif
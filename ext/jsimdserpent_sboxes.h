@@ -0,0 +1,604 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+/* Generated by extras/serpent_sboxes.rb. Don't edit this by hand, change
+ * the generator and run it again. */
+
+#ifndef __JSIMDSERPENT_SBOXES_H__
+#define __JSIMDSERPENT_SBOXES_H__
+
+// 20 gates
+template <class W>
+static SIMD_INLINE void serpentS0(W& x0, W& x1, W& x2, W& x3)
+{
+  const W t1 = x0 | x3;
+  const W t2 = t1 ^ x1;
+  const W t3 = t2 ^ x2;
+  const W t4 = ~x0;
+  const W t5 = t4 ^ x3;
+  const W t6 = t5 & x1;
+  const W t7 = x3 ^ t6;
+  const W t8 = x1 & ~t5;
+  const W t9 = x0 ^ t8;
+  const W t10 = t9 & x2;
+  const W t11 = t7 ^ t10;
+  const W t12 = x1 & x3;
+  const W t13 = t4 ^ t12;
+  const W t14 = t7 ^ t1;
+  const W t15 = t14 & x2;
+  const W t16 = t13 ^ t15;
+  const W t17 = x0 & x1;
+  const W t18 = t5 ^ t17;
+  const W t19 = x2 & ~t14;
+  const W t20 = t18 ^ t19;
+
+  const W y0 = t20;
+  const W y1 = t16;
+  const W y2 = t11;
+  const W y3 = t3;
+
+  x0 = y0;
+  x1 = y1;
+  x2 = y2;
+  x3 = y3;
+}
+
+// 22 gates
+template <class W>
+static SIMD_INLINE void serpentS1(W& x0, W& x1, W& x2, W& x3)
+{
+  const W t1 = ~x3;
+  const W t2 = t1 | ~x2;
+  const W t3 = t2 & x1;
+  const W t4 = t1 ^ t3;
+  const W t5 = x2 | x3;
+  const W t6 = x1 & x3;
+  const W t7 = t5 ^ t6;
+  const W t8 = t7 & x0;
+  const W t9 = t4 ^ t8;
+  const W t10 = t1 ^ x2;
+  const W t11 = t10 ^ x1;
+  const W t12 = x0 & x1;
+  const W t13 = t11 ^ t12;
+  const W t14 = t10 | t6;
+  const W t15 = t11 | x3;
+  const W t16 = t15 & x0;
+  const W t17 = t14 ^ t16;
+  const W t18 = x1 & ~t7;
+  const W t19 = t2 ^ t18;
+  const W t20 = x2 | ~x3;
+  const W t21 = t20 & x0;
+  const W t22 = t19 ^ t21;
+
+  const W y0 = t22;
+  const W y1 = t17;
+  const W y2 = t13;
+  const W y3 = t9;
+
+  x0 = y0;
+  x1 = y1;
+  x2 = y2;
+  x3 = y3;
+}
+
+// 19 gates
+template <class W>
+static SIMD_INLINE void serpentS2(W& x0, W& x1, W& x2, W& x3)
+{
+  const W t1 = ~x1;
+  const W t2 = t1 ^ x0;
+  const W t3 = t1 | ~x0;
+  const W t4 = t3 & x2;
+  const W t5 = t2 ^ t4;
+  const W t6 = x1 & x3;
+  const W t7 = t5 ^ t6;
+  const W t8 = x0 ^ x1;
+  const W t9 = x1 & x2;
+  const W t10 = t8 ^ t9;
+  const W t11 = t5 | x0;
+  const W t12 = t11 & x3;
+  const W t13 = t10 ^ t12;
+  const W t14 = t9 | ~t5;
+  const W t15 = t11 ^ t2;
+  const W t16 = t15 & x3;
+  const W t17 = t14 ^ t16;
+  const W t18 = t11 ^ t3;
+  const W t19 = t18 ^ x3;
+
+  const W y0 = t19;
+  const W y1 = t17;
+  const W y2 = t13;
+  const W y3 = t7;
+
+  x0 = y0;
+  x1 = y1;
+  x2 = y2;
+  x3 = y3;
+}
+
+// 22 gates
+template <class W>
+static SIMD_INLINE void serpentS3(W& x0, W& x1, W& x2, W& x3)
+{
+  const W t1 = x2 | x3;
+  const W t2 = t1 ^ x1;
+  const W t3 = x3 | ~x2;
+  const W t4 = x1 & ~x2;
+  const W t5 = t3 ^ t4;
+  const W t6 = t5 & x0;
+  const W t7 = t2 ^ t6;
+  const W t8 = x2 ^ x3;
+  const W t9 = x1 & x3;
+  const W t10 = t8 ^ t9;
+  const W t11 = t8 | ~x1;
+  const W t12 = t11 & x0;
+  const W t13 = t10 ^ t12;
+  const W t14 = t8 ^ t2;
+  const W t15 = t9 | ~t1;
+  const W t16 = t15 & x0;
+  const W t17 = t14 ^ t16;
+  const W t18 = x3 & ~x2;
+  const W t19 = t3 & x1;
+  const W t20 = t18 ^ t19;
+  const W t21 = x0 & ~t18;
+  const W t22 = t20 ^ t21;
+
+  const W y0 = t22;
+  const W y1 = t17;
+  const W y2 = t13;
+  const W y3 = t7;
+
+  x0 = y0;
+  x1 = y1;
+  x2 = y2;
+  x3 = y3;
+}
+
+// 20 gates
+template <class W>
+static SIMD_INLINE void serpentS4(W& x0, W& x1, W& x2, W& x3)
+{
+  const W t1 = x0 ^ x1;
+  const W t2 = x0 | x1;
+  const W t3 = t2 & x3;
+  const W t4 = t1 ^ t3;
+  const W t5 = x2 & ~x1;
+  const W t6 = t4 ^ t5;
+  const W t7 = x0 & ~x1;
+  const W t8 = t3 & ~x0;
+  const W t9 = t7 ^ t8;
+  const W t10 = x0 | ~x1;
+  const W t11 = x3 & ~x1;
+  const W t12 = t10 ^ t11;
+  const W t13 = t12 & x2;
+  const W t14 = t9 ^ t13;
+  const W t15 = t11 ^ x0;
+  const W t16 = t1 | x3;
+  const W t17 = t16 & x2;
+  const W t18 = t15 ^ t17;
+  const W t19 = t7 | ~t16;
+  const W t20 = t19 ^ x2;
+
+  const W y0 = t20;
+  const W y1 = t18;
+  const W y2 = t14;
+  const W y3 = t6;
+
+  x0 = y0;
+  x1 = y1;
+  x2 = y2;
+  x3 = y3;
+}
+
+// 21 gates
+template <class W>
+static SIMD_INLINE void serpentS5(W& x0, W& x1, W& x2, W& x3)
+{
+  const W t1 = ~x3;
+  const W t2 = t1 ^ x1;
+  const W t3 = t2 ^ x2;
+  const W t4 = x2 & ~t2;
+  const W t5 = t1 ^ t4;
+  const W t6 = t5 & x0;
+  const W t7 = t3 ^ t6;
+  const W t8 = t4 & x3;
+  const W t9 = t2 ^ t8;
+  const W t10 = x1 & x3;
+  const W t11 = x2 & ~x3;
+  const W t12 = t10 ^ t11;
+  const W t13 = t12 & x0;
+  const W t14 = t9 ^ t13;
+  const W t15 = t12 ^ t1;
+  const W t16 = x3 | ~x1;
+  const W t17 = t16 & x0;
+  const W t18 = t15 ^ t17;
+  const W t19 = t10 ^ t3;
+  const W t20 = x0 & ~t2;
+  const W t21 = t19 ^ t20;
+
+  const W y0 = t21;
+  const W y1 = t18;
+  const W y2 = t14;
+  const W y3 = t7;
+
+  x0 = y0;
+  x1 = y1;
+  x2 = y2;
+  x3 = y3;
+}
+
+// 20 gates
+template <class W>
+static SIMD_INLINE void serpentS6(W& x0, W& x1, W& x2, W& x3)
+{
+  const W t1 = x1 & ~x0;
+  const W t2 = x1 | ~x0;
+  const W t3 = t2 & x2;
+  const W t4 = t1 ^ t3;
+  const W t5 = x1 | ~x2;
+  const W t6 = t5 & x3;
+  const W t7 = t4 ^ t6;
+  const W t8 = x2 & ~t1;
+  const W t9 = t2 ^ t8;
+  const W t10 = t1 | ~t5;
+  const W t11 = t10 & x3;
+  const W t12 = t9 ^ t11;
+  const W t13 = ~x1;
+  const W t14 = t13 ^ x2;
+  const W t15 = x0 & x3;
+  const W t16 = t14 ^ t15;
+  const W t17 = t2 & ~t10;
+  const W t18 = t4 | ~x1;
+  const W t19 = t18 & x3;
+  const W t20 = t17 ^ t19;
+
+  const W y0 = t20;
+  const W y1 = t16;
+  const W y2 = t12;
+  const W y3 = t7;
+
+  x0 = y0;
+  x1 = y1;
+  x2 = y2;
+  x3 = y3;
+}
+
+// 23 gates
+template <class W>
+static SIMD_INLINE void serpentS7(W& x0, W& x1, W& x2, W& x3)
+{
+  const W t1 = x0 | x2;
+  const W t2 = ~x0;
+  const W t3 = t2 | ~x2;
+  const W t4 = t3 & x1;
+  const W t5 = t1 ^ t4;
+  const W t6 = x0 & x3;
+  const W t7 = t5 ^ t6;
+  const W t8 = t5 & t3;
+  const W t9 = t5 & x1;
+  const W t10 = t2 ^ t9;
+  const W t11 = t10 & x3;
+  const W t12 = t8 ^ t11;
+  const W t13 = x2 & ~x0;
+  const W t14 = t13 ^ t9;
+  const W t15 = x2 | ~x0;
+  const W t16 = x0 & x1;
+  const W t17 = t15 ^ t16;
+  const W t18 = t17 & x3;
+  const W t19 = t14 ^ t18;
+  const W t20 = t17 ^ t1;
+  const W t21 = t5 | x2;
+  const W t22 = t21 & x3;
+  const W t23 = t20 ^ t22;
+
+  const W y0 = t23;
+  const W y1 = t19;
+  const W y2 = t12;
+  const W y3 = t7;
+
+  x0 = y0;
+  x1 = y1;
+  x2 = y2;
+  x3 = y3;
+}
+
+// 21 gates
+template <class W>
+static SIMD_INLINE void serpentInvS0(W& x0, W& x1, W& x2, W& x3)
+{
+  const W t1 = x2 | ~x3;
+  const W t2 = t1 ^ x3;
+  const W t3 = t2 & x0;
+  const W t4 = t1 ^ t3;
+  const W t5 = x2 & ~x3;
+  const W t6 = x0 & x3;
+  const W t7 = t5 ^ t6;
+  const W t8 = t7 & x1;
+  const W t9 = t4 ^ t8;
+  const W t10 = t5 ^ t1;
+  const W t11 = t10 ^ x0;
+  const W t12 = x1 & ~x0;
+  const W t13 = t11 ^ t12;
+  const W t14 = x0 & ~t5;
+  const W t15 = x2 ^ t14;
+  const W t16 = t1 & x1;
+  const W t17 = t15 ^ t16;
+  const W t18 = t10 | ~t7;
+  const W t19 = x3 | ~t11;
+  const W t20 = t19 & x1;
+  const W t21 = t18 ^ t20;
+
+  const W y0 = t21;
+  const W y1 = t17;
+  const W y2 = t13;
+  const W y3 = t9;
+
+  x0 = y0;
+  x1 = y1;
+  x2 = y2;
+  x3 = y3;
+}
+
+// 21 gates
+template <class W>
+static SIMD_INLINE void serpentInvS1(W& x0, W& x1, W& x2, W& x3)
+{
+  const W t1 = x0 ^ x2;
+  const W t2 = x3 & ~x1;
+  const W t3 = t1 ^ t2;
+  const W t4 = x2 | ~x0;
+  const W t5 = x0 | ~x2;
+  const W t6 = t5 & x1;
+  const W t7 = t4 ^ t6;
+  const W t8 = t1 | ~x2;
+  const W t9 = t8 & x3;
+  const W t10 = t7 ^ t9;
+  const W t11 = t8 & x1;
+  const W t12 = x2 ^ t11;
+  const W t13 = t7 | x2;
+  const W t14 = t13 & x3;
+  const W t15 = t12 ^ t14;
+  const W t16 = ~x0;
+  const W t17 = t4 & x1;
+  const W t18 = t16 ^ t17;
+  const W t19 = t6 | ~t8;
+  const W t20 = t19 & x3;
+  const W t21 = t18 ^ t20;
+
+  const W y0 = t21;
+  const W y1 = t15;
+  const W y2 = t10;
+  const W y3 = t3;
+
+  x0 = y0;
+  x1 = y1;
+  x2 = y2;
+  x3 = y3;
+}
+
+// 20 gates
+template <class W>
+static SIMD_INLINE void serpentInvS2(W& x0, W& x1, W& x2, W& x3)
+{
+  const W t1 = ~x3;
+  const W t2 = x2 & x3;
+  const W t3 = t2 & x0;
+  const W t4 = t1 ^ t3;
+  const W t5 = x0 | x2;
+  const W t6 = t5 & x1;
+  const W t7 = t4 ^ t6;
+  const W t8 = t1 ^ x2;
+  const W t9 = t4 & x0;
+  const W t10 = t8 ^ t9;
+  const W t11 = x0 | x3;
+  const W t12 = t11 & x1;
+  const W t13 = t10 ^ t12;
+  const W t14 = t5 & ~t8;
+  const W t15 = x3 | ~x0;
+  const W t16 = t15 & x1;
+  const W t17 = t14 ^ t16;
+  const W t18 = x0 ^ x2;
+  const W t19 = t8 & x1;
+  const W t20 = t18 ^ t19;
+
+  const W y0 = t20;
+  const W y1 = t17;
+  const W y2 = t13;
+  const W y3 = t7;
+
+  x0 = y0;
+  x1 = y1;
+  x2 = y2;
+  x3 = y3;
+}
+
+// 22 gates
+template <class W>
+static SIMD_INLINE void serpentInvS3(W& x0, W& x1, W& x2, W& x3)
+{
+  const W t1 = x0 | x2;
+  const W t2 = x0 ^ x2;
+  const W t3 = t2 & x3;
+  const W t4 = t1 ^ t3;
+  const W t5 = t2 | ~x2;
+  const W t6 = x0 & x3;
+  const W t7 = t5 ^ t6;
+  const W t8 = t7 & x1;
+  const W t9 = t4 ^ t8;
+  const W t10 = t3 | ~t7;
+  const W t11 = x3 & ~x0;
+  const W t12 = t2 ^ t11;
+  const W t13 = t12 & x1;
+  const W t14 = t10 ^ t13;
+  const W t15 = t7 & x3;
+  const W t16 = x2 ^ t15;
+  const W t17 = t10 | ~x2;
+  const W t18 = t17 & x1;
+  const W t19 = t16 ^ t18;
+  const W t20 = x2 | x3;
+  const W t21 = t20 & x1;
+  const W t22 = t12 ^ t21;
+
+  const W y0 = t22;
+  const W y1 = t19;
+  const W y2 = t14;
+  const W y3 = t9;
+
+  x0 = y0;
+  x1 = y1;
+  x2 = y2;
+  x3 = y3;
+}
+
+// 21 gates
+template <class W>
+static SIMD_INLINE void serpentInvS4(W& x0, W& x1, W& x2, W& x3)
+{
+  const W t1 = ~x3;
+  const W t2 = x2 & ~x3;
+  const W t3 = x1 ^ t2;
+  const W t4 = x1 | x3;
+  const W t5 = t4 & x0;
+  const W t6 = t3 ^ t5;
+  const W t7 = t1 & ~x1;
+  const W t8 = t7 ^ x2;
+  const W t9 = x3 | ~x1;
+  const W t10 = x2 & ~x1;
+  const W t11 = t9 ^ t10;
+  const W t12 = t11 & x0;
+  const W t13 = t8 ^ t12;
+  const W t14 = x2 ^ x3;
+  const W t15 = t3 ^ x3;
+  const W t16 = t15 & x0;
+  const W t17 = t14 ^ t16;
+  const W t18 = t3 ^ t1;
+  const W t19 = t8 ^ t3;
+  const W t20 = t19 & x0;
+  const W t21 = t18 ^ t20;
+
+  const W y0 = t21;
+  const W y1 = t17;
+  const W y2 = t13;
+  const W y3 = t6;
+
+  x0 = y0;
+  x1 = y1;
+  x2 = y2;
+  x3 = y3;
+}
+
+// 19 gates
+template <class W>
+static SIMD_INLINE void serpentInvS5(W& x0, W& x1, W& x2, W& x3)
+{
+  const W t1 = ~x0;
+  const W t2 = t1 | ~x3;
+  const W t3 = t2 ^ x2;
+  const W t4 = x2 | ~x0;
+  const W t5 = t4 & x1;
+  const W t6 = t3 ^ t5;
+  const W t7 = t2 & x2;
+  const W t8 = x0 ^ t7;
+  const W t9 = x0 | x3;
+  const W t10 = t9 & x1;
+  const W t11 = t8 ^ t10;
+  const W t12 = x0 & x2;
+  const W t13 = t9 ^ t12;
+  const W t14 = t12 ^ t3;
+  const W t15 = t14 & x1;
+  const W t16 = t13 ^ t15;
+  const W t17 = x0 ^ x3;
+  const W t18 = x1 & ~t3;
+  const W t19 = t17 ^ t18;
+
+  const W y0 = t19;
+  const W y1 = t16;
+  const W y2 = t11;
+  const W y3 = t6;
+
+  x0 = y0;
+  x1 = y1;
+  x2 = y2;
+  x3 = y3;
+}
+
+// 21 gates
+template <class W>
+static SIMD_INLINE void serpentInvS6(W& x0, W& x1, W& x2, W& x3)
+{
+  const W t1 = ~x3;
+  const W t2 = t1 & ~x2;
+  const W t3 = x0 & x3;
+  const W t4 = t2 ^ t3;
+  const W t5 = x3 | ~x2;
+  const W t6 = t1 ^ x2;
+  const W t7 = t6 & x0;
+  const W t8 = t5 ^ t7;
+  const W t9 = t8 & x1;
+  const W t10 = t4 ^ t9;
+  const W t11 = t1 | ~x2;
+  const W t12 = t11 ^ x0;
+  const W t13 = t4 & x1;
+  const W t14 = t12 ^ t13;
+  const W t15 = x0 & x2;
+  const W t16 = t6 ^ t15;
+  const W t17 = t16 ^ x1;
+  const W t18 = x0 & ~x2;
+  const W t19 = t1 ^ t18;
+  const W t20 = x1 & ~t8;
+  const W t21 = t19 ^ t20;
+
+  const W y0 = t21;
+  const W y1 = t17;
+  const W y2 = t14;
+  const W y3 = t10;
+
+  x0 = y0;
+  x1 = y1;
+  x2 = y2;
+  x3 = y3;
+}
+
+// 22 gates
+template <class W>
+static SIMD_INLINE void serpentInvS7(W& x0, W& x1, W& x2, W& x3)
+{
+  const W t1 = x0 & x3;
+  const W t2 = t1 ^ x2;
+  const W t3 = x0 | x3;
+  const W t4 = x0 & x2;
+  const W t5 = t3 ^ t4;
+  const W t6 = t5 & x1;
+  const W t7 = t2 ^ t6;
+  const W t8 = t3 & x2;
+  const W t9 = x3 ^ t8;
+  const W t10 = x1 & ~t1;
+  const W t11 = t9 ^ t10;
+  const W t12 = ~t3;
+  const W t13 = x2 & ~t1;
+  const W t14 = t12 ^ t13;
+  const W t15 = x2 | x3;
+  const W t16 = t15 & x1;
+  const W t17 = t14 ^ t16;
+  const W t18 = ~x0;
+  const W t19 = x2 & x3;
+  const W t20 = t18 ^ t19;
+  const W t21 = t16 ^ t10;
+  const W t22 = t20 ^ t21;
+
+  const W y0 = t22;
+  const W y1 = t17;
+  const W y2 = t11;
+  const W y3 = t7;
+
+  x0 = y0;
+  x1 = y1;
+  x2 = y2;
+  x3 = y3;
+}
+
+#endif
@@ -0,0 +1,411 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#include "jsimdtwofish.h"
+
+// Crypto++ headers...
+
+#include "misc.h"
+
+/* The key schedule follows the Twofish paper. The S-boxes it builds are
+ * the four tables of g, each one a byte of the input run through h's q
+ * permutations and key bytes and then multiplied by its column of the MDS
+ * matrix, so g is four lookups xored together. */
+
+// the fixed permutations q0 and q1
+static const byte q[2][256] = {
+  {
+    0xa9, 0x67, 0xb3, 0xe8, 0x04, 0xfd, 0xa3, 0x76, 0x9a, 0x92, 0x80, 0x78, 0xe4, 0xdd, 0xd1, 0x38,
+    0x0d, 0xc6, 0x35, 0x98, 0x18, 0xf7, 0xec, 0x6c, 0x43, 0x75, 0x37, 0x26, 0xfa, 0x13, 0x94, 0x48,
+    0xf2, 0xd0, 0x8b, 0x30, 0x84, 0x54, 0xdf, 0x23, 0x19, 0x5b, 0x3d, 0x59, 0xf3, 0xae, 0xa2, 0x82,
+    0x63, 0x01, 0x83, 0x2e, 0xd9, 0x51, 0x9b, 0x7c, 0xa6, 0xeb, 0xa5, 0xbe, 0x16, 0x0c, 0xe3, 0x61,
+    0xc0, 0x8c, 0x3a, 0xf5, 0x73, 0x2c, 0x25, 0x0b, 0xbb, 0x4e, 0x89, 0x6b, 0x53, 0x6a, 0xb4, 0xf1,
+    0xe1, 0xe6, 0xbd, 0x45, 0xe2, 0xf4, 0xb6, 0x66, 0xcc, 0x95, 0x03, 0x56, 0xd4, 0x1c, 0x1e, 0xd7,
+    0xfb, 0xc3, 0x8e, 0xb5, 0xe9, 0xcf, 0xbf, 0xba, 0xea, 0x77, 0x39, 0xaf, 0x33, 0xc9, 0x62, 0x71,
+    0x81, 0x79, 0x09, 0xad, 0x24, 0xcd, 0xf9, 0xd8, 0xe5, 0xc5, 0xb9, 0x4d, 0x44, 0x08, 0x86, 0xe7,
+    0xa1, 0x1d, 0xaa, 0xed, 0x06, 0x70, 0xb2, 0xd2, 0x41, 0x7b, 0xa0, 0x11, 0x31, 0xc2, 0x27, 0x90,
+    0x20, 0xf6, 0x60, 0xff, 0x96, 0x5c, 0xb1, 0xab, 0x9e, 0x9c, 0x52, 0x1b, 0x5f, 0x93, 0x0a, 0xef,
+    0x91, 0x85, 0x49, 0xee, 0x2d, 0x4f, 0x8f, 0x3b, 0x47, 0x87, 0x6d, 0x46, 0xd6, 0x3e, 0x69, 0x64,
+    0x2a, 0xce, 0xcb, 0x2f, 0xfc, 0x97, 0x05, 0x7a, 0xac, 0x7f, 0xd5, 0x1a, 0x4b, 0x0e, 0xa7, 0x5a,
+    0x28, 0x14, 0x3f, 0x29, 0x88, 0x3c, 0x4c, 0x02, 0xb8, 0xda, 0xb0, 0x17, 0x55, 0x1f, 0x8a, 0x7d,
+    0x57, 0xc7, 0x8d, 0x74, 0xb7, 0xc4, 0x9f, 0x72, 0x7e, 0x15, 0x22, 0x12, 0x58, 0x07, 0x99, 0x34,
+    0x6e, 0x50, 0xde, 0x68, 0x65, 0xbc, 0xdb, 0xf8, 0xc8, 0xa8, 0x2b, 0x40, 0xdc, 0xfe, 0x32, 0xa4,
+    0xca, 0x10, 0x21, 0xf0, 0xd3, 0x5d, 0x0f, 0x00, 0x6f, 0x9d, 0x36, 0x42, 0x4a, 0x5e, 0xc1, 0xe0
+  },
+  {
+    0x75, 0xf3, 0xc6, 0xf4, 0xdb, 0x7b, 0xfb, 0xc8, 0x4a, 0xd3, 0xe6, 0x6b, 0x45, 0x7d, 0xe8, 0x4b,
+    0xd6, 0x32, 0xd8, 0xfd, 0x37, 0x71, 0xf1, 0xe1, 0x30, 0x0f, 0xf8, 0x1b, 0x87, 0xfa, 0x06, 0x3f,
+    0x5e, 0xba, 0xae, 0x5b, 0x8a, 0x00, 0xbc, 0x9d, 0x6d, 0xc1, 0xb1, 0x0e, 0x80, 0x5d, 0xd2, 0xd5,
+    0xa0, 0x84, 0x07, 0x14, 0xb5, 0x90, 0x2c, 0xa3, 0xb2, 0x73, 0x4c, 0x54, 0x92, 0x74, 0x36, 0x51,
+    0x38, 0xb0, 0xbd, 0x5a, 0xfc, 0x60, 0x62, 0x96, 0x6c, 0x42, 0xf7, 0x10, 0x7c, 0x28, 0x27, 0x8c,
+    0x13, 0x95, 0x9c, 0xc7, 0x24, 0x46, 0x3b, 0x70, 0xca, 0xe3, 0x85, 0xcb, 0x11, 0xd0, 0x93, 0xb8,
+    0xa6, 0x83, 0x20, 0xff, 0x9f, 0x77, 0xc3, 0xcc, 0x03, 0x6f, 0x08, 0xbf, 0x40, 0xe7, 0x2b, 0xe2,
+    0x79, 0x0c, 0xaa, 0x82, 0x41, 0x3a, 0xea, 0xb9, 0xe4, 0x9a, 0xa4, 0x97, 0x7e, 0xda, 0x7a, 0x17,
+    0x66, 0x94, 0xa1, 0x1d, 0x3d, 0xf0, 0xde, 0xb3, 0x0b, 0x72, 0xa7, 0x1c, 0xef, 0xd1, 0x53, 0x3e,
+    0x8f, 0x33, 0x26, 0x5f, 0xec, 0x76, 0x2a, 0x49, 0x81, 0x88, 0xee, 0x21, 0xc4, 0x1a, 0xeb, 0xd9,
+    0xc5, 0x39, 0x99, 0xcd, 0xad, 0x31, 0x8b, 0x01, 0x18, 0x23, 0xdd, 0x1f, 0x4e, 0x2d, 0xf9, 0x48,
+    0x4f, 0xf2, 0x65, 0x8e, 0x78, 0x5c, 0x58, 0x19, 0x8d, 0xe5, 0x98, 0x57, 0x67, 0x7f, 0x05, 0x64,
+    0xaf, 0x63, 0xb6, 0xfe, 0xf5, 0xb7, 0x3c, 0xa5, 0xce, 0xe9, 0x68, 0x44, 0xe0, 0x4d, 0x43, 0x69,
+    0x29, 0x2e, 0xac, 0x15, 0x59, 0xa8, 0x0a, 0x9e, 0x6e, 0x47, 0xdf, 0x34, 0x35, 0x6a, 0xcf, 0xdc,
+    0x22, 0xc9, 0xc0, 0x9b, 0x89, 0xd4, 0xed, 0xab, 0x12, 0xa2, 0x0d, 0x52, 0xbb, 0x02, 0x2f, 0xa9,
+    0xd7, 0x61, 0x1e, 0xb4, 0x50, 0x04, 0xf6, 0xc2, 0x16, 0x25, 0x86, 0x56, 0x55, 0x09, 0xbe, 0x91
+  }
+};
+
+// which of q0 and q1 each stage of h runs each byte through, from the
+// stage for the fourth S-box key word to the final permutation
+static const byte hPermutations[4][5] = {
+  { 1, 1, 0, 0, 1 },
+  { 0, 1, 1, 0, 0 },
+  { 0, 0, 0, 1, 1 },
+  { 1, 0, 1, 1, 0 }
+};
+
+// the MDS matrix, by which of 0x01, 0x5b and 0xef each entry is
+static const byte mds[4][4] = {
+  { 0, 2, 1, 1 },
+  { 1, 2, 2, 0 },
+  { 2, 1, 0, 2 },
+  { 2, 0, 2, 1 }
+};
+
+static const byte rs[4][8] = {
+  { 0x01, 0xa4, 0x55, 0x87, 0x5a, 0x58, 0xdb, 0x9e },
+  { 0xa4, 0x56, 0x82, 0xf3, 0x1e, 0xc6, 0x68, 0xe5 },
+  { 0x02, 0xa1, 0xfc, 0xc1, 0x47, 0xae, 0x3d, 0x19 },
+  { 0xa4, 0x55, 0x87, 0x5a, 0x58, 0xdb, 0x9e, 0x03 }
+};
+
+// multiplies in GF(2^8) modulo the polynomial p
+static byte gfMultiply(byte a, byte b, const word32 p)
+{
+  word32 x = a, r = 0;
+
+  for (; b != 0; b >>= 1) {
+    if (b & 1) {
+      r ^= x;
+    }
+    x <<= 1;
+    if (x & 0x100) {
+      x ^= p;
+    }
+  }
+  return (byte) r;
+}
+
+// y times 0x5b and 0xef modulo the MDS polynomial, 0x169, as the Twofish
+// reference code does them, which is a good deal quicker than gfMultiply
+// for building the S-boxes
+static byte mds5b(const byte y)
+{
+  return y ^ (y >> 2) ^ ((y & 2) ? 0xb4 : 0) ^ ((y & 1) ? 0x5a : 0);
+}
+
+static byte mdsEf(const byte y)
+{
+  return mds5b(y) ^ (y >> 1) ^ ((y & 1) ? 0xb4 : 0);
+}
+
+// byte y times column j of the MDS matrix
+static word32 mdsColumn(const unsigned int j, const byte y)
+{
+  const byte m[3] = { y, mds5b(y), mdsEf(y) };
+  word32 r = 0;
+
+  for (unsigned int i = 0; i < 4; ++i) {
+    r |= word32(m[mds[i][j]]) << (i * 8);
+  }
+  return r;
+}
+
+// byte j of h's input, run through its q permutations and the bytes of the
+// k words of l, before the MDS matrix
+static byte hByte(byte x, const unsigned int j, const word32* l, const unsigned int k)
+{
+  for (unsigned int stage = 4 - k; stage < 4; ++stage) {
+    x = q[hPermutations[j][stage]][x] ^ GETBYTE(l[3 - stage], j);
+  }
+  return q[hPermutations[j][4]][x];
+}
+
+static word32 h(const byte x, const word32* l, const unsigned int k)
+{
+  word32 r = 0;
+
+  for (unsigned int j = 0; j < 4; ++j) {
+    r ^= mdsColumn(j, hByte(x, j, l, k));
+  }
+  return r;
+}
+
+enum TwofishKernel {
+  UNKNOWN_TWOFISH_KERNEL = -1,
+  NO_TWOFISH_KERNEL,
+  AVX2_TWOFISH_KERNEL
+};
+
+#ifdef HAVE_X86_SIMD
+#  include <immintrin.h>
+
+static TwofishKernel kernel()
+{
+  static volatile TwofishKernel kernel = UNKNOWN_TWOFISH_KERNEL;
+
+  if (kernel == UNKNOWN_TWOFISH_KERNEL) {
+    __builtin_cpu_init();
+    kernel = __builtin_cpu_supports("avx2") ? AVX2_TWOFISH_KERNEL : NO_TWOFISH_KERNEL;
+  }
+  return kernel;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i rotateLeft(const __m256i x, const int n)
+{
+  return _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - n));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i addKey(const __m256i x, const word32 k)
+{
+  return _mm256_add_epi32(x, _mm256_set1_epi32(k));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i xorKey(const __m256i x, const word32 k)
+{
+  return _mm256_xor_si256(x, _mm256_set1_epi32(k));
+}
+
+// g on every lane, a gather from each of the four tables
+__attribute__((target("avx2")))
+static inline __m256i g(const word32* s, const __m256i x)
+{
+  const __m256i mask = _mm256_set1_epi32(0xff);
+  __m256i r;
+
+  r = _mm256_i32gather_epi32((const int*) s, _mm256_and_si256(x, mask), 4);
+  r = _mm256_xor_si256(r, _mm256_i32gather_epi32((const int*) (s + 256), _mm256_and_si256(_mm256_srli_epi32(x, 8), mask), 4));
+  r = _mm256_xor_si256(r, _mm256_i32gather_epi32((const int*) (s + 512), _mm256_and_si256(_mm256_srli_epi32(x, 16), mask), 4));
+  r = _mm256_xor_si256(r, _mm256_i32gather_epi32((const int*) (s + 768), _mm256_srli_epi32(x, 24), 4));
+  return r;
+}
+
+// the round with a and b as its input, k being its pair of subkeys
+__attribute__((target("avx2")))
+static inline void encryptRound(const word32* s, const word32* k, const __m256i& a, const __m256i& b, __m256i& c, __m256i& d)
+{
+  __m256i x = g(s, a);
+  __m256i y = g(s, rotateLeft(b, 8));
+
+  x = _mm256_add_epi32(x, y);
+  y = addKey(_mm256_add_epi32(y, x), k[1]);
+  c = rotateLeft(_mm256_xor_si256(c, addKey(x, k[0])), 31);
+  d = _mm256_xor_si256(rotateLeft(d, 1), y);
+}
+
+__attribute__((target("avx2")))
+static inline void decryptRound(const word32* s, const word32* k, const __m256i& a, const __m256i& b, __m256i& c, __m256i& d)
+{
+  __m256i x = g(s, a);
+  __m256i y = g(s, rotateLeft(b, 8));
+
+  x = _mm256_add_epi32(x, y);
+  y = addKey(_mm256_add_epi32(y, x), k[1]);
+  c = _mm256_xor_si256(rotateLeft(c, 1), addKey(x, k[0]));
+  d = rotateLeft(_mm256_xor_si256(d, y), 31);
+}
+
+/* The blocks come in as rows and get transposed within each 128-bit half,
+ * so that vector i holds word i of every block. That shuffles the order of
+ * the blocks across the lanes, but as every lane gets the same treatment
+ * the order doesn't matter, and the same transpose puts them back. */
+__attribute__((target("avx2")))
+static inline void transpose(__m256i& a, __m256i& b, __m256i& c, __m256i& d)
+{
+  const __m256i t0 = _mm256_unpacklo_epi32(a, b);
+  const __m256i t1 = _mm256_unpackhi_epi32(a, b);
+  const __m256i t2 = _mm256_unpacklo_epi32(c, d);
+  const __m256i t3 = _mm256_unpackhi_epi32(c, d);
+
+  a = _mm256_unpacklo_epi64(t0, t2);
+  b = _mm256_unpackhi_epi64(t0, t2);
+  c = _mm256_unpacklo_epi64(t1, t3);
+  d = _mm256_unpackhi_epi64(t1, t3);
+}
+
+__attribute__((target("avx2")))
+static void runBlocksAVX2(const word32* k, const word32* s, const byte* in, byte* out, const bool encryption)
+{
+  __m256i a = _mm256_loadu_si256((const __m256i*) in);
+  __m256i b = _mm256_loadu_si256((const __m256i*) (in + 32));
+  __m256i c = _mm256_loadu_si256((const __m256i*) (in + 64));
+  __m256i d = _mm256_loadu_si256((const __m256i*) (in + 96));
+
+  transpose(a, b, c, d);
+
+  if (encryption) {
+    a = xorKey(a, k[0]);
+    b = xorKey(b, k[1]);
+    c = xorKey(c, k[2]);
+    d = xorKey(d, k[3]);
+
+    for (unsigned int round = 0; round < 16; round += 2) {
+      encryptRound(s, k + 8 + round * 2, a, b, c, d);
+      encryptRound(s, k + 10 + round * 2, c, d, a, b);
+    }
+
+    // the last round's halves aren't swapped back
+    const __m256i t0 = xorKey(c, k[4]);
+    const __m256i t1 = xorKey(d, k[5]);
+
+    c = xorKey(a, k[6]);
+    d = xorKey(b, k[7]);
+    a = t0;
+    b = t1;
+  }
+  else {
+    const __m256i t0 = xorKey(a, k[4]);
+    const __m256i t1 = xorKey(b, k[5]);
+
+    a = xorKey(c, k[6]);
+    b = xorKey(d, k[7]);
+    c = t0;
+    d = t1;
+
+    for (unsigned int round = 16; round > 0; round -= 2) {
+      decryptRound(s, k + 6 + round * 2, c, d, a, b);
+      decryptRound(s, k + 4 + round * 2, a, b, c, d);
+    }
+
+    a = xorKey(a, k[0]);
+    b = xorKey(b, k[1]);
+    c = xorKey(c, k[2]);
+    d = xorKey(d, k[3]);
+  }
+
+  transpose(a, b, c, d);
+
+  _mm256_storeu_si256((__m256i*) out, a);
+  _mm256_storeu_si256((__m256i*) (out + 32), b);
+  _mm256_storeu_si256((__m256i*) (out + 64), c);
+  _mm256_storeu_si256((__m256i*) (out + 96), d);
+}
+
+#endif
+
+unsigned int SIMDTwofishEngine::parallelBlocks() const
+{
+#ifdef HAVE_X86_SIMD
+  return kernel() == AVX2_TWOFISH_KERNEL ? SIMD_TWOFISH_PARALLEL_BLOCKS : 0;
+#else
+  return 0;
+#endif
+}
+
+void SIMDTwofishEngine::setKey(const byte* key, size_t keylength, const bool encryption)
+{
+  m_encryption = encryption;
+
+  // no sense in a key schedule that nothing will use
+  if (parallelBlocks() == 0) {
+    return;
+  }
+
+  // the key is padded with 0s out to the next of 128, 192 or 256 bits, and
+  // split into k 64-bit halves
+  const unsigned int k = keylength <= 16 ? 2 : (keylength <= 24 ? 3 : 4);
+  byte padded[32];
+  word32 even[4], odd[4], sKey[4];
+
+  memset(padded, 0, sizeof(padded));
+  memcpy(padded, key, keylength);
+
+  for (unsigned int i = 0; i < k; ++i) {
+    even[i] = GetWord<word32>(false, LITTLE_ENDIAN_ORDER, padded + i * 8);
+    odd[i] = GetWord<word32>(false, LITTLE_ENDIAN_ORDER, padded + i * 8 + 4);
+
+    // the S-box key words are each half through the RS code, in reverse
+    word32 s = 0;
+    for (unsigned int j = 0; j < 4; ++j) {
+      byte b = 0;
+      for (unsigned int c = 0; c < 8; ++c) {
+        b ^= gfMultiply(rs[j][c], padded[i * 8 + c], 0x14d);
+      }
+      s |= word32(b) << (j * 8);
+    }
+    sKey[k - 1 - i] = s;
+  }
+
+  for (unsigned int i = 0; i < 20; ++i) {
+    const word32 a = h(i * 2, even, k);
+    const word32 b = rotlFixed(h(i * 2 + 1, odd, k), 8);
+
+    m_subkeys[i * 2] = a + b;
+    m_subkeys[i * 2 + 1] = rotlFixed(a + b * 2, 9);
+  }
+
+  for (unsigned int j = 0; j < 4; ++j) {
+    for (unsigned int x = 0; x < 256; ++x) {
+      m_sBoxes[j * 256 + x] = mdsColumn(j, hByte(x, j, sKey, k));
+    }
+  }
+
+  SecureWipeArray(padded, sizeof(padded));
+  SecureWipeArray(even, 4);
+  SecureWipeArray(odd, 4);
+  SecureWipeArray(sKey, 4);
+}
+
+size_t SIMDTwofishEngine::processBlocks(const byte* inBlocks, const byte* xorBlocks, byte* outBlocks, size_t length, word32 flags) const
+{
+  const size_t blocks = length / 16;
+  const bool counter = (flags & BlockTransformation::BT_InBlockIsCounter) != 0;
+  const bool reverse = (flags & BlockTransformation::BT_ReverseDirection) != 0;
+  byte buffer[16 * SIMD_TWOFISH_PARALLEL_BLOCKS];
+
+  for (size_t done = 0; done < blocks;) {
+    const size_t n = STDMIN(blocks - done, (size_t) SIMD_TWOFISH_PARALLEL_BLOCKS);
+
+    // as with CBC decryption, where each xor block is the input block
+    // before it, so working backwards is what makes it safe in place
+    const size_t first = reverse ? blocks - done - n : done;
+
+    if (counter) {
+      for (size_t i = 0; i < n; ++i) {
+        memcpy(buffer + i * 16, inBlocks, 16);
+        buffer[i * 16 + 15] += (byte) (done + i);
+      }
+    }
+    else {
+      memcpy(buffer, inBlocks + first * 16, n * 16);
+    }
+
+    // a short batch runs the whole kernel all the same, and the spare
+    // lanes are just thrown away
+    memset(buffer + n * 16, 0, (SIMD_TWOFISH_PARALLEL_BLOCKS - n) * 16);
+
+#ifdef HAVE_X86_SIMD
+    runBlocksAVX2(m_subkeys, m_sBoxes, buffer, buffer, m_encryption);
+#endif
+
+    if (xorBlocks != NULL) {
+      xorbuf(buffer, xorBlocks + first * 16, n * 16);
+    }
+    memcpy(outBlocks + first * 16, buffer, n * 16);
+
+    done += n;
+  }
+
+  // CTR mode picks the counter up from where we leave it...
+  if (counter) {
+    const_cast<byte*>(inBlocks)[15] += (byte) blocks;
+  }
+
+  SecureWipeArray(buffer, sizeof(buffer));
+
+  return length % 16;
+}
@@ -0,0 +1,52 @@
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+#ifndef __JSIMDTWOFISH_H__
+#define __JSIMDTWOFISH_H__
+
+// Crypto++ headers...
+
+#include "twofish.h"
+#include "secblock.h"
+
+#include "jparallelcipher.h"
+
+// the blocks the AVX2 kernel runs at once
+#define SIMD_TWOFISH_PARALLEL_BLOCKS 8
+
+using namespace CryptoPP;
+
+/* Runs Twofish over eight blocks at once with AVX2, where the CPU has it.
+ * Twofish is built around key-dependent S-boxes rather than a circuit, so
+ * each vector holds one word of the state from every block and the S-box
+ * lookups are AVX2 gathers into the same four combined S-box and MDS tables
+ * the usual implementation uses. Like that implementation, and unlike the
+ * bitsliced engines, its timing depends on the data.
+ *
+ * It runs its own key schedule, the layout of Crypto++'s being private to
+ * its Twofish, and is wrapped up as a Crypto++ block cipher by
+ * ParallelCipher_Template. Without HAVE_X86_SIMD, or on a CPU without AVX2,
+ * parallelBlocks is 0 and it's never used. */
+class SIMDTwofishEngine
+{
+  public:
+    void setKey(const byte* key, size_t keylength, const bool encryption);
+
+    unsigned int parallelBlocks() const;
+    unsigned int minimumBlocks() const { return 2; }
+
+    size_t processBlocks(const byte* inBlocks, const byte* xorBlocks, byte* outBlocks, size_t length, word32 flags) const;
+
+  private:
+    FixedSizeSecBlock<word32, 40> m_subkeys;
+    FixedSizeSecBlock<word32, 4 * 256> m_sBoxes;
+    bool m_encryption;
+};
+
+typedef ParallelCipher_Template<Twofish_Info, Twofish, SIMDTwofishEngine> SIMDTwofish;
+
+#endif
@@ -5,18 +5,189 @@
  * See MIT-LICENSE for the extact license
  */
 
+#include <errno.h>
+#include <unistd.h>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
 #include "jsink.h"
+#include "jgvl.h"
+
+#ifdef HAVE_RUBY_FIBER_SCHEDULER_H
+extern "C" {
+#include "ruby/fiber/scheduler.h"
+}
+#endif
+
+struct descriptor_io
+{
+  int fd;
+  void* buffer;
+  size_t length;
+  ssize_t result;
+  int error;
+};
+
+static void* read_descriptor_without_gvl(void* data)
+{
+  struct descriptor_io* io = (struct descriptor_io*) data;
+  io->result = read(io->fd, io->buffer, io->length);
+  io->error = errno;
+  return NULL;
+}
+
+static void* write_descriptor_without_gvl(void* data)
+{
+  struct descriptor_io* io = (struct descriptor_io*) data;
+  io->result = write(io->fd, io->buffer, io->length);
+  io->error = errno;
+  return NULL;
+}
+
+VALUE getRubyFiberScheduler()
+{
+#ifdef HAVE_RB_FIBER_SCHEDULER_CURRENT
+  return rb_fiber_scheduler_current();
+#else
+  return Qnil;
+#endif
+}
+
+/* Waits for io to become readable or writable. Under a fiber scheduler this
+ * yields to the other fibers until it is. */
+static void wait_for_descriptor(VALUE io, int fd, bool writing)
+{
+#ifdef HAVE_RB_IO_WAIT
+  if (!NIL_P(getRubyFiberScheduler())) {
+    rb_io_wait(writing ? rb_io_get_write_io(io) : io, RB_INT2NUM(writing ? RUBY_IO_WRITABLE : RUBY_IO_READABLE), Qnil);
+    return;
+  }
+#endif
+
+  if (writing) {
+    rb_thread_fd_writable(fd);
+  }
+  else {
+    rb_thread_wait_fd(fd);
+  }
+}
+
+/* Whether a stream should be read or written with read_nonblock or
+ * write_nonblock. Only under a fiber scheduler, where a blocking read or
+ * write would stall every fiber on the thread. */
+static bool use_nonblock(VALUE stream, bool writing)
+{
+  return !NIL_P(getRubyFiberScheduler()) && rb_respond_to(stream, rb_intern(writing ? "write_nonblock" : "read_nonblock"));
+}
+
+/* Calls stream.method(arg, exception: false). Only used under a fiber
+ * scheduler, so keyword arguments are always available. */
+static VALUE call_nonblock(VALUE stream, const char* method, VALUE arg)
+{
+#ifdef HAVE_RB_FIBER_SCHEDULER_CURRENT
+  VALUE args[2];
+
+  args[0] = arg;
+  args[1] = rb_hash_new();
+  rb_hash_aset(args[1], ID2SYM(rb_intern("exception")), Qfalse);
+
+  return rb_funcallv_kw(stream, rb_intern(method), 2, args, RB_PASS_KEYWORDS);
+#else
+  rb_raise(rb_eNotImpError, "%s needs a fiber scheduler", method);
+#endif
+}
+
+/* Returns the file descriptor behind a File, Socket, pipe and the like if we
+ * can safely bypass Ruby's IO layer, otherwise -1. Anything sitting in Ruby's
+ * read buffer would be skipped over so we stick to IO#read in that case, and
+ * Ruby's write buffer is flushed before we start writing around it.
+ *
+ * Under a fiber scheduler a blocking read or write on the descriptor would
+ * stall every fiber on the thread, so only descriptors that are non-blocking
+ * or regular files, which never block for long, are used directly. */
+static int ruby_io_descriptor(VALUE io, bool writing)
+{
+#if defined(RUBY_VERSION_CODE) && RUBY_VERSION_CODE >= 200
+  rb_io_t* fptr;
+
+  if (TYPE(io) != T_FILE) {
+    return -1;
+  }
+
+  if (writing) {
+    io = rb_io_get_write_io(io);
+  }
+
+  GetOpenFile(io, fptr);
+  if (fptr->mode & FMODE_TEXTMODE) {
+    return -1;
+  }
+
+  if (writing) {
+    if (!(fptr->mode & FMODE_WRITABLE)) {
+      return -1;
+    }
+    rb_io_flush(io);
+  }
+  else if (!(fptr->mode & FMODE_READABLE) || fptr->rbuf.len > 0) {
+    return -1;
+  }
+
+  if (!NIL_P(getRubyFiberScheduler())) {
+    struct stat st;
+    int flags = fcntl(fptr->fd, F_GETFL);
+
+    if (flags < 0 || (!(flags & O_NONBLOCK) && (fstat(fptr->fd, &st) != 0 || !S_ISREG(st.st_mode)))) {
+      return -1;
+    }
+  }
+
+  return fptr->fd;
+#else
+  return -1;
+#endif
+}
+
+RubyIOOptions getRubyIOOptions(VALUE options)
+{
+  RubyIOOptions retval;
+
+  if (!NIL_P(options)) {
+    Check_Type(options, T_HASH);
+
+    VALUE buffer_size = rb_hash_aref(options, ID2SYM(rb_intern("buffer_size")));
+    if (!NIL_P(buffer_size)) {
+      // NUM2UINT would wrap a negative size around to a huge one...
+      if (NUM2LONG(buffer_size) <= 0) {
+        rb_raise(rb_eArgError, "buffer_size must be greater than zero");
+      }
+      retval.bufferSize = NUM2UINT(buffer_size);
+    }
+
+    retval.pipeline = RTEST(rb_hash_aref(options, ID2SYM(rb_intern("pipeline"))));
+  }
+
+  return retval;
+}
 
 void RubyIOStore::StoreInitialize(const NameValuePairs& parameters)
 {
   m_stream = NULL;
   parameters.GetValue(Name::InputStreamPointer(), m_stream);
+  m_bufferSize = parameters.GetValueWithDefault(RubyIOBufferSize(), (size_t) RUBY_IO_DEFAULT_BUFFER_SIZE);
+  m_fd = m_stream ? ruby_io_descriptor(*m_stream, false) : -1;
+  m_nonblock = m_stream && m_fd < 0 && use_nonblock(*m_stream, false);
+  m_eof = false;
   m_waiting = false;
 }
 
 size_t RubyIOStore::Peek(byte& outByte) const
 {
-  if (!m_stream || rb_funcall(*m_stream, rb_intern("eof?"), 0)) {
+  if (m_fd >= 0 || m_nonblock) {
+    return m_eof ? 0 : 1;
+  }
+  else if (!m_stream || rb_funcall(*m_stream, rb_intern("eof?"), 0)) {
     return 0;
   }
   else {
@@ -32,6 +203,10 @@ size_t RubyIOStore::TransferTo2(BufferedTransformation& target, CryptoPP::lword&
     return 0;
   }
 
+  if (m_fd >= 0) {
+    return TransferFromDescriptor(target, transferBytes, channel, blocking);
+  }
+
   lword size = transferBytes;
   transferBytes = 0;
 
@@ -39,13 +214,22 @@ size_t RubyIOStore::TransferTo2(BufferedTransformation& target, CryptoPP::lword&
     goto output;
   }
 
-  while (size && !RTEST(rb_funcall(*m_stream, rb_intern("eof?"), 0))) {
+  while (size && !(m_nonblock ? m_eof : RTEST(rb_funcall(*m_stream, rb_intern("eof?"), 0)))) {
     {
       VALUE buffer;
-      size_t spaceSize = 1024;
+      size_t spaceSize = m_bufferSize;
       m_space = HelpCreatePutSpace(target, channel, 1, UnsignedMin(size_t(0) - 1, size), spaceSize);
 
-      buffer = rb_funcall(*m_stream, rb_intern("read"), 1, UINT2NUM(STDMIN(size, (lword) spaceSize)));
+      if (m_nonblock) {
+        buffer = ReadNonblock(STDMIN(size, (lword) spaceSize));
+        if (NIL_P(buffer)) {
+          m_eof = true;
+          break;
+        }
+      }
+      else {
+        buffer = rb_funcall(*m_stream, rb_intern("read"), 1, UINT2NUM(STDMIN(size, (lword) spaceSize)));
+      }
       if (TYPE(buffer) != T_STRING) {
         throw ReadErr();
       }
@@ -62,16 +246,171 @@ size_t RubyIOStore::TransferTo2(BufferedTransformation& target, CryptoPP::lword&
       size -= m_len;
       transferBytes += m_len;
   }
-  if (!RTEST(rb_funcall(*m_stream, rb_intern("eof?"), 0))) {
+  if (!m_nonblock && !RTEST(rb_funcall(*m_stream, rb_intern("eof?"), 0))) {
     throw ReadErr();
   }
   return 0;
 }
 
+/* Reads up to length bytes with read_nonblock, waiting on the stream until
+ * there's something to read. Returns nil at the end of the stream. */
+VALUE RubyIOStore::ReadNonblock(size_t length)
+{
+  while (true) {
+    VALUE buffer = call_nonblock(*m_stream, "read_nonblock", SIZET2NUM(length));
+
+    if (buffer == ID2SYM(rb_intern("wait_readable"))) {
+      rb_funcall(*m_stream, rb_intern("wait_readable"), 0);
+    }
+    else {
+      return buffer;
+    }
+  }
+}
+
+/* Same as TransferTo2, but reads straight from the file descriptor into a
+ * large buffer with the GVL released. */
+size_t RubyIOStore::TransferFromDescriptor(BufferedTransformation& target, CryptoPP::lword& transferBytes, const std::string& channel, bool blocking)
+{
+  lword size = transferBytes;
+  transferBytes = 0;
+
+  if (m_waiting) {
+    goto output;
+  }
+
+  while (size && !m_eof) {
+    {
+      size_t spaceSize = m_bufferSize;
+      m_space = HelpCreatePutSpace(target, channel, 1, UnsignedMin(size_t(0) - 1, size), spaceSize);
+      m_len = ReadDescriptor(m_space, STDMIN(size, (lword) spaceSize));
+      if (m_len == 0) {
+        m_eof = true;
+        break;
+      }
+    }
+    size_t blockedBytes;
+    output:
+      blockedBytes = target.ChannelPutModifiable2(channel, m_space, m_len, 0, blocking);
+      m_waiting = blockedBytes > 0;
+      if (m_waiting) {
+        return blockedBytes;
+      }
+      size -= m_len;
+      transferBytes += m_len;
+  }
+  return 0;
+}
+
+/* Reads up to length bytes, returning 0 at the end of the stream. Interrupted
+ * reads are retried and non-blocking descriptors are waited on. */
+size_t RubyIOStore::ReadDescriptor(byte* buffer, size_t length)
+{
+  struct descriptor_io io;
+
+  io.fd = m_fd;
+  io.buffer = buffer;
+  io.length = length;
+
+  while (true) {
+    callWithoutGVL(read_descriptor_without_gvl, &io, RUBY_UBF_IO, NULL);
+    if (io.result >= 0) {
+      return io.result;
+    }
+    else if (io.error == EINTR) {
+      rb_thread_check_ints();
+    }
+    else if (io.error == EAGAIN || io.error == EWOULDBLOCK) {
+      wait_for_descriptor(*m_stream, m_fd, false);
+    }
+    else {
+      throw ReadErr();
+    }
+  }
+}
+
 void RubyIOSink::IsolatedInitialize(const NameValuePairs& parameters)
 {
   m_stream = NULL;
   parameters.GetValue(Name::OutputStreamPointer(), m_stream);
+  m_fd = m_stream ? ruby_io_descriptor(*m_stream, true) : -1;
+  m_nonblock = m_stream && m_fd < 0 && use_nonblock(*m_stream, true);
+  m_buffer.New(parameters.GetValueWithDefault(RubyIOBufferSize(), (size_t) RUBY_IO_DEFAULT_BUFFER_SIZE));
+  m_buffered = 0;
+}
+
+bool RubyIOSink::IsolatedFlush(bool hardFlush, bool blocking)
+{
+  if (hardFlush) {
+    FlushBuffer();
+  }
+  return false;
+}
+
+void RubyIOSink::FlushBuffer()
+{
+  if (m_buffered > 0) {
+    Write(m_buffer, m_buffered);
+    m_buffered = 0;
+  }
+}
+
+void RubyIOSink::Write(const byte* buffer, size_t length)
+{
+  if (m_fd >= 0) {
+    WriteDescriptor(buffer, length);
+  }
+  else if (m_nonblock) {
+    WriteNonblock(buffer, length);
+  }
+  else {
+    rb_funcall(*m_stream, rb_intern("write"), 1, rb_str_new((const char*) buffer, length));
+  }
+}
+
+/* Writes all of buffer, coping with short writes, interrupts and
+ * non-blocking descriptors. */
+void RubyIOSink::WriteDescriptor(const byte* buffer, size_t length)
+{
+  struct descriptor_io io;
+
+  io.fd = m_fd;
+  while (length > 0) {
+    io.buffer = (void*) buffer;
+    io.length = length;
+    callWithoutGVL(write_descriptor_without_gvl, &io, RUBY_UBF_IO, NULL);
+    if (io.result >= 0) {
+      buffer += io.result;
+      length -= io.result;
+    }
+    else if (io.error == EINTR) {
+      rb_thread_check_ints();
+    }
+    else if (io.error == EAGAIN || io.error == EWOULDBLOCK) {
+      wait_for_descriptor(*m_stream, m_fd, true);
+    }
+    else {
+      throw WriteErr();
+    }
+  }
+}
+
+/* Writes all of buffer with write_nonblock, waiting on the stream whenever
+ * it can't take any more. */
+void RubyIOSink::WriteNonblock(const byte* buffer, size_t length)
+{
+  while (length > 0) {
+    VALUE written = call_nonblock(*m_stream, "write_nonblock", rb_str_new((const char*) buffer, length));
+
+    if (written == ID2SYM(rb_intern("wait_writable"))) {
+      rb_funcall(*m_stream, rb_intern("wait_writable"), 0);
+    }
+    else {
+      size_t len = NUM2SIZET(written);
+      buffer += len;
+      length -= len;
+    }
+  }
 }
 
 size_t RubyIOSink::Put2(const byte* inString, size_t length, int messageEnd, bool blocking)
@@ -80,10 +419,80 @@ size_t RubyIOSink::Put2(const byte* inString, size_t length, int messageEnd, boo
     throw Err("RubyIOSink: output stream not opened");
   }
 
-  rb_funcall(*m_stream, rb_intern("write"), 1, rb_str_new((const char*) inString, length));
+  if (length > m_buffer.size() - m_buffered) {
+    FlushBuffer();
+
+    // anything at least a buffer's worth goes straight out without copying
+    if (length >= m_buffer.size()) {
+      Write(inString, length);
+      length = 0;
+    }
+  }
+
+  if (length > 0) {
+    memcpy(m_buffer + m_buffered, inString, length);
+    m_buffered += length;
+  }
 
   if (messageEnd) {
-    rb_funcall(*m_stream, rb_intern("flush"), 0);
+    FlushBuffer();
+    if (m_fd < 0) {
+      rb_funcall(*m_stream, rb_intern("flush"), 0);
+    }
+  }
+
+  return 0;
+}
+
+static VALUE yield_chunk(VALUE chunk)
+{
+  return rb_yield(chunk);
+}
+
+void RubyYieldSink::Yield(const byte* chunk, size_t length)
+{
+  VALUE str = rb_tainted_str_new((const char*) chunk, length);
+
+  rb_protect(yield_chunk, str, m_state);
+  if (*m_state != 0) {
+    throw Err();
+  }
+}
+
+size_t RubyYieldSink::Put2(const byte* inString, size_t length, int messageEnd, bool blocking)
+{
+  // top up a partly filled chunk first...
+  if (m_buffered > 0) {
+    size_t len = STDMIN(length, m_buffer.size() - m_buffered);
+
+    memcpy(m_buffer + m_buffered, inString, len);
+    m_buffered += len;
+    inString += len;
+    length -= len;
+
+    if (m_buffered == m_buffer.size()) {
+      m_buffered = 0;
+      Yield(m_buffer, m_buffer.size());
+    }
+  }
+
+  // ...then whole chunks go straight from the input without a copy
+  while (length >= m_buffer.size()) {
+    Yield(inString, m_buffer.size());
+    inString += m_buffer.size();
+    length -= m_buffer.size();
+  }
+
+  if (length > 0) {
+    memcpy(m_buffer + m_buffered, inString, length);
+    m_buffered += length;
+  }
+
+  if (messageEnd && m_buffered > 0) {
+    size_t last = m_buffered;
+
+    m_buffered = 0;
+    Yield(m_buffer, last);
   }
 
   return 0;
@@ -23,6 +23,33 @@ extern "C" {
 
 using namespace CryptoPP;
 
+// the default size of the buffers RubyIOStore reads into and RubyIOSink
+// collects its output in before writing it out
+#define RUBY_IO_DEFAULT_BUFFER_SIZE 65536
+
+// name of the parameter used to pass the buffer size to RubyIOStore and
+// RubyIOSink
+inline const char* RubyIOBufferSize() { return "RubyIOBufferSize"; }
+
+// per-call options for the *_io methods
+struct RubyIOOptions
+{
+  RubyIOOptions() : bufferSize(RUBY_IO_DEFAULT_BUFFER_SIZE), pipeline(false) {}
+
+  size_t bufferSize;
+
+  // overlap reading, crypto and writing, see RubyIOPipeline
+  bool pipeline;
+};
+
+// reads a RubyIOOptions out of a Ruby options Hash, which may be nil
+RubyIOOptions getRubyIOOptions(VALUE options);
+
+// the fiber scheduler the current fiber runs under if it's a non-blocking
+// fiber, otherwise nil. Waits must then go through the scheduler so other
+// fibers can run rather than blocking the whole thread.
+VALUE getRubyFiberScheduler();
+
 class RubyIOStore : public Store, private FilterPutSpaceHelper
 {
   public:
@@ -46,9 +73,9 @@ class RubyIOStore : public Store, private FilterPutSpaceHelper
 
     RubyIOStore() {}
 
-    RubyIOStore(VALUE** in)
+    RubyIOStore(VALUE** in, size_t bufferSize = RUBY_IO_DEFAULT_BUFFER_SIZE)
     {
-      StoreInitialize(MakeParameters(Name::InputStreamPointer(), *in));
+      StoreInitialize(MakeParameters(Name::InputStreamPointer(), *in)(RubyIOBufferSize(), bufferSize));
     }
 
     RubyIOStore(const char* filename)
@@ -70,8 +97,21 @@ class RubyIOStore : public Store, private FilterPutSpaceHelper
 
   private:
     void StoreInitialize(const NameValuePairs &parameters);
+    size_t TransferFromDescriptor(BufferedTransformation &target, CryptoPP::lword &transferBytes, const std::string &channel, bool blocking);
+    size_t ReadDescriptor(byte* buffer, size_t length);
+    VALUE ReadNonblock(size_t length);
     VALUE* m_stream;
 
+    // when the stream is a real IO we read from its file descriptor directly
+    // rather than going through IO#read, otherwise this is -1...
+    int m_fd;
+    bool m_eof;
+    size_t m_bufferSize;
+
+    // under a fiber scheduler, streams that aren't plain IOs are read with
+    // read_nonblock so waiting for data yields to other fibers...
+    bool m_nonblock;
+
     byte* m_space;
     unsigned int m_len;
     bool m_waiting;
@@ -86,9 +126,9 @@ class RubyIOSource : public SourceTemplate<RubyIOStore>
 
     RubyIOSource(BufferedTransformation* attachment = NULL) : SourceTemplate<RubyIOStore>(attachment) {}
 
-    RubyIOSource(VALUE** in, bool pumpAll, BufferedTransformation* attachment = NULL) : SourceTemplate<RubyIOStore>(attachment)
+    RubyIOSource(VALUE** in, bool pumpAll, BufferedTransformation* attachment = NULL, size_t bufferSize = RUBY_IO_DEFAULT_BUFFER_SIZE) : SourceTemplate<RubyIOStore>(attachment)
     {
-      SourceInitialize(pumpAll, MakeParameters(Name::InputStreamPointer(), *in));
+      SourceInitialize(pumpAll, MakeParameters(Name::InputStreamPointer(), *in)(RubyIOBufferSize(), bufferSize));
     }
 
     RubyIOSource(const char* filename, bool pumpAll, BufferedTransformation* attachment = NULL, bool binary = true) : SourceTemplate<RubyIOStore>(attachment)
@@ -127,11 +167,14 @@ class RubyIOSink : public Sink
     RubyIOSink()
     {
       m_stream = NULL;
+      m_fd = -1;
+      m_buffered = 0;
+      m_nonblock = false;
     }
 
-    RubyIOSink(VALUE** out)
+    RubyIOSink(VALUE** out, size_t bufferSize = RUBY_IO_DEFAULT_BUFFER_SIZE)
     {
-      IsolatedInitialize(MakeParameters(Name::OutputStreamPointer(), *out));
+      IsolatedInitialize(MakeParameters(Name::OutputStreamPointer(), *out)(RubyIOBufferSize(), bufferSize));
     }
 
     RubyIOSink(const char* filename, bool binary = true)
@@ -147,12 +190,54 @@ class RubyIOSink : public Sink
     void IsolatedInitialize(const NameValuePairs& parameters);
     size_t Put2(const byte* inString, size_t length, int messageEnd, bool blocking);
 
-    // IsolatedFlush isn't actually used, but needs to be implemented because
-    // it's abstract...
-    bool IsolatedFlush(bool hardFlush, bool blocking) { return false; };
+    bool IsolatedFlush(bool hardFlush, bool blocking);
 
   private:
+    void FlushBuffer();
+    void Write(const byte* buffer, size_t length);
+    void WriteDescriptor(const byte* buffer, size_t length);
+    void WriteNonblock(const byte* buffer, size_t length);
     VALUE* m_stream;
+
+    // output is collected here and written out a whole buffer at a time
+    // rather than a few blocks at a time as the filters hand it to us...
+    SecByteBlock m_buffer;
+    size_t m_buffered;
+
+    // the file descriptor to write to directly when the stream is a real IO,
+    // otherwise -1 and we go through IO#write...
+    int m_fd;
+
+    // write with write_nonblock, see RubyIOStore
+    bool m_nonblock;
+};
+
+/* Hands its input to the block of the current method as Strings of exactly
+ * chunkSize bytes, apart from the last one which gets whatever's left.
+ *
+ * If the block raises or breaks out, the sink records the jump in *state
+ * and throws an Err so the Crypto++ objects can be unwound and cleaned up.
+ * The caller must then pass *state on to rb_jump_tag. */
+class RubyYieldSink : public Sink
+{
+  public:
+    class Err : public Exception
+    {
+      public:
+        Err() : Exception(OTHER_ERROR, "RubyYieldSink: left the block") {}
+    };
+
+    RubyYieldSink(size_t chunkSize, int* state) : m_buffer(chunkSize), m_buffered(0), m_state(state) {}
+
+    size_t Put2(const byte* inString, size_t length, int messageEnd, bool blocking);
+    bool IsolatedFlush(bool hardFlush, bool blocking) { return false; }
+
+  private:
+    void Yield(const byte* chunk, size_t length);
+
+    SecByteBlock m_buffer;
+    size_t m_buffered;
+    int* m_state;
 };
 
 #endif
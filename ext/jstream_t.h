@@ -19,11 +19,8 @@ class JStream_Template : public JBasicCipherInfo<INFO, JStream>
     inline enum CipherEnum getCipherType() const;
     inline unsigned int getBlockSize() const { return 0; }
 
-    bool encrypt();
-    bool decrypt();
-
-    bool encryptRubyIO(VALUE* in, VALUE* out);
-    bool decryptRubyIO(VALUE* in, VALUE* out);
+    JCipherFilter* getEncryptionFilter(BufferedTransformation* attachment = NULL);
+    JCipherFilter* getDecryptionFilter(BufferedTransformation* attachment = NULL);
 
   protected:
     virtual SymmetricCipher* getEncryptionObject() = 0;
@@ -43,81 +40,27 @@ CipherEnum JStream_Template<INFO, TYPE>::getCipherType() const
 }
 
 template <typename INFO, enum CipherEnum TYPE>
-bool JStream_Template<INFO, TYPE>::encrypt()
+JCipherFilter* JStream_Template<INFO, TYPE>::getEncryptionFilter(BufferedTransformation* attachment)
 {
-  StreamTransformation* cipher = NULL;
-
-  cipher = getEncryptionObject();
+  StreamTransformation* cipher = getEncryptionObject();
 
-  if (cipher != NULL) {
-    this->itsCiphertext.erase();
-    StringSource(this->itsPlaintext, true, new StreamTransformationFilter(*cipher, new StringSink(this->itsCiphertext)));
-    delete cipher;
-    return true;
+  if (cipher == NULL) {
+    return NULL;
   }
-  else {
-    return false;
-  }
-}
-
-template <typename INFO, enum CipherEnum TYPE>
-bool JStream_Template<INFO, TYPE>::decrypt()
-{
-  StreamTransformation* cipher = NULL;
-
-  cipher = getDecryptionObject();
 
-  if (cipher != NULL) {
-    this->itsPlaintext.erase();
-    StringSource(this->itsCiphertext, true, new StreamTransformationFilter(*cipher, new StringSink(this->itsPlaintext)));
-    delete cipher;
-    return true;
-  }
-  else {
-    return false;
-  }
+  return new JCipherFilter(cipher, NULL, attachment);
 }
 
 template <typename INFO, enum CipherEnum TYPE>
-bool JStream_Template<INFO, TYPE>::encryptRubyIO(VALUE* in, VALUE* out)
+JCipherFilter* JStream_Template<INFO, TYPE>::getDecryptionFilter(BufferedTransformation* attachment)
 {
-  StreamTransformation* cipher = NULL;
-
-  cipher = getEncryptionObject();
-
-  if (cipher != NULL) {
-    try {
-      RubyIOSource(&in, true, new StreamTransformationFilter(*cipher, new RubyIOSink(&out)));
-    }
-    catch (RubyIOStore::OpenErr e) {
-      delete cipher;
-      throw e;
-    }
-    delete cipher;
-  }
+  StreamTransformation* cipher = getDecryptionObject();
 
-  return true;
-}
-
-template <typename INFO, enum CipherEnum TYPE>
-bool JStream_Template<INFO, TYPE>::decryptRubyIO(VALUE* in, VALUE* out)
-{
-  StreamTransformation* cipher = NULL;
-
-  cipher = getDecryptionObject();
-
-  if (cipher != NULL) {
-    try {
-      RubyIOSource(&in, true, new StreamTransformationFilter(*cipher, new RubyIOSink(&out)));
-    }
-    catch (RubyIOStore::OpenErr e) {
-      delete cipher;
-      throw e;
-    }
-    delete cipher;
+  if (cipher == NULL) {
+    return NULL;
   }
 
-  return true;
+  return new JCipherFilter(cipher, NULL, attachment);
 }
 
 #endif
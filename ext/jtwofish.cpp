@@ -9,14 +9,16 @@
 
 #if ENABLED_TWOFISH_CIPHER
 
+#include "jsimdtwofish.h"
+
 BlockCipher* JTwofish::getEncryptionObject()
 {
-  return new TwofishEncryption((byte*) itsKey.data(), itsKeylength);
+  return new SIMDTwofish::Encryption((byte*) itsKey.data(), itsKeylength);
 }
 
 BlockCipher* JTwofish::getDecryptionObject()
 {
-  return new TwofishDecryption((byte*) itsKey.data(), itsKeylength);
+  return new SIMDTwofish::Decryption((byte*) itsKey.data(), itsKeylength);
 }
 
 #endif
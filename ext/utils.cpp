@@ -5,4 +5,86 @@
  * See MIT-LICENSE for the extact license
  */
 
+#include "jhelpers.h"
+
 #include "cryptopp_ruby_api.h"
+
+/* Encodes bin straight into a new Ruby String, so the hex and Base64
+ * kernels write into the String's own buffer rather than a temporary. */
+VALUE encodeRubyString(const string& bin, RubyEncodingEnum encoding)
+{
+  VALUE retval;
+
+  switch (encoding) {
+    case HEX_ENCODING:
+      retval = rb_tainted_str_new(NULL, bin.length() * 2);
+      bin2hex(bin.data(), bin.length(), RSTRING_PTR(retval));
+      break;
+
+    case BASE64_ENCODING:
+    case BASE64URL_ENCODING:
+      retval = rb_tainted_str_new(NULL, base64Length(bin.length(), encoding == BASE64URL_ENCODING));
+      bin2base64(bin.data(), bin.length(), RSTRING_PTR(retval), encoding == BASE64URL_ENCODING);
+      break;
+
+    default:
+      retval = rb_tainted_str_new(bin.data(), bin.length());
+  }
+
+  return retval;
+}
+
+
+/* Decodes a Ruby String to binary. Base64 input may use either alphabet. */
+string decodeRubyString(VALUE str, RubyEncodingEnum encoding)
+{
+  Check_Type(str, T_STRING);
+
+  const char* data = RSTRING_PTR(str);
+  size_t length = RSTRING_LEN(str);
+  string retval;
+
+  switch (encoding) {
+    case HEX_ENCODING:
+      retval.resize(length / 2);
+      retval.resize(hex2bin(data, length, &retval[0]));
+      break;
+
+    case BASE64_ENCODING:
+    case BASE64URL_ENCODING:
+      retval.resize(length / 4 * 3 + 2);
+      retval.resize(base642bin(data, length, &retval[0]));
+      break;
+
+    default:
+      retval.assign(data, length);
+  }
+
+  return retval;
+}
+
+
+/* Looks up name in options along with its _hex, _b64 and _b64url variants,
+ * raising if more than one of them is set. Returns nil if none of them are,
+ * otherwise the value, with its encoding in *encoding. */
+VALUE getEncodedRubyOption(VALUE options, const char* name, RubyEncodingEnum* encoding)
+{
+  static const char* suffixes[] = { "", "_hex", "_b64", "_b64url" };
+  static const RubyEncodingEnum encodings[] = { BINARY_ENCODING, HEX_ENCODING, BASE64_ENCODING, BASE64URL_ENCODING };
+  VALUE retval = Qnil;
+  const char* found = NULL;
+
+  for (size_t i = 0; i < sizeof(encodings) / sizeof(encodings[0]); ++i) {
+    VALUE value = rb_hash_aref(options, ID2SYM(rb_intern((string(name) + suffixes[i]).c_str())));
+    if (!NIL_P(value)) {
+      if (found != NULL) {
+        rb_raise(rb_eCryptoPP_Error, "can't set both %s%s and %s%s in options", name, found, name, suffixes[i]);
+      }
+      retval = value;
+      found = suffixes[i];
+      *encoding = encodings[i];
+    }
+  }
+
+  return retval;
+}
@@ -0,0 +1,172 @@
+#!/usr/bin/env ruby
+
+# Generates ext/jbitsliceddes_sboxes.h, the gate circuits for the eight DES
+# S-boxes and the round function that wires them up for the bitsliced DES
+# in ext/jbitsliceddes.cpp.
+#
+# Each S-box output is a Boolean function of six inputs, synthesized by
+# extras/sbox_circuits.rb, and every circuit is checked against the S-box
+# table before it's written out.
+#
+# The circuits come out at 64 to 85 gates an S-box. Hand-optimized ones like
+# Matthew Kwan's are down around 55, so there's room to improve this if it
+# ever matters.
+#
+# Usage:
+#
+#   ruby extras/bitsliced_des_sboxes.rb > ext/jbitsliceddes_sboxes.h
+
+require File.expand_path('../sbox_circuits', __FILE__)
+
+module BitslicedDES
+  SBOXES = [
+    [ 14,  4, 13,  1,  2, 15, 11,  8,  3, 10,  6, 12,  5,  9,  0,  7,
+       0, 15,  7,  4, 14,  2, 13,  1, 10,  6, 12, 11,  9,  5,  3,  8,
+       4,  1, 14,  8, 13,  6,  2, 11, 15, 12,  9,  7,  3, 10,  5,  0,
+      15, 12,  8,  2,  4,  9,  1,  7,  5, 11,  3, 14, 10,  0,  6, 13 ],
+    [ 15,  1,  8, 14,  6, 11,  3,  4,  9,  7,  2, 13, 12,  0,  5, 10,
+       3, 13,  4,  7, 15,  2,  8, 14, 12,  0,  1, 10,  6,  9, 11,  5,
+       0, 14,  7, 11, 10,  4, 13,  1,  5,  8, 12,  6,  9,  3,  2, 15,
+      13,  8, 10,  1,  3, 15,  4,  2, 11,  6,  7, 12,  0,  5, 14,  9 ],
+    [ 10,  0,  9, 14,  6,  3, 15,  5,  1, 13, 12,  7, 11,  4,  2,  8,
+      13,  7,  0,  9,  3,  4,  6, 10,  2,  8,  5, 14, 12, 11, 15,  1,
+      13,  6,  4,  9,  8, 15,  3,  0, 11,  1,  2, 12,  5, 10, 14,  7,
+       1, 10, 13,  0,  6,  9,  8,  7,  4, 15, 14,  3, 11,  5,  2, 12 ],
+    [  7, 13, 14,  3,  0,  6,  9, 10,  1,  2,  8,  5, 11, 12,  4, 15,
+      13,  8, 11,  5,  6, 15,  0,  3,  4,  7,  2, 12,  1, 10, 14,  9,
+      10,  6,  9,  0, 12, 11,  7, 13, 15,  1,  3, 14,  5,  2,  8,  4,
+       3, 15,  0,  6, 10,  1, 13,  8,  9,  4,  5, 11, 12,  7,  2, 14 ],
+    [  2, 12,  4,  1,  7, 10, 11,  6,  8,  5,  3, 15, 13,  0, 14,  9,
+      14, 11,  2, 12,  4,  7, 13,  1,  5,  0, 15, 10,  3,  9,  8,  6,
+       4,  2,  1, 11, 10, 13,  7,  8, 15,  9, 12,  5,  6,  3,  0, 14,
+      11,  8, 12,  7,  1, 14,  2, 13,  6, 15,  0,  9, 10,  4,  5,  3 ],
+    [ 12,  1, 10, 15,  9,  2,  6,  8,  0, 13,  3,  4, 14,  7,  5, 11,
+      10, 15,  4,  2,  7, 12,  9,  5,  6,  1, 13, 14,  0, 11,  3,  8,
+       9, 14, 15,  5,  2,  8, 12,  3,  7,  0,  4, 10,  1, 13, 11,  6,
+       4,  3,  2, 12,  9,  5, 15, 10, 11, 14,  1,  7,  6,  0,  8, 13 ],
+    [  4, 11,  2, 14, 15,  0,  8, 13,  3, 12,  9,  7,  5, 10,  6,  1,
+      13,  0, 11,  7,  4,  9,  1, 10, 14,  3,  5, 12,  2, 15,  8,  6,
+       1,  4, 11, 13, 12,  3,  7, 14, 10, 15,  6,  8,  0,  5,  9,  2,
+       6, 11, 13,  8,  1,  4, 10,  7,  9,  5,  0, 15, 14,  2,  3, 12 ],
+    [ 13,  2,  8,  4,  6, 15, 11,  1, 10,  9,  3, 14,  5,  0, 12,  7,
+       1, 15, 13,  8, 10,  3,  7,  4, 12,  5,  6, 11,  0, 14,  9,  2,
+       7, 11,  4,  1,  9, 12, 14,  2,  0,  6, 10, 13, 15,  3,  5,  8,
+       2,  1, 14,  7,  4, 10,  8, 13, 15, 12,  9,  0,  3,  5,  6, 11 ]
+  ]
+
+  # the expansion, which picks the six bits of R each S-box sees
+  E = [
+    32,  1,  2,  3,  4,  5,  4,  5,  6,  7,  8,  9,
+     8,  9, 10, 11, 12, 13, 12, 13, 14, 15, 16, 17,
+    16, 17, 18, 19, 20, 21, 20, 21, 22, 23, 24, 25,
+    24, 25, 26, 27, 28, 29, 28, 29, 30, 31, 32,  1
+  ]
+
+  # the permutation of the S-box outputs
+  P = [
+    16,  7, 20, 21, 29, 12, 28, 17,  1, 15, 23, 26,  5, 18, 31, 10,
+     2,  8, 24, 14, 32, 27,  3,  9, 19, 13, 30,  6, 22, 11,  4, 25
+  ]
+
+  # how many variable orders get a full synthesis, out of the 720
+  ORDERS_TRIED = 60
+
+  class << self
+    # the truth tables of the four outputs, out1 being the most significant
+    def outputs(sbox)
+      (0...4).collect { |o|
+        (0...64).inject(0) { |t, i|
+          row = ((i >> 4) & 2) | (i & 1)
+          column = (i >> 1) & 15
+          ((sbox[row * 16 + column] >> (3 - o)) & 1) == 1 ? t | (1 << i) : t
+        }
+      }
+    end
+
+    def synthesize(sbox)
+      SBoxCircuit.synthesize(outputs(sbox), %w{ a1 a2 a3 a4 a5 a6 }, ORDERS_TRIED)
+    end
+  end
+
+  class Writer
+    def initialize(io)
+      @io = io
+    end
+
+    def write
+      @io.puts header
+
+      SBOXES.each_with_index do |sbox, n|
+        circuit, outputs = BitslicedDES.synthesize(sbox)
+        check(sbox, circuit, outputs)
+        write_sbox(n + 1, circuit, outputs)
+      end
+
+      write_round
+      @io.puts "#endif"
+    end
+
+    private
+      def header
+        <<-EOF
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+/* Generated by extras/bitsliced_des_sboxes.rb. Don't edit this by hand,
+ * change the generator and run it again. */
+
+#ifndef __JBITSLICEDDES_SBOXES_H__
+#define __JBITSLICEDDES_SBOXES_H__
+
+        EOF
+      end
+
+      def check(sbox, circuit, outputs)
+        unless circuit.evaluate(outputs) == BitslicedDES.outputs(sbox)
+          raise "the circuit for an S-box doesn't match its table"
+        end
+      end
+
+      def write_sbox(n, circuit, outputs)
+        @io.puts "// #{circuit.gates.length} gates"
+        @io.puts "static inline void sbox#{n}(const word64 a1, const word64 a2, const word64 a3, const word64 a4, const word64 a5, const word64 a6,"
+        @io.puts "  word64& out1, word64& out2, word64& out3, word64& out4)"
+        @io.puts "{"
+        circuit.gates.each do |name, op, a, b, _|
+          @io.puts "  const word64 #{name} = #{circuit.expression(op, a, b)};"
+        end
+        @io.puts
+        outputs.each_with_index do |o, i|
+          @io.puts "  out#{i + 1} ^= #{o};"
+        end
+        @io.puts "}"
+        @io.puts
+      end
+
+      # One round, l ^= f(r, k). The expansion and the permutation are just
+      # wiring here, so they cost nothing.
+      def write_round
+        inverse = []
+        P.each_with_index { |p, i| inverse[p - 1] = i }
+
+        @io.puts "static inline void desRound(word64* l, const word64* r, const word64* k)"
+        @io.puts "{"
+        8.times do |s|
+          inputs = (0...6).collect { |i| "r[#{E[s * 6 + i] - 1}] ^ k[#{s * 6 + i}]" }
+          outputs = (0...4).collect { |i| "l[#{inverse[s * 4 + i]}]" }
+          @io.puts "  sbox#{s + 1}(#{inputs.join(', ')},"
+          @io.puts "    #{outputs.join(', ')});"
+        end
+        @io.puts "}"
+        @io.puts
+      end
+  end
+end
+
+if __FILE__ == $0
+  BitslicedDES::Writer.new($stdout).write
+end
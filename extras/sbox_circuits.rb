@@ -0,0 +1,178 @@
+# Gate-level synthesis of small S-boxes for bitsliced code, shared by the
+# S-box generators in extras.
+#
+# Each S-box output is a Boolean function of its inputs, given as a truth
+# table whose bit i is the output for input i, the first input being the most
+# significant bit of i. We build each function by Shannon expansion on one
+# input at a time, in a fixed order, as a BDD would. Every signal built so
+# far goes into a pool, and before expanding a function we check whether one
+# gate over two pool signals gives it, so the outputs share as much of the
+# circuit as they can. The variable order decides how much sharing there is,
+# so we try the most promising orders and keep the smallest circuit.
+
+class SBoxCircuit
+  FORMATS = {
+    :and    => '%s & %s',
+    :or     => '%s | %s',
+    :xor    => '%s ^ %s',
+    :andnot => '%s & ~%s',
+    :ornot  => '%s | ~%s',
+    :not    => '~%s'
+  }
+
+  attr_reader :gates, :inputs
+
+  class << self
+    # Returns the smallest circuit found for the outputs, along with the
+    # names of the signals that hold them. names are the inputs' names, and
+    # the gates are named prefix1, prefix2 and so on.
+    def synthesize(outputs, names, orders_tried, prefix = 'x')
+      orders = (0...names.length).to_a.permutation.sort_by { |order|
+        new(names, prefix).bdd_size(outputs, order)
+      }.first(orders_tried)
+
+      orders.collect { |order|
+        circuit = new(names, prefix)
+        [ circuit, circuit.prune(outputs.collect { |t| circuit.build(t, order) }) ]
+      }.min_by { |circuit, _| circuit.gates.length }
+    end
+  end
+
+  def initialize(names, prefix = 'x')
+    @names = names
+    @prefix = prefix
+    @full = (1 << (1 << names.length)) - 1
+    @inputs = (0...names.length).collect { |v|
+      (0...(1 << names.length)).inject(0) { |t, i|
+        ((i >> (names.length - 1 - v)) & 1) == 1 ? t | (1 << i) : t
+      }
+    }
+    @gates = []
+    @pool = {}
+    @reachable = {}
+    @inputs.each_with_index { |t, v| add(t, names[v]) }
+  end
+
+  def apply(op, a, b)
+    case op
+      when :and then a & b
+      when :or then a | b
+      when :xor then a ^ b
+      when :andnot then a & (@full ^ b)
+      when :ornot then a | (@full ^ b)
+      when :not then @full ^ a
+    end
+  end
+
+  def expression(op, a, b)
+    format(FORMATS[op], a, b)
+  end
+
+  def cofactor(t, v, value)
+    shift = 1 << (@names.length - 1 - v)
+    if value == 1
+      x = t & @inputs[v]
+      x | (x >> shift)
+    else
+      x = t & (@full ^ @inputs[v])
+      x | (x << shift)
+    end
+  end
+
+  # The size of the plain BDD for an order, which is a cheap way to rank
+  # the orders before running the full synthesis on the best of them.
+  def bdd_size(outputs, order)
+    seen = {}
+    count = lambda { |t|
+      next 0 if t == 0 || t == @full || seen[t]
+      seen[t] = true
+      v = order.find { |w| cofactor(t, w, 0) != cofactor(t, w, 1) }
+      1 + count.call(cofactor(t, v, 0)) + count.call(cofactor(t, v, 1))
+    }
+    outputs.inject(0) { |sum, t| sum + count.call(t) }
+  end
+
+  # Returns the name of a signal with the truth table t.
+  def build(t, order)
+    return @pool[t] if @pool[t]
+    return gate(t, *@reachable[t]) if @reachable[t]
+
+    v = order.find { |w| cofactor(t, w, 0) != cofactor(t, w, 1) }
+    lo = cofactor(t, v, 0)
+    hi = cofactor(t, v, 1)
+    x = @pool[@inputs[v]]
+
+    if lo == 0
+      gate(t, :and, build(hi, order), x)
+    elsif hi == 0
+      gate(t, :andnot, build(lo, order), x)
+    elsif hi == @full
+      gate(t, :or, build(lo, order), x)
+    elsif lo == @full
+      gate(t, :ornot, build(hi, order), x)
+    elsif hi == @full ^ lo
+      gate(t, :xor, build(lo, order), x)
+    else
+      # lo ^ ((lo ^ hi) & x)
+      l = build(lo, order)
+      build(lo ^ hi, order)
+      gate(t, :xor, l, build((lo ^ hi) & @inputs[v], order))
+    end
+  end
+
+  # Drops the gates none of the named signals depend on, which the expansion
+  # sometimes builds along the way without using, and numbers the rest
+  # again. Returns the new names of the signals. This is for a finished
+  # circuit, nothing can be built on it afterwards.
+  def prune(names)
+    live = {}
+    names.each { |name| live[name] = true }
+    @gates.reverse_each do |name, op, a, b, _|
+      next unless live[name]
+      live[a] = true
+      live[b] = true unless op == :not
+    end
+
+    renamed = {}
+    @gates = @gates.select { |name, _| live[name] }.each_with_index.collect { |(name, op, a, b, t), i|
+      renamed[name] = "#{@prefix}#{i + 1}"
+      [ renamed[name], op, renamed[a] || a, op == :not ? nil : renamed[b] || b, t ]
+    }
+    names.collect { |name| renamed[name] || name }
+  end
+
+  # Runs the circuit on the truth tables of its inputs and returns those of
+  # the named signals, to check it against the table it came from.
+  def evaluate(names)
+    values = {}
+    @inputs.each_with_index { |t, v| values[@names[v]] = t }
+    @gates.each do |name, op, a, b, _|
+      values[name] = apply(op, values[a], values[b])
+    end
+    names.collect { |name| values[name] }
+  end
+
+  private
+    def add(t, name)
+      @pool[t] = name
+      @pool.each do |u, other|
+        FORMATS.each_key do |op|
+          reach(apply(op, t, u), op, name, other)
+          reach(apply(op, u, t), op, other, name)
+        end
+      end
+      name
+    end
+
+    # the constants never come up as S-box outputs, so there's no sense
+    # spending gates on them
+    def reach(t, op, a, b)
+      @reachable[t] ||= [ op, a, b ] unless t == 0 || t == @full
+    end
+
+    def gate(t, op, a, b)
+      name = "#{@prefix}#{@gates.length + 1}"
+      @gates << [ name, op, a, b, t ]
+      add(t, name)
+    end
+end
@@ -0,0 +1,120 @@
+#!/usr/bin/env ruby
+
+# Generates ext/jsimdserpent_sboxes.h, the gate circuits for the eight
+# Serpent S-boxes and their inverses used by the SIMD Serpent in
+# ext/jsimdserpent.cpp.
+#
+# Serpent is bitsliced to begin with, its four 32-bit words holding bit 0 to
+# bit 3 of 32 S-box inputs, so an S-box is a circuit over whole words, and
+# over whole vectors of words just as well. The circuits are templates on
+# the word type for that reason. Each one is synthesized by
+# extras/sbox_circuits.rb over all 24 variable orders and checked against
+# its table before it's written out.
+#
+# Usage:
+#
+#   ruby extras/serpent_sboxes.rb > ext/jsimdserpent_sboxes.h
+
+require File.expand_path('../sbox_circuits', __FILE__)
+
+module SerpentSBoxes
+  SBOXES = [
+    [  3,  8, 15,  1, 10,  6,  5, 11, 14, 13,  4,  2,  7,  0,  9, 12 ],
+    [ 15, 12,  2,  7,  9,  0,  5, 10,  1, 11, 14,  8,  6, 13,  3,  4 ],
+    [  8,  6,  7,  9,  3, 12, 10, 15, 13,  1, 14,  4,  0, 11,  5,  2 ],
+    [  0, 15, 11,  8, 12,  9,  6,  3, 13,  1,  2,  4, 10,  7,  5, 14 ],
+    [  1, 15,  8,  3, 12,  0, 11,  6,  2,  5,  4, 10,  9, 14,  7, 13 ],
+    [ 15,  5,  2, 11,  4, 10,  9, 12,  0,  3, 14,  8, 13,  6,  7,  1 ],
+    [  7,  2, 12,  5,  8,  4,  6, 11, 14,  9,  1, 15, 13,  3, 10,  0 ],
+    [  1, 13, 15,  0, 14,  8,  2, 11,  7,  4, 12, 10,  9,  3,  5,  6 ]
+  ]
+
+  # x3 is the most significant bit of an S-box's input
+  INPUTS = %w{ x3 x2 x1 x0 }
+
+  class << self
+    def inverse(sbox)
+      sbox.each_with_index.inject([]) { |inverse, (y, x)| inverse[y] = x; inverse }
+    end
+
+    # the truth tables of the four outputs, y3 being the most significant
+    def outputs(sbox)
+      (0...4).collect { |o|
+        (0...16).inject(0) { |t, i| ((sbox[i] >> (3 - o)) & 1) == 1 ? t | (1 << i) : t }
+      }
+    end
+
+    def synthesize(sbox)
+      SBoxCircuit.synthesize(outputs(sbox), INPUTS, 24, 't')
+    end
+  end
+
+  class Writer
+    def initialize(io)
+      @io = io
+    end
+
+    def write
+      @io.puts header
+
+      SBOXES.each_with_index do |sbox, n|
+        write_sbox("serpentS#{n}", sbox)
+      end
+
+      SBOXES.each_with_index do |sbox, n|
+        write_sbox("serpentInvS#{n}", SerpentSBoxes.inverse(sbox))
+      end
+
+      @io.puts "#endif"
+    end
+
+    private
+      def header
+        <<-EOF
+
+/*
+ * Copyright (c) 2002-2014 J Smith <dark.panda@gmail.com>
+ * Crypto++ copyright (c) 1995-2013 Wei Dai
+ * See MIT-LICENSE for the extact license
+ */
+
+/* Generated by extras/serpent_sboxes.rb. Don't edit this by hand, change
+ * the generator and run it again. */
+
+#ifndef __JSIMDSERPENT_SBOXES_H__
+#define __JSIMDSERPENT_SBOXES_H__
+
+        EOF
+      end
+
+      def write_sbox(name, sbox)
+        circuit, outputs = SerpentSBoxes.synthesize(sbox)
+
+        unless sbox.sort == (0...16).to_a && circuit.evaluate(outputs) == SerpentSBoxes.outputs(sbox)
+          raise "the circuit for #{name} doesn't match its table"
+        end
+
+        @io.puts "// #{circuit.gates.length} gates"
+        @io.puts "template <class W>"
+        @io.puts "static SIMD_INLINE void #{name}(W& x0, W& x1, W& x2, W& x3)"
+        @io.puts "{"
+        circuit.gates.each do |gate, op, a, b, _|
+          @io.puts "  const W #{gate} = #{circuit.expression(op, a, b)};"
+        end
+        @io.puts
+        outputs.reverse.each_with_index do |o, i|
+          @io.puts "  const W y#{i} = #{o};"
+        end
+        @io.puts
+        4.times do |i|
+          @io.puts "  x#{i} = y#{i};"
+        end
+        @io.puts "}"
+        @io.puts
+      end
+  end
+end
+
+if __FILE__ == $0
+  SerpentSBoxes::Writer.new($stdout).write
+end
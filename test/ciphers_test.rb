@@ -28,4 +28,735 @@ class CiphersTest < MiniTest::Unit::TestCase
       end
     end
   end
+
+  def test_encrypt_io_with_real_files
+    if CryptoPP.cipher_enabled? :aes
+      require 'stringio'
+      require 'tempfile'
+
+      cipher = CryptoPP.cipher_factory(:aes, {
+        :key => '0123456789abcdef',
+        :iv => 'fedcba9876543210',
+        :block_mode => :cbc
+      })
+      plaintext = 'x' * 200_000
+
+      expected = StringIO.new
+      cipher.encrypt_io(StringIO.new(plaintext), expected)
+
+      Tempfile.open('cryptopp_in') do |input|
+        input.binmode
+        input.write(plaintext)
+        input.rewind
+
+        Tempfile.open('cryptopp_out') do |output|
+          output.binmode
+          cipher.encrypt_io(input, output)
+          output.rewind
+
+          assert_equal(expected.string, output.read)
+
+          output.rewind
+          decrypted = StringIO.new
+          cipher.decrypt_io(output, decrypted)
+          assert_equal(plaintext, decrypted.string)
+        end
+      end
+    end
+  end
+
+  def test_encrypt_io_buffers_writes
+    if CryptoPP.cipher_enabled? :aes
+      require 'stringio'
+
+      counting_io = Class.new(StringIO) do
+        attr_reader :writes
+
+        def write(*args)
+          @writes = (@writes || 0) + 1
+          super
+        end
+      end
+
+      cipher = CryptoPP.cipher_factory(:aes, {
+        :key => '0123456789abcdef',
+        :iv => 'fedcba9876543210',
+        :block_mode => :cbc
+      })
+      plaintext = 'x' * 200_000
+
+      buffered = counting_io.new
+      cipher.encrypt_io(StringIO.new(plaintext), buffered)
+      assert_operator(buffered.writes, :<=, 4)
+
+      small = counting_io.new
+      cipher.encrypt_io(StringIO.new(plaintext), small, :buffer_size => 1000)
+      assert_equal(buffered.string, small.string)
+      assert_operator(small.writes, :>, buffered.writes)
+    end
+  end
+
+  def test_encrypt_io_pipeline
+    if CryptoPP.cipher_enabled? :aes
+      require 'stringio'
+
+      cipher = CryptoPP.cipher_factory(:aes, {
+        :key => '0123456789abcdef',
+        :iv => 'fedcba9876543210',
+        :block_mode => :cbc
+      })
+      plaintext = 'x' * 300_000
+
+      expected = StringIO.new
+      cipher.encrypt_io(StringIO.new(plaintext), expected)
+
+      pipelined = StringIO.new
+      cipher.encrypt_io(StringIO.new(plaintext), pipelined, :pipeline => true, :buffer_size => 1000)
+      assert_equal(expected.string, pipelined.string)
+
+      decrypted = StringIO.new
+      cipher.decrypt_io(StringIO.new(pipelined.string), decrypted, :pipeline => true)
+      assert_equal(plaintext, decrypted.string)
+    end
+  end
+
+  def test_file_crypter
+    if CryptoPP.cipher_enabled? :aes
+      require 'tmpdir'
+
+      options = {
+        :algorithm => :aes,
+        :key => '0123456789abcdef',
+        :iv => 'fedcba9876543210',
+        :block_mode => :cbc,
+        :buffer_size => 1000
+      }
+      cipher = CryptoPP.cipher_factory(:aes, options)
+
+      Dir.mktmpdir do |dir|
+        plaintexts = [ '', 'short', 'x' * 5000, 'y' * 100_000 ]
+        pairs = plaintexts.each_with_index.collect do |plaintext, i|
+          File.binwrite(File.join(dir, "#{i}.txt"), plaintext)
+          [ File.join(dir, "#{i}.txt"), File.join(dir, "#{i}.enc") ]
+        end
+
+        assert(CryptoPP::FileCrypter.encrypt_files(pairs, options))
+
+        pairs.each_with_index do |(plain, enc), i|
+          cipher.plaintext = plaintexts[i]
+          assert_equal(cipher.encrypt, File.binread(enc))
+        end
+
+        decrypted = pairs.collect { |plain, enc| [ enc, "#{plain}.dec" ] }
+        assert(CryptoPP::FileCrypter.decrypt_files(decrypted, cipher, :threads => 2))
+        decrypted.each_with_index do |(enc, dec), i|
+          assert_equal(plaintexts[i], File.binread(dec))
+        end
+
+        missing = [ [ File.join(dir, 'missing.txt'), File.join(dir, 'missing.enc') ] ]
+        assert_raises(CryptoPP::CryptoPPError) do
+          CryptoPP::FileCrypter.encrypt_files(missing + pairs, cipher)
+        end
+        assert(!File.exist?(File.join(dir, 'missing.enc')))
+
+        plain = pairs.last.first
+        File.symlink(plain, File.join(dir, 'link.txt'))
+        [ plain, File.join(dir, 'link.txt') ].each do |out|
+          assert_raises(CryptoPP::CryptoPPError) do
+            CryptoPP::FileCrypter.encrypt_files([ [ plain, out ] ], cipher)
+          end
+          assert_equal(plaintexts.last, File.binread(plain))
+        end
+      end
+    end
+  end
+
+  def test_encrypt_file
+    if CryptoPP.cipher_enabled? :aes
+      require 'tempfile'
+
+      cipher = CryptoPP.cipher_factory(:aes, {
+        :key => '0123456789abcdef',
+        :iv => 'fedcba9876543210',
+        :block_mode => :cbc
+      })
+      plaintext = 'x' * 100_000
+
+      Tempfile.create('plaintext') do |plain|
+        plain.binmode
+        plain.write(plaintext)
+        plain.close
+
+        cipher.plaintext = plaintext
+        assert(cipher.encrypt_file(plain.path, "#{plain.path}.enc"))
+        assert_equal(cipher.encrypt, File.binread("#{plain.path}.enc"))
+
+        assert(cipher.decrypt_file("#{plain.path}.enc", "#{plain.path}.dec"))
+        assert_equal(plaintext, File.binread("#{plain.path}.dec"))
+
+        File.unlink("#{plain.path}.enc", "#{plain.path}.dec")
+      end
+    end
+  end
+
+  def test_encrypt_each
+    if CryptoPP.cipher_enabled? :aes
+      require 'stringio'
+
+      cipher = CryptoPP.cipher_factory(:aes, {
+        :key => '0123456789abcdef',
+        :iv => 'fedcba9876543210',
+        :block_mode => :cbc
+      })
+      plaintext = 'x' * 10_000
+      cipher.plaintext = plaintext
+      ciphertext = cipher.encrypt
+
+      chunks = []
+      cipher.encrypt_each(plaintext, :chunk_size => 1000) { |chunk| chunks << chunk }
+      assert_equal(ciphertext, chunks.join)
+      assert(chunks[0..-2].all? { |chunk| chunk.length == 1000 })
+
+      assert_equal(ciphertext, cipher.encrypt_each(StringIO.new(plaintext)).to_a.join)
+      assert_equal(plaintext, cipher.decrypt_each(ciphertext, :chunk_size => 7).to_a.join)
+      assert_equal(ciphertext.slice(0, 1000), cipher.encrypt_each(plaintext, :chunk_size => 1000).first)
+    end
+  end
+
+  # Just enough of a Fiber::Scheduler to run fibers that wait on IOs.
+  class TestScheduler
+    def initialize
+      @readable, @writable, @sleeping = {}, {}, {}
+    end
+
+    def io_wait(io, events, timeout)
+      @readable[io] = Fiber.current if events & IO::READABLE != 0
+      @writable[io] = Fiber.current if events & IO::WRITABLE != 0
+      Fiber.yield
+      events
+    end
+
+    def kernel_sleep(duration = nil)
+      @sleeping[Fiber.current] = Time.now + duration.to_f
+      Fiber.yield
+    end
+
+    def fiber(&block)
+      Fiber.new(:blocking => false, &block).tap(&:resume)
+    end
+
+    def block(blocker, timeout = nil)
+      raise NotImplementedError
+    end
+
+    def unblock(blocker, fiber)
+    end
+
+    def close
+      until @readable.empty? && @writable.empty? && @sleeping.empty?
+        readable, writable = IO.select(@readable.keys, @writable.keys, [], 0.01)
+        (readable || []).each { |io| @readable.delete(io).resume }
+        (writable || []).each { |io| @writable.delete(io).resume }
+        @sleeping.select { |fiber, time| time <= Time.now }.each_key { |fiber| @sleeping.delete(fiber); fiber.resume }
+      end
+    end
+  end
+
+  def test_encrypt_io_under_fiber_scheduler
+    if CryptoPP.cipher_enabled?(:aes) && defined?(Fiber.set_scheduler)
+      require 'stringio'
+
+      cipher = CryptoPP.cipher_factory(:aes, {
+        :key => '0123456789abcdef',
+        :iv => 'fedcba9876543210',
+        :block_mode => :cbc
+      })
+      plaintext = 'x' * 50_000
+      cipher.plaintext = plaintext
+      output = StringIO.new
+
+      # the writer only gets to run if encrypt_io yields while it waits
+      Thread.new do
+        Fiber.set_scheduler(TestScheduler.new)
+        reader, writer = IO.pipe
+
+        Fiber.schedule do
+          cipher.encrypt_io(reader, output, :pipeline => true)
+        end
+
+        Fiber.schedule do
+          5.times do
+            writer.write('x' * 10_000)
+            sleep 0.01
+          end
+          writer.close
+        end
+      end.join
+
+      assert_equal(cipher.encrypt, output.string)
+    end
+  end
+
+  def test_encrypt_io_with_digests
+    if CryptoPP.cipher_enabled?(:aes) && CryptoPP.digest_enabled?(:sha256) && CryptoPP.digest_enabled?(:md5)
+      require 'stringio'
+
+      cipher = CryptoPP.cipher_factory(:aes, {
+        :key => '0123456789abcdef',
+        :iv => 'fedcba9876543210',
+        :block_mode => :cbc
+      })
+      plaintext = 'x' * 300_000
+
+      [ false, true ].each do |pipeline|
+        encrypted = StringIO.new
+        digests = cipher.encrypt_io(StringIO.new(plaintext), encrypted,
+          :pipeline => pipeline,
+          :plaintext_digests => [ :sha256 ],
+          :ciphertext_digests => [ :md5, :sha256 ]
+        )
+        ciphertext = encrypted.string
+
+        assert_equal(CryptoPP.digest(:sha256, plaintext), digests[:plaintext_digests][:sha256])
+        assert_equal(CryptoPP.digest(:md5, ciphertext), digests[:ciphertext_digests][:md5])
+        assert_equal(CryptoPP.digest(:sha256, ciphertext), digests[:ciphertext_digests][:sha256])
+
+        decrypted = StringIO.new
+        digests = cipher.decrypt_io(StringIO.new(ciphertext), decrypted, :pipeline => pipeline, :plaintext_digests => :sha256)
+        assert_equal(plaintext, decrypted.string)
+        assert_equal(CryptoPP.digest(:sha256, plaintext), digests[:plaintext_digests][:sha256])
+        assert_equal({}, digests[:ciphertext_digests])
+      end
+    end
+  end
+
+  def test_encrypt_with_compression
+    if CryptoPP.cipher_enabled? :aes
+      require 'stringio'
+      require 'zlib'
+
+      cipher = CryptoPP.cipher_factory(:aes, {
+        :key => '0123456789abcdef',
+        :iv => 'fedcba9876543210',
+        :block_mode => :cbc
+      })
+      plaintext = '{"json":"blob"}' * 10_000
+
+      [ :deflate, :gzip ].each do |compression|
+        cipher.plaintext = plaintext
+        ciphertext = cipher.encrypt(:compress => compression)
+        assert(ciphertext.length < plaintext.length / 10)
+
+        cipher.ciphertext = ciphertext
+        assert_equal(plaintext, cipher.decrypt(:decompress => compression))
+
+        encrypted = StringIO.new
+        cipher.encrypt_io(StringIO.new(plaintext), encrypted, :compress => compression, :pipeline => true)
+        assert_equal(ciphertext, encrypted.string)
+
+        decrypted = StringIO.new
+        cipher.decrypt_io(StringIO.new(encrypted.string), decrypted, :decompress => compression)
+        assert_equal(plaintext, decrypted.string)
+      end
+
+      cipher.ciphertext = cipher.encrypt(:compress => :gzip)
+      assert_equal(plaintext, Zlib.gunzip(cipher.decrypt))
+
+      assert_raises(CryptoPP::CryptoPPError) do
+        cipher.encrypt(:compress => :lzma)
+      end
+    end
+  end
+
+  def test_hex_round_trip
+    if CryptoPP.cipher_enabled? :aes
+      cipher = CryptoPP.cipher_factory(:aes)
+      binary = (0..255).map(&:chr).join * 5
+
+      cipher.plaintext = binary
+      assert_equal(binary.unpack('H*').first, cipher.plaintext_hex)
+
+      cipher.plaintext_hex = binary.unpack('H*').first.upcase
+      assert_equal(binary, cipher.plaintext)
+
+      cipher.plaintext_hex = "0a 0B\n0c"
+      assert_equal("\x0a\x0b\x0c", cipher.plaintext)
+    end
+  end
+
+  def test_base64
+    if CryptoPP.cipher_enabled? :aes
+      require 'base64'
+
+      cipher = CryptoPP.cipher_factory(:aes, :key_b64url => Base64.urlsafe_encode64('k' * 16, :padding => false))
+      assert_equal('k' * 16, cipher.key)
+
+      (0..100).each do |length|
+        binary = (0...length).map { |i| ((i * 37) % 256).chr }.join
+
+        cipher.plaintext = binary
+        assert_equal(Base64.strict_encode64(binary), cipher.plaintext_b64)
+        assert_equal(Base64.urlsafe_encode64(binary, :padding => false), cipher.plaintext_b64url)
+
+        cipher.plaintext_b64 = Base64.strict_encode64(binary)
+        assert_equal(binary, cipher.plaintext)
+        cipher.plaintext_b64url = Base64.urlsafe_encode64(binary)
+        assert_equal(binary, cipher.plaintext)
+
+        ciphertext = cipher.encrypt
+        assert_equal(Base64.urlsafe_encode64(ciphertext, :padding => false), cipher.encrypt_b64url)
+        cipher.ciphertext_b64 = Base64.strict_encode64(ciphertext)
+        assert_equal(Base64.strict_encode64(binary), cipher.decrypt_b64)
+      end
+    end
+
+    if CryptoPP.digest_enabled? :sha256
+      assert_equal(Base64.strict_encode64(CryptoPP.digest(:sha256, 'foo')), CryptoPP.digest_b64(:sha256, 'foo'))
+    end
+  end
+
+  def test_random_bytes
+    assert_equal('', CryptoPP.random_bytes(0))
+    assert_equal(1000, CryptoPP.random_bytes(1000).length)
+    refute_equal(CryptoPP.random_bytes(32), CryptoPP.random_bytes(32))
+    assert_equal(16, CryptoPP.random_bytes(16, :rand).length)
+
+    assert_raises(ArgumentError) do
+      CryptoPP.random_bytes(-1)
+    end
+
+    if CryptoPP.rng_available?(:non_blocking)
+      cipher = CryptoPP.cipher_factory(:aes, :rng => :non_blocking)
+      cipher.rand_iv(16)
+      assert_equal(16, cipher.iv.length)
+    end
+  end
+
+  def test_hardware_rngs
+    [ :rdrand, :rdseed ].each do |rng|
+      assert(CryptoPP.rng_available?(rng))
+      assert_equal(37, CryptoPP.random_bytes(37, rng).length)
+      refute_equal(CryptoPP.random_bytes(16, rng), CryptoPP.random_bytes(16, rng))
+
+      if CryptoPP.cipher_enabled? :aes
+        cipher = CryptoPP.cipher_factory(:aes, :rng => rng, :rand_iv => 16)
+        assert_equal(rng, cipher.rng)
+        assert_equal(16, cipher.iv.length)
+        assert_match(/#{rng.to_s.upcase}/, cipher.rng_name)
+      end
+    end
+  end
+
+  def test_nonce_sequence
+    nonces = CryptoPP::NonceSequence.new
+    first, second = nonces.next, nonces.next
+    assert_equal(16, nonces.size)
+    assert_equal(2, nonces.count)
+    assert_equal(nonces.prefix + "\0" * 7 + "\1" + "\0" * 4, second)
+    refute_equal(first, second)
+
+    gcm = CryptoPP::NonceSequence.new(:size => 12, :block_counter_size => 0)
+    assert_equal(12, gcm.next.length)
+
+    assert_raises(CryptoPP::CryptoPPError) do
+      CryptoPP::NonceSequence.new(:size => 8)
+    end
+
+    # size + block_counter_size would wrap around to 7 here
+    assert_raises(CryptoPP::CryptoPPError) do
+      CryptoPP::NonceSequence.new(:size => 16, :block_counter_size => 0xFFFFFFFF)
+    end
+
+    # a child process mustn't hand out the nonces its parent will
+    if Process.respond_to?(:fork)
+      forked = CryptoPP::NonceSequence.new
+      reader, writer = IO.pipe
+      pid = fork do
+        reader.close
+        writer.write(forked.next)
+        writer.close
+        exit!(0)
+      end
+      writer.close
+      child = reader.read
+      reader.close
+      Process.wait(pid)
+
+      assert_equal(16, child.length)
+      refute_equal(forked.prefix, child[0, 4])
+      assert_equal("\0" * 8, child[4, 8])
+      refute_equal(child, forked.next)
+    end
+
+    # an 8 byte block would only see the prefix and the top of the counter
+    if CryptoPP.cipher_enabled? :des
+      des = CryptoPP.cipher_factory(:des, :key => '01234567', :block_mode => :ctr)
+      assert_raises(ArgumentError) do
+        des.iv = CryptoPP::NonceSequence.new
+      end
+      assert_raises(ArgumentError) do
+        CryptoPP::FileCrypter.encrypt_files([], des, :iv => CryptoPP::NonceSequence.new)
+      end
+
+      des.iv = CryptoPP::NonceSequence.new(:size => 8, :block_counter_size => 0)
+      assert_equal(8, des.iv.length)
+    end
+
+    if CryptoPP.cipher_enabled? :aes
+      require 'tmpdir'
+
+      cipher = CryptoPP.cipher_factory(:aes, :key => '0123456789abcdef', :block_mode => :ctr, :iv => nonces)
+      assert_equal(nonces.prefix + "\0" * 7 + "\2" + "\0" * 4, cipher.iv)
+
+      Dir.mktmpdir do |dir|
+        pairs = (0...3).collect do |i|
+          File.binwrite(File.join(dir, "#{i}.txt"), "file #{i}" * 1000)
+          [ File.join(dir, "#{i}.txt"), File.join(dir, "#{i}.enc") ]
+        end
+
+        iv = cipher.iv
+        ivs = CryptoPP::FileCrypter.encrypt_files(pairs, cipher, :iv => nonces)
+        assert_equal(3, ivs.uniq.length)
+        assert_equal(iv, cipher.iv)
+        pairs.each_with_index do |(plain, enc), i|
+          cipher.iv = ivs[i]
+          cipher.ciphertext = File.binread(enc)
+          assert_equal(File.binread(plain), cipher.decrypt)
+        end
+      end
+    end
+  end
+
+  def test_cipher_spec
+    if CryptoPP.cipher_enabled? :aes
+      key, iv = '0123456789abcdef', 'fedcba9876543210'
+      spec = CryptoPP::CipherSpec.new(:aes, :key => key, :block_mode => :cbc)
+      assert(spec.frozen?)
+      assert_equal(:cbc, spec.block_mode)
+      assert_equal(16, spec.block_size)
+
+      cipher = CryptoPP.cipher_factory(:aes, :key => key, :block_mode => :cbc, :iv => iv, :plaintext => 'a secret')
+      assert_equal(cipher.encrypt, spec.encrypt('a secret', :iv => iv))
+      assert_equal('a secret', spec.decrypt(cipher.ciphertext, :iv_hex => iv.unpack('H*').first))
+
+      long = 'long message' * 10000
+      threads = (0...4).collect do |i|
+        Thread.new do
+          own_iv = CryptoPP.random_bytes(16)
+          spec.decrypt(spec.encrypt(long + i.to_s, :iv => own_iv), :iv => own_iv)
+        end
+      end
+      threads.each_with_index do |thread, i|
+        assert_equal(long + i.to_s, thread.value)
+      end
+
+      assert_raises(CryptoPP::CryptoPPError) do
+        spec.encrypt('a secret', :iv => 'short')
+      end
+
+      assert_raises(CryptoPP::CryptoPPError) do
+        CryptoPP::CipherSpec.new(:aes, :key => key, :iv => iv)
+      end
+    end
+  end
+
+  def test_key_schedule_cache
+    if CryptoPP.cipher_enabled? :aes
+      keys = (0...4).collect { |i| i.to_s * 16 }
+
+      assert_raises(CryptoPP::CryptoPPError) do
+        CryptoPP::KeyScheduleCache.preload(:aes, keys)
+      end
+
+      begin
+        assert(CryptoPP::KeyScheduleCache.enable(1024 * 1024))
+        assert(CryptoPP::KeyScheduleCache.enabled?)
+        assert_equal(4, CryptoPP::KeyScheduleCache.preload(:aes, keys, :block_mode => :cbc))
+
+        stats = CryptoPP::KeyScheduleCache.stats
+        assert_equal(8, stats[:entries])
+        assert_equal(1024 * 1024, stats[:max_bytes])
+
+        cipher = CryptoPP.cipher_factory(:aes, :key => keys.first, :block_mode => :cbc, :iv => '0' * 16, :plaintext => 'a secret')
+        ciphertext = cipher.encrypt
+        assert_equal('a secret', cipher.decrypt)
+        assert_equal(stats[:hits] + 2, CryptoPP::KeyScheduleCache.stats[:hits])
+
+        CryptoPP::KeyScheduleCache.disable
+        assert_equal(0, CryptoPP::KeyScheduleCache.stats[:entries])
+        assert_equal(ciphertext, cipher.encrypt)
+      ensure
+        CryptoPP::KeyScheduleCache.disable
+      end
+    end
+  end
+
+  def test_fast_paths
+    if CryptoPP.cipher_enabled? :aes
+      plaintext = 'fast path' * 100
+
+      [ :ecb, :cbc, :cbc_cts, :cfb, :ctr, :ofb ].each do |mode|
+        options = { :key => '0123456789abcdef', :iv => 'fedcba9876543210', :block_mode => mode, :plaintext => plaintext }
+        fast = CryptoPP.cipher_factory(:aes, options).encrypt
+
+        # the key schedule cache turns the fast paths off...
+        begin
+          CryptoPP::KeyScheduleCache.enable
+          generic = CryptoPP.cipher_factory(:aes, options)
+          assert_equal(fast, generic.encrypt, "#{mode} fast path")
+        ensure
+          CryptoPP::KeyScheduleCache.disable
+        end
+
+        assert_equal(plaintext, CryptoPP.cipher_factory(:aes, options.merge(:ciphertext => fast)).decrypt)
+      end
+    end
+  end
+
+  def test_encrypt_blocks
+    if CryptoPP.cipher_enabled? :aes
+      cipher = CryptoPP.cipher_factory(:aes, :key => '0123456789abcdef', :block_mode => :ecb, :padding => :zeros)
+      ids = (0...2000).collect { |i| [ i, i * 7 ].pack('Q>Q>') }
+
+      encrypted = cipher.encrypt_blocks(ids.join)
+      assert_equal(ids.length * 16, encrypted.length)
+      assert_equal(encrypted, cipher.encrypt_blocks(ids).join)
+      assert_equal(ids, cipher.decrypt_blocks(encrypted.scan(/.{16}/m)))
+
+      cipher.plaintext = ids.first
+      assert_equal(cipher.encrypt, encrypted[0, 16])
+
+      assert_raises(CryptoPP::CryptoPPError) do
+        cipher.encrypt_blocks('not a block')
+      end
+
+      assert_raises(CryptoPP::CryptoPPError) do
+        cipher.encrypt_blocks([ 'not a block' ])
+      end
+    end
+  end
+
+  def test_bitsliced_aes
+    if CryptoPP.cipher_enabled? :aes
+      cipher = CryptoPP::AES.new(:key_hex => '000102030405060708090a0b0c0d0e0f', :block_mode => :ecb, :padding => :zeros, :backend => :bitsliced)
+      assert_equal(:bitsliced, cipher.backend)
+      assert_equal('69c4e0d86a7b0430d8cdb78070b4c55a', cipher.encrypt_blocks(['00112233445566778899aabbccddeeff'].pack('H*')).unpack('H*').first)
+
+      plaintext = 'bitsliced' * 100
+
+      [ 16, 24, 32 ].each do |key_length|
+        [ :ecb, :cbc, :ctr ].each do |mode|
+          options = { :key => 'k' * key_length, :iv => 'fedcba9876543210', :block_mode => mode, :plaintext => plaintext }
+          expected = CryptoPP::AES.new(options).encrypt
+
+          ciphertext = CryptoPP::AES.new(options.merge(:backend => :bitsliced)).encrypt
+          assert_equal(expected, ciphertext, "#{mode} with a #{key_length * 8}-bit key")
+          assert_equal(plaintext, CryptoPP::AES.new(options.merge(:ciphertext => ciphertext, :backend => :bitsliced)).decrypt)
+        end
+      end
+
+      assert_raises(CryptoPP::CryptoPPError) do
+        CryptoPP::AES.new(:backend => :nope)
+      end
+
+      if CryptoPP.cipher_enabled? :blowfish
+        assert_raises(CryptoPP::CryptoPPError) do
+          CryptoPP.cipher_factory(:blowfish, :backend => :bitsliced)
+        end
+      end
+    end
+  end
+
+  def test_bitsliced_des
+    if CryptoPP.cipher_enabled? :des
+      cipher = CryptoPP::DES.new(:key_hex => '133457799bbcdff1', :block_mode => :ecb, :padding => :zeros)
+      assert_equal(['85e813540f0ab405'].pack('H*') * 64, cipher.encrypt_blocks(['0123456789abcdef'].pack('H*') * 64))
+    end
+
+    [ [ :des, 8 ], [ :des_ede2, 16 ], [ :des_ede3, 24 ] ].each do |name, key_length|
+      next unless CryptoPP.cipher_enabled? name
+
+      key = 'abcdefghijklmnopqrstuvwx'[0, key_length]
+
+      # single blocks go through the table-driven DES and longer runs through
+      # the bitsliced one, so the two have to agree
+      cipher = CryptoPP.cipher_factory(name, :key => key, :block_mode => :ecb, :padding => :zeros)
+      blocks = (0...200).collect { |i| [ i * 7 ].pack('Q>') }
+      encrypted = cipher.encrypt_blocks(blocks.join)
+      assert_equal(blocks.collect { |block| cipher.encrypt_blocks(block) }.join, encrypted, "#{name} ecb")
+      assert_equal(blocks.join, cipher.decrypt_blocks(encrypted))
+
+      counters = (0...200).collect { |i| [ 0x6665646362613938 + i ].pack('Q>') }
+      keystream = CryptoPP.cipher_factory(name, :key => key, :iv => 'fedcba98', :block_mode => :ctr, :plaintext => "\0" * 1600).encrypt
+      assert_equal(counters.collect { |counter| cipher.encrypt_blocks(counter) }.join, keystream, "#{name} ctr")
+
+      plaintext = 'bitsliced' * 100
+      options = { :key => key, :iv => 'fedcba98', :block_mode => :cbc, :plaintext => plaintext }
+      ciphertext = CryptoPP.cipher_factory(name, options).encrypt
+      assert_equal(plaintext, CryptoPP.cipher_factory(name, options.merge(:ciphertext => ciphertext)).decrypt, "#{name} cbc")
+    end
+  end
+
+  def test_simd_serpent_and_twofish
+    if CryptoPP.cipher_enabled? :twofish
+      cipher = CryptoPP::Twofish.new(:key => "\0" * 16, :block_mode => :ecb, :padding => :zeros)
+      assert_equal(['9f589f5cf6122c32b6bfec2f2ae8c35a'].pack('H*') * 64, cipher.encrypt_blocks("\0" * 1024))
+    end
+
+    [ :serpent, :twofish ].each do |name|
+      next unless CryptoPP.cipher_enabled? name
+
+      [ 16, 24, 32 ].each do |key_length|
+        key = 'abcdefghijklmnopqrstuvwxyz012345'[0, key_length]
+
+        # single blocks go through Crypto++'s implementation and longer runs
+        # through the SIMD one where the CPU has it, so the two have to agree
+        cipher = CryptoPP.cipher_factory(name, :key => key, :block_mode => :ecb, :padding => :zeros)
+        blocks = (0...200).collect { |i| [ i * 7, i ].pack('Q>Q>') }
+        encrypted = cipher.encrypt_blocks(blocks.join)
+        assert_equal(blocks.collect { |block| cipher.encrypt_blocks(block) }.join, encrypted, "#{name} ecb")
+        assert_equal(blocks.join, cipher.decrypt_blocks(encrypted))
+
+        counters = (0...200).collect { |i| [ 0x6665646362613938, 0x3736353433323130 + i ].pack('Q>Q>') }
+        keystream = CryptoPP.cipher_factory(name, :key => key, :iv => 'fedcba9876543210', :block_mode => :ctr, :plaintext => "\0" * 3200).encrypt
+        assert_equal(counters.collect { |counter| cipher.encrypt_blocks(counter) }.join, keystream, "#{name} ctr")
+
+        plaintext = 'vectorized' * 100
+        options = { :key => key, :iv => 'fedcba9876543210', :block_mode => :cbc, :plaintext => plaintext }
+        ciphertext = CryptoPP.cipher_factory(name, options).encrypt
+        assert_equal(plaintext, CryptoPP.cipher_factory(name, options.merge(:ciphertext => ciphertext)).decrypt, "#{name} cbc")
+      end
+    end
+  end
+
+  def test_encrypt_many
+    [ :aes, :serpent, :des_ede3 ].each do |name|
+      next unless CryptoPP.cipher_enabled? name
+
+      [ :pkcs, :zeros, :one_and_zeros ].each do |padding|
+        cipher = CryptoPP.cipher_factory(name, :key => 'abcdefghijklmnopqrstuvwx', :block_mode => :cbc, :padding => padding)
+        plaintexts = (0...50).collect { |i| 'record' * (i * 3 % 41) }
+        ivs = (0...50).collect { |i| [ i ].pack('N') * 4 }
+
+        # every message is interleaved with the others, but the output has
+        # to be just what encrypting it on its own gives
+        expected = plaintexts.zip(ivs).collect { |plaintext, iv|
+          cipher.iv = iv
+          cipher.plaintext = plaintext
+          cipher.encrypt
+        }
+        assert_equal(expected, cipher.encrypt_many(plaintexts, ivs), "#{name} #{padding}")
+      end
+    end
+
+    if CryptoPP.cipher_enabled? :aes
+      cipher = CryptoPP::AES.new(:key => 'abcdefghijklmnop', :block_mode => :cbc)
+      assert_equal([], cipher.encrypt_many([], []))
+      assert_raises(ArgumentError) { cipher.encrypt_many([ 'a', 'b' ], [ 'x' * 16 ]) }
+      assert_raises(CryptoPP::CryptoPPError) { cipher.encrypt_many([ 'a' ], [ 'short' ]) }
+
+      cipher.block_mode = :ctr
+      assert_raises(CryptoPP::CryptoPPError) { cipher.encrypt_many([ 'a' ], [ 'x' * 16 ]) }
+    end
+  end
 end
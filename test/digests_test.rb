@@ -20,4 +20,44 @@ class DigestsTest < MiniTest::Unit::TestCase
       end
     end
   end
+
+  def test_digest_io_pipeline
+    if CryptoPP.digest_enabled? :sha256
+      require 'stringio'
+
+      plaintext = 'x' * 300_000
+      expected = CryptoPP.digest_hex(:sha256, plaintext)
+
+      assert_equal(expected, CryptoPP.digest_io_hex(:sha256, StringIO.new(plaintext), :pipeline => true))
+      assert_equal(expected, CryptoPP.digest_io_hex(:sha256, StringIO.new(plaintext), :pipeline => true, :buffer_size => 1000))
+
+      [ 0, -1 ].each do |buffer_size|
+        assert_raises(ArgumentError) do
+          CryptoPP.digest_io_hex(:sha256, StringIO.new(plaintext), :buffer_size => buffer_size)
+        end
+      end
+    end
+  end
+
+  def test_copy_stream
+    if CryptoPP.digest_enabled?(:sha256) && CryptoPP.digest_enabled?(:md5)
+      require 'stringio'
+
+      plaintext = 'x' * 300_000
+      out = StringIO.new
+
+      digests = CryptoPP.copy_stream(StringIO.new(plaintext), out, :digests => [ :sha256, :md5 ])
+      assert_equal(plaintext, out.string)
+      assert_equal(CryptoPP.digest(:sha256, plaintext), digests[:sha256])
+      assert_equal(CryptoPP.digest(:md5, plaintext), digests[:md5])
+
+      assert_equal({}, CryptoPP.copy_stream(StringIO.new(plaintext), StringIO.new))
+
+      [ :sha256_hmac, :not_a_digest ].each do |algorithm|
+        assert_raises(CryptoPP::CryptoPPError) do
+          CryptoPP.copy_stream(StringIO.new(plaintext), StringIO.new, :digests => [ :sha256, algorithm ])
+        end
+      end
+    end
+  end
 end
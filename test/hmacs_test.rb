@@ -29,4 +29,105 @@ class HMACsTest < MiniTest::Unit::TestCase
       end
     end
   end
+
+  def test_changing_the_key_rekeys_the_hmac
+    if CryptoPP.digest_enabled? :sha256_hmac
+      d = CryptoPP.hmac_factory(:sha256_hmac, {
+        :key => 'first key',
+        :plaintext => 'message'
+      })
+      first = d.calculate
+
+      d.key = 'second key'
+      second = d.calculate
+
+      refute_equal(first, second)
+      assert_equal(CryptoPP.digest_hmac(:sha256_hmac, 'message', 'second key'), second)
+      assert_equal(second, d.calculate)
+    end
+  end
+
+  def test_hmac_many
+    if CryptoPP.digest_enabled? :sha256_hmac
+      messages = [ '', 'first message', 'second message' * 100 ]
+      macs = CryptoPP.hmac_many(:sha256_hmac, 'key', messages)
+
+      assert_equal(messages.collect { |m| CryptoPP.digest_hmac(:sha256_hmac, m, 'key') }, macs)
+
+      pairs = messages.zip(macs)
+      pairs << [ 'first message', macs.last ]
+      pairs << [ 'first message', macs[1][0, 16] ]
+      assert_equal([ true, true, true, false, false ], CryptoPP.hmac_verify_many(:sha256_hmac, 'key', pairs))
+    end
+  end
+
+  def test_pbkdf2
+    if CryptoPP.digest_enabled? :sha_hmac
+      assert_equal('0c60c80f961f0e71f3a9b524af6012062fe037a6',
+        CryptoPP.pbkdf2(:sha, 'password', 'salt', 1, 20).unpack('H*').first)
+      assert_equal('4b007901b765489abead49d926f721d065a429c1',
+        CryptoPP.pbkdf2(:sha_hmac, 'password', 'salt', 4096, 20).unpack('H*').first)
+      assert_equal('3d2eec4fe41c849b80c8d83662c0e44a8b291a964cf2f07038',
+        CryptoPP.pbkdf2(:sha, 'passwordPASSWORDpassword', 'saltSALTsaltSALTsaltSALTsaltSALTsalt', 4096, 25).unpack('H*').first)
+
+      assert_raises(CryptoPP::CryptoPPError) do
+        CryptoPP.pbkdf2(:not_a_hash, 'password', 'salt', 1, 20)
+      end
+      [ [ 0, 20 ], [ -1, 20 ], [ 1, 0 ], [ 1, -1 ] ].each do |iterations, length|
+        assert_raises(ArgumentError) do
+          CryptoPP.pbkdf2(:sha, 'password', 'salt', iterations, length)
+        end
+      end
+    end
+  end
+
+  def test_pbkdf2_interrupted
+    if CryptoPP.digest_enabled? :sha_hmac
+      require 'timeout'
+
+      assert_raises(Timeout::Error) do
+        Timeout.timeout(0.1) do
+          CryptoPP.pbkdf2(:sha, 'password', 'salt', 0xffffffff, 20)
+        end
+      end
+    end
+  end
+
+  def test_kdf_with_busy_threads
+    if CryptoPP.digest_enabled? :sha256_hmac
+      expected = CryptoPP.pbkdf2(:sha256, 'password', 'salt', 2, 32)
+      hkdf_expected = CryptoPP.hkdf(:sha256, 'ikm', 'salt', 'info', 32)
+
+      # another thread wanting the GVL keeps the thread switch timer firing,
+      # so some derivations start with an interrupt already pending...
+      busy = Thread.new { loop { Thread.pass } }
+      begin
+        2000.times do
+          assert_equal(expected, CryptoPP.pbkdf2(:sha256, 'password', 'salt', 2, 32))
+          assert_equal(hkdf_expected, CryptoPP.hkdf(:sha256, 'ikm', 'salt', 'info', 32))
+        end
+      ensure
+        busy.kill
+      end
+    end
+  end
+
+  def test_hkdf
+    if CryptoPP.digest_enabled? :sha256_hmac
+      ikm = ["0b" * 22].pack('H*')
+      salt = ['000102030405060708090a0b0c'].pack('H*')
+      info = ['f0f1f2f3f4f5f6f7f8f9'].pack('H*')
+
+      assert_equal('3cb25f25faacd57a90434f64d0362f2a2d2d0a90cf1a5a4c5db02d56ecc4c5bf34007208d5b887185865',
+        CryptoPP.hkdf(:sha256, ikm, salt, info, 42).unpack('H*').first)
+      assert_equal('8da4e775a563c18f715f802a063c5a31b8a11f5c5ee1879ec3454e5f3c738d2d9d201395faa4b61a96c8',
+        CryptoPP.hkdf(:sha256_hmac, ikm, '', '', 42).unpack('H*').first)
+
+      [ 0, -1 ].each do |length|
+        assert_raises(ArgumentError) do
+          CryptoPP.hkdf(:sha256, ikm, salt, info, length)
+        end
+      end
+    end
+  end
 end